@@ -0,0 +1,54 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QTemporaryDir>
+#include <cstdio>
+#include "sap_cloud_client/api_client.h"
+#include "sap_cloud_client/backup_exporter.h"
+#include "server_thread.h"
+#include "support/test_data.h"
+
+using namespace sap::client;
+
+// bench_backup [files] [KiB each] [latency ms]: full-account export against a server with per-request latency
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    int files = argc > 1 ? QByteArray(argv[1]).toInt() : 500;
+    qint64 kib = argc > 2 ? QByteArray(argv[2]).toLongLong() : 64;
+    int latency_ms = argc > 3 ? QByteArray(argv[3]).toInt() : 20;
+
+    bench::ServerThread server;
+    server.call([&]() {
+        for (int i = 0; i < files; ++i)
+            server.server()->put_file(QString("dir%1/file%2.bin").arg(i % 10).arg(i), test::random_bytes(kib * 1024, i));
+        server.server()->faults().latency_ms = latency_ms;
+    });
+    ApiClient api;
+    api.set_server_url(server.url());
+    api.set_token("bench");
+
+    QTemporaryDir dir;
+    BackupExporter exporter(&api, dir.filePath("backup.tar"));
+    QEventLoop loop;
+    bool ok = false;
+    QObject::connect(&exporter, &BackupExporter::finished, &loop, [&](bool done, const QStringList& errors) {
+        ok = done && errors.isEmpty();
+        loop.quit();
+    });
+    QElapsedTimer timer;
+    timer.start();
+    exporter.start();
+    loop.exec();
+    double seconds = timer.nsecsElapsed() / 1e9;
+    if (!ok) {
+        std::fprintf(stderr, "Export failed\n");
+        return 1;
+    }
+
+    double bytes = double(files) * kib * 1024;
+    std::printf("%d files of %lld KiB, %d ms per request, %d requests in flight\n", files, static_cast<long long>(kib), latency_ms,
+                BackupExporter::k_MaxInFlight);
+    std::printf("%.2f s: %.0f files/s, %.1f MB/s\n", seconds, files / seconds, bytes / seconds / 1e6);
+    std::printf("one request at a time would need at least %.2f s\n", files * latency_ms / 1000.0);
+    return 0;
+}
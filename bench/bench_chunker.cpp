@@ -0,0 +1,83 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QRandomGenerator>
+#include <QSet>
+#include <QTemporaryDir>
+#include <cstdio>
+#include "sap_cloud_client/chunker.h"
+#include "support/test_data.h"
+
+using namespace sap::client;
+
+// bench_chunker [MiB] [edits]: boundary search and manifest throughput, and how much of an edited
+// copy dedups against the original
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    qint64 mib = argc > 1 ? QByteArray(argv[1]).toLongLong() : 512;
+    int edits = argc > 2 ? QByteArray(argv[2]).toInt() : 16;
+
+    QByteArray data = test::random_bytes(mib * 1024 * 1024, 1);
+    const auto* bytes = reinterpret_cast<const uchar*>(data.constData());
+
+    QElapsedTimer timer;
+    timer.start();
+    qint64 offset = 0;
+    int chunks = 0;
+    while (offset < data.size()) {
+        offset += Chunker::cut(bytes + offset, data.size() - offset);
+        chunks++;
+    }
+    double cut_s = timer.nsecsElapsed() / 1e9;
+
+    // Scattered inserts, deletes and overwrites of a few KiB each
+    QByteArray edited = data;
+    QRandomGenerator rng(2);
+    for (int i = 0; i < edits; ++i) {
+        qint64 at = rng.bounded(static_cast<quint32>(edited.size() - 8192));
+        switch (i % 3) {
+        case 0:
+            edited.insert(at, test::random_bytes(1000 + i, 3 + i));
+            break;
+        case 1:
+            edited.remove(at, 1000 + i);
+            break;
+        default:
+            edited.replace(at, 4096, test::random_bytes(4096, 3 + i));
+            break;
+        }
+    }
+
+    QTemporaryDir dir;
+    QString original = dir.filePath("original.bin");
+    QString copy = dir.filePath("edited.bin");
+    if (!test::write_file(original, data) || !test::write_file(copy, edited)) {
+        std::fprintf(stderr, "Cannot write test files\n");
+        return 1;
+    }
+
+    timer.start();
+    auto before = Chunker::manifest_for_file(original);
+    double manifest_s = timer.nsecsElapsed() / 1e9;
+    auto after = Chunker::manifest_for_file(copy);
+    if (!before || !after) {
+        std::fprintf(stderr, "Cannot chunk test files\n");
+        return 1;
+    }
+
+    QSet<QString> known;
+    for (const auto& chunk : before->chunks)
+        known.insert(chunk.hash);
+    qint64 new_bytes = 0;
+    for (const auto& chunk : after->chunks) {
+        if (!known.contains(chunk.hash))
+            new_bytes += chunk.size;
+    }
+
+    std::printf("%lld MiB, %d chunks, average %.0f KiB\n", static_cast<long long>(mib), chunks, data.size() / 1024.0 / chunks);
+    std::printf("boundaries only:  %6.2f GB/s\n", data.size() / cut_s / 1e9);
+    std::printf("chunk and hash:   %6.2f GB/s (from disk)\n", data.size() / manifest_s / 1e9);
+    std::printf("%d edits: %lld of %lld bytes new (%.2f%%), %.1fx less to send\n", edits, static_cast<long long>(new_bytes),
+                static_cast<long long>(edited.size()), 100.0 * new_bytes / edited.size(),
+                new_bytes > 0 ? double(edited.size()) / new_bytes : 0.0);
+    return 0;
+}
@@ -0,0 +1,90 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <cstdio>
+#include "sap_cloud_client/drive_cipher.h"
+#include "sap_cloud_client/upload_source.h"
+#include "support/test_data.h"
+
+using namespace sap::client;
+
+namespace {
+
+    // Reads the whole source the way the network stack does, in 64 KiB blocks; returns seconds
+    double drain(UploadSource& source) {
+        QByteArray block(64 * 1024, Qt::Uninitialized);
+        QElapsedTimer timer;
+        timer.start();
+        while (source.read(block.data(), block.size()) > 0) {
+        }
+        return timer.nsecsElapsed() / 1e9;
+    }
+
+} // anonymous namespace
+
+// bench_cipher [MiB]: chunk sealing in memory, and upload bodies with and without encryption
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    qint64 mib = argc > 1 ? QByteArray(argv[1]).toLongLong() : 256;
+    qint64 size = mib * 1024 * 1024;
+
+    DriveCipher cipher;
+    cipher.generate_key();
+    QByteArray plain = test::random_bytes(size, 1);
+
+    // Chunks straight from memory: AES-GCM alone
+    DriveCipher::FileKey key = cipher.new_file_key();
+    QByteArray sealed(DriveCipher::k_SealedChunkSize, Qt::Uninitialized);
+    QByteArray opened(DriveCipher::k_ChunkSize, Qt::Uninitialized);
+    QElapsedTimer timer;
+    timer.start();
+    quint64 index = 0;
+    for (qint64 pos = 0; pos < size; pos += DriveCipher::k_ChunkSize, ++index)
+        DriveCipher::seal_chunk(key, index, false, QByteArrayView(plain).sliced(pos, DriveCipher::k_ChunkSize), sealed.data());
+    double seal_s = timer.nsecsElapsed() / 1e9;
+    timer.start();
+    for (quint64 i = 0; i < index; ++i)
+        DriveCipher::open_chunk(key, i, false, sealed, opened.data());
+    double open_s = timer.nsecsElapsed() / 1e9;
+
+    QTemporaryDir dir;
+    QString local = dir.filePath("plain.bin");
+    QString encrypted = dir.filePath("sealed.bin");
+    if (!test::write_file(local, plain)) {
+        std::fprintf(stderr, "Cannot write %s\n", qPrintable(local));
+        return 1;
+    }
+
+    // Upload bodies from disk: hashing alone, then sealing and hashing
+    UploadSource plain_source(local);
+    UploadSource sealed_source(local, &cipher);
+    if (!plain_source.open(QIODevice::ReadOnly) || !sealed_source.open(QIODevice::ReadOnly)) {
+        std::fprintf(stderr, "Cannot open %s\n", qPrintable(local));
+        return 1;
+    }
+    double plain_body_s = drain(plain_source);
+    double sealed_body_s = drain(sealed_source);
+
+    UploadSource to_disk(local, &cipher);
+    if (!to_disk.open(QIODevice::ReadOnly) || !test::write_file(encrypted, to_disk.readAll())) {
+        std::fprintf(stderr, "Cannot write %s\n", qPrintable(encrypted));
+        return 1;
+    }
+
+    timer.start();
+    QString error;
+    if (!cipher.decrypt_file(encrypted, dir.filePath("decrypted.bin"), &error)) {
+        std::fprintf(stderr, "%s\n", qPrintable(error));
+        return 1;
+    }
+    double decrypt_s = timer.nsecsElapsed() / 1e9;
+
+    auto rate = [size](double seconds) { return size / seconds / 1e9; };
+    std::printf("%lld MiB in %lld KiB chunks\n", static_cast<long long>(mib), static_cast<long long>(DriveCipher::k_ChunkSize / 1024));
+    std::printf("seal chunks (memory):   %6.2f GB/s\n", rate(seal_s));
+    std::printf("open chunks (memory):   %6.2f GB/s\n", rate(open_s));
+    std::printf("plain upload body:      %6.2f GB/s\n", rate(plain_body_s));
+    std::printf("sealed upload body:     %6.2f GB/s\n", rate(sealed_body_s));
+    std::printf("decrypt file (to disk): %6.2f GB/s\n", rate(decrypt_s));
+    return 0;
+}
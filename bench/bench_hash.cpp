@@ -0,0 +1,33 @@
+#include <QCoreApplication>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <cstdio>
+#include "sap_cloud_client/hash_service.h"
+#include "support/test_data.h"
+
+using namespace sap::client;
+
+// bench_hash [FILE...]: hashing throughput for one file and for all of them in parallel.
+// Without arguments it hashes 8 generated files of 64 MiB.
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    QStringList paths = app.arguments().mid(1);
+
+    QTemporaryDir dir;
+    if (paths.isEmpty()) {
+        for (int i = 0; i < 8; ++i) {
+            QString path = dir.filePath(QString("file%1.bin").arg(i));
+            if (!test::write_file(path, test::random_bytes(64 * 1024 * 1024, i + 1))) {
+                std::fprintf(stderr, "Cannot write test files\n");
+                return 1;
+            }
+            paths.append(path);
+        }
+    }
+
+    double single = HashService::benchmark(paths.mid(0, 1));
+    double batch = HashService::benchmark(paths);
+    std::printf("one file:              %6.2f GB/s\n", single / 1e9);
+    std::printf("%3lld files in parallel: %6.2f GB/s\n", static_cast<long long>(paths.size()), batch / 1e9);
+    return 0;
+}
@@ -0,0 +1,88 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <cstdio>
+#include "sap_cloud_client/api_client.h"
+#include "sap_cloud_client/peer_cache.h"
+#include "server_thread.h"
+#include "support/peer_node.h"
+#include "support/test_data.h"
+
+using namespace sap::client;
+
+// bench_peer_cache [MiB] [origin MB/s]: one download from a throttled origin, then the same blob from a LAN peer
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    QStandardPaths::setTestModeEnabled(true);
+    qint64 mib = argc > 1 ? QByteArray(argv[1]).toLongLong() : 64;
+    qint64 origin_mbps = argc > 2 ? QByteArray(argv[2]).toLongLong() : 20;
+
+    QTemporaryDir dir;
+    QByteArray data = test::random_bytes(mib * 1024 * 1024, 70);
+    QString hash = test::StubServer::hash_of(data);
+    QString blob = dir.filePath("blob.bin");
+    if (!test::write_file(blob, data)) {
+        std::fprintf(stderr, "Cannot write %s\n", qPrintable(blob));
+        return 1;
+    }
+
+    bench::ServerThread server;
+    server.call([&]() {
+        server.server()->put_file("blob.bin", data);
+        server.server()->faults().bytes_per_sec = origin_mbps * 1000 * 1000;
+    });
+    ApiClient api;
+    api.set_server_url(server.url());
+    api.set_token("bench");
+
+    QEventLoop loop;
+    QElapsedTimer timer;
+    bool ok = false;
+    timer.start();
+    api.download_file("blob.bin", dir.filePath("origin.bin"), {}, [&](bool done) {
+        ok = done;
+        loop.quit();
+    });
+    loop.exec();
+    double origin_seconds = timer.nsecsElapsed() / 1e9;
+    if (!ok) {
+        std::fprintf(stderr, "Origin download failed\n");
+        return 1;
+    }
+
+    QByteArray key(32, 'b');
+    QProcess peer;
+    QString error;
+    if (!test::start_peer_node(peer, key, blob, hash, dir.filePath("peer"), &error)) {
+        std::fprintf(stderr, "Cannot start a peer: %s\n", qPrintable(error));
+        return 1;
+    }
+    PeerCache cache;
+    cache.set_account_key(key);
+    if (!cache.start()) {
+        std::fprintf(stderr, "%s\n", qPrintable(cache.last_error()));
+        return 1;
+    }
+    timer.restart();
+    cache.fetch(hash, data.size(), dir.filePath("peer.bin"), {}, [&](bool done) {
+        ok = done;
+        loop.quit();
+    });
+    loop.exec();
+    double peer_seconds = timer.nsecsElapsed() / 1e9;
+    peer.kill();
+    peer.waitForFinished();
+    if (!ok) {
+        std::fprintf(stderr, "No peer served the blob\n");
+        return 1;
+    }
+
+    double bytes = double(data.size());
+    std::printf("%lld MiB, origin throttled to %lld MB/s\n", static_cast<long long>(mib), static_cast<long long>(origin_mbps));
+    std::printf("origin: %.2f s, %.1f MB/s\n", origin_seconds, bytes / origin_seconds / 1e6);
+    std::printf("peer:   %.2f s, %.1f MB/s (including discovery)\n", peer_seconds, bytes / peer_seconds / 1e6);
+    std::printf("server egress saved: %lld bytes\n", static_cast<long long>(cache.stats().bytes_from_peers));
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QTemporaryDir>
+#include <cstdio>
+#include "sap_cloud_client/api_client.h"
+#include "sap_cloud_client/upload_session.h"
+#include "sap_cloud_client/upload_source.h"
+#include "server_thread.h"
+#include "support/test_data.h"
+
+using namespace sap::client;
+
+// bench_upload [MiB] [latency ms]: one streamed PUT against a multipart upload session, on the loopback
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    qint64 mib = argc > 1 ? QByteArray(argv[1]).toLongLong() : 128;
+    int latency_ms = argc > 2 ? QByteArray(argv[2]).toInt() : 0;
+
+    QTemporaryDir dir;
+    QString local = dir.filePath("upload.bin");
+    if (!test::write_file(local, test::random_bytes(mib * 1024 * 1024, 1))) {
+        std::fprintf(stderr, "Cannot write %s\n", qPrintable(local));
+        return 1;
+    }
+
+    bench::ServerThread server;
+    server.call([&]() { server.server()->faults().latency_ms = latency_ms; });
+    ApiClient api;
+    api.set_server_url(server.url());
+    api.set_token("bench");
+
+    QEventLoop loop;
+    QElapsedTimer timer;
+    bool ok = false;
+
+    auto* source = new UploadSource(local);
+    if (!source->open(QIODevice::ReadOnly)) {
+        std::fprintf(stderr, "Cannot open %s\n", qPrintable(local));
+        return 1;
+    }
+    timer.start();
+    api.upload_file("single.bin", source, {}, [&](bool done, QString) {
+        ok = done;
+        loop.quit();
+    });
+    loop.exec();
+    double single_ms = timer.nsecsElapsed() / 1e6;
+    if (!ok) {
+        std::fprintf(stderr, "Single PUT failed\n");
+        return 1;
+    }
+
+    UploadSession session(&api, local, "multipart.bin");
+    QObject::connect(&session, &UploadSession::finished, &loop, [&](bool done, const FileInfo&) {
+        ok = done;
+        loop.quit();
+    });
+    timer.start();
+    session.start();
+    loop.exec();
+    double multi_ms = timer.nsecsElapsed() / 1e6;
+    if (!ok) {
+        std::fprintf(stderr, "Multipart upload failed\n");
+        return 1;
+    }
+
+    int parts = server.call([&]() { return server.server()->requests("PUT part"); });
+    double bytes = mib * 1024.0 * 1024.0;
+    std::printf("%lld MiB, %d ms latency\n", static_cast<long long>(mib), latency_ms);
+    std::printf("single PUT: %8.1f ms  %7.1f MB/s\n", single_ms, bytes / single_ms / 1e3);
+    std::printf("multipart:  %8.1f ms  %7.1f MB/s  (%d parts of %lld MiB, %d in parallel)\n", multi_ms, bytes / multi_ms / 1e3, parts,
+                static_cast<long long>(session.part_size() / (1024 * 1024)), UploadSession::k_MaxConcurrentParts);
+    return 0;
+}
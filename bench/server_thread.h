@@ -0,0 +1,57 @@
+#pragma once
+
+#include <QCoreApplication>
+#include <QMetaObject>
+#include <QThread>
+#include <type_traits>
+#include "support/stub_server.h"
+
+namespace sap::client::bench {
+
+    // A StubServer on its own thread, so serving doesn't compete with the client's event loop.
+    // Everything that touches the server goes through call(), which runs on the server thread and waits.
+    class ServerThread {
+    public:
+        ServerThread() {
+            m_Thread.start();
+            m_Context.moveToThread(&m_Thread);
+            call([this]() {
+                m_Server = new test::StubServer();
+                m_Server->listen();
+            });
+        }
+
+        ~ServerThread() {
+            call([this]() {
+                delete m_Server;
+                m_Context.moveToThread(QCoreApplication::instance()->thread());
+            });
+            m_Thread.quit();
+            m_Thread.wait();
+        }
+
+        QString url() {
+            return call([this]() { return m_Server->url(); });
+        }
+
+        template <typename F> auto call(F f) {
+            using R = std::invoke_result_t<F>;
+            if constexpr (std::is_void_v<R>) {
+                QMetaObject::invokeMethod(&m_Context, f, Qt::BlockingQueuedConnection);
+            } else {
+                R result{};
+                QMetaObject::invokeMethod(&m_Context, [&result, &f]() { result = f(); }, Qt::BlockingQueuedConnection);
+                return result;
+            }
+        }
+
+        // Only valid inside call()
+        test::StubServer* server() { return m_Server; }
+
+    private:
+        QThread m_Thread;
+        QObject m_Context;
+        test::StubServer* m_Server = nullptr;
+    };
+
+} // namespace sap::client::bench
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+namespace sap::client {
+
+    // First-order Markov model of what gets opened after what. Keys are opaque strings.
+    // Each key counts the keys opened right after it. A row's counts are halved once they pass
+    // k_MaxRowCount so old habits fade, and a row keeps only its k_MaxSuccessors strongest
+    // successors. Past k_MaxRows, the least recently opened key is forgotten.
+    // Opens more than k_SessionGapMs apart are not linked.
+    class AccessPredictor {
+    public:
+        struct Prediction {
+            QString key;
+            double probability = 0;
+        };
+
+        static constexpr int k_MaxRows = 2000;
+        static constexpr int k_MaxSuccessors = 8;
+        static constexpr int k_MaxRowCount = 64;
+        static constexpr qint64 k_SessionGapMs = 30 * 60 * 1000;
+
+        AccessPredictor() = default;
+
+        void record(const QString& key, qint64 now_ms);
+        // The likeliest keys to follow key, best first
+        QVector<Prediction> predict(const QString& key, int count) const;
+        void clear();
+
+        bool load(const QString& path);
+        bool save(const QString& path) const;
+
+    private:
+        struct Row {
+            QHash<QString, int> next;
+            int total = 0;
+            quint64 seen = 0;
+        };
+
+        void trim(Row& row);
+
+        QHash<QString, Row> m_Rows;
+        QString m_Last;
+        qint64 m_LastAt = 0;
+        quint64 m_Clock = 0;
+    };
+
+} // namespace sap::client
@@ -1,23 +1,44 @@
 #pragma once
 
+#include <QHash>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QObject>
+#include <QPointer>
 #include <functional>
+#include <memory>
+#include "download_verifier.h"
+#include "segmented_download.h"
 #include "types.h"
+#include "upload_source.h"
 
 namespace sap::client {
 
+    // Byte-level transfer progress; total is -1 when the size is not known yet
+    using ProgressFn = std::function<void(qint64 done, qint64 total)>;
+
     class ApiClient : public QObject {
         Q_OBJECT
 
     public:
+        // Optional server endpoints; each is assumed present until the server answers 404/405/501
+        enum class Feature { UploadSessions, ContentChunks, Preflight, Batch, Move, Merkle, Manifests };
+
+        // Operations per batch request; larger batches are sent as consecutive requests
+        static constexpr int k_MaxBatchOps = 500;
+
         explicit ApiClient(QObject* parent = nullptr);
 
         void set_server_url(const QString& url) { m_BaseUrl = url; }
+        QString server_url() const { return m_BaseUrl; }
         void set_token(const QString& token) { m_Token = token; }
         QString token() const { return m_Token; }
         bool is_authenticated() const { return !m_Token.isEmpty(); }
+        bool supports(Feature feature) const { return !(m_MissingFeatures & feature_bit(feature)); }
+        // Deflate bounded upload bodies when the server accepts it and the data isn't already compressed
+        void set_upload_compression(bool enabled) { m_UploadCompression = enabled; }
+        // Aborts a reply returned by this class, or the uncompressed resend that took its place after a 415
+        void abort(QNetworkReply* reply);
 
         // Authentication
         void request_challenge(const QString& public_key, std::function<void(bool, AuthChallenge)> cb);
@@ -27,16 +48,76 @@ namespace sap::client {
         // Files
         void list_files(std::function<void(bool, QVector<FileInfo>)> cb);
         void get_file(const QString& path, std::function<void(bool, QByteArray)> cb);
+        // Streams the body into dest as it arrives; dest must stay open until cb fires.
+        // Every block written to dest is also handed to verifier, if given.
+        QNetworkReply* download_file(const QString& path, QIODevice* dest, ProgressFn progress, std::function<void(bool)> cb,
+                                     DownloadVerifier* verifier = nullptr);
+        // Streams into "<local_path>.part" and renames it over local_path once complete
+        QNetworkReply* download_file(const QString& path, const QString& local_path, ProgressFn progress, std::function<void(bool)> cb);
+        // Continues "<local_path>.part" from offset with a Range request (restarts if the server ignores it).
+        // With an expected hash the body is hashed as it is written (the existing prefix alongside the
+        // request) and a mismatch deletes the part file and fails. Any other failure keeps the part file
+        // for a later resume.
+        QNetworkReply* resume_download(const QString& path, const QString& local_path, qint64 offset, const QString& expected_hash,
+                                       ProgressFn progress, std::function<void(bool)> cb);
+        // Parallel Range requests into "<local_path>.part", verified against file.hash; falls back to one stream if needed
+        SegmentedDownload* download_file_segmented(const FileInfo& file, const QString& local_path, ProgressFn progress,
+                                                   std::function<void(bool)> cb);
+        // Raw ranged GET (length <= 0 means to the end: a Range header can't ask for nothing); the caller owns the reply
+        QNetworkReply* get_file_range(const QString& path, qint64 offset, qint64 length);
+        void head_file(const QString& path, std::function<void(bool, qint64)> cb);
         void upload_file(const QString& path, const QByteArray& data, std::function<void(bool)> cb);
+        // Sends an open source, deflated in memory when it is small enough and the server takes it;
+        // the reply takes ownership of source. cb receives the content hash of the source's bytes.
+        QNetworkReply* upload_file(const QString& path, UploadSource* source, ProgressFn progress, std::function<void(bool, QString)> cb);
         void delete_file(const QString& path, std::function<void(bool)> cb);
+        // Metadata-only rename on the server. Without the move endpoint it falls back to download,
+        // re-upload and delete, streamed through a temporary file; the old file is only removed
+        // once the new one is stored.
+        void move_file(const QString& from, const QString& to, std::function<void(bool)> cb);
+        // Renames every file under from_prefix in one request; cb receives how many were moved.
+        // The fallback lists the files and moves them through run_batch.
+        void move_prefix(const QString& from_prefix, const QString& to_prefix, std::function<void(bool, int)> cb);
+        // One round trip for a whole batch; the result is keyed by candidate path
+        void preflight_files(const QVector<FileCandidate>& files, std::function<void(bool, QHash<QString, PreflightStatus>)> cb);
+        // Creates files from content the server already stores; cb receives the paths it couldn't link
+        void link_files(const QVector<FileCandidate>& files, std::function<void(bool, QStringList)> cb);
+
+        // Resumable uploads: create a session, PUT numbered parts, then complete
+        void create_upload(const QString& path, qint64 size, qint64 part_size, std::function<void(bool, UploadStatus)> cb);
+        void get_upload(const QString& upload_id, std::function<void(bool, UploadStatus)> cb);
+        QNetworkReply* upload_part(const QString& upload_id, int part, UploadSource* source, ProgressFn progress, std::function<void(bool)> cb);
+        // content_hash is of the whole file; the server refuses to commit parts that don't add up to it
+        void complete_upload(const QString& upload_id, const QString& content_hash, std::function<void(bool, FileInfo)> cb);
+        void abort_upload(const QString& upload_id, std::function<void(bool)> cb);
+
+        // Content-addressed chunks: ask which are missing, PUT those, then commit the file as a manifest
+        void find_missing_chunks(const QStringList& hashes, std::function<void(bool, QStringList)> cb);
+        QNetworkReply* upload_chunk(const QString& hash, UploadSource* source, ProgressFn progress, std::function<void(bool)> cb);
+        // On failure cb receives the chunks the server no longer has (empty for any other error)
+        void commit_manifest(const FileManifest& manifest, std::function<void(bool, QStringList)> cb);
+        // Chunk list of a stored file; fails quietly for files that weren't stored as chunks
+        void get_manifest(const QString& path, std::function<void(bool, FileManifest)> cb);
+
+        // Batched mutations: one request per k_MaxBatchOps operations, falling back to one request per
+        // operation when the server has no batch endpoint. cb always receives one result per op, in order;
+        // deleting something that is already gone counts as success.
+        void run_batch(const QVector<BatchOp>& ops, std::function<void(bool, QVector<BatchResult>)> cb);
 
         // Sync
         void get_sync_state(std::function<void(bool, SyncState)> cb, std::optional<Timestamp> since = std::nullopt);
+        // One directory of the server's Merkle tree ("" is the root, others end in '/');
+        // without children only the digest is returned
+        void get_merkle_node(const QString& dir, bool with_children, std::function<void(bool, MerkleNode)> cb);
+
+        // LAN peers: a secret shared by every session of the signed-in account, for PeerCache
+        void get_peer_key(std::function<void(bool, QByteArray)> cb);
 
         // Notes
         void list_notes(std::function<void(bool, QVector<NoteItem>)> cb);
         void get_note(const QString& id, std::function<void(bool, Note)> cb);
-        void create_note(const Note& note, std::function<void(bool, Note)> cb);
+        // A retried create with the same idempotency key returns the note created the first time
+        void create_note(const Note& note, std::function<void(bool, Note)> cb, const QString& idempotency_key = {});
         void update_note(const QString& id, const Note& note, std::function<void(bool, Note)> cb);
         void delete_note(const QString& id, std::function<void(bool)> cb);
         void get_tags(std::function<void(bool, QVector<QString>)> cb);
@@ -48,10 +129,46 @@ namespace sap::client {
 
     private:
         QNetworkRequest make_request(const QString& endpoint);
+        QNetworkRequest make_upload_request(const QString& path);
+        // Request bodies are deflated once the server has advertised it accepts that (RFC 7694)
+        void note_encodings(QNetworkReply* reply);
+        QByteArray encode_body(QNetworkRequest& req, const QByteArray& body, bool check_entropy);
+        // POSTs or PUTs body through encode_body; a deflated body is remembered until the reply finishes
+        QNetworkReply* send_body(QNetworkAccessManager::Operation op, QNetworkRequest req, const QByteArray& body, bool check_entropy,
+                                 ProgressFn progress = {});
+        // Calls handler once reply is done. A deflated body the server rejects with 415 is resent
+        // uncompressed first, and handler sees the resend's reply instead.
+        void when_finished(QNetworkReply* reply, std::function<void(QNetworkReply*)> handler);
+        QNetworkReply* post_json(const QString& endpoint, const QJsonObject& obj);
+        QNetworkReply* post_json(QNetworkRequest req, const QJsonObject& obj);
+        QNetworkReply* put_json(const QString& endpoint, const QJsonObject& obj);
+        // PUTs a file window with its Content-Length, compressed in memory when small enough; takes ownership of source
+        QNetworkReply* put_source(QNetworkRequest req, UploadSource* source, ProgressFn progress);
+        void move_by_copy(const QString& from, const QString& to, std::function<void(bool)> cb);
+        struct SingleOps;
+        void send_batch_slice(const QVector<BatchOp>& ops, qsizetype offset, std::shared_ptr<QVector<BatchResult>> results,
+                              std::function<void(bool, QVector<BatchResult>)> cb);
+        void run_ops_individually(const QVector<BatchOp>& ops, std::shared_ptr<QVector<BatchResult>> results,
+                                  std::function<void(bool, QVector<BatchResult>)> cb);
+        void pump_single_ops(std::shared_ptr<SingleOps> state);
+        void run_single_op(const BatchOp& op, std::function<void(BatchResult)> cb);
+        void stream_reply(QNetworkReply* reply, QIODevice* dest, ProgressFn progress, std::function<void(bool)> cb,
+                          DownloadVerifier* verifier = nullptr);
+        // Records the feature as missing when the reply says the endpoint doesn't exist; returns true if so
+        bool note_missing_feature(QNetworkReply* reply, Feature feature);
+        static quint32 feature_bit(Feature feature) { return 1u << static_cast<int>(feature); }
 
         QNetworkAccessManager* m_Net;
         QString m_BaseUrl;
         QString m_Token;
+        quint32 m_MissingFeatures = 0;
+        bool m_ServerAcceptsDeflate = false;
+        bool m_DeflateRejected = false;
+        bool m_UploadCompression = true;
+        // Deflated requests still in flight -> how to send them again uncompressed
+        QHash<QNetworkReply*, std::function<QNetworkReply*()>> m_Resend;
+        // Rejected requests -> their uncompressed resend, so abort() reaches the live one
+        QHash<QNetworkReply*, QPointer<QNetworkReply>> m_Replaced;
     };
 
 } // namespace sap::client
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QNetworkReply>
+#include <QObject>
+#include <QPointer>
+#include <QStringList>
+#include <deque>
+#include "tar_writer.h"
+#include "types.h"
+
+namespace sap::client {
+
+    class ApiClient;
+
+    // Streams a whole account into one tar archive: every live Drive file under files/,
+    // every note under notes/ as Markdown with a front-matter header.
+    // - Up to k_MaxInFlight requests run at once; large files are split into ranged segments
+    // - Each file's region in the archive is reserved when its first request goes out, so bytes are
+    //   written straight to disk as they arrive, in whatever order requests complete
+    // - Memory stays at a few read buffers regardless of account size
+    // Files that fail after retries keep a zero-filled entry and are listed in BACKUP_ERRORS.txt.
+    class BackupExporter : public QObject {
+        Q_OBJECT
+
+    public:
+        static constexpr int k_MaxInFlight = 8;
+        static constexpr qint64 k_SegmentSize = 8LL * 1024 * 1024;
+        static constexpr qint64 k_ReadBufferSize = 256 * 1024;
+        static constexpr int k_MaxRetries = 3;
+
+        BackupExporter(ApiClient* api, const QString& archive_path, QObject* parent = nullptr);
+
+        void start();
+        void abort();
+
+    signals:
+        void progress(qint64 bytes_done, qint64 bytes_total, int entries_done, int entries_total);
+        // Emitted exactly once; errors lists entries that could not be backed up
+        void finished(bool ok, const QStringList& errors);
+
+    private:
+        struct Segment {
+            int file = 0;
+            qint64 archive_offset = 0; // where the file's data starts in the archive
+            qint64 offset = 0;         // within the file
+            qint64 length = 0;
+            qint64 written = 0;
+            // Current request: the file position it asked for and how many body bytes came back
+            qint64 attempt_start = 0;
+            qint64 received = 0;
+            int retries = 0;
+            QPointer<QNetworkReply> reply;
+        };
+
+        void on_listed();
+        void pump();
+        bool dispatch_next_file();
+        void fetch_segment(quint64 id);
+        void on_segment_data(quint64 id);
+        void on_segment_finished(quint64 id, QNetworkReply* reply);
+        void finish_segment(quint64 id);
+        void fetch_note(int index);
+        void entry_done();
+        void report_progress();
+        void fail(const QString& error);
+        void complete();
+
+        ApiClient* m_Api;
+        TarWriter m_Tar;
+
+        QVector<FileInfo> m_Files;
+        QVector<NoteItem> m_Notes;
+        int m_Listed = 0;
+        bool m_ListFailed = false;
+
+        int m_NextFile = 0;
+        int m_NextNote = 0;
+        QHash<int, int> m_SegmentsLeft;
+        std::deque<quint64> m_Queue;
+        QHash<quint64, Segment> m_Segments;
+        quint64 m_NextSegment = 1;
+        int m_InFlight = 0;
+        int m_Waiting = 0; // segments backing off before a retry
+
+        qint64 m_BytesTotal = 0;
+        qint64 m_BytesDone = 0;
+        int m_EntriesDone = 0;
+        QStringList m_Errors;
+        QElapsedTimer m_ProgressClock;
+        bool m_Done = false;
+    };
+
+} // namespace sap::client
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <QCache>
+#include <QHash>
+#include <QObject>
+#include <functional>
+#include "api_client.h"
+
+namespace sap::client {
+
+    // Remote file content in fixed-size blocks, fetched on demand with Range requests and kept in
+    // memory. Blocks are keyed by content hash, so a file that changed never serves stale data.
+    // Least recently used blocks go once the cache passes its limit, and concurrent reads of one
+    // block share a single request.
+    class BlockCache : public QObject {
+        Q_OBJECT
+
+    public:
+        using ReadFn = std::function<void(bool ok, const QByteArray& data)>;
+
+        struct Stats {
+            qint64 hits = 0;
+            qint64 misses = 0;
+            qint64 bytes_fetched = 0;
+        };
+
+        static constexpr qint64 k_BlockSize = 1024 * 1024;
+        static constexpr qint64 k_DefaultLimit = 256LL * 1024 * 1024;
+
+        explicit BlockCache(ApiClient* api, QObject* parent = nullptr);
+
+        // Block index of file (shorter at the end of the file). A cached block calls cb right away.
+        void read(const FileInfo& file, qint64 index, ReadFn cb);
+        // Fetches the block in the background if it isn't cached or on its way
+        void prefetch(const FileInfo& file, qint64 index);
+        qint64 block_count(const FileInfo& file) const { return (file.size + k_BlockSize - 1) / k_BlockSize; }
+
+        void set_limit(qint64 bytes);
+        Stats stats() const { return m_Stats; }
+
+    private:
+        void fetch(const FileInfo& file, qint64 index, const QString& key);
+
+        ApiClient* m_Api;
+        // Cost is the block size in bytes, so the cache's max cost is the memory limit
+        QCache<QString, QByteArray> m_Blocks;
+        QHash<QString, QVector<ReadFn>> m_Waiting;
+        Stats m_Stats;
+    };
+
+} // namespace sap::client
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <QFile>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+namespace sap::client {
+
+    // Local record of chunk hashes the server is known to hold.
+    // Lets a dedup upload skip asking about chunks it already sent; the server stays
+    // authoritative and reports collected chunks when a manifest is committed.
+    // File layout: "SAPC" magic, u32 version, then raw fixed-size digests appended in order.
+    class ChunkIndex {
+    public:
+        // Past this the index is started over rather than grown; it is only an optimization
+        static constexpr int k_MaxEntries = 4 * 1024 * 1024;
+
+        explicit ChunkIndex(const QString& path);
+
+        bool open();
+        QString last_error() const { return m_LastError; }
+
+        bool contains(const QString& hash) const;
+        // Hex digests; already known ones are skipped
+        void insert(const QStringList& hashes);
+        void forget(const QStringList& hashes);
+        int size() const { return static_cast<int>(m_Hashes.size()); }
+
+    private:
+        bool rewrite();
+
+        QString m_Path;
+        QFile m_File;
+        QSet<QByteArray> m_Hashes;
+        QString m_LastError;
+    };
+
+} // namespace sap::client
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <QString>
+#include <optional>
+#include "types.h"
+
+namespace sap::client {
+
+    // FastCDC-style content-defined chunking.
+    // Boundaries come from a rolling gear hash of the content itself, so an insert or delete
+    // only moves the boundaries around the edit and every other chunk keeps its hash.
+    // Normalized chunking: a stricter mask before the average size and a looser one after
+    // it pulls chunk sizes towards k_AvgSize.
+    class Chunker {
+    public:
+        static constexpr qint64 k_MinSize = 256 * 1024;
+        static constexpr qint64 k_AvgSize = 1024 * 1024;
+        static constexpr qint64 k_MaxSize = 4 * 1024 * 1024;
+
+        // Length of the first chunk in data[0, size); size itself when no boundary is found
+        static qint64 cut(const uchar* data, qint64 size);
+
+        // Chunks and hashes a file in one streaming pass (chunk hashes and the whole-file hash)
+        static std::optional<FileManifest> manifest_for_file(const QString& local_path);
+    };
+
+} // namespace sap::client
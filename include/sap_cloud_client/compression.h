@@ -0,0 +1,18 @@
+#pragma once
+
+#include <QByteArray>
+#include <QByteArrayView>
+
+namespace sap::client {
+
+    // Shannon entropy of the bytes in data, in bits per byte (0 to 8)
+    double byte_entropy(QByteArrayView data);
+
+    // Cheap check on a few spread-out samples; false for media, archives and encrypted data,
+    // where compressing would only cost CPU
+    bool looks_compressible(QByteArrayView data);
+
+    // Body for "Content-Encoding: deflate", which HTTP defines as a zlib stream (RFC 9110)
+    QByteArray deflate_body(QByteArrayView data, int level = -1);
+
+} // namespace sap::client
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+namespace sap::client {
+
+    // File content on local disk, addressed by content hash: <root>/<first two hex digits>/<hash>.
+    // Blobs are written under a temporary name and only committed once their hash checked out,
+    // so a blob that exists is always complete. Identical files share one blob.
+    class ContentStore {
+    public:
+        ContentStore() = default;
+
+        // Creates the directory if needed and counts what is already there
+        bool open(const QString& root);
+        QString root() const { return m_Root; }
+        QString last_error() const { return m_LastError; }
+
+        bool contains(const QString& hash) const { return m_Sizes.contains(hash.toLower()); }
+        // Where the blob lives, whether or not it exists yet
+        QString path(const QString& hash) const;
+        // Where to write a blob before commit(), with its directory created. Temporaries
+        // left over from an interrupted fetch are removed by open().
+        QString prepare(const QString& hash);
+        // Moves a verified temporary into place
+        bool commit(const QString& hash);
+        // Deletes every blob whose (lowercase) hash is not in keep; returns the bytes freed
+        qint64 retain(const QSet<QString>& keep);
+
+        qint64 usage() const { return m_Usage; }
+        int size() const { return static_cast<int>(m_Sizes.size()); }
+        QStringList hashes() const { return m_Sizes.keys(); }
+        qint64 blob_size(const QString& hash) const { return m_Sizes.value(hash.toLower(), 0); }
+
+    private:
+        QString temp_path(const QString& hash) const;
+
+        QString m_Root;
+        QHash<QString, qint64> m_Sizes;
+        qint64 m_Usage = 0;
+        QString m_LastError;
+    };
+
+} // namespace sap::client
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <QHash>
+#include <QNetworkReply>
+#include <QObject>
+#include <QPointer>
+#include <QVector>
+#include "types.h"
+
+namespace sap::client {
+
+    class ApiClient;
+    class ChunkIndex;
+
+    // Uploads a file as content-defined chunks, sending only the chunks the server lacks:
+    // - The file is chunked and hashed off the GUI thread (Chunker::manifest_for_file)
+    // - Chunks in the local ChunkIndex are assumed present; the rest are checked with the server
+    // - Missing chunks are PUT in parallel, then the manifest commits the file
+    // An edited file therefore costs roughly the size of the edit instead of the whole file.
+    class DedupUpload : public QObject {
+        Q_OBJECT
+
+    public:
+        // Smaller files fit in a handful of chunks, where the extra round trips outweigh any savings
+        static constexpr qint64 k_MinFileSize = 8LL * 1024 * 1024;
+        static constexpr int k_MaxConcurrentChunks = 4;
+        static constexpr int k_MaxChunkRetries = 3;
+
+        DedupUpload(ApiClient* api, ChunkIndex* index, const QString& local_path, const QString& remote_path, QObject* parent = nullptr);
+
+        void start();
+        void abort();
+
+        qint64 bytes_total() const { return m_Manifest.size; }
+        // Chunk bytes that actually went over the wire
+        qint64 bytes_sent() const { return m_SentBytes; }
+
+    signals:
+        void progress(qint64 done, qint64 total);
+        // Emitted exactly once
+        void finished(bool ok);
+
+    private:
+        struct InFlight {
+            QPointer<QNetworkReply> reply;
+            qint64 sent = 0;
+        };
+
+        void on_manifest(const FileManifest& manifest);
+        void queue_missing(const QStringList& missing);
+        void pump();
+        void send_chunk(const ChunkRef& chunk);
+        void on_chunk_finished(const ChunkRef& chunk, bool ok);
+        void commit();
+        void report_progress();
+        void complete(bool ok);
+
+        ApiClient* m_Api;
+        ChunkIndex* m_Index;
+        QString m_LocalPath;
+        QString m_RemotePath;
+
+        FileManifest m_Manifest;
+        // First occurrence of every distinct chunk, by hash
+        QHash<QString, ChunkRef> m_Unique;
+        QVector<ChunkRef> m_Queue;
+        QHash<QString, InFlight> m_InFlight;
+        QHash<QString, int> m_Retries;
+        qint64 m_PendingBytes = 0;
+        qint64 m_SentBytes = 0;
+        bool m_Recommitted = false;
+        bool m_Committing = false;
+        bool m_Done = false;
+    };
+
+} // namespace sap::client
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <memory>
+#include "types.h"
+
+namespace sap::client {
+
+    // Checks a download against its content hash while it arrives, so there is no second pass once it is done.
+    // Bytes are fed in file order, either as they come off the network or as a range that is already on
+    // disk (a resumed prefix, or what a later segment wrote before the hash frontier got there). Hashing
+    // runs on HashService's pool one task at a time, overlapping the transfer instead of following it.
+    // Given the file's chunk manifest, every chunk is checked as well: a bad one is reported so the caller
+    // can fetch that range again and rewind() to it, instead of failing the whole file at the end.
+    class DownloadVerifier : public QObject {
+        Q_OBJECT
+
+    public:
+        // Hashing done by every verifier in this process
+        struct Totals {
+            qint64 bytes = 0;
+            qint64 busy_ns = 0;
+
+            double bytes_per_sec() const { return busy_ns > 0 ? bytes * 1e9 / busy_ns : 0.0; }
+        };
+
+        // chunks must tile the file from offset 0; anything else is ignored
+        explicit DownloadVerifier(const QString& expected_hash, const QVector<ChunkRef>& chunks = {}, QObject* parent = nullptr);
+        ~DownloadVerifier() override;
+
+        bool has_chunks() const { return m_HasChunks; }
+        // Bytes handed over so far; the next add() continues at this offset
+        qint64 fed() const { return m_Fed; }
+        void add(const QByteArray& data);
+        // Hashes [fed(), fed() + length) of the file at path
+        void add_file(const QString& path, qint64 length);
+        // Drops everything after offset, which must be 0 or the start of the chunk last reported bad
+        void rewind(qint64 offset);
+        // No more bytes; finished follows once everything queued is hashed. Ignored while a bad chunk
+        // waits for its rewind, so call it again after feeding the repaired range.
+        void finish();
+
+        static Totals totals();
+
+    signals:
+        // The chunk at [offset, offset + size) does not match the manifest; later bytes are ignored until rewind()
+        void chunk_failed(qint64 offset, qint64 size);
+        void finished(bool ok, const QString& actual_hash);
+
+    private:
+        struct Task;
+        struct State;
+
+        void post(Task task);
+
+        std::shared_ptr<State> m_State;
+        qint64 m_Fed = 0;
+        bool m_HasChunks = false;
+    };
+
+} // namespace sap::client
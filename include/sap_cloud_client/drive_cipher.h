@@ -0,0 +1,83 @@
+#pragma once
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QString>
+
+namespace sap::client {
+
+    // Client-side encryption for Drive files: AES-256-GCM over fixed-size chunks.
+    // Layout: header ("SAPE", version, reserved, 32-byte salt), then every chunk as ciphertext || 16-byte tag.
+    // - Each file gets its own subkey, HKDF(master key, salt), so chunk nonces are just the chunk index
+    // - The header and a last-chunk flag are authenticated with every chunk, so truncation,
+    //   reordering or a swapped header fail to decrypt
+    // - Chunks sit at fixed offsets and authenticate on their own, so any range can be decrypted
+    //   without reading the rest of the file
+    class DriveCipher {
+    public:
+        static constexpr int k_KeySize = 32;
+        static constexpr int k_SaltSize = 32;
+        static constexpr int k_TagSize = 16;
+        static constexpr qint64 k_HeaderSize = 8 + k_SaltSize;
+        static constexpr qint64 k_ChunkSize = 64 * 1024;
+        static constexpr qint64 k_SealedChunkSize = k_ChunkSize + k_TagSize;
+
+        // What a file on disk turned out to be
+        enum class Probe {
+            Plain,     // not in our layout, or a plaintext that merely starts with the magic
+            Sealed,    // our layout and the first chunk authenticates under our key
+            Unreadable // our layout but no key, or a key other than ours
+        };
+
+        // What one file needs to seal or open its chunks
+        struct FileKey {
+            QByteArray header;
+            QByteArray key;
+
+            bool is_valid() const { return key.size() == k_KeySize; }
+        };
+
+        DriveCipher();
+        ~DriveCipher();
+        // Work queued for another thread takes a copy, so the key can be replaced meanwhile
+        DriveCipher(const DriveCipher& other) = default;
+        DriveCipher& operator=(const DriveCipher& other) = default;
+
+        // Master key file: 32 raw bytes, owner read/write only
+        bool load_key(const QString& path);
+        bool generate_key();
+        bool save_key(const QString& path);
+        bool has_key() const { return m_Key.size() == k_KeySize; }
+
+        // Fresh random salt for a file about to be encrypted
+        FileKey new_file_key() const;
+        // Key for an existing file from its header; invalid if the header isn't ours
+        FileKey file_key(QByteArrayView header) const;
+
+        static bool is_encrypted(QByteArrayView header);
+        static qint64 chunk_count(qint64 plain_size);
+        static qint64 encrypted_size(qint64 plain_size);
+        static qint64 plain_size(qint64 encrypted_size);
+
+        // out must hold plain.size() + k_TagSize bytes
+        static bool seal_chunk(const FileKey& key, quint64 index, bool last, QByteArrayView plain, char* out);
+        // out must hold sealed.size() - k_TagSize bytes; false if the chunk fails authentication
+        static bool open_chunk(const FileKey& key, quint64 index, bool last, QByteArrayView sealed, char* out);
+
+        // Magic alone can't tell a sealed file from a plaintext one that starts with "SAPE", so the
+        // size has to fit the layout and the first chunk has to authenticate
+        Probe probe_file(const QString& path) const;
+        // Streams an encrypted file into a plain one, chunk by chunk; safe to call from a worker thread
+        bool decrypt_file(const QString& source, const QString& target, QString* error = nullptr) const;
+
+        QString last_error() const { return m_LastError; }
+
+    private:
+        QByteArray m_Key;
+        mutable QString m_LastError;
+
+        void set_error(const QString& error) const { m_LastError = error; }
+        void clear_error() const { m_LastError.clear(); }
+    };
+
+} // namespace sap::client
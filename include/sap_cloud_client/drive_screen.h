@@ -1,5 +1,6 @@
 #pragma once
 
+#include <QHash>
 #include <QLabel>
 #include <QLineEdit>
 #include <QMenu>
@@ -8,6 +9,9 @@
 #include <QTreeWidget>
 #include <QWidget>
 #include "api_client.h"
+#include "offline_store.h"
+#include "sync_engine.h"
+#include "transfer_manager.h"
 
 namespace sap::client {
 
@@ -15,19 +19,30 @@ namespace sap::client {
         Q_OBJECT
 
     public:
-        explicit DriveScreen(ApiClient* api, QWidget* parent = nullptr);
+        DriveScreen(ApiClient* api, TransferManager* transfers, SyncEngine* sync, OfflineStore* offline, QWidget* parent = nullptr);
         void refresh();
 
+    protected:
+        void dragEnterEvent(QDragEnterEvent* event) override;
+        void dropEvent(QDropEvent* event) override;
+
     private slots:
         void on_upload();
+        void on_upload_folder();
         void on_delete();
         void on_download();
         void on_rename();
+        void on_rename_folder();
         void on_info();
         void on_selection_changed();
         void on_search(const QString& text);
         void on_item_double_clicked(QTreeWidgetItem* item, int column);
         void on_context_menu(const QPoint& pos);
+        void on_cancel_transfers();
+        void on_transfer_stats();
+        void on_transfer_batch_finished(int succeeded, int failed, int cancelled);
+        void on_sync_changed(const QStringList& updated, const QStringList& removed);
+        void on_offline_changed();
 
     private:
         void setup_ui();
@@ -36,8 +51,22 @@ namespace sap::client {
         QString format_time(qint64 ms);
         QString get_file_icon(const QString& path);
         void show_file_info_dialog(const FileInfo& file);
+        void begin_transfer_batch(const QString& verb, bool reload_after);
+        // Files upload under their name, folders under their name plus each file's relative path
+        void upload_paths(const QStringList& paths);
+        void update_offline_mark(QTreeWidgetItem* item);
+        void toggle_pin(const QString& path);
+        // Opens the file in its default application: a pinned or prefetched copy goes straight
+        // there, anything else is downloaded first
+        void open_item(const QString& path);
+        // Where opened files are put, one folder per remote folder so equal names don't collide
+        QString open_path(const QString& path) const;
+        void launch(const QString& path, const QString& local_path);
 
         ApiClient* m_Api;
+        TransferManager* m_Transfers;
+        SyncEngine* m_Sync;
+        OfflineStore* m_Offline;
 
         // Header
         QLabel* m_Title;
@@ -55,9 +84,18 @@ namespace sap::client {
         // Status
         QLabel* m_Status;
         QProgressBar* m_Progress;
+        QPushButton* m_CancelBtn;
+
+        // Current transfer batch
+        QString m_TransferVerb;
+        bool m_ReloadAfterBatch = false;
+        // Items a batched request reported as failed while the request itself succeeded
+        int m_ItemsFailed = 0;
 
-        // Data
-        QVector<FileInfo> m_Files;
+        // Tree rows by remote path, updated from sync deltas
+        QHash<QString, QTreeWidgetItem*> m_Items;
+        // Downloads started by open_item(): job -> remote path and where it lands
+        QHash<TransferScheduler::JobId, QPair<QString, QString>> m_OpenAfterDownload;
     };
 
 } // namespace sap::client
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+#include <QTimer>
+#include <functional>
+#include "folder_watcher.h"
+#include "sync_engine.h"
+#include "transfer_manager.h"
+
+namespace sap::client {
+
+    // Two-way sync between a local folder and remote_prefix on the server.
+    // Local changes come from FolderWatcher; remote ones from SyncEngine deltas. Each synced file
+    // keeps a record of its last agreed state (local size, mtime and hash, remote hash), so:
+    // - A changed size or mtime is the cheap first check; only then is the file hashed (off-thread)
+    // - A side that differs from the record changed; if only one did, it wins
+    // - If both did, the local copy is renamed "<name> (conflict <date>)" and the remote one pulled
+    // Files this class writes itself are recorded when the download completes, so their watcher
+    // events compare equal and are not echoed back to the server.
+    class FolderSync : public QObject {
+        Q_OBJECT
+
+    public:
+        static constexpr int k_SaveDelayMs = 2000;
+
+        FolderSync(ApiClient* api, TransferManager* transfers, SyncEngine* sync, const QString& local_root,
+                   const QString& remote_prefix, QObject* parent = nullptr);
+        ~FolderSync() override;
+
+        bool start();
+        QString last_error() const { return m_LastError; }
+        QString local_root() const { return m_Root; }
+
+    signals:
+        // A change was pushed or pulled
+        void activity(const QString& relative_path, bool uploaded);
+
+    private:
+        struct Record {
+            qint64 size = 0;
+            qint64 mtime = 0;
+            QString local_hash;
+            // Empty while an upload's result hasn't shown up in the delta feed yet
+            QString remote_hash;
+        };
+
+        struct LocalFile {
+            QString path; // relative
+            qint64 size = 0;
+            qint64 mtime = 0;
+            QString hash;
+        };
+
+        struct Job {
+            QString path;
+            bool upload = false;
+            LocalFile local;     // what was uploaded
+            QString remote_hash; // what was downloaded
+        };
+
+        void scan(const QStringList& relative_paths, bool initial = false);
+        // Hashes on the pool and calls done on this thread; files that can't be read are dropped
+        void hash_files(const QVector<LocalFile>& files, std::function<void(QVector<LocalFile>)> done);
+        void on_scanned(const QStringList& roots, const QVector<LocalFile>& files, bool initial);
+        void on_hashed(const QVector<LocalFile>& files, bool initial);
+        void on_local_file(const LocalFile& file);
+        void on_local_deleted(const QString& path, QVector<BatchOp>& deletes);
+        void on_remote_changed(const QStringList& updated, const QStringList& removed);
+        void on_job_finished(TransferScheduler::JobId id, bool ok);
+        void reconcile_remote();
+
+        void push(const LocalFile& file);
+        void pull(const FileInfo& remote);
+        void keep_both(const LocalFile& file, const FileInfo& remote);
+        bool local_matches_record(const QString& path) const;
+        QString remote_path(const QString& relative) const { return m_Prefix + relative; }
+        QString local_path(const QString& relative) const { return m_Root + '/' + relative; }
+        bool busy(const QString& path) const;
+        void mark_done(const QString& path);
+
+        QString state_path() const;
+        void load();
+        void save();
+
+        ApiClient* m_Api;
+        TransferManager* m_Transfers;
+        SyncEngine* m_Sync;
+        FolderWatcher* m_Watcher;
+        QString m_Root;
+        QString m_Prefix;
+        QString m_LastError;
+
+        QHash<QString, Record> m_Records;
+        QHash<TransferScheduler::JobId, Job> m_Jobs;
+        QSet<QString> m_Busy;
+        // Paths that changed locally or remotely while busy; rechecked once their transfer ends
+        QSet<QString> m_Dirty;
+        QSet<QString> m_RemoteDirty;
+        bool m_InitialScanDone = false;
+        bool m_RemoteReconciled = false;
+        QTimer m_SaveTimer;
+    };
+
+} // namespace sap::client
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+#include <QTimer>
+#include <memory>
+
+class QFileSystemWatcher;
+class QSocketNotifier;
+
+namespace sap::client {
+
+    // Reports changes under a local directory tree, coalesced into bursts.
+    // On Linux (and Android) this is one inotify watch per directory, registered from the thread
+    // pool so a large tree doesn't stall the GUI; elsewhere QFileSystemWatcher stands in and only
+    // reports which directory changed. Events are held until k_SettleMs pass without new ones,
+    // but never longer than k_MaxDelayMs, and paths under a reported directory are folded into it.
+    class FolderWatcher : public QObject {
+        Q_OBJECT
+
+    public:
+        static constexpr int k_SettleMs = 300;
+        static constexpr int k_MaxDelayMs = 2000;
+
+        explicit FolderWatcher(const QString& root, QObject* parent = nullptr);
+        ~FolderWatcher() override;
+
+        bool start();
+        QString last_error() const { return m_LastError; }
+
+    signals:
+        // Relative paths that may have changed; a path ending in '/' stands for its whole subtree
+        void changed(const QStringList& paths);
+        // Events were lost (queue overflow, watch limit); the whole tree needs rescanning
+        void overflowed();
+
+    private:
+        struct Watches;
+
+        void watch_tree(const QString& relative_dir);
+        void on_readable();
+        void note(const QString& relative_path);
+        void flush();
+
+        QString m_Root;
+        QString m_LastError;
+        std::shared_ptr<Watches> m_Watches;
+        QSocketNotifier* m_Notifier = nullptr;
+        QFileSystemWatcher* m_Fallback = nullptr;
+
+        QSet<QString> m_Pending;
+        QTimer m_SettleTimer;
+        QElapsedTimer m_PendingSince;
+    };
+
+} // namespace sap::client
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <QByteArrayView>
+#include <QFuture>
+#include <QString>
+#include <QStringList>
+#include <atomic>
+#include <memory>
+
+class QIODevice;
+class QThreadPool;
+
+typedef struct evp_md_ctx_st EVP_MD_CTX;
+
+namespace sap::client {
+
+    // Incremental content hash in the server's format (SHA-256, lowercase hex).
+    // Goes through OpenSSL's EVP interface, which picks SHA-NI / AVX2 / NEON code at runtime;
+    // QCryptographicHash only does that when Qt itself was built against OpenSSL.
+    class ContentHasher {
+    public:
+        ContentHasher();
+        ~ContentHasher();
+        // Copies carry the state so far, e.g. to roll back to a checkpoint
+        ContentHasher(const ContentHasher& other);
+        ContentHasher& operator=(const ContentHasher& other);
+
+        void reset();
+        void add(QByteArrayView data);
+        // Hashes the rest of device; false on a read error
+        bool add(QIODevice* device);
+        // Digest of everything added so far; adding more afterwards is fine
+        QString result() const;
+
+    private:
+        EVP_MD_CTX* m_Ctx;
+    };
+
+    // File hashing for comparisons, dedup and integrity checks.
+    // Files are read in k_ReadBlock blocks with sequential read-ahead advice. They are never mapped:
+    // a user file truncated mid-hash (FolderSync, an editor) would SIGBUS the client, where a read
+    // just comes up short. Batches run one file per thread on a dedicated pool, so hashing never
+    // starves the global pool's short tasks.
+    // A single file always hashes on one core: SHA-256 is a strict chain, and a tree mode would
+    // not match the plain digest the server stores. Read-ahead overlaps its I/O instead.
+    class HashService {
+    public:
+        static constexpr qint64 k_ReadBlock = 4LL * 1024 * 1024;
+
+        // Empty on failure; cancel is polled between blocks
+        static QString hash_file(const QString& path, QString* error = nullptr, const std::atomic<bool>* cancel = nullptr);
+        // Results in input order; unreadable files get an empty hash
+        static QFuture<QStringList> hash_files(const QStringList& paths, std::shared_ptr<std::atomic<bool>> cancel = {});
+        static QThreadPool* pool();
+
+        // Hashes the files rounds times and returns bytes per second over all of it
+        static double benchmark(const QStringList& paths, int rounds = 3);
+    };
+
+} // namespace sap::client
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QObject>
+#include <QSet>
+#include <deque>
+#include <memory>
+#include "types.h"
+
+namespace sap::client {
+
+    class ApiClient;
+
+    // Bulk import of notes and files:
+    // - MarkdownFolder: every .md/.markdown file below a directory becomes a note
+    //   (front-matter title and tags, else the first heading or the file name)
+    // - BackupArchive: a BackupExporter tar; notes/ entries become notes, files/ entries are
+    //   uploaded to their original paths straight from the archive
+    // Reading and parsing run on a worker thread that stays at most k_MaxQueued items ahead of the
+    // network, which runs k_MaxInFlight requests at a time.
+    // Progress is journaled per source, so a rerun after a failure skips what already went through;
+    // notes that may or may not have gone through are resent under the same idempotency key.
+    class Importer : public QObject {
+        Q_OBJECT
+
+    public:
+        enum class Source { MarkdownFolder, BackupArchive };
+
+        static constexpr int k_MaxInFlight = 8;
+        static constexpr int k_MaxQueued = 256;
+
+        Importer(ApiClient* api, Source source, const QString& path, QObject* parent = nullptr);
+        ~Importer() override;
+
+        void start();
+        void abort();
+
+        struct Item {
+            enum class Kind { Note, File };
+            Kind kind = Kind::Note;
+            QString key;
+            Note note;
+            // Files: archive window and destination
+            QString remote_path;
+            qint64 offset = 0;
+            qint64 size = 0;
+        };
+
+    signals:
+        // total is -1 while the source is still being scanned
+        void progress(int done, int failed, int total, double items_per_sec);
+        // Emitted exactly once
+        void finished(bool ok, int imported, int skipped, int failed);
+
+    private:
+        struct Shared;
+
+        void load_state();
+        void record(char op, const Item& item);
+        void begin_scan();
+        void on_item(const Item& item);
+        void on_scan_done(int total, const QString& error);
+        void pump();
+        void send(const Item& item);
+        void on_sent(const Item& item, bool ok);
+        void release_slot();
+        void report_progress();
+        void complete(bool ok);
+
+        ApiClient* m_Api;
+        Source m_Source;
+        QString m_Path;
+        std::shared_ptr<Shared> m_Shared;
+
+        // Journal: "D <key>" once the server has the item
+        QFile m_State;
+        QSet<QString> m_Completed;
+
+        std::deque<Item> m_Pending;
+        int m_InFlight = 0;
+        int m_Total = -1;
+        int m_Imported = 0;
+        int m_Skipped = 0;
+        int m_Failed = 0;
+        QString m_ScanError;
+        QElapsedTimer m_Clock;
+        qint64 m_LastReport = -1;
+        bool m_Done = false;
+    };
+
+} // namespace sap::client
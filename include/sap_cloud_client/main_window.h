@@ -3,14 +3,23 @@
 #include <QFrame>
 #include <QLabel>
 #include <QMainWindow>
+#include <QPointer>
 #include <QPropertyAnimation>
 #include <QStackedWidget>
 #include <QToolButton>
 #include "api_client.h"
+#include "folder_sync.h"
+#include "importer.h"
+#include "offline_store.h"
+#include "peer_cache.h"
 #include "ssh_auth.h"
+#include "sync_engine.h"
+#include "transfer_manager.h"
+#include "webdav_server.h"
 
 namespace sap::client {
 
+    class BackupExporter;
     class DriveScreen;
     class NotesScreen;
 
@@ -27,6 +36,9 @@ namespace sap::client {
         void toggle_sidebar();
         void on_authenticated();
         void on_auth_error(const QString& msg);
+        void export_backup();
+        void start_import(Importer::Source source);
+        void choose_sync_folder();
 
     private:
         void setup_ui();
@@ -34,13 +46,30 @@ namespace sap::client {
         QToolButton* create_nav_button(const QString& text, const QString& icon_path);
         void update_nav_state();
         void authenticate();
+        // Starts syncing the folder saved in settings, if any and not already running
+        void start_folder_sync();
+        // Starts or stops sharing downloads with LAN peers; false if sharing couldn't start
+        bool set_peer_sharing(bool enabled);
+        // Peers only share with clients of the same account; the key comes from the server
+        void fetch_peer_key();
+        // Starts the loopback WebDAV endpoint if settings ask for it
+        void start_webdav();
 
         QVector<std::function<void()>> m_PostAuthenticationQueue;
         ApiClient* m_Api;
         SshAuth* m_SshAuth;
+        TransferScheduler* m_Scheduler;
+        TransferManager* m_Transfers;
+        SyncEngine* m_Sync;
+        OfflineStore* m_Offline;
+        PeerCache* m_Peers;
+        WebDavServer* m_WebDav;
         QStackedWidget* m_Stack;
         DriveScreen* m_Drive;
         NotesScreen* m_Notes;
+        QPointer<BackupExporter> m_Backup;
+        QPointer<Importer> m_Import;
+        QPointer<FolderSync> m_FolderSync;
 
         // Sidebar
         QFrame* m_Sidebar;
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <QObject>
+#include <QStringList>
+
+namespace sap::client {
+
+    class ApiClient;
+    class MerkleTree;
+    struct MerkleNode;
+
+    // Compares a local MerkleTree with the server's, descending only into directories whose
+    // digests differ. A mirror that is in sync costs one request; a single changed file costs
+    // one request per directory level above it.
+    class MerkleReconciler : public QObject {
+        Q_OBJECT
+
+    public:
+        static constexpr int k_MaxInFlight = 8;
+
+        // The tree must outlive the reconciler and not change while it runs
+        MerkleReconciler(ApiClient* api, const MerkleTree* tree, QObject* parent = nullptr);
+
+        void start();
+        void abort();
+        int requests() const { return m_Requests; }
+
+    signals:
+        // differing holds file paths that differ or exist on one side only, and directory
+        // prefixes (ending in '/') that exist on one side only. Emitted exactly once.
+        void finished(bool ok, const QStringList& differing);
+
+    private:
+        void pump();
+        void on_node(const QString& dir, bool ok, const MerkleNode& node);
+        void complete(bool ok);
+
+        ApiClient* m_Api;
+        const MerkleTree* m_Tree;
+        QStringList m_Queue;
+        QStringList m_Differing;
+        int m_InFlight = 0;
+        int m_Requests = 0;
+        bool m_Done = false;
+    };
+
+} // namespace sap::client
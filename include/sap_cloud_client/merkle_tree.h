@@ -0,0 +1,46 @@
+#pragma once
+
+#include <QHash>
+#include <QMap>
+#include <QSet>
+#include <QString>
+#include <QVector>
+#include "types.h"
+
+namespace sap::client {
+
+    // Merkle tree over the '/'-separated file namespace, one node per directory.
+    // Digests are SHA-256, lowercase hex, and must match the server's:
+    //   file entry: hash of "f\0" + name + "\0" + content hash
+    //   directory:  hash of "d\0" + one line per child sorted by key, key + "\0" + child digest + "\n",
+    //               where key is the name, with a trailing '/' for subdirectories
+    // Inserts and removals only mark the directories above them stale; digests are recomputed
+    // lazily, so keeping the tree in step with sync deltas costs O(depth) per change.
+    class MerkleTree {
+    public:
+        void clear();
+        void insert(const QString& path, const QString& content_hash);
+        void remove(const QString& path);
+
+        // Digest of a directory ("" is the root, others end in '/'); empty if it doesn't exist
+        QString digest(const QString& dir = {}) const;
+        bool contains_dir(const QString& dir) const { return m_Dirs.contains(dir); }
+        QVector<MerkleEntry> children(const QString& dir) const;
+        // Every file path at or below dir
+        QStringList files_under(const QString& dir) const;
+
+    private:
+        struct Dir {
+            QMap<QString, QString> files; // name -> file entry digest
+            QSet<QString> subdirs;        // names, without the trailing '/'
+            mutable QString digest;
+            mutable bool stale = true;
+        };
+
+        static QString parent_of(const QString& dir);
+        void mark_stale(QString dir);
+
+        QHash<QString, Dir> m_Dirs;
+    };
+
+} // namespace sap::client
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+#include <optional>
+#include <utility>
+#include "types.h"
+
+namespace sap::client {
+
+    // The last known listings in a compact binary file, read back through a memory map at startup
+    // so the screens have something to show before authentication and the first round trip.
+    // Layout (little-endian):
+    //   header: "SAPM" magic, u32 version, i64 cursor, u32 file, tombstone and note counts, u32 string bytes
+    //   fixed-size file, tombstone and note records; strings are (u32 offset, u32 length) refs
+    //   a UTF-8 string table shared by all records
+    // Every ref is bounds-checked on read, and a file that fails a check or has another version
+    // reads as nothing. Writes go through QSaveFile, so a crash leaves the previous snapshot.
+    struct MetadataSnapshot {
+        static constexpr quint32 k_Version = 1;
+
+        Timestamp cursor = 0;
+        QVector<FileInfo> files;
+        QVector<std::pair<QString, Timestamp>> tombstones;
+        QVector<NoteItem> notes;
+
+        // One snapshot per listing kind ("sync", "notes") and server
+        static QString path_for(const QString& kind, const QString& server_url);
+        static std::optional<MetadataSnapshot> read(const QString& path);
+        bool write(const QString& path) const;
+    };
+
+} // namespace sap::client
@@ -11,6 +11,7 @@
 #include <QTimer>
 #include <QWidget>
 #include "api_client.h"
+#include "offline_store.h"
 #include "smart_text_edit.h"
 
 namespace sap::client {
@@ -19,7 +20,7 @@ namespace sap::client {
         Q_OBJECT
 
     public:
-        explicit NotesScreen(ApiClient* api, QWidget* parent = nullptr);
+        NotesScreen(ApiClient* api, OfflineStore* offline, QWidget* parent = nullptr);
         void refresh();
 
     private slots:
@@ -32,18 +33,28 @@ namespace sap::client {
         void on_search(const QString& text);
         void on_content_changed();
         void on_auto_save();
+        void on_list_context_menu(const QPoint& pos);
 
     private:
         void setup_ui();
         void load_notes();
+        void show_notes(const QVector<NoteItem>& notes);
         void load_note(const QString& id);
+        void show_note(const QString& id, const Note& note);
         void clear_editor();
         void save_current_note();
         void update_word_count();
         void show_empty_state();
         void hide_empty_state();
+        QStringList selected_ids() const;
+        // Deletes or retags every selected note with one batch request
+        void delete_notes(const QStringList& ids);
+        void edit_tags(const QStringList& ids, bool add);
+        // Pins every note in ids, or unpins them if the first one is pinned already
+        void toggle_pins(const QStringList& ids);
 
         ApiClient* m_Api;
+        OfflineStore* m_Offline;
 
         // Sidebar
         QWidget* m_Sidebar;
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QPointer>
+#include <QSet>
+#include <QTimer>
+#include <deque>
+#include <optional>
+#include "access_predictor.h"
+#include "api_client.h"
+#include "content_store.h"
+#include "sync_engine.h"
+#include "transfer_scheduler.h"
+
+namespace sap::client {
+
+    // "Available offline" pins on Drive files, folder prefixes and notes, and the background
+    // prefetcher that keeps them current.
+    // Pinned file content lives in a ContentStore, so a file is fetched again only when its hash
+    // changes; pinned notes are kept as JSON beside it. File changes arrive through SyncEngine's
+    // delta feed; notes have no feed, so their listing is compared every k_NotePollMs.
+    // Fetches run one at a time, only while the network is up and no user transfer is running,
+    // and stay inside two budgets:
+    // - Bandwidth: after each fetch the next one waits until the average is back under the limit
+    // - Disk: a pinned file that would push the store past the limit is skipped and counted in
+    //   over_budget() until room is made
+    // Opens that go through open_note()/open_file() also feed an AccessPredictor. Its likeliest
+    // next items are prefetched after the pinned work, into a cache of up to prefetch_limit() bytes
+    // that is dropped oldest first; prefetch_stats() tells how much of that paid off.
+    // Everything is kept per server, under AppDataLocation/offline/<sha1 of the server URL>.
+    class OfflineStore : public QObject {
+        Q_OBJECT
+
+    public:
+        struct PrefetchStats {
+            int hits = 0;   // opens served by a prefetched copy
+            int misses = 0; // opens of unpinned items that had to go to the server
+            int fetched = 0;
+            qint64 bytes_fetched = 0;
+            qint64 bytes_wasted = 0; // prefetched, then dropped without being opened
+
+            double hit_rate() const { return hits + misses > 0 ? static_cast<double>(hits) / (hits + misses) : 0; }
+        };
+
+        static constexpr int k_NotePollMs = 5 * 60 * 1000;
+        static constexpr int k_RetryDelayMs = 60 * 1000;
+        static constexpr qint64 k_DefaultDiskLimit = 2LL * 1024 * 1024 * 1024;
+        static constexpr qint64 k_DefaultBandwidthLimit = 4LL * 1024 * 1024;
+        static constexpr qint64 k_DefaultPrefetchLimit = 64LL * 1024 * 1024;
+        // Successors worth fetching after each open, and how likely they have to be
+        static constexpr int k_PrefetchFanout = 2;
+        static constexpr double k_MinProbability = 0.25;
+        // A prefetched note is served only this long; files are checked against the index instead
+        static constexpr qint64 k_PrefetchedNoteTtlMs = 10 * 60 * 1000;
+        static constexpr int k_HistorySaveDelayMs = 10 * 1000;
+
+        OfflineStore(ApiClient* api, SyncEngine* sync, TransferScheduler* foreground, QObject* parent = nullptr);
+        ~OfflineStore() override;
+
+        // Prefetching needs a signed-in client; pins and offline copies work regardless
+        void start();
+        void stop();
+
+        // path is a file, or a folder prefix ending in '/'
+        void pin_path(const QString& path);
+        void unpin_path(const QString& path);
+        // Pinned directly or through a pinned prefix
+        bool is_pinned(const QString& path) const;
+        bool is_pinned_directly(const QString& path) const { return m_Paths.contains(path); }
+        void pin_note(const QString& id);
+        void unpin_note(const QString& id);
+        bool is_note_pinned(const QString& id) const { return m_Notes.contains(id); }
+
+        // Offline copy of a pinned file matching the index's current hash; empty if there is none
+        QString local_copy(const QString& path) const;
+        std::optional<Note> note(const QString& id) const;
+        // Every pinned note that has an offline copy, newest first
+        QVector<NoteItem> offline_notes() const;
+        // Keeps a pinned or prefetched note's copy current after a local edit
+        void store_note(const Note& note);
+
+        // The user opens a note or file: records the access, prefetches what usually follows and
+        // returns a local copy (pinned or prefetched) if there is one
+        std::optional<Note> open_note(const QString& id);
+        QString open_file(const QString& path);
+        // 0 turns predictive prefetching off
+        void set_prefetch_limit(qint64 bytes);
+        qint64 prefetch_limit() const { return m_PrefetchLimit; }
+        PrefetchStats prefetch_stats() const { return m_PrefetchStats; }
+
+        void set_disk_limit(qint64 bytes);
+        // Bytes per second on average; 0 lifts the limit
+        void set_bandwidth_limit(qint64 bytes_per_sec);
+        qint64 disk_limit() const { return m_DiskLimit; }
+        qint64 bandwidth_limit() const { return m_BandwidthLimit; }
+        qint64 disk_usage() const { return m_Store.usage(); }
+        const ContentStore& content_store() const { return m_Store; }
+        int pending() const { return static_cast<int>(m_Queue.size()) + (m_Busy ? 1 : 0); }
+        int over_budget() const { return static_cast<int>(m_OverBudget.size()); }
+
+    signals:
+        // Pins, offline copies or the counters above changed
+        void changed();
+
+    private:
+        struct Item {
+            bool note = false;
+            QString key; // remote path or note id
+            bool speculative = false;
+        };
+
+        struct Prefetched {
+            QString key; // queue key of the item
+            QString hash; // file blobs only
+            qint64 bytes = 0;
+            qint64 at = 0;
+            bool used = false;
+        };
+
+        void on_sync_changed(const QStringList& updated, const QStringList& removed);
+        void queue_pinned_files(const QString& path);
+        void refresh_notes();
+        void enqueue(const Item& item);
+        void pump();
+        void fetch_file(const Item& item);
+        void fetch_note(const Item& item);
+        void fetch_done(const Item& item, bool ok, qint64 bytes);
+        void record_open(const QString& key);
+        void add_prefetched(const Prefetched& entry);
+        void evict_prefetched();
+        // The cache entry for key, marked used and moved to the back; nullptr if there is none
+        Prefetched* use_prefetched(const QString& key);
+        void drop_prefetch_cache();
+        bool network_ready() const;
+        void collect_garbage();
+        QString note_path(const QString& id) const;
+        // Switches to the pins of the current server if it changed
+        void check_server();
+        void load();
+        void save();
+
+        ApiClient* m_Api;
+        SyncEngine* m_Sync;
+        TransferScheduler* m_Foreground;
+        ContentStore m_Store;
+        QString m_Dir;
+        QString m_LoadedFor;
+
+        QSet<QString> m_Paths;
+        // Pinned note id -> updated_at of its offline copy (0 until fetched)
+        QHash<QString, Timestamp> m_Notes;
+        QSet<QString> m_OverBudget;
+        qint64 m_DiskLimit = k_DefaultDiskLimit;
+        qint64 m_BandwidthLimit = k_DefaultBandwidthLimit;
+
+        std::deque<Item> m_Queue;
+        QSet<QString> m_Queued;
+        // Predicted items; replaced on every open and only fetched once m_Queue is empty
+        std::deque<Item> m_Speculative;
+        bool m_Running = false;
+        bool m_Busy = false;
+        bool m_GcPending = false;
+        QPointer<QNetworkReply> m_Reply;
+        QElapsedTimer m_FetchTimer;
+        QTimer m_PaceTimer;
+        QTimer m_NoteTimer;
+        // Bumped whenever the pins are swapped out, so late replies are dropped
+        quint64 m_Generation = 0;
+
+        AccessPredictor m_Predictor;
+        QTimer m_HistoryTimer;
+        qint64 m_PrefetchLimit = k_DefaultPrefetchLimit;
+        // Oldest first
+        std::deque<Prefetched> m_Prefetched;
+        QHash<QString, Note> m_PrefetchedNotes;
+        qint64 m_PrefetchBytes = 0;
+        qint64 m_PrefetchFileBytes = 0;
+        PrefetchStats m_PrefetchStats;
+    };
+
+} // namespace sap::client
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QTcpServer>
+#include <QUdpSocket>
+#include <functional>
+#include <memory>
+#include "api_client.h"
+#include "content_store.h"
+
+namespace sap::client {
+
+    // Optional LAN cache of file content shared between clients.
+    // Peers are found per blob, not by inventory: a client about to download a file asks the
+    // multicast group who has its hash, and every peer holding it answers with the TCP port it
+    // serves on. The blob is streamed from the first peer that answered, the others are kept as
+    // fallbacks, and a DownloadVerifier checks the hash before the file is moved into place.
+    // Anything short of a verified copy leaves the download to the server.
+    // Blobs served come from the cache's own ContentStore, which keeps completed downloads
+    // within a disk budget (least recently used go first), and from stores added with add_source().
+    // Only clients of the same account take part: queries and answers carry an HMAC keyed with
+    // the account's peer key, and a TCP fetch must answer the serving peer's fresh challenge with
+    // an HMAC over it and the hash. Without a key nothing is asked, answered or served.
+    // Several clients can run on one machine: the discovery port is shared and every client
+    // serves on its own ephemeral TCP port.
+    class PeerCache : public QObject {
+        Q_OBJECT
+
+    public:
+        struct Stats {
+            int hits = 0;   // downloads served by a peer
+            int misses = 0; // downloads no peer could serve
+            qint64 bytes_from_peers = 0; // server egress saved
+            qint64 bytes_served = 0;     // sent to other peers
+        };
+
+        // Smaller files aren't worth the discovery round trip
+        static constexpr qint64 k_MinFileSize = 1024 * 1024;
+        static constexpr int k_QueryTimeoutMs = 250;
+        static constexpr int k_IdleTimeoutMs = 10 * 1000;
+        static constexpr int k_MaxServing = 4;
+        static constexpr qint64 k_DefaultDiskLimit = 1LL * 1024 * 1024 * 1024;
+
+        explicit PeerCache(QObject* parent = nullptr);
+        ~PeerCache() override;
+
+        bool start();
+        void stop();
+        bool is_running() const { return m_Running; }
+        // TCP port blobs are served on; 0 while stopped
+        quint16 port() const { return m_Server.serverPort(); }
+        QString last_error() const { return m_LastError; }
+
+        // Secret shared by the account's sessions (ApiClient::get_peer_key); empty stops all sharing
+        void set_account_key(const QByteArray& key);
+        bool has_account_key() const { return !m_AccountKey.isEmpty(); }
+        // Also serves blobs held by store; it must outlive the cache or be removed first
+        void add_source(const ContentStore* store);
+        void remove_source(const ContentStore* store);
+        void set_disk_limit(qint64 bytes);
+        qint64 disk_limit() const { return m_DiskLimit; }
+
+        // Copies a verified download into the cache so peers can get it from here, then calls then
+        void offer(const QString& path, const QString& hash, std::function<void()> then);
+        // Streams the blob from a peer to target. done(true) only with a verified file in place;
+        // the returned function aborts, and done(false) follows.
+        std::function<void()> fetch(const QString& hash, qint64 size, const QString& target, ProgressFn progress,
+                                    std::function<void(bool)> done);
+
+        Stats stats() const { return m_Stats; }
+
+    signals:
+        void stats_changed();
+
+    private:
+        struct Fetch;
+
+        void on_query();
+        void on_answer();
+        void serve(QTcpSocket* socket);
+        void connect_next(quint64 nonce);
+        void on_peer_data(quint64 nonce);
+        void on_peer_complete(quint64 nonce);
+        void drop_peer(const std::shared_ptr<Fetch>& f);
+        void end_fetch(quint64 nonce, bool ok);
+        QString blob_path(const QString& hash) const;
+        // HMAC-SHA256 under the account key, hex encoded
+        QByteArray sign(const QByteArray& message) const;
+        bool verify(const QByteArray& message, const QString& mac) const;
+        void touch(const QString& hash);
+        // Evicts least recently used blobs until the store fits the disk limit
+        void trim();
+
+        QTcpServer m_Server;
+        QUdpSocket m_Listen; // shared discovery port, receives queries
+        QUdpSocket m_Send;   // own port, sends queries and receives answers
+        quint64 m_Self = 0;
+        QByteArray m_AccountKey;
+        bool m_Running = false;
+        QString m_LastError;
+
+        ContentStore m_Store;
+        QVector<const ContentStore*> m_Sources;
+        qint64 m_DiskLimit = k_DefaultDiskLimit;
+        QHash<QString, qint64> m_Used; // hash -> last use, for eviction
+        QSet<QString> m_Offering;
+
+        QHash<quint64, std::shared_ptr<Fetch>> m_Fetches;
+        int m_Serving = 0;
+        Stats m_Stats;
+    };
+
+} // namespace sap::client
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QNetworkReply>
+#include <QObject>
+#include <QPointer>
+#include <memory>
+#include <vector>
+#include "types.h"
+
+namespace sap::client {
+
+    class ApiClient;
+    class DownloadVerifier;
+
+    // Downloads one file as several HTTP Range requests in parallel:
+    // - Each segment writes through its own handle at its own offset of a presized (sparse) part file
+    // - Segment count starts from the file size and grows by splitting the slowest segment's
+    //   remaining range whenever another segment finishes early
+    // - Bytes are hashed in file order while they arrive: the segment at the hash frontier feeds the
+    //   verifier directly, and whatever later segments wrote ahead of it is read back when the frontier
+    //   gets there, so the finished file needs no second pass
+    // - With the file's chunk manifest a corrupt chunk is fetched again on its own, up to k_MaxRetries times
+    // Servers that ignore Range get a single plain stream instead, verified the same way.
+    class SegmentedDownload : public QObject {
+        Q_OBJECT
+
+    public:
+        // Below this size the extra connections cost more than they gain
+        static constexpr qint64 k_MinFileSize = 32LL * 1024 * 1024;
+
+        SegmentedDownload(ApiClient* api, const QString& path, const QString& part_path, qint64 size, const QString& expected_hash,
+                          QObject* parent = nullptr);
+        ~SegmentedDownload() override;
+
+        void start();
+        void abort();
+
+        qint64 size() const { return m_Size; }
+        qint64 received() const { return m_Received; }
+        // Every byte before this offset is on disk; a single-stream Range resume can continue from here
+        qint64 contiguous_prefix() const;
+
+    signals:
+        void progress(qint64 received, qint64 total);
+        // Emitted exactly once; when ok the part file holds the complete, verified body
+        void finished(bool ok);
+
+    private:
+        struct Segment {
+            qint64 begin = 0;
+            qint64 end = 0; // exclusive; may shrink when the tail is handed to a new segment
+            qint64 pos = 0;
+            qint64 attempt_pos = 0; // pos when the current request started, for throughput
+            int retries = 0;
+            bool repair = false; // refetching a chunk that failed verification
+            std::unique_ptr<QFile> file;
+            QPointer<QNetworkReply> reply;
+            QElapsedTimer timer;
+
+            qint64 remaining() const { return end - pos; }
+            double bytes_per_ms() const;
+        };
+
+        void begin_segments();
+        bool open_segment(Segment& seg);
+        void launch(Segment& seg);
+        void on_segment_data(Segment& seg, QNetworkReply* reply);
+        void on_segment_finished(Segment& seg, QNetworkReply* reply);
+        void segment_done(Segment& seg);
+        // Hands the second half of the slowest segment's remaining range to a new segment
+        bool split_slowest();
+        int active_segments() const;
+        void fall_back_to_single_stream();
+        void create_verifier(const QVector<ChunkRef>& chunks);
+        // Feeds bytes already on disk at the hash frontier, and finishes verification once everything is in
+        void advance_hash();
+        void on_chunk_failed(qint64 offset, qint64 size);
+        void on_verified(bool ok);
+        bool all_written() const;
+        void finalize();
+        void fail(const QString& msg);
+        void complete(bool ok);
+        Segment* find(QNetworkReply* reply);
+        // The segment whose bytes count at offset; an unfinished repair wins over the data it replaces
+        const Segment* covering(qint64 offset) const;
+
+        static constexpr qint64 k_MinSegmentSize = 4LL * 1024 * 1024;
+        static constexpr qint64 k_ReadChunk = 256 * 1024;
+        static constexpr int k_InitialSegments = 4;
+        static constexpr int k_MaxSegments = 8;
+        static constexpr int k_MaxRetries = 3;
+
+        ApiClient* m_Api;
+        QString m_Path;
+        QString m_PartPath;
+        qint64 m_Size;
+        QString m_ExpectedHash;
+
+        QFile m_File;
+        std::vector<std::unique_ptr<Segment>> m_Segments;
+        qint64 m_Received = 0;
+        bool m_Done = false;
+        bool m_SingleStream = false;
+        QPointer<QNetworkReply> m_StreamReply;
+        DownloadVerifier* m_Verifier = nullptr;
+        bool m_Verifying = false; // every byte is fed and finish() was called
+        QHash<qint64, int> m_Repairs; // chunk offset -> refetches so far
+    };
+
+} // namespace sap::client
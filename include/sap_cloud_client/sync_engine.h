@@ -0,0 +1,101 @@
+#pragma once
+
+#include <QHash>
+#include <QObject>
+#include <QStringList>
+#include <QTimer>
+#include <optional>
+#include "api_client.h"
+#include "merkle_tree.h"
+
+namespace sap::client {
+
+    // Local mirror of the remote file listing, kept current from the sync/state delta feed.
+    // The first sync (or one after a long absence) fetches everything; after that each poll asks
+    // for changes since the last server_time and applies them in O(changes). Cursors are always
+    // server timestamps, so the local clock never decides what is fetched; the measured skew is
+    // only exposed for callers comparing local and remote times.
+    // Deleted files leave a tombstone just long enough to reject stale replays from the overlap window.
+    // Polling starts at k_MinPollMs and doubles up to k_MaxPollMs while nothing changes.
+    // The index also keeps a MerkleTree, compared against the server's after startup and every
+    // k_VerifyIntervalMs; any divergence is repaired with a full listing.
+    class SyncEngine : public QObject {
+        Q_OBJECT
+
+    public:
+        static constexpr int k_MinPollMs = 2000;
+        static constexpr int k_MaxPollMs = 60000;
+        // Deltas are requested from this far before the cursor so writes stamped just before it aren't missed
+        static constexpr qint64 k_OverlapMs = 5000;
+        // Beyond this the server may have compacted its own tombstones, so a full listing is fetched instead
+        static constexpr qint64 k_MaxDeltaAgeMs = 7LL * 24 * 60 * 60 * 1000;
+        static constexpr int k_SaveDelayMs = 2000;
+        static constexpr int k_VerifyIntervalMs = 60 * 60 * 1000;
+
+        explicit SyncEngine(ApiClient* api, QObject* parent = nullptr);
+        ~SyncEngine() override;
+
+        void start();
+        void stop();
+        // Fetches changes now and drops back to the fastest poll interval
+        void sync_now();
+        // Forgets the index (different server or account); the next sync is a full listing
+        void reset();
+        // Checks the index against the server's Merkle tree; needs Feature::Merkle
+        void verify();
+
+        const QHash<QString, FileInfo>& files() const { return m_Files; }
+        std::optional<FileInfo> file(const QString& path) const;
+        bool has_snapshot() const { return m_Cursor > 0; }
+        // Server clock as estimated from the last responses
+        Timestamp server_now() const;
+        qint64 clock_skew_ms() const { return m_SkewMs; }
+        int poll_interval_ms() const { return m_IntervalMs; }
+        const MerkleTree& tree() const { return m_Tree; }
+
+    signals:
+        void changed(const QStringList& updated, const QStringList& removed);
+        void sync_failed();
+        // requests is how many Merkle nodes were fetched to decide
+        void verified(bool in_sync, int requests);
+
+    private:
+        void poll();
+        void on_state(bool ok, const SyncState& state, bool full, qint64 sent_at);
+        void apply_full(const SyncState& state, QStringList& updated, QStringList& removed);
+        void apply_delta(const FileInfo& f, QStringList& updated, QStringList& removed);
+        void compact_tombstones();
+        void schedule_next(bool changed);
+        void note_skew(Timestamp server_time, qint64 sent_at);
+        void switch_server();
+        void clear();
+        // Reads the binary snapshot (MetadataSnapshot) of the index
+        void load();
+        void save();
+
+        ApiClient* m_Api;
+        QTimer m_PollTimer;
+        QTimer m_SaveTimer;
+        QTimer m_VerifyTimer;
+        QString m_LoadedFor;
+
+        QHash<QString, FileInfo> m_Files;
+        // Deleted path -> server time of the deletion
+        QHash<QString, Timestamp> m_Tombstones;
+        MerkleTree m_Tree;
+        bool m_Verifying = false;
+        bool m_VerifyPending = true;
+        // server_time of the last applied response; 0 means no snapshot yet
+        Timestamp m_Cursor = 0;
+        qint64 m_SkewMs = 0;
+        bool m_SkewKnown = false;
+
+        int m_IntervalMs = k_MinPollMs;
+        bool m_Running = false;
+        bool m_InFlight = false;
+        bool m_Again = false;
+        // Bumped by reset() so replies to older requests are dropped
+        quint64 m_Generation = 0;
+    };
+
+} // namespace sap::client
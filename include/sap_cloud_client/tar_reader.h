@@ -0,0 +1,37 @@
+#pragma once
+
+#include <QFile>
+#include <QString>
+#include <optional>
+#include "types.h"
+
+namespace sap::client {
+
+    // Sequential reader for the ustar/pax archives TarWriter produces (and most others).
+    // Only regular files are returned; their data is left in place at Entry::offset so callers
+    // can map or stream it without copying.
+    class TarReader {
+    public:
+        struct Entry {
+            QString name;
+            qint64 offset = 0;
+            qint64 size = 0;
+            Timestamp mtime_ms = 0;
+        };
+
+        explicit TarReader(const QString& path);
+
+        bool open();
+        QString last_error() const { return m_LastError; }
+
+        // Next regular file, or nullopt at the end of the archive (or on a corrupt header; see last_error)
+        std::optional<Entry> next();
+        QByteArray read(const Entry& entry);
+
+    private:
+        QFile m_File;
+        qint64 m_Pos = 0;
+        QString m_LastError;
+    };
+
+} // namespace sap::client
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <QFile>
+#include <QString>
+#include "types.h"
+
+namespace sap::client {
+
+    // Writes a POSIX (ustar + pax) tar archive whose entries are filled in out of order.
+    // reserve() appends an entry header and sets aside its padded data region up front, so several
+    // entries can be downloaded into the archive at once with write_at(); anything never written
+    // reads back as zeros. Names that don't fit ustar, and sizes of 8 GiB or more, get a pax header.
+    class TarWriter {
+    public:
+        static constexpr qint64 k_BlockSize = 512;
+
+        explicit TarWriter(const QString& path);
+
+        bool open();
+        QString last_error() const { return m_LastError; }
+
+        // Returns the archive offset of the entry's data, or -1 on a write error
+        qint64 reserve(const QString& name, qint64 size, Timestamp mtime_ms);
+        bool write_at(qint64 offset, const char* data, qint64 length);
+        // Appends a complete entry in one go
+        bool append(const QString& name, const QByteArray& data, Timestamp mtime_ms);
+        // Writes the end-of-archive marker and closes the file
+        bool finish();
+
+        qint64 size() const { return m_End; }
+
+    private:
+        bool write_header(const QByteArray& name, qint64 size, Timestamp mtime_ms, char type);
+
+        QFile m_File;
+        qint64 m_End = 0;
+        QString m_LastError;
+    };
+
+} // namespace sap::client
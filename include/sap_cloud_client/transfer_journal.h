@@ -0,0 +1,67 @@
+#pragma once
+
+#include <QBitArray>
+#include <QFile>
+#include <QHash>
+#include <QString>
+
+namespace sap::client {
+
+    // Append-only, crash-tolerant record of queued and partial transfers.
+    // File layout: "SAPJ" magic, u32 version, then records of [u32 length][u32 crc32][payload].
+    // Replay stops at the first short or corrupt record (a torn write) and truncates it away;
+    // the log is rewritten with only live entries once it is mostly superseded records.
+    class TransferJournal {
+    public:
+        enum class Kind : quint8 { Download = 0, Upload = 1 };
+
+        struct Entry {
+            quint64 id = 0;
+            Kind kind = Kind::Download;
+            QString remote_path;
+            QString local_path;
+            QString expected_hash;
+            qint64 size = 0;
+            // Downloads: contiguous bytes already in the part file
+            qint64 committed = 0;
+            // Uploads: server-side session and which of its parts the server acknowledged, and the
+            // local file's mtime (ms since epoch) when the session began
+            QString upload_id;
+            qint64 part_size = 0;
+            QBitArray acked_parts;
+            qint64 local_mtime = 0;
+            int attempts = 0;
+
+            QString part_path() const { return local_path + ".part"; }
+        };
+
+        explicit TransferJournal(const QString& path);
+
+        // Replays the log; an unreadable or foreign file is discarded and started fresh
+        bool open();
+        QString last_error() const { return m_LastError; }
+
+        quint64 add(Entry entry);
+        void update(const Entry& entry);
+        void remove(quint64 id);
+
+        const Entry* find(quint64 id) const;
+        QList<Entry> entries() const { return m_Entries.values(); }
+
+    private:
+        enum class Op : quint8 { Put = 1, Remove = 2 };
+
+        bool append(Op op, const QByteArray& payload);
+        bool write_header(QIODevice& file);
+        void compact();
+
+        static constexpr quint32 k_Version = 1;
+
+        QFile m_File;
+        QHash<quint64, Entry> m_Entries;
+        quint64 m_NextId = 1;
+        int m_Records = 0;
+        QString m_LastError;
+    };
+
+} // namespace sap::client
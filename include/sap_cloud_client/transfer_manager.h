@@ -0,0 +1,127 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <memory>
+#include "api_client.h"
+#include "chunk_index.h"
+#include "drive_cipher.h"
+#include "peer_cache.h"
+#include "transfer_journal.h"
+#include "transfer_scheduler.h"
+
+namespace sap::client {
+
+    // Journaled uploads and downloads on top of TransferScheduler.
+    // Every transfer is recorded in a TransferJournal before it starts and removed once it
+    // succeeds or is cancelled. Anything left over (crash, lost network) is re-queued by
+    // resume_pending(): downloads continue their part file with a Range request, large uploads
+    // continue their server-side session from the last acknowledged part.
+    // Large uploads prefer content-defined chunking with dedup when the server offers it.
+    // With encryption on, uploads are sealed on the fly and downloads of sealed files are decrypted in place.
+    // With a PeerCache set, fresh downloads try LAN peers first and completed ones are offered to them.
+    class TransferManager : public QObject {
+        Q_OBJECT
+
+    public:
+        // What uploads avoided sending since the stats were last taken
+        struct UploadStats {
+            // Bytes handed to dedup uploads versus bytes they actually had to send
+            qint64 bytes_total = 0;
+            qint64 bytes_sent = 0;
+            // Files the preflight found unchanged, or created from content the server already had
+            int files_unchanged = 0;
+            int files_linked = 0;
+        };
+
+        struct UploadItem {
+            QString local_path;
+            QString remote_path;
+        };
+
+        TransferManager(ApiClient* api, TransferScheduler* scheduler, QObject* parent = nullptr);
+
+        TransferScheduler* scheduler() const { return m_Scheduler; }
+
+        TransferScheduler::JobId download(const FileInfo& file, const QString& local_path);
+        TransferScheduler::JobId upload(const QString& local_path, const QString& remote_path);
+        // nullptr turns peer sharing off
+        void set_peer_cache(PeerCache* peers) { m_Peers = peers; }
+
+        // Copies an offline copy to local_path, decrypting it if it is sealed; no network involved
+        void restore_copy(const QString& source, const QString& local_path, std::function<void(bool)> done);
+        // Hashes the files, asks the server about all of them at once and only uploads what it lacks
+        void upload_batch(const QVector<UploadItem>& items);
+        // Uploads everything under local_dir to remote_prefix/<relative path>. The tree is walked in the
+        // background and files are handed to upload_batch as they are found; the walk itself is a
+        // cancellable job so the transfer batch stays open until it ends.
+        void upload_tree(const QString& local_dir, const QString& remote_prefix);
+
+        // Turning encryption on loads the key from ~/.sapcloud, creating one only if there is no key file yet
+        bool set_encryption(bool enabled);
+        bool encryption_enabled() const { return m_EncryptUploads; }
+        QString encryption_error() const { return m_Cipher.last_error(); }
+
+        // Re-queues every journaled transfer that isn't already queued or running
+        void resume_pending();
+
+        // Returns the totals accumulated since the last call and resets them
+        UploadStats take_upload_stats();
+
+    signals:
+        // A journaled upload is done for good: succeeded, cancelled or out of retries. Unlike the
+        // scheduler's job_finished, transient failures that are retried under a new job don't count.
+        void upload_finished(const QString& local_path, bool ok);
+
+    private:
+        TransferScheduler::JobId enqueue_entry(quint64 entry_id);
+        TransferScheduler::AbortFn run_download(quint64 entry_id, ProgressFn progress, TransferScheduler::DoneFn done);
+        TransferScheduler::AbortFn run_server_download(quint64 entry_id, qint64 offset, ProgressFn progress,
+                                                       std::function<void(bool)> finish, std::shared_ptr<bool> cancelled);
+        TransferScheduler::AbortFn run_tree_scan(const QString& local_dir, const QString& remote_prefix,
+                                                 TransferScheduler::DoneFn done);
+        TransferScheduler::AbortFn run_preflight(const QVector<UploadItem>& items, TransferScheduler::DoneFn done);
+        TransferScheduler::AbortFn run_upload(quint64 entry_id, ProgressFn progress, TransferScheduler::DoneFn done);
+        // Picks the best upload path the server still supports; a path that finds its endpoint
+        // missing calls back in here, and replaces *abort so cancelling reaches the new attempt
+        void start_upload(quint64 entry_id, ProgressFn progress, TransferScheduler::DoneFn done,
+                          std::shared_ptr<TransferScheduler::AbortFn> abort, std::shared_ptr<bool> cancelled);
+        void run_dedup_upload(quint64 entry_id, ProgressFn progress, TransferScheduler::DoneFn done,
+                              std::shared_ptr<TransferScheduler::AbortFn> abort, std::shared_ptr<bool> cancelled);
+        void run_session_upload(quint64 entry_id, ProgressFn progress, TransferScheduler::DoneFn done,
+                                std::shared_ptr<TransferScheduler::AbortFn> abort, std::shared_ptr<bool> cancelled);
+        void run_plain_upload(quint64 entry_id, ProgressFn progress, TransferScheduler::DoneFn done,
+                              std::shared_ptr<TransferScheduler::AbortFn> abort, std::shared_ptr<bool> cancelled);
+        // Persists progress at most every k_RecordInterval bytes or milliseconds per transfer
+        void record_committed(quint64 entry_id, qint64 committed);
+        // A permanent failure is dropped from the journal instead of retried
+        void finish_entry(quint64 entry_id, bool ok, bool cancelled, bool permanent = false);
+        // Decrypts a finished download in place if it is sealed, then calls done; on failure the file keeps its downloaded bytes
+        void decrypt_download(const QString& local_path, std::function<void(bool)> done);
+
+        static constexpr qint64 k_RecordIntervalBytes = 8LL * 1024 * 1024;
+        static constexpr qint64 k_RecordIntervalMs = 1000;
+        static constexpr int k_MaxAttempts = 5;
+
+        ApiClient* m_Api;
+        TransferScheduler* m_Scheduler;
+        TransferJournal m_Journal;
+        ChunkIndex m_ChunkIndex;
+        DriveCipher m_Cipher;
+        PeerCache* m_Peers = nullptr;
+        bool m_EncryptUploads = false;
+        UploadStats m_UploadStats;
+        QHash<quint64, TransferScheduler::JobId> m_Active;
+        QHash<TransferScheduler::JobId, quint64> m_JobEntries; // the reverse of m_Active
+
+        struct Recorded {
+            qint64 committed = 0; // last value written to the journal
+            qint64 latest = 0;
+            qint64 at = 0;
+        };
+        QHash<quint64, Recorded> m_Recorded;
+        QElapsedTimer m_Clock;
+    };
+
+} // namespace sap::client
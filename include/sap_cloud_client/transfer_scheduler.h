@@ -0,0 +1,122 @@
+#pragma once
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QTimer>
+#include <deque>
+#include <functional>
+#include "api_client.h"
+#include "download_verifier.h"
+
+namespace sap::client {
+
+    // Bounded queue for bulk Drive operations.
+    // Runs at most concurrency_limit() jobs at once and adapts that limit with AIMD:
+    // - Additive increase while each round of completions keeps or improves throughput
+    // - Multiplicative decrease on failures, or when latency climbs without a throughput gain
+    class TransferScheduler : public QObject {
+        Q_OBJECT
+
+    public:
+        using JobId = quint64;
+        using AbortFn = std::function<void()>;
+        using DoneFn = std::function<void(bool)>;
+        // Starts the work and returns a way to abort it (may be empty); done must be called exactly once
+        using StartFn = std::function<AbortFn(ProgressFn progress, DoneFn done)>;
+
+        enum class JobKind { Upload, Download, Delete, Other };
+        enum class JobState { Queued, Running, Succeeded, Failed, Cancelled };
+
+        struct Job {
+            JobId id = 0;
+            JobKind kind = JobKind::Other;
+            QString label;
+            qint64 bytes_total = 0;
+            qint64 bytes_done = 0;
+            JobState state = JobState::Queued;
+            qint64 started_at = 0;
+            qint64 finished_at = 0;
+        };
+
+        // Aggregate over the current batch (everything enqueued since the queue was last idle)
+        struct Stats {
+            int queued = 0;
+            int running = 0;
+            int succeeded = 0;
+            int failed = 0;
+            int cancelled = 0;
+            qint64 bytes_total = 0;
+            qint64 bytes_done = 0;
+            double bytes_per_sec = 0;
+            qint64 eta_ms = -1;
+            // Downloads hashed against their expected content hash during this batch, and how fast
+            // the hashing itself runs (time spent hashing, not wall time)
+            qint64 bytes_verified = 0;
+            double verify_bytes_per_sec = 0;
+            int concurrency_limit = 0;
+
+            int total() const { return queued + running + succeeded + failed + cancelled; }
+            int finished() const { return succeeded + failed + cancelled; }
+        };
+
+        explicit TransferScheduler(QObject* parent = nullptr);
+
+        void set_concurrency_bounds(int min_limit, int max_limit);
+        int concurrency_limit() const { return static_cast<int>(m_Limit); }
+
+        JobId enqueue(JobKind kind, const QString& label, qint64 bytes, StartFn start);
+        void cancel(JobId id);
+        void cancel_all();
+
+        const Job* job(JobId id) const;
+        Stats stats() const;
+        bool is_idle() const { return m_Queue.empty() && m_Running.isEmpty(); }
+
+    signals:
+        // Every job ends with exactly one of these, including jobs cancelled before they started
+        void job_finished(TransferScheduler::JobId id, bool ok);
+        // Emitted at most every k_StatsIntervalMs while work is in flight
+        void stats_changed();
+        // The queue drained; counts cover the batch that just ended
+        void batch_finished(int succeeded, int failed, int cancelled);
+
+    private:
+        void pump();
+        void start_job(JobId id);
+        void on_job_progress(JobId id, qint64 done, qint64 total);
+        void on_job_done(JobId id, bool ok);
+        void adapt(const Job& job, bool ok);
+        void update_rate();
+        void schedule_stats();
+        void finish_batch_if_idle();
+
+        static constexpr int k_StatsIntervalMs = 100;
+
+        QHash<JobId, Job> m_Jobs;
+        QHash<JobId, StartFn> m_Starters;
+        QHash<JobId, AbortFn> m_Running;
+        std::deque<JobId> m_Queue;
+        JobId m_NextId = 1;
+
+        // AIMD state
+        double m_Limit = 4;
+        int m_MinLimit = 1;
+        int m_MaxLimit = 16;
+        qint64 m_RoundStart = 0;
+        qint64 m_RoundBytes = 0;
+        int m_RoundJobs = 0;
+        qint64 m_RoundLatency = 0;
+        double m_LastRoundRate = 0;
+        qint64 m_BaseLatency = 0;
+
+        // Smoothed batch throughput
+        QElapsedTimer m_Clock;
+        qint64 m_RateSampleAt = 0;
+        qint64 m_RateSampleBytes = 0;
+        double m_BytesPerSec = 0;
+        DownloadVerifier::Totals m_VerifyBase; // process-wide totals when the batch started
+        QTimer* m_StatsTimer;
+    };
+
+} // namespace sap::client
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <QObject>
+#include <QStringList>
+#include <QTimer>
+#include <memory>
+
+namespace sap::client {
+
+    // Walks a local directory tree on the thread pool and reports files as it finds them.
+    // Every directory is listed by its own pool task (one readdir pass each, subdirectories fanned
+    // out to further tasks), so wide trees are enumerated in parallel. Results arrive in batches of
+    // up to k_BatchSize relative paths, flushed at least every k_BatchIntervalMs, long before the
+    // walk is complete. Symlinked directories are not followed.
+    class TreeScanner : public QObject {
+        Q_OBJECT
+
+    public:
+        static constexpr int k_BatchSize = 256;
+        static constexpr int k_BatchIntervalMs = 100;
+
+        explicit TreeScanner(const QString& root, QObject* parent = nullptr);
+        ~TreeScanner() override;
+
+        QString root() const { return m_Root; }
+        int files_found() const { return m_Found; }
+
+        void start();
+        void abort();
+
+    signals:
+        // Paths relative to root, '/'-separated
+        void batch(const QStringList& relative_paths);
+        // Emitted once after the last batch; not emitted after abort()
+        void finished(bool ok);
+
+    private:
+        struct Shared;
+
+        // Each runs on the pool; the last directory to finish hands control back to the owner
+        static void spawn(const std::shared_ptr<Shared>& shared, const QString& dir, const QString& prefix);
+        static void scan_directory(const std::shared_ptr<Shared>& shared, const QString& dir, const QString& prefix);
+
+        void flush();
+        void on_walk_done();
+
+        QString m_Root;
+        std::shared_ptr<Shared> m_Shared;
+        QTimer m_FlushTimer;
+        int m_Found = 0;
+        bool m_Done = false;
+    };
+
+} // namespace sap::client
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <QCryptographicHash>
 #include <QJsonArray>
 #include <QJsonObject>
 #include <QString>
@@ -10,6 +11,9 @@ namespace sap::client {
 
     using Timestamp = qint64;
 
+    // Algorithm behind FileInfo::hash, rendered as lowercase hex
+    constexpr QCryptographicHash::Algorithm k_ContentHashAlgorithm = QCryptographicHash::Sha256;
+
     struct AuthChallenge {
         QString challenge;
         QString public_key;
@@ -56,6 +60,178 @@ namespace sap::client {
             f.is_deleted = obj["is_deleted"].toBool();
             return f;
         }
+
+        QJsonObject to_json() const {
+            QJsonObject obj;
+            obj["path"] = path;
+            obj["hash"] = hash;
+            obj["size"] = size;
+            obj["mtime"] = mtime;
+            obj["created_at"] = created_at;
+            obj["updated_at"] = updated_at;
+            if (is_deleted)
+                obj["is_deleted"] = true;
+            return obj;
+        }
+
+        bool same_version(const FileInfo& other) const {
+            return hash == other.hash && size == other.size && mtime == other.mtime && updated_at == other.updated_at &&
+                   is_deleted == other.is_deleted;
+        }
+    };
+
+    // Server-side state of a resumable (multipart) upload
+    struct UploadStatus {
+        QString id;
+        QString path;
+        qint64 size = 0;
+        qint64 part_size = 0;
+        QVector<int> parts; // acknowledged part numbers
+
+        static UploadStatus from_json(const QJsonObject& obj) {
+            UploadStatus u;
+            u.id = obj["upload_id"].toString();
+            u.path = obj["path"].toString();
+            u.size = obj["size"].toInteger();
+            u.part_size = obj["part_size"].toInteger();
+            for (const auto& p : obj["parts"].toArray()) {
+                u.parts.append(p.toInt());
+            }
+            return u;
+        }
+    };
+
+    // A local file offered to the server before uploading it, by path and content hash
+    struct FileCandidate {
+        QString path;
+        QString hash;
+        qint64 size = 0;
+
+        QJsonObject to_json() const {
+            QJsonObject obj;
+            obj["path"] = path;
+            obj["hash"] = hash;
+            obj["size"] = size;
+            return obj;
+        }
+    };
+
+    // Preflight answer per candidate: same content already at that path, content stored
+    // under another path (can be linked), or not on the server at all
+    enum class PreflightStatus { Missing, Exists, Known };
+
+    // One mutation in a batch request; target is a file path or a note id
+    struct BatchOp {
+        enum class Kind { DeleteFile, MoveFile, DeleteNote, TagNote };
+
+        Kind kind = Kind::DeleteFile;
+        QString target;
+        QString destination;          // MoveFile
+        QVector<QString> add_tags;    // TagNote
+        QVector<QString> remove_tags; // TagNote
+
+        QJsonObject to_json() const {
+            QJsonObject obj;
+            switch (kind) {
+            case Kind::DeleteFile:
+                obj["op"] = "delete_file";
+                obj["path"] = target;
+                break;
+            case Kind::MoveFile:
+                obj["op"] = "move_file";
+                obj["from"] = target;
+                obj["to"] = destination;
+                break;
+            case Kind::DeleteNote:
+                obj["op"] = "delete_note";
+                obj["id"] = target;
+                break;
+            case Kind::TagNote: {
+                obj["op"] = "tag_note";
+                obj["id"] = target;
+                QJsonArray add, remove;
+                for (const auto& t : add_tags)
+                    add.append(t);
+                for (const auto& t : remove_tags)
+                    remove.append(t);
+                obj["add"] = add;
+                obj["remove"] = remove;
+                break;
+            }
+            }
+            return obj;
+        }
+
+        bool is_delete() const { return kind == Kind::DeleteFile || kind == Kind::DeleteNote; }
+    };
+
+    // Outcome of one BatchOp, with the HTTP status it would have had on its own
+    struct BatchResult {
+        bool ok = false;
+        int status = 0;
+        QString error;
+
+        static BatchResult from_json(const QJsonObject& obj) {
+            BatchResult r;
+            r.status = obj["status"].toInt();
+            r.ok = r.status >= 200 && r.status < 300;
+            r.error = obj["error"].toString();
+            return r;
+        }
+    };
+
+    // One content-defined chunk of a file, addressed by its content hash
+    struct ChunkRef {
+        QString hash;
+        qint64 offset = 0;
+        qint64 size = 0;
+
+        static ChunkRef from_json(const QJsonObject& obj) {
+            ChunkRef c;
+            c.hash = obj["hash"].toString();
+            c.offset = obj["offset"].toInteger();
+            c.size = obj["size"].toInteger();
+            return c;
+        }
+
+        QJsonObject to_json() const {
+            QJsonObject obj;
+            obj["hash"] = hash;
+            obj["offset"] = offset;
+            obj["size"] = size;
+            return obj;
+        }
+    };
+
+    // A file described as an ordered list of chunks
+    struct FileManifest {
+        QString path;
+        QString hash;
+        qint64 size = 0;
+        QVector<ChunkRef> chunks;
+
+        static FileManifest from_json(const QJsonObject& obj) {
+            FileManifest m;
+            m.path = obj["path"].toString();
+            m.hash = obj["hash"].toString();
+            m.size = obj["size"].toInteger();
+            for (const auto& v : obj["chunks"].toArray()) {
+                m.chunks.append(ChunkRef::from_json(v.toObject()));
+            }
+            return m;
+        }
+
+        QJsonObject to_json() const {
+            QJsonObject obj;
+            obj["path"] = path;
+            obj["hash"] = hash;
+            obj["size"] = size;
+            QJsonArray arr;
+            for (const auto& c : chunks)
+                arr.append(c.to_json());
+            obj["chunks"] = arr;
+            return obj;
+        }
     };
 
     struct SyncState {
@@ -72,6 +248,35 @@ namespace sap::client {
         }
     };
 
+    // One child of a Merkle directory node; hash is the lowercase hex node digest
+    struct MerkleEntry {
+        QString name;
+        QString hash;
+        bool is_dir = false;
+
+        static MerkleEntry from_json(const QJsonObject& obj) {
+            MerkleEntry e;
+            e.name = obj["name"].toString();
+            e.hash = obj["hash"].toString();
+            e.is_dir = obj["dir"].toBool();
+            return e;
+        }
+    };
+
+    // A directory of the remote namespace as the server's Merkle tree sees it
+    struct MerkleNode {
+        QString hash;
+        QVector<MerkleEntry> children;
+
+        static MerkleNode from_json(const QJsonObject& obj) {
+            MerkleNode n;
+            n.hash = obj["hash"].toString();
+            for (const auto& v : obj["children"].toArray())
+                n.children.append(MerkleEntry::from_json(v.toObject()));
+            return n;
+        }
+    };
+
     struct NoteItem {
         QString id;
         QString title;
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <QBitArray>
+#include <QHash>
+#include <QNetworkReply>
+#include <QObject>
+#include <QPointer>
+#include <atomic>
+#include <memory>
+#include "types.h"
+
+namespace sap::client {
+
+    class ApiClient;
+
+    // Uploads one local file through a server-side multipart upload session:
+    // - Up to k_MaxConcurrentParts parts are PUT in parallel, each retried with backoff on its own
+    // - Part size follows the file size and the bandwidth measured on earlier parts
+    // Acknowledged parts survive a dropped connection or a restart: resume() asks the
+    // server which parts it holds and only sends the rest, unless the local file changed since.
+    // The whole-file hash goes with complete, so parts from before and after an edit the size and
+    // mtime didn't show are refused by the server; the session then starts over once.
+    class UploadSession : public QObject {
+        Q_OBJECT
+
+    public:
+        // Below this size a resumable session costs more round trips than a restart would
+        static constexpr qint64 k_MinFileSize = 16LL * 1024 * 1024;
+        static constexpr qint64 k_MinPartSize = 5LL * 1024 * 1024;
+        static constexpr qint64 k_MaxPartSize = 128LL * 1024 * 1024;
+        static constexpr int k_MaxParts = 10000;
+        static constexpr int k_MaxConcurrentParts = 4;
+        static constexpr int k_MaxPartRetries = 3;
+
+        // Part size for a file of this size given the per-connection bandwidth seen so far
+        static qint64 choose_part_size(qint64 file_size);
+
+        UploadSession(ApiClient* api, const QString& local_path, const QString& remote_path, QObject* parent = nullptr);
+
+        void start();
+        // Continues an existing session begun when the file had local_mtime (see local_mtime());
+        // falls back to a fresh one if the server no longer knows it or the file changed
+        void resume(const QString& upload_id, qint64 local_mtime);
+        void abort();
+
+        QString upload_id() const { return m_Id; }
+        qint64 part_size() const { return m_PartSize; }
+        // Modification time of the local file (ms since epoch) when the current session began
+        qint64 local_mtime() const { return m_Mtime; }
+
+    signals:
+        void session_created(const QString& upload_id, qint64 part_size);
+        void part_acked(int part);
+        void progress(qint64 sent, qint64 total);
+        // Emitted exactly once
+        void finished(bool ok, const FileInfo& file);
+
+    private:
+        struct InFlight {
+            QPointer<QNetworkReply> reply;
+            qint64 sent = 0;
+        };
+
+        void begin(const UploadStatus& status);
+        void start_hash();
+        void on_complete_failed();
+        void pump();
+        void send_part(int part);
+        void on_part_finished(int part, bool ok, qint64 elapsed_ms);
+        void report_progress();
+        qint64 part_length(int part) const;
+        qint64 acked_bytes() const;
+        void complete(bool ok, const FileInfo& file = {});
+
+        // Process-wide EWMA of bytes/second per part connection, feeds choose_part_size()
+        static double s_PartBandwidth;
+        // Aim for parts that take a few seconds each: long enough to amortize the request, short enough to retry cheaply
+        static constexpr double k_TargetPartSeconds = 4.0;
+
+        ApiClient* m_Api;
+        QString m_LocalPath;
+        QString m_RemotePath;
+        qint64 m_Size = 0;
+        qint64 m_Mtime = 0;
+
+        QString m_Id;
+        qint64 m_PartSize = k_MinPartSize;
+        QBitArray m_Acked;
+        QHash<int, InFlight> m_InFlight;
+        QHash<int, int> m_Retries;
+        // Hashed alongside the parts; complete waits for it
+        QString m_ContentHash;
+        std::shared_ptr<std::atomic<bool>> m_HashCancel;
+        bool m_Completing = false;
+        bool m_Restarted = false;
+        bool m_Done = false;
+    };
+
+} // namespace sap::client
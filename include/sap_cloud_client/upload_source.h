@@ -0,0 +1,63 @@
+#pragma once
+
+#include <QFile>
+#include <QIODevice>
+#include "drive_cipher.h"
+#include "hash_service.h"
+
+namespace sap::client {
+
+    // Read-only, random-access view of a local file used as an upload body:
+    // - Serves reads with positioned reads, never a mapping: the file belongs to the user, and one
+    //   truncated mid-upload (an editor, FolderSync) must fail the request rather than SIGBUS the client
+    // - Hashes the content in the same pass the network stack reads it
+    // - Reports a fixed size so the request goes out with a known Content-Length
+    // A window (offset, length) exposes just that slice of the file, e.g. one part of a multipart upload.
+    // With a cipher the source presents the whole file encrypted (DriveCipher layout), sealing one chunk
+    // at a time as it is read; the hash is then of the encrypted bytes, which is what the server stores.
+    class UploadSource : public QIODevice {
+        Q_OBJECT
+
+    public:
+        explicit UploadSource(const QString& local_path, QObject* parent = nullptr);
+        UploadSource(const QString& local_path, qint64 offset, qint64 length, QObject* parent = nullptr);
+        UploadSource(const QString& local_path, const DriveCipher* cipher, QObject* parent = nullptr);
+        ~UploadSource() override;
+
+        bool open(OpenMode mode) override;
+        void close() override;
+        bool isSequential() const override { return false; }
+        qint64 size() const override { return m_Size; }
+        bool seek(qint64 pos) override;
+
+        QString local_path() const { return m_File.fileName(); }
+        // Hex content hash, valid once every byte has been read in order; empty otherwise
+        QString hash() const;
+
+    protected:
+        qint64 readData(char* data, qint64 max_size) override;
+        qint64 writeData(const char*, qint64) override { return -1; }
+
+    private:
+        qint64 read_plain(qint64 pos, char* data, qint64 count);
+        qint64 read_sealed(char* data, qint64 count);
+
+        QFile m_File;
+        qint64 m_Offset = 0;
+        qint64 m_Length = -1; // -1: up to the end of the file
+        qint64 m_Size = 0;
+        qint64 m_Pos = 0;
+
+        const DriveCipher* m_Cipher = nullptr;
+        DriveCipher::FileKey m_FileKey;
+        qint64 m_PlainSize = 0;
+        // Most recently sealed chunk; the network stack reads it in smaller pieces
+        qint64 m_SealedIndex = -1;
+        QByteArray m_Sealed;
+
+        // Bytes [0, m_Hashed) have been fed to m_Hash; rewinds (e.g. resent requests) don't rehash them
+        ContentHasher m_Hash;
+        qint64 m_Hashed = 0;
+    };
+
+} // namespace sap::client
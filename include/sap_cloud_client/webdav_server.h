@@ -0,0 +1,119 @@
+#pragma once
+
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QTcpServer>
+#include <memory>
+#include <optional>
+#include "api_client.h"
+#include "block_cache.h"
+#include "offline_store.h"
+#include "sync_engine.h"
+#include "transfer_manager.h"
+
+class QTcpSocket;
+
+namespace sap::client {
+
+    // Optional WebDAV endpoint on 127.0.0.1, so other desktop apps can open Drive files directly.
+    // The namespace comes from SyncEngine's index; folders are implied by the paths under them.
+    // File bodies come from the offline copy when there is one, and otherwise from a BlockCache,
+    // one Range request per block, so a viewer reading a few pages of a large file only fetches
+    // those pages. PUT bodies are spooled to disk and handed to TransferManager::upload(); the
+    // response waits for the upload and its retries. Locks are accepted but not enforced (class 2
+    // only so that clients mount read-write). Requests whose Host isn't the loopback are refused,
+    // which keeps web pages from reaching the server through DNS rebinding, and every request needs
+    // Basic auth with a password drawn for this run, since other local users can reach the port too.
+    // The server won't start
+    // while client-side encryption is on, since it has no way to serve sealed files as plaintext.
+    class WebDavServer : public QObject {
+        Q_OBJECT
+
+    public:
+        static constexpr quint16 k_DefaultPort = 8765;
+        static constexpr qint64 k_MaxHeaderSize = 64 * 1024;
+        static constexpr qint64 k_MaxXmlBody = 1024 * 1024;
+        static constexpr char k_User[] = "sap";
+
+        WebDavServer(ApiClient* api, SyncEngine* sync, TransferManager* transfers, OfflineStore* offline, QObject* parent = nullptr);
+        ~WebDavServer() override;
+
+        bool start(quint16 port = k_DefaultPort);
+        void stop();
+        bool is_running() const { return m_Server.isListening(); }
+        QString url() const;
+        // Credentials clients must mount with; the password changes every run
+        QString user() const { return k_User; }
+        QString password() const { return m_Password; }
+        QString last_error() const { return m_LastError; }
+        BlockCache* cache() { return &m_Cache; }
+
+    private:
+        using Headers = QList<std::pair<QByteArray, QByteArray>>;
+        struct Connection;
+
+        void on_connection(QTcpSocket* socket);
+        void on_ready_read(QTcpSocket* socket);
+        // Parses the request head at the front of the buffer; 0 if it's fine, otherwise the status to fail with
+        int parse_head(Connection& c, qsizetype head_size);
+        // Moves body bytes from the buffer to the spool or the in-memory body; true once it's all there
+        bool read_body(Connection& c);
+        void dispatch(const std::shared_ptr<Connection>& c);
+        void on_upload_finished(const QString& spool_path, bool ok);
+
+        void handle_options(const std::shared_ptr<Connection>& c);
+        void handle_propfind(const std::shared_ptr<Connection>& c);
+        void handle_proppatch(const std::shared_ptr<Connection>& c);
+        void handle_get(const std::shared_ptr<Connection>& c, bool head);
+        void handle_put(const std::shared_ptr<Connection>& c);
+        void handle_delete(const std::shared_ptr<Connection>& c);
+        void handle_mkcol(const std::shared_ptr<Connection>& c);
+        void handle_move(const std::shared_ptr<Connection>& c);
+        void handle_lock(const std::shared_ptr<Connection>& c);
+
+        // Sends the next stretch of a GET body once the socket has room for it
+        void pump_body(const std::shared_ptr<Connection>& c);
+        void send_head(const std::shared_ptr<Connection>& c, int status, qint64 length, const Headers& headers = {});
+        void respond(const std::shared_ptr<Connection>& c, int status, const QByteArray& body = {}, const Headers& headers = {});
+        // Readies a kept-alive connection for its next request
+        void finish_response(const std::shared_ptr<Connection>& c);
+        void close(const std::shared_ptr<Connection>& c);
+
+        std::optional<FileInfo> file(const QString& path) const;
+        bool is_folder(const QString& path) const;
+        // Brings path's entry in m_Children in line with whether it exists, adding or pruning its ancestors
+        void update_index(const QString& path);
+        void rebuild_index();
+        QByteArray prop_response(const QString& path, const FileInfo* file) const;
+        void on_sync_changed(const QStringList& updated, const QStringList& removed);
+
+        ApiClient* m_Api;
+        SyncEngine* m_Sync;
+        TransferManager* m_Transfers;
+        OfflineStore* m_Offline;
+        QTcpServer m_Server;
+        BlockCache m_Cache;
+        QString m_LastError;
+        QString m_SpoolDir;
+        QString m_Password;
+        // "Basic <base64 of user:password>", as clients send it
+        QByteArray m_Authorization;
+
+        QHash<QTcpSocket*, std::shared_ptr<Connection>> m_Connections;
+        // Uploads waiting on TransferManager, by spool path; retries keep reading the same spool
+        QHash<QString, std::shared_ptr<Connection>> m_Uploads;
+        // Written here but not in the index yet; the spooled copy serves reads meanwhile
+        struct Written {
+            FileInfo info;
+            QString spool;
+        };
+        QHash<QString, Written> m_Written;
+        // Created with MKCOL and still empty
+        QSet<QString> m_Folders;
+        // Folder -> its direct entries, over the index, m_Written and m_Folders; "" is the root.
+        // Kept current from SyncEngine::changed so folder lookups and listings don't scan the Drive.
+        QHash<QString, QSet<QString>> m_Children;
+    };
+
+} // namespace sap::client
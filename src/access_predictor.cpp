@@ -0,0 +1,120 @@
+#include "sap_cloud_client/access_predictor.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <algorithm>
+
+namespace sap::client {
+
+    void AccessPredictor::record(const QString& key, qint64 now_ms) {
+        if (key.isEmpty())
+            return;
+        bool linked = !m_Last.isEmpty() && m_Last != key && now_ms - m_LastAt <= k_SessionGapMs;
+        if (linked) {
+            Row& row = m_Rows[m_Last];
+            row.next[key]++;
+            row.total++;
+            trim(row);
+        }
+        m_Rows[key].seen = ++m_Clock;
+        m_Last = key;
+        m_LastAt = now_ms;
+
+        if (m_Rows.size() > k_MaxRows) {
+            auto oldest = std::min_element(m_Rows.begin(), m_Rows.end(), [](const Row& a, const Row& b) { return a.seen < b.seen; });
+            m_Rows.erase(oldest);
+        }
+    }
+
+    void AccessPredictor::trim(Row& row) {
+        if (row.total > k_MaxRowCount) {
+            row.total = 0;
+            for (auto it = row.next.begin(); it != row.next.end();) {
+                it.value() /= 2;
+                if (it.value() == 0) {
+                    it = row.next.erase(it);
+                    continue;
+                }
+                row.total += it.value();
+                ++it;
+            }
+        }
+        while (row.next.size() > k_MaxSuccessors) {
+            auto weakest = std::min_element(row.next.begin(), row.next.end());
+            row.total -= weakest.value();
+            row.next.erase(weakest);
+        }
+    }
+
+    QVector<AccessPredictor::Prediction> AccessPredictor::predict(const QString& key, int count) const {
+        QVector<Prediction> out;
+        auto row = m_Rows.constFind(key);
+        if (row == m_Rows.constEnd() || row->total <= 0)
+            return out;
+        for (auto it = row->next.constBegin(); it != row->next.constEnd(); ++it)
+            out.append({it.key(), static_cast<double>(it.value()) / row->total});
+        std::sort(out.begin(), out.end(), [](const Prediction& a, const Prediction& b) { return a.probability > b.probability; });
+        if (out.size() > count)
+            out.resize(count);
+        return out;
+    }
+
+    void AccessPredictor::clear() {
+        m_Rows.clear();
+        m_Last.clear();
+        m_LastAt = 0;
+        m_Clock = 0;
+    }
+
+    bool AccessPredictor::load(const QString& path) {
+        clear();
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly))
+            return false;
+        QJsonObject obj = QJsonDocument::fromJson(file.readAll()).object();
+        m_Clock = obj["clock"].toInteger();
+        QJsonObject rows = obj["rows"].toObject();
+        for (auto it = rows.constBegin(); it != rows.constEnd(); ++it) {
+            QJsonObject r = it.value().toObject();
+            Row row;
+            row.seen = r["seen"].toInteger();
+            QJsonObject next = r["next"].toObject();
+            for (auto n = next.constBegin(); n != next.constEnd(); ++n) {
+                int count = n.value().toInt();
+                if (count <= 0)
+                    continue;
+                row.next.insert(n.key(), count);
+                row.total += count;
+            }
+            m_Rows.insert(it.key(), row);
+        }
+        return true;
+    }
+
+    bool AccessPredictor::save(const QString& path) const {
+        QJsonObject rows;
+        for (auto it = m_Rows.constBegin(); it != m_Rows.constEnd(); ++it) {
+            QJsonObject next;
+            for (auto n = it->next.constBegin(); n != it->next.constEnd(); ++n)
+                next[n.key()] = n.value();
+            QJsonObject r;
+            r["seen"] = static_cast<qint64>(it->seen);
+            r["next"] = next;
+            rows[it.key()] = r;
+        }
+        QJsonObject obj;
+        obj["clock"] = static_cast<qint64>(m_Clock);
+        obj["rows"] = rows;
+
+        QDir().mkpath(QFileInfo(path).absolutePath());
+        QSaveFile file(path);
+        if (!file.open(QIODevice::WriteOnly))
+            return false;
+        file.write(QJsonDocument(obj).toJson(QJsonDocument::Compact));
+        return file.commit();
+    }
+
+} // namespace sap::client
@@ -1,13 +1,56 @@
 #include "sap_cloud_client/api_client.h"
+#include <QDir>
+#include <QFile>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QPointer>
+#include <QTemporaryFile>
 #include <QUrlQuery>
+#include <filesystem>
+#include <memory>
+#include <utility>
+#include "sap_cloud_client/compression.h"
+
+namespace {
+
+    // Upper bound on body bytes buffered inside a reply before we drain them to disk
+    constexpr qint64 k_DownloadBufferSize = 1024 * 1024;
+
+    // Below this the deflate header and CPU cost outweigh the savings
+    constexpr qsizetype k_MinCompressSize = 1024;
+    // Larger upload bodies are streamed from disk as-is rather than buffered to compress
+    constexpr qint64 k_MaxCompressedUploadSize = 8 * 1024 * 1024;
+
+    // Replaces target with source in one step (overwrites an existing target)
+    bool replace_file(const QString& source, const QString& target) {
+        std::error_code ec;
+        std::filesystem::rename(std::filesystem::path(source.toStdU16String()), std::filesystem::path(target.toStdU16String()), ec);
+        return !ec;
+    }
+
+    // Decoded body length, or -1 when unknown (a compressed body's Content-Length counts encoded bytes)
+    qint64 body_length(QNetworkReply* reply) {
+        QByteArray coding = reply->rawHeader("Content-Encoding").trimmed().toLower();
+        if (!coding.isEmpty() && coding != "identity")
+            return -1;
+        QVariant length = reply->header(QNetworkRequest::ContentLengthHeader);
+        return length.isValid() ? length.toLongLong() : -1;
+    }
+
+    bool is_http_error(QNetworkReply* reply) { return reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() >= 400; }
+
+} // anonymous namespace
 
 namespace sap::client {
 
-    ApiClient::ApiClient(QObject* parent) : QObject(parent), m_Net(new QNetworkAccessManager(this)), m_BaseUrl("http://localhost:8080") {}
+    ApiClient::ApiClient(QObject* parent) : QObject(parent), m_Net(new QNetworkAccessManager(this)), m_BaseUrl("http://localhost:8080") {
+        connect(m_Net, &QNetworkAccessManager::finished, this, &ApiClient::note_encodings);
+    }
 
+    // Responses: QNetworkAccessManager advertises the codings it can decode (gzip, deflate, and
+    // brotli/zstd where Qt was built with them) and decompresses transparently, as long as no
+    // request sets Accept-Encoding itself. Only ranged reads ask for identity.
     QNetworkRequest ApiClient::make_request(const QString& endpoint) {
         QNetworkRequest req(QUrl(m_BaseUrl + endpoint));
         req.setHeader(QNetworkRequest::ContentTypeHeader, "application/json");
@@ -17,11 +60,127 @@ namespace sap::client {
         return req;
     }
 
+    void ApiClient::note_encodings(QNetworkReply* reply) {
+        // A server that can't decode our bodies says so once; don't try again this session
+        int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        if (status == 415 && reply->request().hasRawHeader("Content-Encoding")) {
+            m_DeflateRejected = true;
+            m_ServerAcceptsDeflate = false;
+            return;
+        }
+        // RFC 7694: Accept-Encoding on a response lists the codings the server takes in requests
+        if (!m_DeflateRejected && reply->hasRawHeader("Accept-Encoding"))
+            m_ServerAcceptsDeflate = reply->rawHeader("Accept-Encoding").toLower().contains("deflate");
+    }
+
+    QByteArray ApiClient::encode_body(QNetworkRequest& req, const QByteArray& body, bool check_entropy) {
+        if (!m_ServerAcceptsDeflate || body.size() < k_MinCompressSize)
+            return body;
+        if (check_entropy && !looks_compressible(body))
+            return body;
+        // Uploads favour speed; JSON compresses well at any level
+        QByteArray packed = deflate_body(body, check_entropy ? 1 : -1);
+        if (packed.size() >= body.size() * 9 / 10)
+            return body;
+        req.setRawHeader("Content-Encoding", "deflate");
+        return packed;
+    }
+
+    QNetworkReply* ApiClient::send_body(QNetworkAccessManager::Operation op, QNetworkRequest req, const QByteArray& body,
+                                        bool check_entropy, ProgressFn progress) {
+        QNetworkRequest plain = req;
+        QByteArray wire = encode_body(req, body, check_entropy);
+        QNetworkReply* reply = op == QNetworkAccessManager::PostOperation ? m_Net->post(req, wire) : m_Net->put(req, wire);
+
+        // Callers track content bytes, so scale wire progress back to the uncompressed size
+        qint64 raw_size = body.size();
+        qint64 wire_size = wire.size();
+        if (progress) {
+            connect(reply, &QNetworkReply::uploadProgress, this, [progress, raw_size, wire_size](qint64 sent, qint64) {
+                progress(wire_size > 0 ? sent * raw_size / wire_size : sent, raw_size);
+            });
+        }
+
+        // Kept so a 415 can be answered by sending the same body again as it is
+        if (req.hasRawHeader("Content-Encoding")) {
+            m_Resend.insert(reply, [this, op, plain, body, progress]() {
+                QNetworkReply* again = op == QNetworkAccessManager::PostOperation ? m_Net->post(plain, body) : m_Net->put(plain, body);
+                if (progress)
+                    connect(again, &QNetworkReply::uploadProgress, this, [progress](qint64 sent, qint64 total) { progress(sent, total); });
+                return again;
+            });
+            connect(reply, &QObject::destroyed, this, [this, reply]() { m_Resend.remove(reply); });
+        }
+        return reply;
+    }
+
+    void ApiClient::when_finished(QNetworkReply* reply, std::function<void(QNetworkReply*)> handler) {
+        connect(reply, &QNetworkReply::finished, this, [this, reply, handler]() {
+            auto resend = m_Resend.take(reply);
+            int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            if (!resend || status != 415) {
+                handler(reply);
+                return;
+            }
+            // The server takes the body, just not deflated: no more compression this session, and
+            // this request goes again uncompressed. The original stays alive as the caller's handle.
+            m_DeflateRejected = true;
+            m_ServerAcceptsDeflate = false;
+            QNetworkReply* again = resend();
+            m_Replaced.insert(reply, again);
+            when_finished(again, [this, reply, handler](QNetworkReply* resent) {
+                m_Replaced.remove(reply);
+                reply->deleteLater();
+                handler(resent);
+            });
+        });
+    }
+
+    void ApiClient::abort(QNetworkReply* reply) {
+        if (!reply)
+            return;
+        QPointer<QNetworkReply> again = m_Replaced.value(reply);
+        if (again)
+            again->abort();
+        else
+            reply->abort();
+    }
+
+    QNetworkReply* ApiClient::post_json(const QString& endpoint, const QJsonObject& obj) { return post_json(make_request(endpoint), obj); }
+
+    QNetworkReply* ApiClient::post_json(QNetworkRequest req, const QJsonObject& obj) {
+        return send_body(QNetworkAccessManager::PostOperation, req, QJsonDocument(obj).toJson(QJsonDocument::Compact), false);
+    }
+
+    QNetworkReply* ApiClient::put_json(const QString& endpoint, const QJsonObject& obj) {
+        return send_body(QNetworkAccessManager::PutOperation, make_request(endpoint), QJsonDocument(obj).toJson(QJsonDocument::Compact),
+                         false);
+    }
+
+    QNetworkReply* ApiClient::put_source(QNetworkRequest req, UploadSource* source, ProgressFn progress) {
+        // Bounded bodies (chunks, parts, small files) are small enough to compress in memory.
+        // The source stays with the reply either way, so its hash is still there afterwards.
+        qint64 raw_size = source->size();
+        if (m_UploadCompression && m_ServerAcceptsDeflate && raw_size <= k_MaxCompressedUploadSize) {
+            QNetworkReply* reply = send_body(QNetworkAccessManager::PutOperation, req, source->readAll(), true, progress);
+            source->setParent(reply);
+            return reply;
+        }
+
+        req.setHeader(QNetworkRequest::ContentLengthHeader, raw_size);
+        QNetworkReply* reply = m_Net->put(req, source);
+        source->setParent(reply);
+        if (progress) {
+            connect(reply, &QNetworkReply::uploadProgress, this, [progress, raw_size](qint64 sent, qint64) { progress(sent, raw_size); });
+        }
+        return reply;
+    }
+
     void ApiClient::request_challenge(const QString& public_key, std::function<void(bool, AuthChallenge)> cb) {
         QJsonObject obj;
         obj["public_key"] = public_key;
-        auto* reply = m_Net->post(make_request("/api/v1/auth/challenge"), QJsonDocument(obj).toJson());
-        connect(reply, &QNetworkReply::finished, this, [this, reply, cb]() {
+        auto* reply = post_json("/api/v1/auth/challenge", obj);
+        when_finished(reply, [this, cb](QNetworkReply* reply) {
             reply->deleteLater();
             if (reply->error() != QNetworkReply::NoError) {
                 emit error(reply->errorString());
@@ -39,8 +198,8 @@ namespace sap::client {
         obj["challenge"] = challenge;
         obj["public_key"] = public_key;
         obj["signature"] = signature;
-        auto* reply = m_Net->post(make_request("/api/v1/auth/verify"), QJsonDocument(obj).toJson());
-        connect(reply, &QNetworkReply::finished, this, [this, reply, cb]() {
+        auto* reply = post_json("/api/v1/auth/verify", obj);
+        when_finished(reply, [this, cb](QNetworkReply* reply) {
             reply->deleteLater();
             if (reply->error() != QNetworkReply::NoError) {
                 emit error(reply->errorString());
@@ -73,6 +232,25 @@ namespace sap::client {
         });
     }
 
+    void ApiClient::get_merkle_node(const QString& dir, bool with_children, std::function<void(bool, MerkleNode)> cb) {
+        QUrlQuery query;
+        query.addQueryItem("path", dir);
+        if (!with_children)
+            query.addQueryItem("children", "0");
+        auto* reply = m_Net->get(make_request("/api/v1/sync/merkle?" + query.toString(QUrl::FullyEncoded)));
+        connect(reply, &QNetworkReply::finished, this, [this, reply, cb]() {
+            reply->deleteLater();
+            if (reply->error() != QNetworkReply::NoError) {
+                if (!note_missing_feature(reply, Feature::Merkle))
+                    emit error(reply->errorString());
+                cb(false, {});
+                return;
+            }
+            auto doc = QJsonDocument::fromJson(reply->readAll());
+            cb(true, MerkleNode::from_json(doc.object()));
+        });
+    }
+
     void ApiClient::list_files(std::function<void(bool, QVector<FileInfo>)> cb) {
         auto* reply = m_Net->get(make_request("/api/v1/files/"));
         connect(reply, &QNetworkReply::finished, this, [this, reply, cb]() {
@@ -104,14 +282,222 @@ namespace sap::client {
         });
     }
 
-    void ApiClient::upload_file(const QString& path, const QByteArray& data, std::function<void(bool)> cb) {
+    void ApiClient::stream_reply(QNetworkReply* reply, QIODevice* dest, ProgressFn progress, std::function<void(bool)> cb,
+                                 DownloadVerifier* verifier) {
+        // Bounded buffer: the socket is only read as fast as we drain it to dest
+        reply->setReadBufferSize(k_DownloadBufferSize);
+        auto write_failed = std::make_shared<bool>(false);
+        auto written = std::make_shared<qint64>(0);
+        QPointer<DownloadVerifier> hash(verifier);
+
+        // Progress counts bytes handed to dest, not bytes received, so it is safe to resume from
+        auto drain = [reply, dest, write_failed, written, progress, hash]() {
+            if (*write_failed || is_http_error(reply))
+                return;
+            qint64 before = *written;
+            while (reply->bytesAvailable() > 0) {
+                QByteArray chunk = reply->read(k_DownloadBufferSize);
+                if (dest->write(chunk) != chunk.size()) {
+                    *write_failed = true;
+                    reply->abort();
+                    return;
+                }
+                if (hash)
+                    hash->add(chunk);
+                *written += chunk.size();
+            }
+            if (progress && *written != before)
+                progress(*written, body_length(reply));
+        };
+        connect(reply, &QNetworkReply::readyRead, this, drain);
+        connect(reply, &QNetworkReply::finished, this, [this, reply, dest, drain, write_failed, cb]() {
+            reply->deleteLater();
+            drain();
+            if (*write_failed) {
+                emit error("Failed to write download: " + dest->errorString());
+                cb(false);
+                return;
+            }
+            if (reply->error() != QNetworkReply::NoError) {
+                emit error(reply->errorString());
+                cb(false);
+                return;
+            }
+            cb(true);
+        });
+    }
+
+    QNetworkReply* ApiClient::download_file(const QString& path, QIODevice* dest, ProgressFn progress, std::function<void(bool)> cb,
+                                            DownloadVerifier* verifier) {
+        auto* reply = m_Net->get(make_request("/api/v1/files/" + path));
+        stream_reply(reply, dest, progress, cb, verifier);
+        return reply;
+    }
+
+    QNetworkReply* ApiClient::download_file(const QString& path, const QString& local_path, ProgressFn progress,
+                                            std::function<void(bool)> cb) {
+        return resume_download(path, local_path, 0, {}, progress, cb);
+    }
+
+    QNetworkReply* ApiClient::resume_download(const QString& path, const QString& local_path, qint64 offset, const QString& expected_hash,
+                                              ProgressFn progress, std::function<void(bool)> cb) {
+        QString part_path = local_path + ".part";
+        auto* part = new QFile(part_path);
+        // Unbuffered so everything reported as written is already with the OS if we crash
+        QIODevice::OpenMode mode = offset > 0 ? QIODevice::OpenMode(QIODevice::ReadWrite) : (QIODevice::WriteOnly | QIODevice::Truncate);
+        mode |= QIODevice::Unbuffered;
+        if (!part->open(mode) || !part->seek(offset)) {
+            emit error("Cannot open " + part_path + ": " + part->errorString());
+            delete part;
+            cb(false);
+            return nullptr;
+        }
+
+        QNetworkRequest req = make_request("/api/v1/files/" + path);
+        if (offset > 0) {
+            req.setRawHeader("Range", "bytes=" + QByteArray::number(offset) + "-");
+            // Ranges address the encoded representation, so keep it unencoded
+            req.setRawHeader("Accept-Encoding", "identity");
+        }
+        auto* reply = m_Net->get(req);
+        part->setParent(reply);
+
+        // Outlives the reply: the last blocks may still be hashing when it finishes
+        DownloadVerifier* verifier = nullptr;
+        if (!expected_hash.isEmpty()) {
+            verifier = new DownloadVerifier(expected_hash, {}, this);
+            // The prefix from an earlier attempt hashes while the rest is on its way
+            verifier->add_file(part_path, offset);
+        }
+
+        // Bytes already in the part file; drops to 0 if the server ignores Range and resends everything
+        auto base = std::make_shared<qint64>(offset);
+        connect(reply, &QNetworkReply::metaDataChanged, part, [reply, part, base, verifier]() {
+            if (is_http_error(reply))
+                return;
+            if (*base > 0 && reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 200) {
+                *base = 0;
+                part->seek(0);
+                if (verifier)
+                    verifier->rewind(0);
+            }
+            // Reserve the full size up front once the server tells us how big the body is
+            qint64 length = body_length(reply);
+            if (length > 0 && part->pos() == *base) {
+                part->resize(*base + length);
+            }
+        });
+
+        ProgressFn shifted;
+        if (progress) {
+            shifted = [progress, base](qint64 received, qint64 total) { progress(*base + received, total > 0 ? *base + total : total); };
+        }
+
+        // A failed transfer keeps its part file so it can be resumed from committed bytes later
+        stream_reply(
+            reply, part, shifted,
+            [this, part, path, part_path, local_path, verifier, cb](bool ok) {
+                if (ok) {
+                    // Drop any preallocated tail the body did not fill
+                    part->resize(part->pos());
+                    ok = part->flush();
+                }
+                part->close();
+                if (!ok) {
+                    if (verifier)
+                        verifier->deleteLater();
+                    cb(false);
+                    return;
+                }
+
+                auto move_into_place = [this, part_path, local_path, cb]() {
+                    if (!replace_file(part_path, local_path)) {
+                        emit error("Cannot move download into place: " + local_path);
+                        cb(false);
+                        return;
+                    }
+                    cb(true);
+                };
+                if (!verifier) {
+                    move_into_place();
+                    return;
+                }
+                connect(verifier, &DownloadVerifier::finished, this, [this, verifier, path, part_path, move_into_place, cb](bool verified) {
+                    verifier->deleteLater();
+                    if (!verified) {
+                        // Nothing in this file can be trusted for a resume
+                        QFile::remove(part_path);
+                        emit error("Hash mismatch for " + path);
+                        cb(false);
+                        return;
+                    }
+                    move_into_place();
+                });
+                verifier->finish();
+            },
+            verifier);
+        return reply;
+    }
+
+    SegmentedDownload* ApiClient::download_file_segmented(const FileInfo& file, const QString& local_path, ProgressFn progress,
+                                                          std::function<void(bool)> cb) {
+        QString part_path = local_path + ".part";
+        auto* download = new SegmentedDownload(this, file.path, part_path, file.size, file.hash, this);
+        if (progress) {
+            connect(download, &SegmentedDownload::progress, this, [progress](qint64 received, qint64 total) { progress(received, total); });
+        }
+        connect(download, &SegmentedDownload::finished, this, [this, download, part_path, local_path, cb](bool ok) {
+            download->deleteLater();
+            if (ok && !replace_file(part_path, local_path)) {
+                emit error("Cannot move download into place: " + local_path);
+                ok = false;
+            }
+            cb(ok);
+        });
+        download->start();
+        return download;
+    }
+
+    QNetworkReply* ApiClient::get_file_range(const QString& path, qint64 offset, qint64 length) {
+        QNetworkRequest req = make_request("/api/v1/files/" + path);
+        QByteArray range = "bytes=" + QByteArray::number(offset) + "-";
+        if (length > 0) {
+            range += QByteArray::number(offset + length - 1);
+        }
+        req.setRawHeader("Range", range);
+        // Ranges address the encoded representation, so keep it unencoded
+        req.setRawHeader("Accept-Encoding", "identity");
+        return m_Net->get(req);
+    }
+
+    void ApiClient::head_file(const QString& path, std::function<void(bool, qint64)> cb) {
+        QNetworkRequest req = make_request("/api/v1/files/" + path);
+        req.setRawHeader("Accept-Encoding", "identity");
+        auto* reply = m_Net->head(req);
+        connect(reply, &QNetworkReply::finished, this, [this, reply, cb]() {
+            reply->deleteLater();
+            if (reply->error() != QNetworkReply::NoError) {
+                emit error(reply->errorString());
+                cb(false, 0);
+                return;
+            }
+            cb(true, reply->header(QNetworkRequest::ContentLengthHeader).toLongLong());
+        });
+    }
+
+    QNetworkRequest ApiClient::make_upload_request(const QString& path) {
         QNetworkRequest req(QUrl(m_BaseUrl + "/api/v1/files/" + path));
         req.setHeader(QNetworkRequest::ContentTypeHeader, "application/octet-stream");
         if (!m_Token.isEmpty()) {
             req.setRawHeader("Authorization", ("Bearer " + m_Token).toUtf8());
         }
-        auto* reply = m_Net->put(req, data);
-        connect(reply, &QNetworkReply::finished, this, [this, reply, cb]() {
+        return req;
+    }
+
+    void ApiClient::upload_file(const QString& path, const QByteArray& data, std::function<void(bool)> cb) {
+        QNetworkRequest req = make_upload_request(path);
+        auto* reply = m_UploadCompression ? send_body(QNetworkAccessManager::PutOperation, req, data, true) : m_Net->put(req, data);
+        when_finished(reply, [this, cb](QNetworkReply* reply) {
             reply->deleteLater();
             if (reply->error() != QNetworkReply::NoError) {
                 emit error(reply->errorString());
@@ -122,6 +508,22 @@ namespace sap::client {
         });
     }
 
+    QNetworkReply* ApiClient::upload_file(const QString& path, UploadSource* source, ProgressFn progress,
+                                          std::function<void(bool, QString)> cb) {
+        // Same encoding decision as parts and chunks: small files are deflated when the server takes it
+        auto* reply = put_source(make_upload_request(path), source, progress);
+        when_finished(reply, [this, source, cb](QNetworkReply* reply) {
+            reply->deleteLater();
+            if (reply->error() != QNetworkReply::NoError) {
+                emit error(reply->errorString());
+                cb(false, {});
+                return;
+            }
+            cb(true, source->hash());
+        });
+        return reply;
+    }
+
     void ApiClient::delete_file(const QString& path, std::function<void(bool)> cb) {
         auto* reply = m_Net->deleteResource(make_request("/api/v1/files/" + path));
         connect(reply, &QNetworkReply::finished, this, [this, reply, cb]() {
@@ -130,6 +532,470 @@ namespace sap::client {
         });
     }
 
+    void ApiClient::move_file(const QString& from, const QString& to, std::function<void(bool)> cb) {
+        if (!supports(Feature::Move)) {
+            move_by_copy(from, to, cb);
+            return;
+        }
+        QJsonObject obj;
+        obj["from"] = from;
+        obj["to"] = to;
+        auto* reply = post_json("/api/v1/files/move", obj);
+        when_finished(reply, [this, from, to, cb](QNetworkReply* reply) {
+            reply->deleteLater();
+            if (reply->error() != QNetworkReply::NoError) {
+                // A JSON 404 is the endpoint saying the source doesn't exist, not a missing endpoint
+                bool json = reply->header(QNetworkRequest::ContentTypeHeader).toString().startsWith("application/json");
+                int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+                if (!(json && status == 404) && note_missing_feature(reply, Feature::Move)) {
+                    move_by_copy(from, to, cb);
+                    return;
+                }
+                emit error(reply->errorString());
+                cb(false);
+                return;
+            }
+            cb(true);
+        });
+    }
+
+    void ApiClient::move_prefix(const QString& from_prefix, const QString& to_prefix, std::function<void(bool, int)> cb) {
+        auto fallback = [this, from_prefix, to_prefix, cb]() {
+            list_files([this, from_prefix, to_prefix, cb](bool ok, QVector<FileInfo> files) {
+                if (!ok) {
+                    cb(false, 0);
+                    return;
+                }
+                QVector<BatchOp> ops;
+                for (const auto& f : files) {
+                    if (!f.is_deleted && f.path.startsWith(from_prefix))
+                        ops.append({BatchOp::Kind::MoveFile, f.path, to_prefix + f.path.mid(from_prefix.size())});
+                }
+                run_batch(ops, [cb](bool ok, QVector<BatchResult> results) {
+                    int moved = 0;
+                    for (const auto& r : results) {
+                        if (r.ok)
+                            moved++;
+                    }
+                    cb(ok && moved == results.size(), moved);
+                });
+            });
+        };
+        if (!supports(Feature::Move)) {
+            fallback();
+            return;
+        }
+
+        QJsonObject obj;
+        obj["from_prefix"] = from_prefix;
+        obj["to_prefix"] = to_prefix;
+        auto* reply = post_json("/api/v1/files/move", obj);
+        when_finished(reply, [this, fallback, cb](QNetworkReply* reply) {
+            reply->deleteLater();
+            if (reply->error() != QNetworkReply::NoError) {
+                if (note_missing_feature(reply, Feature::Move)) {
+                    fallback();
+                    return;
+                }
+                emit error(reply->errorString());
+                cb(false, 0);
+                return;
+            }
+            auto doc = QJsonDocument::fromJson(reply->readAll());
+            cb(true, doc.object()["moved"].toInt());
+        });
+    }
+
+    void ApiClient::move_by_copy(const QString& from, const QString& to, std::function<void(bool)> cb) {
+        // Through a temporary file both ways, so a large file never has to fit in memory
+        auto temp = std::make_shared<QTemporaryFile>(QDir::tempPath() + "/sapcloud-move-XXXXXX");
+        if (!temp->open()) {
+            emit error("Cannot create a temporary file to move " + from + ": " + temp->errorString());
+            cb(false);
+            return;
+        }
+        download_file(from, temp.get(), {}, [this, from, to, cb, temp](bool ok) {
+            if (!ok || !temp->flush()) {
+                cb(false);
+                return;
+            }
+            auto* source = new UploadSource(temp->fileName());
+            if (!source->open(QIODevice::ReadOnly)) {
+                emit error("Cannot read " + temp->fileName() + ": " + source->errorString());
+                delete source;
+                cb(false);
+                return;
+            }
+            // The temporary file goes once the upload no longer reads it
+            upload_file(to, source, {}, [this, from, cb, temp](bool ok, QString) {
+                if (!ok) {
+                    cb(false);
+                    return;
+                }
+                delete_file(from, cb);
+            });
+        });
+    }
+
+    void ApiClient::preflight_files(const QVector<FileCandidate>& files, std::function<void(bool, QHash<QString, PreflightStatus>)> cb) {
+        QJsonArray arr;
+        for (const auto& f : files)
+            arr.append(f.to_json());
+        QJsonObject obj;
+        obj["files"] = arr;
+        auto* reply = post_json("/api/v1/files/preflight", obj);
+        when_finished(reply, [this, cb](QNetworkReply* reply) {
+            reply->deleteLater();
+            if (reply->error() != QNetworkReply::NoError) {
+                if (!note_missing_feature(reply, Feature::Preflight))
+                    emit error(reply->errorString());
+                cb(false, {});
+                return;
+            }
+            auto doc = QJsonDocument::fromJson(reply->readAll());
+            QHash<QString, PreflightStatus> results;
+            for (const auto& v : doc.object()["results"].toArray()) {
+                QJsonObject r = v.toObject();
+                QString status = r["status"].toString();
+                results.insert(r["path"].toString(), status == "exists" ? PreflightStatus::Exists
+                                                      : status == "known" ? PreflightStatus::Known
+                                                                          : PreflightStatus::Missing);
+            }
+            cb(true, results);
+        });
+    }
+
+    void ApiClient::link_files(const QVector<FileCandidate>& files, std::function<void(bool, QStringList)> cb) {
+        QJsonArray arr;
+        for (const auto& f : files)
+            arr.append(f.to_json());
+        QJsonObject obj;
+        obj["files"] = arr;
+        auto* reply = post_json("/api/v1/files/link", obj);
+        when_finished(reply, [this, cb](QNetworkReply* reply) {
+            reply->deleteLater();
+            if (reply->error() != QNetworkReply::NoError) {
+                emit error(reply->errorString());
+                cb(false, {});
+                return;
+            }
+            auto doc = QJsonDocument::fromJson(reply->readAll());
+            QStringList failed;
+            for (const auto& v : doc.object()["failed"].toArray())
+                failed.append(v.toString());
+            cb(true, failed);
+        });
+    }
+
+    // Fallback state for servers without /batch: a few single requests in flight at a time
+    struct ApiClient::SingleOps {
+        static constexpr int k_MaxInFlight = 8;
+
+        QVector<BatchOp> ops;
+        std::shared_ptr<QVector<BatchResult>> results;
+        qsizetype base = 0; // results already present before these ops
+        qsizetype next = 0;
+        int in_flight = 0;
+        std::function<void(bool, QVector<BatchResult>)> cb;
+    };
+
+    void ApiClient::run_batch(const QVector<BatchOp>& ops, std::function<void(bool, QVector<BatchResult>)> cb) {
+        auto results = std::make_shared<QVector<BatchResult>>();
+        results->reserve(ops.size());
+        if (ops.isEmpty()) {
+            cb(true, {});
+            return;
+        }
+        if (!supports(Feature::Batch)) {
+            run_ops_individually(ops, results, cb);
+            return;
+        }
+        send_batch_slice(ops, 0, results, cb);
+    }
+
+    void ApiClient::send_batch_slice(const QVector<BatchOp>& ops, qsizetype offset, std::shared_ptr<QVector<BatchResult>> results,
+                                     std::function<void(bool, QVector<BatchResult>)> cb) {
+        QVector<BatchOp> slice = ops.mid(offset, k_MaxBatchOps);
+        QJsonArray arr;
+        for (const auto& op : slice)
+            arr.append(op.to_json());
+        QJsonObject obj;
+        obj["ops"] = arr;
+        auto* reply = post_json("/api/v1/batch", obj);
+        when_finished(reply, [this, ops, offset, slice, results, cb](QNetworkReply* reply) {
+            reply->deleteLater();
+            if (reply->error() != QNetworkReply::NoError) {
+                if (note_missing_feature(reply, Feature::Batch)) {
+                    run_ops_individually(ops.mid(offset), results, cb);
+                    return;
+                }
+                emit error(reply->errorString());
+                // Nothing is known about the rest; report each as failed so results stay aligned with ops
+                BatchResult failed;
+                failed.error = reply->errorString();
+                results->resize(ops.size(), failed);
+                cb(false, *results);
+                return;
+            }
+
+            auto doc = QJsonDocument::fromJson(reply->readAll());
+            QJsonArray arr = doc.object()["results"].toArray();
+            for (qsizetype i = 0; i < slice.size(); ++i) {
+                BatchResult r;
+                if (i < arr.size()) {
+                    r = BatchResult::from_json(arr[i].toObject());
+                    r.ok = r.ok || (r.status == 404 && slice[i].is_delete());
+                } else {
+                    r.error = "No result from server";
+                }
+                results->append(r);
+            }
+
+            if (offset + slice.size() < ops.size())
+                send_batch_slice(ops, offset + slice.size(), results, cb);
+            else
+                cb(true, *results);
+        });
+    }
+
+    void ApiClient::run_ops_individually(const QVector<BatchOp>& ops, std::shared_ptr<QVector<BatchResult>> results,
+                                         std::function<void(bool, QVector<BatchResult>)> cb) {
+        auto state = std::make_shared<SingleOps>();
+        state->ops = ops;
+        state->results = results;
+        state->base = results->size();
+        state->cb = std::move(cb);
+        results->resize(state->base + ops.size());
+        pump_single_ops(state);
+    }
+
+    void ApiClient::pump_single_ops(std::shared_ptr<SingleOps> state) {
+        while (state->in_flight < SingleOps::k_MaxInFlight && state->next < state->ops.size()) {
+            qsizetype index = state->next++;
+            state->in_flight++;
+            run_single_op(state->ops[index], [this, state, index](BatchResult r) {
+                (*state->results)[state->base + index] = r;
+                state->in_flight--;
+                pump_single_ops(state);
+            });
+        }
+        if (state->in_flight == 0 && state->next == state->ops.size() && state->cb)
+            std::exchange(state->cb, {})(true, *state->results);
+    }
+
+    void ApiClient::run_single_op(const BatchOp& op, std::function<void(BatchResult)> cb) {
+        switch (op.kind) {
+        case BatchOp::Kind::DeleteFile:
+        case BatchOp::Kind::DeleteNote: {
+            QString endpoint = op.kind == BatchOp::Kind::DeleteFile ? "/api/v1/files/" : "/api/v1/notes/";
+            auto* reply = m_Net->deleteResource(make_request(endpoint + op.target));
+            connect(reply, &QNetworkReply::finished, this, [reply, cb]() {
+                reply->deleteLater();
+                BatchResult r;
+                r.status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+                r.ok = reply->error() == QNetworkReply::NoError || r.status == 404;
+                if (!r.ok)
+                    r.error = reply->errorString();
+                cb(r);
+            });
+            break;
+        }
+        case BatchOp::Kind::MoveFile:
+            move_file(op.target, op.destination, [cb](bool ok) { cb({ok, ok ? 200 : 0, ok ? QString() : QString("Move failed")}); });
+            break;
+        case BatchOp::Kind::TagNote:
+            get_note(op.target, [this, op, cb](bool ok, Note note) {
+                if (!ok) {
+                    cb({false, 0, "Failed to load note"});
+                    return;
+                }
+                for (const auto& t : op.remove_tags)
+                    note.tags.removeAll(t);
+                for (const auto& t : op.add_tags) {
+                    if (!note.tags.contains(t))
+                        note.tags.append(t);
+                }
+                update_note(op.target, note, [cb](bool ok, Note) {
+                    cb({ok, ok ? 200 : 0, ok ? QString() : QString("Failed to save note")});
+                });
+            });
+            break;
+        }
+    }
+
+    bool ApiClient::note_missing_feature(QNetworkReply* reply, Feature feature) {
+        int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        if (status != 404 && status != 405 && status != 501)
+            return false;
+        m_MissingFeatures |= feature_bit(feature);
+        return true;
+    }
+
+    void ApiClient::create_upload(const QString& path, qint64 size, qint64 part_size, std::function<void(bool, UploadStatus)> cb) {
+        QJsonObject obj;
+        obj["path"] = path;
+        obj["size"] = size;
+        obj["part_size"] = part_size;
+        auto* reply = post_json("/api/v1/uploads", obj);
+        when_finished(reply, [this, cb](QNetworkReply* reply) {
+            reply->deleteLater();
+            if (reply->error() != QNetworkReply::NoError) {
+                // A server without upload sessions isn't an error, callers fall back to a plain PUT
+                if (!note_missing_feature(reply, Feature::UploadSessions))
+                    emit error(reply->errorString());
+                cb(false, {});
+                return;
+            }
+            auto doc = QJsonDocument::fromJson(reply->readAll());
+            cb(true, UploadStatus::from_json(doc.object()));
+        });
+    }
+
+    void ApiClient::get_upload(const QString& upload_id, std::function<void(bool, UploadStatus)> cb) {
+        auto* reply = m_Net->get(make_request("/api/v1/uploads/" + upload_id));
+        connect(reply, &QNetworkReply::finished, this, [reply, cb]() {
+            reply->deleteLater();
+            // 404 here just means the session expired; the caller starts a new one
+            if (reply->error() != QNetworkReply::NoError) {
+                cb(false, {});
+                return;
+            }
+            auto doc = QJsonDocument::fromJson(reply->readAll());
+            cb(true, UploadStatus::from_json(doc.object()));
+        });
+    }
+
+    QNetworkReply* ApiClient::upload_part(const QString& upload_id, int part, UploadSource* source, ProgressFn progress,
+                                          std::function<void(bool)> cb) {
+        QNetworkRequest req = make_request("/api/v1/uploads/" + upload_id + "/parts/" + QString::number(part));
+        req.setHeader(QNetworkRequest::ContentTypeHeader, "application/octet-stream");
+        auto* reply = put_source(req, source, progress);
+        when_finished(reply, [this, cb](QNetworkReply* reply) {
+            reply->deleteLater();
+            if (reply->error() != QNetworkReply::NoError) {
+                emit error(reply->errorString());
+                cb(false);
+                return;
+            }
+            cb(true);
+        });
+        return reply;
+    }
+
+    void ApiClient::complete_upload(const QString& upload_id, const QString& content_hash, std::function<void(bool, FileInfo)> cb) {
+        QJsonObject obj;
+        obj["hash"] = content_hash;
+        auto* reply = post_json("/api/v1/uploads/" + upload_id + "/complete", obj);
+        when_finished(reply, [this, cb](QNetworkReply* reply) {
+            reply->deleteLater();
+            if (reply->error() != QNetworkReply::NoError) {
+                emit error(reply->errorString());
+                cb(false, {});
+                return;
+            }
+            auto doc = QJsonDocument::fromJson(reply->readAll());
+            cb(true, FileInfo::from_json(doc.object()));
+        });
+    }
+
+    void ApiClient::abort_upload(const QString& upload_id, std::function<void(bool)> cb) {
+        auto* reply = m_Net->deleteResource(make_request("/api/v1/uploads/" + upload_id));
+        connect(reply, &QNetworkReply::finished, this, [reply, cb]() {
+            reply->deleteLater();
+            cb(reply->error() == QNetworkReply::NoError);
+        });
+    }
+
+    void ApiClient::find_missing_chunks(const QStringList& hashes, std::function<void(bool, QStringList)> cb) {
+        QJsonObject obj;
+        obj["hashes"] = QJsonArray::fromStringList(hashes);
+        auto* reply = post_json("/api/v1/chunks/missing", obj);
+        when_finished(reply, [this, cb](QNetworkReply* reply) {
+            reply->deleteLater();
+            if (reply->error() != QNetworkReply::NoError) {
+                if (!note_missing_feature(reply, Feature::ContentChunks))
+                    emit error(reply->errorString());
+                cb(false, {});
+                return;
+            }
+            auto doc = QJsonDocument::fromJson(reply->readAll());
+            QStringList missing;
+            for (const auto& v : doc.object()["missing"].toArray())
+                missing.append(v.toString());
+            cb(true, missing);
+        });
+    }
+
+    QNetworkReply* ApiClient::upload_chunk(const QString& hash, UploadSource* source, ProgressFn progress, std::function<void(bool)> cb) {
+        QNetworkRequest req = make_request("/api/v1/chunks/" + hash);
+        req.setHeader(QNetworkRequest::ContentTypeHeader, "application/octet-stream");
+        auto* reply = put_source(req, source, progress);
+        when_finished(reply, [this, cb](QNetworkReply* reply) {
+            reply->deleteLater();
+            if (reply->error() != QNetworkReply::NoError) {
+                emit error(reply->errorString());
+                cb(false);
+                return;
+            }
+            cb(true);
+        });
+        return reply;
+    }
+
+    void ApiClient::commit_manifest(const FileManifest& manifest, std::function<void(bool, QStringList)> cb) {
+        auto* reply = post_json("/api/v1/manifests", manifest.to_json());
+        when_finished(reply, [this, cb](QNetworkReply* reply) {
+            reply->deleteLater();
+            if (reply->error() != QNetworkReply::NoError) {
+                // 409 lists chunks that were collected since we checked; the caller re-sends them
+                int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+                QStringList missing;
+                if (status == 409) {
+                    auto doc = QJsonDocument::fromJson(reply->readAll());
+                    for (const auto& v : doc.object()["missing"].toArray())
+                        missing.append(v.toString());
+                }
+                if (missing.isEmpty())
+                    emit error(reply->errorString());
+                cb(false, missing);
+                return;
+            }
+            cb(true, {});
+        });
+    }
+
+    void ApiClient::get_manifest(const QString& path, std::function<void(bool, FileManifest)> cb) {
+        auto* reply = m_Net->get(make_request("/api/v1/manifests/" + path));
+        connect(reply, &QNetworkReply::finished, this, [this, reply, cb]() {
+            reply->deleteLater();
+            if (reply->error() != QNetworkReply::NoError) {
+                // A JSON 404 only means this file has no manifest; callers go on without one either way
+                bool json = reply->header(QNetworkRequest::ContentTypeHeader).toString().startsWith("application/json");
+                int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+                if (!(json && status == 404))
+                    note_missing_feature(reply, Feature::Manifests);
+                cb(false, {});
+                return;
+            }
+            auto doc = QJsonDocument::fromJson(reply->readAll());
+            cb(true, FileManifest::from_json(doc.object()));
+        });
+    }
+
+    void ApiClient::get_peer_key(std::function<void(bool, QByteArray)> cb) {
+        auto* reply = m_Net->get(make_request("/api/v1/peers/key"));
+        connect(reply, &QNetworkReply::finished, this, [this, reply, cb]() {
+            reply->deleteLater();
+            if (reply->error() != QNetworkReply::NoError) {
+                emit error(reply->errorString());
+                cb(false, {});
+                return;
+            }
+            QByteArray key = QByteArray::fromBase64(QJsonDocument::fromJson(reply->readAll()).object()["key"].toString().toLatin1());
+            cb(!key.isEmpty(), key);
+        });
+    }
+
     void ApiClient::list_notes(std::function<void(bool, QVector<NoteItem>)> cb) {
         auto* reply = m_Net->get(make_request("/api/v1/notes"));
         connect(reply, &QNetworkReply::finished, this, [this, reply, cb]() {
@@ -162,9 +1028,12 @@ namespace sap::client {
         });
     }
 
-    void ApiClient::create_note(const Note& note, std::function<void(bool, Note)> cb) {
-        auto* reply = m_Net->post(make_request("/api/v1/notes"), QJsonDocument(note.to_json()).toJson());
-        connect(reply, &QNetworkReply::finished, this, [this, reply, cb]() {
+    void ApiClient::create_note(const Note& note, std::function<void(bool, Note)> cb, const QString& idempotency_key) {
+        QNetworkRequest req = make_request("/api/v1/notes");
+        if (!idempotency_key.isEmpty())
+            req.setRawHeader("Idempotency-Key", idempotency_key.toUtf8());
+        auto* reply = post_json(req, note.to_json());
+        when_finished(reply, [this, cb](QNetworkReply* reply) {
             reply->deleteLater();
             if (reply->error() != QNetworkReply::NoError) {
                 emit error(reply->errorString());
@@ -177,8 +1046,8 @@ namespace sap::client {
     }
 
     void ApiClient::update_note(const QString& id, const Note& note, std::function<void(bool, Note)> cb) {
-        auto* reply = m_Net->put(make_request("/api/v1/notes/" + id), QJsonDocument(note.to_json()).toJson());
-        connect(reply, &QNetworkReply::finished, this, [this, reply, cb]() {
+        auto* reply = put_json("/api/v1/notes/" + id, note.to_json());
+        when_finished(reply, [this, cb](QNetworkReply* reply) {
             reply->deleteLater();
             if (reply->error() != QNetworkReply::NoError) {
                 emit error(reply->errorString());
@@ -0,0 +1,303 @@
+#include "sap_cloud_client/backup_exporter.h"
+#include <QDateTime>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QRegularExpression>
+#include <QTimer>
+#include "sap_cloud_client/api_client.h"
+
+namespace {
+
+    constexpr qint64 k_ProgressIntervalMs = 100;
+    constexpr int k_MaxTitleLength = 80;
+
+    QString json_string(const QString& value) {
+        QByteArray arr = QJsonDocument(QJsonArray{value}).toJson(QJsonDocument::Compact);
+        return QString::fromUtf8(arr.mid(1, arr.size() - 2));
+    }
+
+    // Markdown with a front-matter header; values are JSON so any YAML reader accepts them
+    QByteArray note_markdown(const sap::client::Note& note) {
+        QJsonArray tags;
+        for (const auto& t : note.tags)
+            tags.append(t);
+
+        QString out;
+        out += "---\n";
+        out += "id: " + json_string(note.id) + "\n";
+        out += "title: " + json_string(note.title) + "\n";
+        out += "tags: " + QString::fromUtf8(QJsonDocument(tags).toJson(QJsonDocument::Compact)) + "\n";
+        out += "created_at: " + QString::number(note.created_at) + "\n";
+        out += "updated_at: " + QString::number(note.updated_at) + "\n";
+        out += "---\n\n";
+        out += note.content;
+        return out.toUtf8();
+    }
+
+    QString note_file_name(const sap::client::NoteItem& item) {
+        static const QRegularExpression unsafe(R"([/\\:*?"<>|\x00-\x1f])");
+        QString title = item.title.left(k_MaxTitleLength).replace(unsafe, "_").trimmed();
+        return (title.isEmpty() ? QString() : title + "-") + item.id + ".md";
+    }
+
+} // anonymous namespace
+
+namespace sap::client {
+
+    BackupExporter::BackupExporter(ApiClient* api, const QString& archive_path, QObject* parent) :
+        QObject(parent), m_Api(api), m_Tar(archive_path) {}
+
+    void BackupExporter::start() {
+        if (!m_Tar.open()) {
+            fail(m_Tar.last_error());
+            return;
+        }
+        m_ProgressClock.start();
+
+        QPointer<BackupExporter> self(this);
+        m_Api->list_files([self](bool ok, QVector<FileInfo> files) {
+            if (!self || self->m_Done)
+                return;
+            self->m_ListFailed |= !ok;
+            for (const auto& f : files) {
+                if (!f.is_deleted)
+                    self->m_Files.append(f);
+            }
+            self->on_listed();
+        });
+        m_Api->list_notes([self](bool ok, QVector<NoteItem> notes) {
+            if (!self || self->m_Done)
+                return;
+            self->m_ListFailed |= !ok;
+            self->m_Notes = notes;
+            self->on_listed();
+        });
+    }
+
+    void BackupExporter::abort() {
+        if (!m_Done)
+            fail("Backup cancelled");
+    }
+
+    void BackupExporter::on_listed() {
+        if (++m_Listed < 2)
+            return;
+        if (m_ListFailed) {
+            fail("Cannot list account contents");
+            return;
+        }
+        for (const auto& f : m_Files)
+            m_BytesTotal += f.size;
+        report_progress();
+        pump();
+    }
+
+    void BackupExporter::pump() {
+        while (!m_Done && m_InFlight < k_MaxInFlight) {
+            if (!m_Queue.empty()) {
+                quint64 id = m_Queue.front();
+                m_Queue.pop_front();
+                fetch_segment(id);
+            } else if (m_NextFile < m_Files.size()) {
+                if (!dispatch_next_file())
+                    return;
+            } else if (m_NextNote < m_Notes.size()) {
+                fetch_note(m_NextNote++);
+            } else {
+                break;
+            }
+        }
+
+        if (!m_Done && m_InFlight == 0 && m_Waiting == 0 && m_Queue.empty() && m_NextFile >= m_Files.size() &&
+            m_NextNote >= m_Notes.size())
+            complete();
+    }
+
+    bool BackupExporter::dispatch_next_file() {
+        int index = m_NextFile++;
+        const FileInfo& file = m_Files[index];
+
+        qint64 archive_offset = m_Tar.reserve("files/" + file.path, file.size, file.mtime);
+        if (archive_offset < 0) {
+            fail(m_Tar.last_error());
+            return false;
+        }
+        if (file.size == 0) {
+            entry_done();
+            return true;
+        }
+
+        int segments = 0;
+        for (qint64 offset = 0; offset < file.size; offset += k_SegmentSize) {
+            Segment seg;
+            seg.file = index;
+            seg.archive_offset = archive_offset;
+            seg.offset = offset;
+            seg.length = qMin(k_SegmentSize, file.size - offset);
+            quint64 id = m_NextSegment++;
+            m_Segments.insert(id, seg);
+            m_Queue.push_back(id);
+            segments++;
+        }
+        m_SegmentsLeft.insert(index, segments);
+        return true;
+    }
+
+    void BackupExporter::fetch_segment(quint64 id) {
+        Segment& seg = m_Segments[id];
+        seg.attempt_start = seg.offset + seg.written;
+        seg.received = 0;
+
+        auto* reply = m_Api->get_file_range(m_Files[seg.file].path, seg.attempt_start, seg.length - seg.written);
+        reply->setReadBufferSize(k_ReadBufferSize);
+        seg.reply = reply;
+        m_InFlight++;
+
+        connect(reply, &QNetworkReply::readyRead, this, [this, id]() { on_segment_data(id); });
+        connect(reply, &QNetworkReply::finished, this, [this, id, reply]() { on_segment_finished(id, reply); });
+    }
+
+    void BackupExporter::on_segment_data(quint64 id) {
+        auto it = m_Segments.find(id);
+        if (m_Done || it == m_Segments.end() || !it->reply)
+            return;
+        Segment& seg = *it;
+        QNetworkReply* reply = seg.reply;
+        int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        if (status >= 400)
+            return;
+
+        // A server that ignores Range answers 200 with the file from byte 0; skip what we don't need
+        const qint64 base = status == 200 ? 0 : seg.attempt_start;
+        const qint64 end = seg.offset + seg.length;
+        while (reply->bytesAvailable() > 0) {
+            QByteArray data = reply->read(k_ReadBufferSize);
+            qint64 pos = base + seg.received;
+            seg.received += data.size();
+
+            qint64 want = seg.offset + seg.written;
+            qint64 to = qMin(pos + data.size(), end);
+            if (pos <= want && want < to) {
+                qint64 n = to - want;
+                if (!m_Tar.write_at(seg.archive_offset + want, data.constData() + (want - pos), n)) {
+                    fail(m_Tar.last_error());
+                    return;
+                }
+                seg.written += n;
+                m_BytesDone += n;
+            }
+            // Everything this segment needs is on disk; don't pull the rest of a 200 or a grown file
+            if (seg.written == seg.length) {
+                seg.reply = nullptr;
+                reply->abort();
+                break;
+            }
+        }
+        report_progress();
+    }
+
+    void BackupExporter::on_segment_finished(quint64 id, QNetworkReply* reply) {
+        reply->deleteLater();
+        m_InFlight--;
+        if (m_Done)
+            return;
+
+        on_segment_data(id);
+        auto it = m_Segments.find(id);
+        if (m_Done || it == m_Segments.end())
+            return;
+        Segment& seg = *it;
+        seg.reply = nullptr;
+        const QString& path = m_Files[seg.file].path;
+
+        if (seg.written == seg.length) {
+            finish_segment(id);
+        } else if (reply->error() == QNetworkReply::NoError) {
+            // Short body: the file shrank since it was listed; the rest of its entry stays zeroed
+            if (!m_Errors.contains(path))
+                m_Errors.append(path + ": changed during backup");
+            finish_segment(id);
+        } else if (seg.retries < k_MaxRetries) {
+            seg.retries++;
+            m_Waiting++;
+            QPointer<BackupExporter> self(this);
+            QTimer::singleShot(500 << seg.retries, this, [self, id]() {
+                if (!self || self->m_Done)
+                    return;
+                self->m_Waiting--;
+                self->m_Queue.push_front(id);
+                self->pump();
+            });
+            return;
+        } else {
+            m_Errors.append(path + ": " + reply->errorString());
+            finish_segment(id);
+        }
+        pump();
+    }
+
+    void BackupExporter::finish_segment(quint64 id) {
+        int file = m_Segments.take(id).file;
+        if (--m_SegmentsLeft[file] == 0) {
+            m_SegmentsLeft.remove(file);
+            entry_done();
+        }
+    }
+
+    void BackupExporter::fetch_note(int index) {
+        m_InFlight++;
+        QPointer<BackupExporter> self(this);
+        m_Api->get_note(m_Notes[index].id, [self, index](bool ok, Note note) {
+            if (!self || self->m_Done)
+                return;
+            self->m_InFlight--;
+            const NoteItem& item = self->m_Notes[index];
+            if (!ok) {
+                self->m_Errors.append("note " + item.id + ": could not be fetched");
+            } else if (!self->m_Tar.append("notes/" + note_file_name(item), note_markdown(note), note.updated_at)) {
+                self->fail(self->m_Tar.last_error());
+                return;
+            }
+            self->entry_done();
+            self->pump();
+        });
+    }
+
+    void BackupExporter::entry_done() {
+        m_EntriesDone++;
+        report_progress();
+    }
+
+    void BackupExporter::report_progress() {
+        if (m_ProgressClock.isValid() && m_ProgressClock.elapsed() < k_ProgressIntervalMs)
+            return;
+        m_ProgressClock.restart();
+        emit progress(m_BytesDone, m_BytesTotal, m_EntriesDone, static_cast<int>(m_Files.size() + m_Notes.size()));
+    }
+
+    void BackupExporter::fail(const QString& error) {
+        m_Done = true;
+        for (auto& seg : m_Segments) {
+            if (QNetworkReply* reply = seg.reply) {
+                seg.reply = nullptr;
+                reply->abort();
+            }
+        }
+        m_Tar.finish();
+        m_Errors.append(error);
+        emit finished(false, m_Errors);
+    }
+
+    void BackupExporter::complete() {
+        m_Done = true;
+        bool ok = true;
+        if (!m_Errors.isEmpty())
+            ok = m_Tar.append("BACKUP_ERRORS.txt", (m_Errors.join('\n') + '\n').toUtf8(), QDateTime::currentMSecsSinceEpoch());
+        ok = m_Tar.finish() && ok;
+        if (!ok)
+            m_Errors.append(m_Tar.last_error());
+        emit progress(m_BytesDone, m_BytesTotal, m_EntriesDone, static_cast<int>(m_Files.size() + m_Notes.size()));
+        emit finished(ok, m_Errors);
+    }
+
+} // namespace sap::client
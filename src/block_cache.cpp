@@ -0,0 +1,93 @@
+#include "sap_cloud_client/block_cache.h"
+#include <QDebug>
+#include <QNetworkReply>
+#include <memory>
+
+namespace {
+
+    QString block_key(const QString& hash, qint64 index) { return hash.toLower() + ':' + QString::number(index); }
+
+} // anonymous namespace
+
+namespace sap::client {
+
+    BlockCache::BlockCache(ApiClient* api, QObject* parent) : QObject(parent), m_Api(api) {
+        m_Blocks.setMaxCost(static_cast<qsizetype>(k_DefaultLimit));
+    }
+
+    void BlockCache::set_limit(qint64 bytes) { m_Blocks.setMaxCost(static_cast<qsizetype>(qMax<qint64>(k_BlockSize, bytes))); }
+
+    void BlockCache::read(const FileInfo& file, qint64 index, ReadFn cb) {
+        if (index < 0 || index >= block_count(file) || file.hash.isEmpty()) {
+            cb(false, {});
+            return;
+        }
+        QString key = block_key(file.hash, index);
+        if (const QByteArray* block = m_Blocks.object(key)) {
+            m_Stats.hits++;
+            cb(true, *block);
+            return;
+        }
+        m_Stats.misses++;
+        auto& waiting = m_Waiting[key];
+        waiting.append(std::move(cb));
+        if (waiting.size() == 1)
+            fetch(file, index, key);
+    }
+
+    void BlockCache::prefetch(const FileInfo& file, qint64 index) {
+        if (index < 0 || index >= block_count(file) || file.hash.isEmpty())
+            return;
+        QString key = block_key(file.hash, index);
+        if (m_Blocks.contains(key) || m_Waiting.contains(key))
+            return;
+        m_Waiting[key];
+        fetch(file, index, key);
+    }
+
+    void BlockCache::fetch(const FileInfo& file, qint64 index, const QString& key) {
+        qint64 offset = index * k_BlockSize;
+        qint64 length = qMin(k_BlockSize, file.size - offset);
+        auto* reply = m_Api->get_file_range(file.path, offset, length);
+
+        auto settled = std::make_shared<bool>(false);
+        auto complete = [this, key, settled](bool ok, const QByteArray& data) {
+            if (*settled)
+                return;
+            *settled = true;
+            if (ok) {
+                m_Stats.bytes_fetched += data.size();
+                m_Blocks.insert(key, new QByteArray(data), static_cast<qsizetype>(data.size()));
+            }
+            const QVector<ReadFn> waiting = m_Waiting.take(key);
+            for (const auto& cb : waiting)
+                cb(ok, data);
+        };
+        auto status = [reply]() { return reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(); };
+
+        // A server that ignores Range sends the whole file: only the first block can use it,
+        // and then only its first bytes
+        connect(reply, &QNetworkReply::metaDataChanged, this, [reply, offset, status]() {
+            if (status() == 200 && offset > 0) {
+                qWarning() << "Server ignored a range request for" << reply->url().path();
+                reply->abort();
+            }
+        });
+        connect(reply, &QNetworkReply::readyRead, this, [reply, length, status, complete]() {
+            if (status() == 200 && reply->bytesAvailable() >= length) {
+                complete(true, reply->read(length));
+                reply->abort();
+            }
+        });
+        connect(reply, &QNetworkReply::finished, this, [reply, length, status, complete]() {
+            reply->deleteLater();
+            if (reply->error() != QNetworkReply::NoError || (status() != 206 && status() != 200)) {
+                complete(false, {});
+                return;
+            }
+            QByteArray data = reply->read(length);
+            complete(data.size() == length, data);
+        });
+    }
+
+} // namespace sap::client
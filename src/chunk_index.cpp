@@ -0,0 +1,112 @@
+#include "sap_cloud_client/chunk_index.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include "sap_cloud_client/types.h"
+
+namespace {
+
+    constexpr char k_Magic[4] = {'S', 'A', 'P', 'C'};
+    constexpr quint32 k_Version = 1;
+    constexpr int k_HeaderSize = 8;
+
+    QByteArray header() {
+        QByteArray out(k_Magic, sizeof(k_Magic));
+        out.append(static_cast<char>(k_Version & 0xFF));
+        out.append(3, '\0');
+        return out;
+    }
+
+    int digest_size() { return QCryptographicHash::hashLength(sap::client::k_ContentHashAlgorithm); }
+
+    QByteArray to_raw(const QString& hash) {
+        QByteArray raw = QByteArray::fromHex(hash.toLatin1());
+        return raw.size() == digest_size() ? raw : QByteArray();
+    }
+
+} // anonymous namespace
+
+namespace sap::client {
+
+    ChunkIndex::ChunkIndex(const QString& path) : m_Path(path), m_File(path) {}
+
+    bool ChunkIndex::open() {
+        QDir().mkpath(QFileInfo(m_Path).absolutePath());
+        m_Hashes.clear();
+
+        if (m_File.open(QIODevice::ReadOnly)) {
+            QByteArray data = m_File.readAll();
+            m_File.close();
+            if (data.startsWith(header())) {
+                // A torn trailing digest is simply ignored and overwritten by the rewrite below
+                const int n = digest_size();
+                for (qsizetype pos = k_HeaderSize; pos + n <= data.size(); pos += n)
+                    m_Hashes.insert(data.mid(pos, n));
+                if ((data.size() - k_HeaderSize) % n == 0) {
+                    if (!m_File.open(QIODevice::WriteOnly | QIODevice::Append)) {
+                        m_LastError = "Cannot open chunk index: " + m_File.errorString();
+                        return false;
+                    }
+                    return true;
+                }
+            }
+        }
+        return rewrite();
+    }
+
+    bool ChunkIndex::contains(const QString& hash) const { return m_Hashes.contains(to_raw(hash)); }
+
+    void ChunkIndex::insert(const QStringList& hashes) {
+        if (m_Hashes.size() + hashes.size() > k_MaxEntries) {
+            m_Hashes.clear();
+            rewrite();
+        }
+
+        QByteArray out;
+        for (const auto& hash : hashes) {
+            QByteArray raw = to_raw(hash);
+            if (raw.isEmpty() || m_Hashes.contains(raw))
+                continue;
+            m_Hashes.insert(raw);
+            out.append(raw);
+        }
+        // Losing the tail on a crash only costs an extra missing-chunks query, so no fsync here
+        if (!out.isEmpty() && m_File.isOpen()) {
+            m_File.write(out);
+            m_File.flush();
+        }
+    }
+
+    void ChunkIndex::forget(const QStringList& hashes) {
+        bool changed = false;
+        for (const auto& hash : hashes)
+            changed |= m_Hashes.remove(to_raw(hash));
+        if (changed)
+            rewrite();
+    }
+
+    bool ChunkIndex::rewrite() {
+        m_File.close();
+
+        QSaveFile out(m_Path);
+        if (!out.open(QIODevice::WriteOnly)) {
+            m_LastError = "Cannot write chunk index: " + out.errorString();
+            return false;
+        }
+        out.write(header());
+        for (const auto& raw : m_Hashes)
+            out.write(raw);
+        if (!out.commit()) {
+            m_LastError = "Cannot write chunk index: " + out.errorString();
+            return false;
+        }
+
+        if (!m_File.open(QIODevice::WriteOnly | QIODevice::Append)) {
+            m_LastError = "Cannot open chunk index: " + m_File.errorString();
+            return false;
+        }
+        return true;
+    }
+
+} // namespace sap::client
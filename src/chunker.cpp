@@ -0,0 +1,106 @@
+#include "sap_cloud_client/chunker.h"
+#include <QFile>
+#include <array>
+#include "sap_cloud_client/hash_service.h"
+
+namespace {
+
+    // Deterministic gear table (splitmix64); every client must cut at the same places
+    constexpr std::array<quint64, 256> make_gear_table() {
+        std::array<quint64, 256> table{};
+        quint64 x = 0x2545F4914F6CDD1Dull;
+        for (auto& v : table) {
+            x += 0x9E3779B97F4A7C15ull;
+            quint64 z = x;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            v = z ^ (z >> 31);
+        }
+        return table;
+    }
+
+    constexpr auto k_Gear = make_gear_table();
+
+    // Masks over the high bits, which mix in the most recent 64 bytes.
+    // log2(avg) = 20: two extra bits before the average size, two fewer after it.
+    constexpr quint64 k_MaskStrict = ~0ull << (64 - 22);
+    constexpr quint64 k_MaskLoose = ~0ull << (64 - 18);
+
+    constexpr qint64 k_ReadSize = 8 * 1024 * 1024;
+
+} // anonymous namespace
+
+namespace sap::client {
+
+    qint64 Chunker::cut(const uchar* data, qint64 size) {
+        if (size <= k_MinSize)
+            return size;
+        qint64 limit = qMin(size, k_MaxSize);
+        qint64 normal = qMin(limit, k_AvgSize);
+
+        quint64 fp = 0;
+        qint64 i = k_MinSize;
+        for (; i < normal; ++i) {
+            fp = (fp << 1) + k_Gear[data[i]];
+            if (!(fp & k_MaskStrict))
+                return i + 1;
+        }
+        for (; i < limit; ++i) {
+            fp = (fp << 1) + k_Gear[data[i]];
+            if (!(fp & k_MaskLoose))
+                return i + 1;
+        }
+        return limit;
+    }
+
+    std::optional<FileManifest> Chunker::manifest_for_file(const QString& local_path) {
+        QFile file(local_path);
+        if (!file.open(QIODevice::ReadOnly))
+            return std::nullopt;
+
+        FileManifest manifest;
+        ContentHasher file_hash;
+        ContentHasher chunk_hash;
+
+        // Sliding window: always keep at least one maximal chunk buffered unless at EOF
+        QByteArray buf;
+        qint64 offset = 0;
+        bool eof = false;
+        while (true) {
+            if (!eof && buf.size() < k_MaxSize) {
+                QByteArray more = file.read(k_ReadSize);
+                if (more.isEmpty()) {
+                    if (file.error() != QFileDevice::NoError)
+                        return std::nullopt;
+                    eof = true;
+                }
+                buf.append(more);
+            }
+            if (buf.isEmpty())
+                break;
+            if (!eof && buf.size() < k_MaxSize)
+                continue;
+
+            qint64 pos = 0;
+            while (pos < buf.size() && (eof || buf.size() - pos >= k_MaxSize)) {
+                const auto* p = reinterpret_cast<const uchar*>(buf.constData()) + pos;
+                qint64 n = cut(p, buf.size() - pos);
+                QByteArrayView view(p, n);
+
+                chunk_hash.reset();
+                chunk_hash.add(view);
+                file_hash.add(view);
+                manifest.chunks.append({chunk_hash.result(), offset, n});
+
+                offset += n;
+                pos += n;
+            }
+            buf.remove(0, pos);
+        }
+
+        manifest.size = offset;
+        manifest.hash = file_hash.result();
+        return manifest;
+    }
+
+} // namespace sap::client
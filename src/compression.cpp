@@ -0,0 +1,52 @@
+#include "sap_cloud_client/compression.h"
+#include <array>
+#include <cmath>
+
+namespace {
+
+    constexpr qsizetype k_SampleSize = 16 * 1024;
+    constexpr int k_SampleCount = 4;
+    // Deflate rarely gains more than a few percent above this
+    constexpr double k_MaxCompressibleEntropy = 7.2;
+
+} // anonymous namespace
+
+namespace sap::client {
+
+    double byte_entropy(QByteArrayView data) {
+        if (data.isEmpty())
+            return 0;
+        std::array<qsizetype, 256> counts{};
+        for (char c : data)
+            counts[static_cast<quint8>(c)]++;
+
+        double entropy = 0;
+        const double n = static_cast<double>(data.size());
+        for (qsizetype count : counts) {
+            if (count == 0)
+                continue;
+            double p = count / n;
+            entropy -= p * std::log2(p);
+        }
+        return entropy;
+    }
+
+    bool looks_compressible(QByteArrayView data) {
+        if (data.size() <= k_SampleSize * k_SampleCount)
+            return byte_entropy(data) < k_MaxCompressibleEntropy;
+
+        // Headers alone can look compressible, so sample across the whole body
+        QByteArray sample;
+        sample.reserve(k_SampleSize * k_SampleCount);
+        qsizetype stride = (data.size() - k_SampleSize) / (k_SampleCount - 1);
+        for (int i = 0; i < k_SampleCount; ++i)
+            sample.append(data.sliced(i * stride, k_SampleSize));
+        return byte_entropy(sample) < k_MaxCompressibleEntropy;
+    }
+
+    QByteArray deflate_body(QByteArrayView data, int level) {
+        // qCompress prefixes a 4-byte length; the rest is a plain zlib stream
+        return qCompress(reinterpret_cast<const uchar*>(data.data()), data.size(), level).mid(4);
+    }
+
+} // namespace sap::client
@@ -0,0 +1,94 @@
+#include "sap_cloud_client/content_store.h"
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+
+namespace {
+
+    constexpr char k_TempSuffix[] = ".tmp";
+
+} // anonymous namespace
+
+namespace sap::client {
+
+    bool ContentStore::open(const QString& root) {
+        m_Root = root;
+        m_Sizes.clear();
+        m_Usage = 0;
+        if (!QDir().mkpath(root)) {
+            m_LastError = "Cannot create " + root;
+            return false;
+        }
+
+        QDirIterator it(root, QDir::Files, QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            it.next();
+            QFileInfo info = it.fileInfo();
+            // Interrupted fetches never committed; nothing refers to them
+            if (info.fileName().endsWith(k_TempSuffix)) {
+                QFile::remove(info.filePath());
+                continue;
+            }
+            m_Sizes.insert(info.fileName(), info.size());
+            m_Usage += info.size();
+        }
+        return true;
+    }
+
+    QString ContentStore::path(const QString& hash) const {
+        QString key = hash.toLower();
+        return m_Root + '/' + key.left(2) + '/' + key;
+    }
+
+    QString ContentStore::prepare(const QString& hash) {
+        QString temp = temp_path(hash);
+        QDir().mkpath(QFileInfo(temp).absolutePath());
+        return temp;
+    }
+
+    QString ContentStore::temp_path(const QString& hash) const { return path(hash) + k_TempSuffix; }
+
+    bool ContentStore::commit(const QString& hash) {
+        QString key = hash.toLower();
+        QString target = path(key);
+        QFileInfo temp(temp_path(key));
+        if (!temp.exists()) {
+            m_LastError = "Nothing to commit for " + key;
+            return false;
+        }
+        // Another fetch of the same content may have won the race; either copy is fine
+        if (m_Sizes.contains(key)) {
+            QFile::remove(temp.filePath());
+            return true;
+        }
+        QFile::remove(target);
+        if (!QFile::rename(temp.filePath(), target)) {
+            m_LastError = "Cannot move blob into place: " + target;
+            QFile::remove(temp.filePath());
+            return false;
+        }
+        m_Sizes.insert(key, temp.size());
+        m_Usage += temp.size();
+        return true;
+    }
+
+    qint64 ContentStore::retain(const QSet<QString>& keep) {
+        qint64 freed = 0;
+        for (auto it = m_Sizes.begin(); it != m_Sizes.end();) {
+            if (keep.contains(it.key())) {
+                ++it;
+                continue;
+            }
+            if (!QFile::remove(path(it.key())) && QFileInfo::exists(path(it.key()))) {
+                ++it;
+                continue;
+            }
+            freed += it.value();
+            m_Usage -= it.value();
+            it = m_Sizes.erase(it);
+        }
+        return freed;
+    }
+
+} // namespace sap::client
@@ -0,0 +1,201 @@
+#include "sap_cloud_client/dedup_upload.h"
+#include <QFuture>
+#include <QPromise>
+#include <QThreadPool>
+#include <QTimer>
+#include <memory>
+#include "sap_cloud_client/api_client.h"
+#include "sap_cloud_client/chunk_index.h"
+#include "sap_cloud_client/chunker.h"
+
+namespace sap::client {
+
+    DedupUpload::DedupUpload(ApiClient* api, ChunkIndex* index, const QString& local_path, const QString& remote_path, QObject* parent) :
+        QObject(parent), m_Api(api), m_Index(index), m_LocalPath(local_path), m_RemotePath(remote_path) {}
+
+    void DedupUpload::start() {
+        auto promise = std::make_shared<QPromise<std::optional<FileManifest>>>();
+        QFuture<std::optional<FileManifest>> future = promise->future();
+        promise->start();
+        QThreadPool::globalInstance()->start([promise, path = m_LocalPath]() {
+            promise->addResult(Chunker::manifest_for_file(path));
+            promise->finish();
+        });
+        future.then(this, [this](std::optional<FileManifest> manifest) {
+            if (m_Done)
+                return;
+            if (!manifest) {
+                emit m_Api->error("Cannot read " + m_LocalPath);
+                complete(false);
+                return;
+            }
+            on_manifest(*manifest);
+        });
+    }
+
+    void DedupUpload::abort() {
+        if (m_Done)
+            return;
+        complete(false);
+    }
+
+    void DedupUpload::on_manifest(const FileManifest& manifest) {
+        m_Manifest = manifest;
+        m_Manifest.path = m_RemotePath;
+
+        QStringList unknown;
+        for (const auto& chunk : m_Manifest.chunks) {
+            if (m_Unique.contains(chunk.hash))
+                continue;
+            m_Unique.insert(chunk.hash, chunk);
+            if (!m_Index->contains(chunk.hash))
+                unknown.append(chunk.hash);
+        }
+        report_progress();
+
+        if (unknown.isEmpty()) {
+            commit();
+            return;
+        }
+
+        QPointer<DedupUpload> self(this);
+        m_Api->find_missing_chunks(unknown, [self](bool ok, QStringList missing) {
+            if (!self || self->m_Done)
+                return;
+            if (!ok) {
+                self->complete(false);
+                return;
+            }
+            self->queue_missing(missing);
+            self->pump();
+        });
+    }
+
+    void DedupUpload::queue_missing(const QStringList& missing) {
+        for (const auto& hash : missing) {
+            auto it = m_Unique.constFind(hash);
+            if (it == m_Unique.constEnd() || m_InFlight.contains(hash))
+                continue;
+            m_Queue.append(*it);
+            m_PendingBytes += it->size;
+        }
+        report_progress();
+    }
+
+    void DedupUpload::pump() {
+        if (m_Done || m_Committing)
+            return;
+
+        while (!m_Queue.isEmpty() && m_InFlight.size() < k_MaxConcurrentChunks) {
+            send_chunk(m_Queue.takeFirst());
+            if (m_Done)
+                return;
+        }
+
+        if (m_Queue.isEmpty() && m_InFlight.isEmpty())
+            commit();
+    }
+
+    void DedupUpload::send_chunk(const ChunkRef& chunk) {
+        auto* source = new UploadSource(m_LocalPath, chunk.offset, chunk.size);
+        if (!source->open(QIODevice::ReadOnly)) {
+            emit m_Api->error("Cannot open " + m_LocalPath + ": " + source->errorString());
+            delete source;
+            complete(false);
+            return;
+        }
+
+        QPointer<DedupUpload> self(this);
+        auto on_progress = [self, hash = chunk.hash](qint64 sent, qint64) {
+            if (!self || !self->m_InFlight.contains(hash))
+                return;
+            self->m_InFlight[hash].sent = sent;
+            self->report_progress();
+        };
+        // Placeholder first: upload_chunk may fail synchronously
+        m_InFlight.insert(chunk.hash, {});
+        QNetworkReply* reply = m_Api->upload_chunk(chunk.hash, source, on_progress, [self, chunk](bool ok) {
+            if (self && !self->m_Done)
+                self->on_chunk_finished(chunk, ok);
+        });
+        if (m_InFlight.contains(chunk.hash))
+            m_InFlight[chunk.hash].reply = reply;
+    }
+
+    void DedupUpload::on_chunk_finished(const ChunkRef& chunk, bool ok) {
+        m_InFlight.remove(chunk.hash);
+
+        if (ok) {
+            m_PendingBytes -= chunk.size;
+            m_SentBytes += chunk.size;
+            report_progress();
+            pump();
+            return;
+        }
+
+        int& retries = m_Retries[chunk.hash];
+        if (++retries > k_MaxChunkRetries) {
+            complete(false);
+            return;
+        }
+        report_progress();
+
+        // Same parking scheme as UploadSession: the slot stays taken until the backoff expires
+        QPointer<DedupUpload> self(this);
+        m_InFlight.insert(chunk.hash, {});
+        QTimer::singleShot(500 << retries, this, [self, chunk]() {
+            if (!self || self->m_Done)
+                return;
+            self->m_InFlight.remove(chunk.hash);
+            self->m_Queue.prepend(chunk);
+            self->pump();
+        });
+    }
+
+    void DedupUpload::commit() {
+        m_Committing = true;
+        QPointer<DedupUpload> self(this);
+        m_Api->commit_manifest(m_Manifest, [self](bool ok, QStringList missing) {
+            if (!self || self->m_Done)
+                return;
+            self->m_Committing = false;
+            if (ok) {
+                self->m_Index->insert(self->m_Unique.keys());
+                self->complete(true);
+                return;
+            }
+            // Chunks collected since the index saw them: send those once and commit again
+            if (missing.isEmpty() || self->m_Recommitted) {
+                self->complete(false);
+                return;
+            }
+            self->m_Recommitted = true;
+            self->m_Index->forget(missing);
+            self->queue_missing(missing);
+            self->pump();
+        });
+    }
+
+    void DedupUpload::report_progress() {
+        // Chunks the server already has count as done straight away
+        qint64 in_flight = 0;
+        for (const auto& f : m_InFlight)
+            in_flight += f.sent;
+        emit progress(m_Manifest.size - m_PendingBytes + in_flight, m_Manifest.size);
+    }
+
+    void DedupUpload::complete(bool ok) {
+        if (m_Done)
+            return;
+        m_Done = true;
+        for (auto& f : m_InFlight) {
+            if (QNetworkReply* reply = f.reply) {
+                f.reply = nullptr;
+                m_Api->abort(reply);
+            }
+        }
+        m_InFlight.clear();
+        emit finished(ok);
+    }
+
+} // namespace sap::client
@@ -0,0 +1,249 @@
+#include "sap_cloud_client/download_verifier.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutex>
+#include <QThreadPool>
+#include <atomic>
+#include <deque>
+#include "sap_cloud_client/hash_service.h"
+
+namespace {
+
+    std::atomic<qint64> g_BytesHashed{0};
+    std::atomic<qint64> g_BusyNs{0};
+
+} // anonymous namespace
+
+namespace sap::client {
+
+    struct DownloadVerifier::Task {
+        enum class Kind { Bytes, File, Rewind, Finish };
+
+        Kind kind = Kind::Bytes;
+        QByteArray data;
+        QString path;
+        qint64 offset = 0;
+        qint64 length = 0;
+    };
+
+    struct DownloadVerifier::State {
+        QMutex mutex;
+        DownloadVerifier* owner = nullptr;
+        bool stopped = false;
+        bool running = false;
+        std::deque<Task> tasks;
+
+        // Only touched by the task that is running
+        QString expected;
+        QVector<ChunkRef> chunks;
+        ContentHasher file_hash;
+        ContentHasher checkpoint; // file_hash at the start of the current chunk
+        ContentHasher chunk_hash;
+        int chunk = 0;
+        qint64 pos = 0;
+        bool stalled = false; // a chunk failed and its rewind hasn't arrived yet
+        QString error;
+
+        // Runs fn on the owner's thread; call with mutex held so the owner can't be destroyed meanwhile
+        template <typename Fn>
+        void post_locked(Fn fn) {
+            if (stopped)
+                return;
+            DownloadVerifier* o = owner;
+            QMetaObject::invokeMethod(o, [o, fn]() { fn(o); }, Qt::QueuedConnection);
+        }
+
+        void consume(QByteArrayView data);
+        void run(const Task& task);
+        static void drain(std::shared_ptr<State> state);
+    };
+
+    void DownloadVerifier::State::consume(QByteArrayView data) {
+        while (!data.isEmpty() && !stalled) {
+            qsizetype take = data.size();
+            bool in_chunk = chunk < chunks.size();
+            if (in_chunk) {
+                take = static_cast<qsizetype>(qMin<qint64>(take, chunks[chunk].offset + chunks[chunk].size - pos));
+                chunk_hash.add(data.first(take));
+            }
+            file_hash.add(data.first(take));
+            pos += take;
+            data = data.sliced(take);
+            if (!in_chunk || pos < chunks[chunk].offset + chunks[chunk].size)
+                continue;
+
+            const ChunkRef& done = chunks[chunk];
+            if (chunk_hash.result().compare(done.hash, Qt::CaseInsensitive) != 0) {
+                // Back to the chunk's start; everything after it waits for the refetched bytes
+                stalled = true;
+                file_hash = checkpoint;
+                chunk_hash.reset();
+                pos = done.offset;
+                QMutexLocker lock(&mutex);
+                post_locked([offset = done.offset, size = done.size](DownloadVerifier* v) { emit v->chunk_failed(offset, size); });
+                return;
+            }
+            ++chunk;
+            chunk_hash.reset();
+            checkpoint = file_hash;
+        }
+    }
+
+    void DownloadVerifier::State::run(const Task& task) {
+        switch (task.kind) {
+            case Task::Kind::Rewind:
+                if (task.offset == 0) {
+                    file_hash.reset();
+                    checkpoint.reset();
+                    chunk = 0;
+                } else if (chunk >= chunks.size() || chunks[chunk].offset != task.offset) {
+                    error = QString("Cannot rewind verification to offset %1").arg(task.offset);
+                    break;
+                } else {
+                    file_hash = checkpoint;
+                }
+                chunk_hash.reset();
+                pos = task.offset;
+                stalled = false;
+                error.clear();
+                break;
+
+            case Task::Kind::Bytes:
+                consume(task.data);
+                break;
+
+            case Task::Kind::File: {
+                if (stalled || !error.isEmpty())
+                    break;
+                QFile file(task.path);
+                if (!file.open(QIODevice::ReadOnly | QIODevice::Unbuffered) || !file.seek(task.offset)) {
+                    error = "Cannot read " + task.path + ": " + file.errorString();
+                    break;
+                }
+                QByteArray block(static_cast<qsizetype>(qMin(HashService::k_ReadBlock, task.length)), Qt::Uninitialized);
+                for (qint64 left = task.length; left > 0 && !stalled;) {
+                    qint64 n = file.read(block.data(), qMin<qint64>(block.size(), left));
+                    if (n <= 0) {
+                        error = "Cannot read " + task.path + ": " + file.errorString();
+                        break;
+                    }
+                    consume(QByteArrayView(block.constData(), n));
+                    left -= n;
+                }
+                break;
+            }
+
+            case Task::Kind::Finish: {
+                if (stalled)
+                    break;
+                if (!error.isEmpty())
+                    qWarning() << error;
+                QString actual = error.isEmpty() ? file_hash.result() : QString();
+                bool ok = !actual.isEmpty() && actual.compare(expected, Qt::CaseInsensitive) == 0;
+                QMutexLocker lock(&mutex);
+                post_locked([ok, actual](DownloadVerifier* v) { emit v->finished(ok, actual); });
+                break;
+            }
+        }
+    }
+
+    void DownloadVerifier::State::drain(std::shared_ptr<State> state) {
+        QElapsedTimer timer;
+        for (;;) {
+            Task task;
+            {
+                QMutexLocker lock(&state->mutex);
+                if (state->stopped || state->tasks.empty()) {
+                    state->running = false;
+                    return;
+                }
+                task = std::move(state->tasks.front());
+                state->tasks.pop_front();
+            }
+            timer.start();
+            qint64 before = state->pos;
+            state->run(task);
+            if (state->pos > before) {
+                g_BytesHashed += state->pos - before;
+                g_BusyNs += timer.nsecsElapsed();
+            }
+        }
+    }
+
+    DownloadVerifier::DownloadVerifier(const QString& expected_hash, const QVector<ChunkRef>& chunks, QObject* parent) :
+        QObject(parent), m_State(std::make_shared<State>()) {
+        m_State->owner = this;
+        m_State->expected = expected_hash;
+
+        qint64 next = 0;
+        bool tiled = !chunks.isEmpty();
+        for (const auto& c : chunks) {
+            if (c.offset != next || c.size <= 0 || c.hash.isEmpty()) {
+                tiled = false;
+                break;
+            }
+            next += c.size;
+        }
+        if (tiled) {
+            m_State->chunks = chunks;
+            m_HasChunks = true;
+        }
+    }
+
+    DownloadVerifier::~DownloadVerifier() {
+        QMutexLocker lock(&m_State->mutex);
+        m_State->stopped = true;
+        m_State->tasks.clear();
+    }
+
+    void DownloadVerifier::add(const QByteArray& data) {
+        if (data.isEmpty())
+            return;
+        Task task;
+        task.data = data;
+        m_Fed += data.size();
+        post(std::move(task));
+    }
+
+    void DownloadVerifier::add_file(const QString& path, qint64 length) {
+        if (length <= 0)
+            return;
+        Task task;
+        task.kind = Task::Kind::File;
+        task.path = path;
+        task.offset = m_Fed;
+        task.length = length;
+        m_Fed += length;
+        post(std::move(task));
+    }
+
+    void DownloadVerifier::rewind(qint64 offset) {
+        Task task;
+        task.kind = Task::Kind::Rewind;
+        task.offset = offset;
+        m_Fed = offset;
+        post(std::move(task));
+    }
+
+    void DownloadVerifier::finish() {
+        Task task;
+        task.kind = Task::Kind::Finish;
+        post(std::move(task));
+    }
+
+    DownloadVerifier::Totals DownloadVerifier::totals() { return {g_BytesHashed.load(), g_BusyNs.load()}; }
+
+    void DownloadVerifier::post(Task task) {
+        QMutexLocker lock(&m_State->mutex);
+        // Whatever is still queued belongs to the range being dropped
+        if (task.kind == Task::Kind::Rewind)
+            m_State->tasks.clear();
+        m_State->tasks.push_back(std::move(task));
+        if (!m_State->running) {
+            m_State->running = true;
+            HashService::pool()->start([state = m_State]() { State::drain(state); });
+        }
+    }
+
+} // namespace sap::client
@@ -0,0 +1,249 @@
+#include "sap_cloud_client/drive_cipher.h"
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <cstring>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/kdf.h>
+#include <openssl/rand.h>
+
+namespace {
+
+    constexpr char k_Magic[4] = {'S', 'A', 'P', 'E'};
+    constexpr char k_Version = 1;
+    constexpr char k_HkdfInfo[] = "sapcloud drive chunk key v1";
+    constexpr int k_NonceSize = 12;
+
+    // 4 zero bytes then the big-endian chunk index; unique because every file has its own key
+    void make_nonce(quint64 index, unsigned char* nonce) {
+        std::memset(nonce, 0, k_NonceSize);
+        for (int i = 0; i < 8; ++i)
+            nonce[k_NonceSize - 1 - i] = static_cast<unsigned char>(index >> (8 * i));
+    }
+
+    QByteArray derive_key(const QByteArray& master, QByteArrayView salt) {
+        QByteArray out(sap::client::DriveCipher::k_KeySize, '\0');
+        EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, nullptr);
+        if (!ctx)
+            return {};
+        size_t len = out.size();
+        bool ok = EVP_PKEY_derive_init(ctx) > 0 && EVP_PKEY_CTX_set_hkdf_md(ctx, EVP_sha256()) > 0 &&
+            EVP_PKEY_CTX_set1_hkdf_salt(ctx, reinterpret_cast<const unsigned char*>(salt.data()), static_cast<int>(salt.size())) > 0 &&
+            EVP_PKEY_CTX_set1_hkdf_key(ctx, reinterpret_cast<const unsigned char*>(master.constData()), static_cast<int>(master.size())) > 0 &&
+            EVP_PKEY_CTX_add1_hkdf_info(ctx, reinterpret_cast<const unsigned char*>(k_HkdfInfo), sizeof(k_HkdfInfo) - 1) > 0 &&
+            EVP_PKEY_derive(ctx, reinterpret_cast<unsigned char*>(out.data()), &len) > 0;
+        EVP_PKEY_CTX_free(ctx);
+        return ok ? out : QByteArray();
+    }
+
+    // One GCM operation over a chunk; the header and last flag go in as associated data
+    bool gcm(bool encrypt, const sap::client::DriveCipher::FileKey& key, quint64 index, bool last, const unsigned char* in, int len,
+             unsigned char* out, unsigned char* tag) {
+        EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+        if (!ctx)
+            return false;
+
+        unsigned char nonce[k_NonceSize];
+        make_nonce(index, nonce);
+        const unsigned char flag = last ? 1 : 0;
+        int n = 0;
+
+        bool ok = EVP_CipherInit_ex(ctx, EVP_aes_256_gcm(), nullptr, nullptr, nullptr, encrypt ? 1 : 0) > 0 &&
+            EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_IVLEN, k_NonceSize, nullptr) > 0 &&
+            EVP_CipherInit_ex(ctx, nullptr, nullptr, reinterpret_cast<const unsigned char*>(key.key.constData()), nonce, -1) > 0 &&
+            EVP_CipherUpdate(ctx, nullptr, &n, reinterpret_cast<const unsigned char*>(key.header.constData()), key.header.size()) > 0 &&
+            EVP_CipherUpdate(ctx, nullptr, &n, &flag, 1) > 0 && (len == 0 || EVP_CipherUpdate(ctx, out, &n, in, len) > 0);
+        if (ok && !encrypt)
+            ok = EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, sap::client::DriveCipher::k_TagSize, tag) > 0;
+        // Final fails on decryption when the tag doesn't match
+        ok = ok && EVP_CipherFinal_ex(ctx, out + n, &n) > 0;
+        if (ok && encrypt)
+            ok = EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, sap::client::DriveCipher::k_TagSize, tag) > 0;
+
+        EVP_CIPHER_CTX_free(ctx);
+        return ok;
+    }
+
+} // anonymous namespace
+
+namespace sap::client {
+
+    DriveCipher::DriveCipher() {}
+
+    DriveCipher::~DriveCipher() {
+        if (!m_Key.isEmpty())
+            OPENSSL_cleanse(m_Key.data(), m_Key.size());
+    }
+
+    bool DriveCipher::load_key(const QString& path) {
+        clear_error();
+
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            set_error("Cannot open encryption key file: " + path);
+            return false;
+        }
+        QByteArray key = file.readAll();
+        if (key.size() != k_KeySize) {
+            set_error("Invalid encryption key file: " + path);
+            return false;
+        }
+        m_Key = key;
+        return true;
+    }
+
+    bool DriveCipher::generate_key() {
+        clear_error();
+
+        QByteArray key(k_KeySize, '\0');
+        if (RAND_bytes(reinterpret_cast<unsigned char*>(key.data()), k_KeySize) != 1) {
+            set_error("Failed to generate encryption key");
+            return false;
+        }
+        m_Key = key;
+        return true;
+    }
+
+    bool DriveCipher::save_key(const QString& path) {
+        clear_error();
+
+        if (!has_key()) {
+            set_error("No encryption key loaded");
+            return false;
+        }
+
+        QDir().mkpath(QFileInfo(path).absolutePath());
+        QSaveFile file(path);
+        if (!file.open(QIODevice::WriteOnly)) {
+            set_error("Cannot open file for writing: " + path);
+            return false;
+        }
+        file.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+        file.write(m_Key);
+        if (!file.commit()) {
+            set_error("Cannot write encryption key: " + file.errorString());
+            return false;
+        }
+        return true;
+    }
+
+    DriveCipher::FileKey DriveCipher::new_file_key() const {
+        QByteArray header(k_Magic, sizeof(k_Magic));
+        header.append(k_Version);
+        header.append(3, '\0');
+        QByteArray salt(k_SaltSize, '\0');
+        if (RAND_bytes(reinterpret_cast<unsigned char*>(salt.data()), k_SaltSize) != 1)
+            return {};
+        header.append(salt);
+        return file_key(header);
+    }
+
+    DriveCipher::FileKey DriveCipher::file_key(QByteArrayView header) const {
+        if (!has_key() || !is_encrypted(header))
+            return {};
+        FileKey fk;
+        fk.header = header.first(k_HeaderSize).toByteArray();
+        fk.key = derive_key(m_Key, header.sliced(8, k_SaltSize));
+        return fk;
+    }
+
+    bool DriveCipher::is_encrypted(QByteArrayView header) {
+        return header.size() >= k_HeaderSize && std::memcmp(header.data(), k_Magic, sizeof(k_Magic)) == 0 && header[4] == k_Version;
+    }
+
+    qint64 DriveCipher::chunk_count(qint64 plain_size) {
+        // An empty file still gets one (empty, final) chunk so its emptiness is authenticated
+        return qMax<qint64>(1, (plain_size + k_ChunkSize - 1) / k_ChunkSize);
+    }
+
+    qint64 DriveCipher::encrypted_size(qint64 plain_size) { return k_HeaderSize + plain_size + chunk_count(plain_size) * k_TagSize; }
+
+    qint64 DriveCipher::plain_size(qint64 encrypted_size) {
+        qint64 body = encrypted_size - k_HeaderSize;
+        if (body < k_TagSize)
+            return -1;
+        qint64 rest = body % k_SealedChunkSize;
+        if (rest > 0 && rest < k_TagSize)
+            return -1;
+        return body / k_SealedChunkSize * k_ChunkSize + (rest > 0 ? rest - k_TagSize : 0);
+    }
+
+    bool DriveCipher::seal_chunk(const FileKey& key, quint64 index, bool last, QByteArrayView plain, char* out) {
+        auto* dst = reinterpret_cast<unsigned char*>(out);
+        return gcm(true, key, index, last, reinterpret_cast<const unsigned char*>(plain.data()), static_cast<int>(plain.size()), dst,
+                   dst + plain.size());
+    }
+
+    bool DriveCipher::open_chunk(const FileKey& key, quint64 index, bool last, QByteArrayView sealed, char* out) {
+        if (sealed.size() < k_TagSize)
+            return false;
+        qsizetype len = sealed.size() - k_TagSize;
+        auto* src = reinterpret_cast<const unsigned char*>(sealed.data());
+        // GCM wants a writable tag buffer
+        unsigned char tag[k_TagSize];
+        std::memcpy(tag, src + len, k_TagSize);
+        return gcm(false, key, index, last, src, static_cast<int>(len), reinterpret_cast<unsigned char*>(out), tag);
+    }
+
+    DriveCipher::Probe DriveCipher::probe_file(const QString& path) const {
+        QFile in(path);
+        if (!in.open(QIODevice::ReadOnly))
+            return Probe::Plain;
+        QByteArray header = in.read(k_HeaderSize);
+        qint64 plain = plain_size(in.size());
+        if (!is_encrypted(header) || plain < 0)
+            return Probe::Plain;
+        FileKey key = file_key(header);
+        if (!key.is_valid())
+            return Probe::Unreadable;
+
+        QByteArray sealed = in.read(k_SealedChunkSize);
+        QByteArray clear(qMax<qsizetype>(0, sealed.size() - k_TagSize), Qt::Uninitialized);
+        return open_chunk(key, 0, chunk_count(plain) == 1, sealed, clear.data()) ? Probe::Sealed : Probe::Unreadable;
+    }
+
+    bool DriveCipher::decrypt_file(const QString& source, const QString& target, QString* error) const {
+        auto fail = [error](const QString& msg) {
+            if (error)
+                *error = msg;
+            return false;
+        };
+
+        QFile in(source);
+        if (!in.open(QIODevice::ReadOnly))
+            return fail("Cannot open " + source + ": " + in.errorString());
+        FileKey key = file_key(in.read(k_HeaderSize));
+        if (!key.is_valid())
+            return fail(has_key() ? "Not an encrypted file: " + source : "No encryption key for " + source);
+        qint64 plain = plain_size(in.size());
+        if (plain < 0)
+            return fail("Truncated encrypted file: " + source);
+
+        QSaveFile out(target);
+        if (!out.open(QIODevice::WriteOnly))
+            return fail("Cannot write " + target + ": " + out.errorString());
+
+        const qint64 chunks = chunk_count(plain);
+        QByteArray clear(k_ChunkSize, Qt::Uninitialized);
+        for (qint64 i = 0; i < chunks; ++i) {
+            QByteArray sealed = in.read(k_SealedChunkSize);
+            bool last = i == chunks - 1;
+            if (sealed.size() < k_TagSize || (!last && sealed.size() != k_SealedChunkSize))
+                return fail("Truncated encrypted file: " + source);
+            if (!open_chunk(key, i, last, sealed, clear.data()))
+                return fail("Encrypted file failed authentication: " + source);
+            qint64 len = sealed.size() - k_TagSize;
+            if (out.write(clear.constData(), len) != len)
+                return fail("Cannot write " + target + ": " + out.errorString());
+        }
+
+        // Closed first so target may be the source itself
+        in.close();
+        if (!out.commit())
+            return fail("Cannot write " + target + ": " + out.errorString());
+        return true;
+    }
+
+} // namespace sap::client
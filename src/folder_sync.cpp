@@ -0,0 +1,423 @@
+#include "sap_cloud_client/folder_sync.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFuture>
+#include <QFileInfo>
+#include <QPromise>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QThreadPool>
+#include <memory>
+#include "sap_cloud_client/hash_service.h"
+
+namespace {
+
+    constexpr quint32 k_StateMagic = 0x53415046; // "SAPF"
+    constexpr quint32 k_StateVersion = 1;
+
+    qint64 mtime_of(const QFileInfo& info) { return info.lastModified().toMSecsSinceEpoch(); }
+
+} // anonymous namespace
+
+namespace sap::client {
+
+    FolderSync::FolderSync(ApiClient* api, TransferManager* transfers, SyncEngine* sync, const QString& local_root,
+                           const QString& remote_prefix, QObject* parent) :
+        QObject(parent), m_Api(api), m_Transfers(transfers), m_Sync(sync), m_Root(QDir(local_root).absolutePath()),
+        m_Prefix(remote_prefix.isEmpty() || remote_prefix.endsWith('/') ? remote_prefix : remote_prefix + '/') {
+        m_Watcher = new FolderWatcher(m_Root, this);
+        m_SaveTimer.setSingleShot(true);
+        m_SaveTimer.setInterval(k_SaveDelayMs);
+        connect(&m_SaveTimer, &QTimer::timeout, this, &FolderSync::save);
+    }
+
+    FolderSync::~FolderSync() {
+        if (m_SaveTimer.isActive())
+            save();
+    }
+
+    bool FolderSync::start() {
+        if (!QFileInfo(m_Root).isDir()) {
+            m_LastError = "Not a folder: " + m_Root;
+            return false;
+        }
+        if (!m_Watcher->start()) {
+            m_LastError = m_Watcher->last_error();
+            return false;
+        }
+        load();
+
+        connect(m_Watcher, &FolderWatcher::changed, this, [this](const QStringList& paths) { scan(paths); });
+        connect(m_Watcher, &FolderWatcher::overflowed, this, [this]() { scan({QString()}); });
+        connect(m_Sync, &SyncEngine::changed, this, &FolderSync::on_remote_changed);
+        connect(m_Transfers->scheduler(), &TransferScheduler::job_finished, this, &FolderSync::on_job_finished);
+
+        scan({QString()}, true);
+        return true;
+    }
+
+    void FolderSync::scan(const QStringList& relative_paths, bool initial) {
+        // Only stat here; hashing waits until size or mtime say the file actually changed
+        auto promise = std::make_shared<QPromise<QVector<LocalFile>>>();
+        QFuture<QVector<LocalFile>> future = promise->future();
+        promise->start();
+        QThreadPool::globalInstance()->start([promise, root = m_Root, relative_paths]() {
+            QVector<LocalFile> files;
+            auto add = [&](const QFileInfo& info) {
+                if (!info.fileName().endsWith(".part"))
+                    files.append({info.filePath().mid(root.size() + 1), info.size(), mtime_of(info)});
+            };
+            for (const auto& relative : relative_paths) {
+                QFileInfo info(QDir::cleanPath(root + '/' + relative));
+                if (relative.isEmpty() || relative.endsWith('/') || info.isDir()) {
+                    QDirIterator it(info.filePath(), QDir::Files | QDir::Hidden | QDir::NoSymLinks, QDirIterator::Subdirectories);
+                    while (it.hasNext())
+                        add(it.nextFileInfo());
+                } else if (info.isFile() && !info.isSymLink()) {
+                    add(info);
+                }
+            }
+            promise->addResult(files);
+            promise->finish();
+        });
+        future.then(this, [this, relative_paths, initial](QVector<LocalFile> files) { on_scanned(relative_paths, files, initial); });
+    }
+
+    void FolderSync::on_scanned(const QStringList& roots, const QVector<LocalFile>& files, bool initial) {
+        QSet<QString> seen;
+        seen.reserve(files.size());
+        for (const auto& f : files)
+            seen.insert(f.path);
+
+        // Records under a scanned root that the scan didn't find were deleted locally
+        QVector<BatchOp> deletes;
+        QSet<QString> dir_roots;
+        for (const auto& root : roots) {
+            if (!root.isEmpty() && !root.endsWith('/') && m_Records.contains(root) && !seen.contains(root))
+                on_local_deleted(root, deletes);
+            // A plain name may have been a directory before the event
+            dir_roots.insert(root.isEmpty() || root.endsWith('/') ? root : root + '/');
+        }
+        QStringList gone;
+        for (auto it = m_Records.constBegin(); it != m_Records.constEnd(); ++it) {
+            if (seen.contains(it.key()))
+                continue;
+            bool covered = dir_roots.contains(QString());
+            for (qsizetype slash = it.key().indexOf('/'); !covered && slash >= 0; slash = it.key().indexOf('/', slash + 1))
+                covered = dir_roots.contains(it.key().left(slash + 1));
+            if (covered)
+                gone.append(it.key());
+        }
+        for (const auto& path : gone)
+            on_local_deleted(path, deletes);
+        if (!deletes.isEmpty()) {
+            m_Api->run_batch(deletes, [](bool, QVector<BatchResult> results) {
+                for (const auto& r : results) {
+                    if (!r.ok)
+                        qWarning() << "Folder sync could not delete a remote file:" << r.error;
+                }
+            });
+        }
+
+        QVector<LocalFile> changed;
+        for (const auto& f : files) {
+            auto rec = m_Records.constFind(f.path);
+            if (rec != m_Records.constEnd() && rec->size == f.size && rec->mtime == f.mtime)
+                continue;
+            if (busy(f.path))
+                m_Dirty.insert(f.path);
+            else
+                changed.append(f);
+        }
+        hash_files(changed, [this, initial](QVector<LocalFile> hashed) { on_hashed(hashed, initial); });
+    }
+
+    void FolderSync::hash_files(const QVector<LocalFile>& files, std::function<void(QVector<LocalFile>)> done) {
+        if (files.isEmpty()) {
+            done({});
+            return;
+        }
+
+        QStringList paths;
+        for (const auto& f : files)
+            paths.append(local_path(f.path));
+        HashService::hash_files(paths).then(this, [files, done](QStringList hashes) {
+            QVector<LocalFile> hashed;
+            for (int i = 0; i < files.size(); ++i) {
+                if (!hashes[i].isEmpty()) {
+                    hashed.append(files[i]);
+                    hashed.last().hash = hashes[i];
+                }
+            }
+            done(hashed);
+        });
+    }
+
+    void FolderSync::on_hashed(const QVector<LocalFile>& files, bool initial) {
+        for (const auto& f : files)
+            on_local_file(f);
+        if (initial) {
+            m_InitialScanDone = true;
+            reconcile_remote();
+        }
+    }
+
+    void FolderSync::on_local_file(const LocalFile& file) {
+        if (busy(file.path)) {
+            m_Dirty.insert(file.path);
+            return;
+        }
+
+        auto rec = m_Records.find(file.path);
+        if (rec != m_Records.end() && rec->local_hash == file.hash) {
+            // Touched but not changed
+            rec->size = file.size;
+            rec->mtime = file.mtime;
+            m_SaveTimer.start();
+            return;
+        }
+
+        auto remote = m_Sync->file(remote_path(file.path));
+        if (rec == m_Records.end()) {
+            if (!remote) {
+                push(file);
+            } else if (!m_Transfers->encryption_enabled() && remote->hash == file.hash) {
+                // Same content on both sides already
+                m_Records.insert(file.path, {file.size, file.mtime, file.hash, remote->hash});
+                m_SaveTimer.start();
+            } else {
+                keep_both(file, *remote);
+            }
+            return;
+        }
+
+        bool remote_changed = remote && !rec->remote_hash.isEmpty() && remote->hash != rec->remote_hash;
+        if (remote_changed)
+            keep_both(file, *remote);
+        else
+            push(file);
+    }
+
+    void FolderSync::on_local_deleted(const QString& path, QVector<BatchOp>& deletes) {
+        if (busy(path)) {
+            m_Dirty.insert(path);
+            return;
+        }
+        Record rec = m_Records.take(path);
+        m_SaveTimer.start();
+        auto remote = m_Sync->file(remote_path(path));
+        if (!remote)
+            return;
+        if (rec.remote_hash.isEmpty() || remote->hash == rec.remote_hash)
+            deletes.append({BatchOp::Kind::DeleteFile, remote->path});
+        else
+            pull(*remote); // Edited remotely since; the edit wins over the delete
+    }
+
+    void FolderSync::on_remote_changed(const QStringList& updated, const QStringList& removed) {
+        if (!m_InitialScanDone)
+            return; // reconcile_remote() covers everything once the local side is known
+
+        for (const auto& path : updated) {
+            if (!path.startsWith(m_Prefix))
+                continue;
+            QString relative = path.mid(m_Prefix.size());
+            if (busy(relative)) {
+                m_RemoteDirty.insert(relative);
+                continue;
+            }
+            auto remote = m_Sync->file(path);
+            if (!remote)
+                continue;
+
+            auto rec = m_Records.find(relative);
+            if (rec != m_Records.end()) {
+                if (rec->remote_hash.isEmpty()) {
+                    // Our own upload showing up in the feed
+                    rec->remote_hash = remote->hash;
+                    m_SaveTimer.start();
+                } else if (rec->remote_hash != remote->hash) {
+                    if (local_matches_record(relative))
+                        pull(*remote);
+                    else
+                        scan({relative}); // changed on both sides; on_local_file keeps both
+                }
+            } else if (!QFileInfo::exists(local_path(relative))) {
+                pull(*remote);
+            } else {
+                scan({relative});
+            }
+        }
+
+        for (const auto& path : removed) {
+            if (!path.startsWith(m_Prefix))
+                continue;
+            QString relative = path.mid(m_Prefix.size());
+            if (busy(relative)) {
+                m_RemoteDirty.insert(relative);
+                continue;
+            }
+            auto rec = m_Records.constFind(relative);
+            if (rec == m_Records.constEnd() || rec->remote_hash.isEmpty())
+                continue;
+            bool unchanged = local_matches_record(relative);
+            m_Records.remove(relative);
+            m_SaveTimer.start();
+            if (unchanged)
+                QFile::remove(local_path(relative));
+            else
+                scan({relative}); // Edited locally since; uploaded again as a new file
+        }
+    }
+
+    void FolderSync::reconcile_remote() {
+        if (!m_Sync->has_snapshot())
+            return; // The first full listing arrives as a change set instead
+        QStringList updated;
+        for (auto it = m_Sync->files().constBegin(); it != m_Sync->files().constEnd(); ++it) {
+            if (it.key().startsWith(m_Prefix))
+                updated.append(it.key());
+        }
+        QStringList removed;
+        for (auto it = m_Records.constBegin(); it != m_Records.constEnd(); ++it) {
+            if (!m_Sync->file(remote_path(it.key())))
+                removed.append(remote_path(it.key()));
+        }
+        on_remote_changed(updated, removed);
+    }
+
+    void FolderSync::push(const LocalFile& file) {
+        m_Busy.insert(file.path);
+        auto id = m_Transfers->upload(local_path(file.path), remote_path(file.path));
+        m_Jobs.insert(id, {file.path, true, file, {}});
+    }
+
+    void FolderSync::pull(const FileInfo& remote) {
+        QString relative = remote.path.mid(m_Prefix.size());
+        m_Busy.insert(relative);
+        QDir().mkpath(QFileInfo(local_path(relative)).absolutePath());
+        auto id = m_Transfers->download(remote, local_path(relative));
+        m_Jobs.insert(id, {relative, false, {}, remote.hash});
+    }
+
+    void FolderSync::keep_both(const LocalFile& file, const FileInfo& remote) {
+        QFileInfo info(local_path(file.path));
+        QString stamp = QDateTime::currentDateTime().toString("yyyy-MM-dd hhmmss");
+        QString name = QString("%1 (conflict %2)").arg(info.completeBaseName(), stamp);
+        if (!info.suffix().isEmpty())
+            name += '.' + info.suffix();
+        QString renamed = info.dir().filePath(name);
+        if (!QFile::rename(info.filePath(), renamed)) {
+            qWarning() << "Folder sync could not set aside conflicting" << info.filePath();
+            return;
+        }
+        m_Records.remove(file.path);
+        pull(remote);
+        // The renamed copy is new to both sides and gets uploaded like any other file
+        scan({renamed.mid(m_Root.size() + 1)});
+    }
+
+    void FolderSync::on_job_finished(TransferScheduler::JobId id, bool ok) {
+        auto it = m_Jobs.find(id);
+        if (it == m_Jobs.end())
+            return;
+        Job job = it.value();
+        m_Jobs.erase(it);
+
+        if (!ok) {
+            qWarning() << "Folder sync failed to" << (job.upload ? "upload" : "download") << job.path;
+            mark_done(job.path);
+            return;
+        }
+
+        if (job.upload) {
+            // The remote hash is filled in when the upload shows up in the delta feed
+            m_Records.insert(job.path, {job.local.size, job.local.mtime, job.local.hash, {}});
+            m_SaveTimer.start();
+            emit activity(job.path, true);
+            mark_done(job.path);
+            m_Sync->sync_now();
+            return;
+        }
+
+        // Record what was written so the watcher event for it isn't echoed back
+        QFileInfo info(local_path(job.path));
+        LocalFile written{job.path, info.size(), mtime_of(info), {}};
+        hash_files({written}, [this, job](QVector<LocalFile> hashed) {
+            if (!hashed.isEmpty()) {
+                const auto& f = hashed.first();
+                m_Records.insert(job.path, {f.size, f.mtime, f.hash, job.remote_hash});
+                m_SaveTimer.start();
+                emit activity(job.path, false);
+            }
+            mark_done(job.path);
+        });
+    }
+
+    bool FolderSync::busy(const QString& path) const { return m_Busy.contains(path); }
+
+    void FolderSync::mark_done(const QString& path) {
+        m_Busy.remove(path);
+        if (m_Dirty.remove(path))
+            scan({path});
+        if (m_RemoteDirty.remove(path)) {
+            if (m_Sync->file(remote_path(path)))
+                on_remote_changed({remote_path(path)}, {});
+            else
+                on_remote_changed({}, {remote_path(path)});
+        }
+    }
+
+    bool FolderSync::local_matches_record(const QString& path) const {
+        auto rec = m_Records.constFind(path);
+        if (rec == m_Records.constEnd())
+            return false;
+        QFileInfo info(local_path(path));
+        return info.isFile() && info.size() == rec->size && mtime_of(info) == rec->mtime;
+    }
+
+    QString FolderSync::state_path() const {
+        QByteArray key = QCryptographicHash::hash((m_Root + '\n' + m_Api->server_url() + '\n' + m_Prefix).toUtf8(),
+                                                  QCryptographicHash::Sha1)
+                             .toHex();
+        return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/folder_sync/" + key + ".state";
+    }
+
+    void FolderSync::load() {
+        QFile file(state_path());
+        if (!file.open(QIODevice::ReadOnly))
+            return;
+        QDataStream ds(&file);
+        quint32 magic = 0, version = 0, count = 0;
+        ds >> magic >> version >> count;
+        if (magic != k_StateMagic || version != k_StateVersion)
+            return;
+        for (quint32 i = 0; i < count && ds.status() == QDataStream::Ok; ++i) {
+            QString path;
+            Record rec;
+            ds >> path >> rec.size >> rec.mtime >> rec.local_hash >> rec.remote_hash;
+            m_Records.insert(path, rec);
+        }
+        if (ds.status() != QDataStream::Ok)
+            m_Records.clear(); // A damaged state only costs a rehash of everything
+    }
+
+    void FolderSync::save() {
+        QString path = state_path();
+        QDir().mkpath(QFileInfo(path).absolutePath());
+        QSaveFile file(path);
+        if (!file.open(QIODevice::WriteOnly))
+            return;
+        QDataStream ds(&file);
+        ds << k_StateMagic << k_StateVersion << static_cast<quint32>(m_Records.size());
+        for (auto it = m_Records.constBegin(); it != m_Records.constEnd(); ++it)
+            ds << it.key() << it->size << it->mtime << it->local_hash << it->remote_hash;
+        file.commit();
+    }
+
+} // namespace sap::client
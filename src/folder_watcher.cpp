@@ -0,0 +1,207 @@
+#include "sap_cloud_client/folder_watcher.h"
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QMutex>
+#include <QSocketNotifier>
+#include <QThreadPool>
+#include <algorithm>
+
+#ifdef Q_OS_LINUX
+#include <cerrno>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace sap::client {
+
+    namespace {
+
+        // Partial downloads are renamed into place when complete; only the final name matters
+        bool ignored(const QString& name) { return name.endsWith(".part"); }
+
+    } // anonymous namespace
+
+    // Watch descriptors are added from the pool and looked up on the GUI thread
+    struct FolderWatcher::Watches {
+        QMutex mutex;
+        QHash<int, QString> dirs; // watch descriptor -> relative dir ("" or ending in '/')
+        FolderWatcher* owner = nullptr;
+        int fd = -1;
+        bool stopped = false;
+        bool exhausted = false;
+
+        // Runs fn on the owner's thread; call with mutex held so the owner can't be destroyed meanwhile
+        template <typename Fn>
+        void post_locked(Fn fn) {
+            if (stopped)
+                return;
+            FolderWatcher* o = owner;
+            QMetaObject::invokeMethod(o, [o, fn]() { fn(o); }, Qt::QueuedConnection);
+        }
+    };
+
+    FolderWatcher::FolderWatcher(const QString& root, QObject* parent) :
+        QObject(parent), m_Root(QDir(root).absolutePath()), m_Watches(std::make_shared<Watches>()) {
+        m_Watches->owner = this;
+        m_SettleTimer.setSingleShot(true);
+        connect(&m_SettleTimer, &QTimer::timeout, this, &FolderWatcher::flush);
+    }
+
+    FolderWatcher::~FolderWatcher() {
+        QMutexLocker lock(&m_Watches->mutex);
+        m_Watches->stopped = true;
+#ifdef Q_OS_LINUX
+        if (m_Watches->fd >= 0)
+            ::close(m_Watches->fd);
+        m_Watches->fd = -1;
+#endif
+    }
+
+    bool FolderWatcher::start() {
+#ifdef Q_OS_LINUX
+        int fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd < 0) {
+            m_LastError = QString("inotify unavailable: %1").arg(qt_error_string(errno));
+            return false;
+        }
+        m_Watches->fd = fd;
+        m_Notifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+        connect(m_Notifier, &QSocketNotifier::activated, this, &FolderWatcher::on_readable);
+#else
+        m_Fallback = new QFileSystemWatcher(this);
+        connect(m_Fallback, &QFileSystemWatcher::directoryChanged, this, [this](const QString& path) {
+            QString relative = QDir(m_Root).relativeFilePath(path);
+            note(relative == "." ? QString() : relative + '/');
+        });
+#endif
+        watch_tree({});
+        return true;
+    }
+
+    void FolderWatcher::watch_tree(const QString& relative_dir) {
+        // Walk off the GUI thread; inotify_add_watch is a plain syscall and safe to call from there
+        QThreadPool::globalInstance()->start([watches = m_Watches, root = m_Root, relative_dir]() {
+            QStringList dirs{relative_dir};
+            QDirIterator it(root + '/' + relative_dir, QDir::Dirs | QDir::Hidden | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+            while (it.hasNext()) {
+                QString path = it.next();
+                if (!QFileInfo(path).isSymLink())
+                    dirs.append(path.mid(root.size() + 1) + '/');
+            }
+
+#ifdef Q_OS_LINUX
+            constexpr uint32_t mask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB |
+                                      IN_DELETE_SELF | IN_DONT_FOLLOW | IN_EXCL_UNLINK;
+            for (const auto& dir : dirs) {
+                // Locked per directory so the owner's destructor never waits on a whole walk
+                QMutexLocker lock(&watches->mutex);
+                if (watches->stopped)
+                    return;
+                int wd = ::inotify_add_watch(watches->fd, QFile::encodeName(root + '/' + dir).constData(), mask);
+                if (wd >= 0) {
+                    watches->dirs.insert(wd, dir);
+                } else if (errno == ENOSPC && !watches->exhausted) {
+                    // fs.inotify.max_user_watches reached; changes below here go unseen until a rescan
+                    watches->exhausted = true;
+                    watches->post_locked([](FolderWatcher* watcher) {
+                        qWarning() << "Out of inotify watches under" << watcher->m_Root;
+                        emit watcher->overflowed();
+                    });
+                }
+            }
+#else
+            QMutexLocker lock(&watches->mutex);
+            watches->post_locked([root, dirs](FolderWatcher* watcher) {
+                QStringList paths;
+                for (const auto& dir : dirs)
+                    paths.append(root + '/' + dir);
+                watcher->m_Fallback->addPaths(paths);
+            });
+#endif
+        });
+    }
+
+    void FolderWatcher::on_readable() {
+#ifdef Q_OS_LINUX
+        alignas(struct inotify_event) char buffer[64 * 1024];
+        for (;;) {
+            ssize_t n = ::read(m_Watches->fd, buffer, sizeof(buffer));
+            if (n <= 0)
+                break;
+
+            QMutexLocker lock(&m_Watches->mutex);
+            for (char* p = buffer; p < buffer + n;) {
+                auto* event = reinterpret_cast<struct inotify_event*>(p);
+                p += sizeof(struct inotify_event) + event->len;
+
+                if (event->mask & IN_Q_OVERFLOW) {
+                    lock.unlock();
+                    emit overflowed();
+                    lock.relock();
+                    continue;
+                }
+                if (event->mask & IN_IGNORED) {
+                    m_Watches->dirs.remove(event->wd);
+                    continue;
+                }
+                auto dir = m_Watches->dirs.constFind(event->wd);
+                if (dir == m_Watches->dirs.constEnd())
+                    continue;
+
+                if (event->mask & IN_DELETE_SELF) {
+                    note(*dir);
+                    continue;
+                }
+                QString name = event->len > 0 ? QFile::decodeName(event->name) : QString();
+                if (name.isEmpty() || ignored(name))
+                    continue;
+                QString relative = *dir + name;
+                if (event->mask & IN_ISDIR) {
+                    relative += '/';
+                    // New directories need their own watches, including any subtree moved in whole
+                    if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                        lock.unlock();
+                        watch_tree(relative);
+                        lock.relock();
+                    }
+                }
+                note(relative);
+            }
+        }
+#endif
+    }
+
+    void FolderWatcher::note(const QString& relative_path) {
+        if (m_Pending.isEmpty())
+            m_PendingSince.start();
+        m_Pending.insert(relative_path);
+        if (m_PendingSince.elapsed() >= k_MaxDelayMs)
+            flush();
+        else
+            m_SettleTimer.start(k_SettleMs);
+    }
+
+    void FolderWatcher::flush() {
+        m_SettleTimer.stop();
+        if (m_Pending.isEmpty())
+            return;
+
+        // Sorted, a directory comes right before everything under it
+        QStringList paths(m_Pending.begin(), m_Pending.end());
+        m_Pending.clear();
+        std::sort(paths.begin(), paths.end());
+        QStringList folded;
+        for (const auto& path : paths) {
+            if (!folded.isEmpty() && folded.last().endsWith('/') && path.startsWith(folded.last()))
+                continue;
+            folded.append(path);
+        }
+        emit changed(folded);
+    }
+
+} // namespace sap::client
@@ -0,0 +1,142 @@
+#include "sap_cloud_client/hash_service.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QPromise>
+#include <QThread>
+#include <QThreadPool>
+#include <memory>
+#include <openssl/evp.h>
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#endif
+
+namespace sap::client {
+
+    ContentHasher::ContentHasher() : m_Ctx(EVP_MD_CTX_new()) { reset(); }
+
+    ContentHasher::ContentHasher(const ContentHasher& other) : m_Ctx(EVP_MD_CTX_new()) { EVP_MD_CTX_copy_ex(m_Ctx, other.m_Ctx); }
+
+    ContentHasher& ContentHasher::operator=(const ContentHasher& other) {
+        if (this != &other)
+            EVP_MD_CTX_copy_ex(m_Ctx, other.m_Ctx);
+        return *this;
+    }
+
+    ContentHasher::~ContentHasher() { EVP_MD_CTX_free(m_Ctx); }
+
+    void ContentHasher::reset() { EVP_DigestInit_ex(m_Ctx, EVP_sha256(), nullptr); }
+
+    void ContentHasher::add(QByteArrayView data) {
+        if (!data.isEmpty())
+            EVP_DigestUpdate(m_Ctx, data.data(), static_cast<size_t>(data.size()));
+    }
+
+    bool ContentHasher::add(QIODevice* device) {
+        QByteArray block(HashService::k_ReadBlock, Qt::Uninitialized);
+        for (;;) {
+            qint64 n = device->read(block.data(), block.size());
+            if (n < 0)
+                return false;
+            if (n == 0)
+                return true;
+            add(QByteArrayView(block.constData(), n));
+        }
+    }
+
+    QString ContentHasher::result() const {
+        unsigned char digest[EVP_MAX_MD_SIZE];
+        unsigned int length = 0;
+        EVP_MD_CTX* copy = EVP_MD_CTX_new();
+        EVP_MD_CTX_copy_ex(copy, m_Ctx);
+        EVP_DigestFinal_ex(copy, digest, &length);
+        EVP_MD_CTX_free(copy);
+        return QString::fromLatin1(QByteArray(reinterpret_cast<const char*>(digest), length).toHex());
+    }
+
+    QString HashService::hash_file(const QString& path, QString* error, const std::atomic<bool>* cancel) {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+            if (error)
+                *error = file.errorString();
+            return {};
+        }
+
+#ifdef Q_OS_LINUX
+        // Read-ahead without a mapping; advice only, so a failure changes nothing
+        ::posix_fadvise(file.handle(), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+        ContentHasher hasher;
+        QByteArray block(k_ReadBlock, Qt::Uninitialized);
+        for (;;) {
+            if (cancel && *cancel)
+                return {};
+            qint64 n = file.read(block.data(), block.size());
+            if (n < 0) {
+                if (error)
+                    *error = file.errorString();
+                return {};
+            }
+            if (n == 0)
+                break;
+            hasher.add(QByteArrayView(block.constData(), n));
+        }
+        return hasher.result();
+    }
+
+    QThreadPool* HashService::pool() {
+        static QThreadPool* pool = [] {
+            auto* p = new QThreadPool();
+            p->setMaxThreadCount(QThread::idealThreadCount());
+            return p;
+        }();
+        return pool;
+    }
+
+    QFuture<QStringList> HashService::hash_files(const QStringList& paths, std::shared_ptr<std::atomic<bool>> cancel) {
+        // One task per file; the last one to finish publishes the batch
+        struct Batch {
+            QPromise<QStringList> promise;
+            QStringList hashes;
+            std::atomic<int> remaining;
+        };
+        auto batch = std::make_shared<Batch>();
+        QFuture<QStringList> future = batch->promise.future();
+        batch->promise.start();
+        if (paths.isEmpty()) {
+            batch->promise.addResult(QStringList());
+            batch->promise.finish();
+            return future;
+        }
+
+        batch->hashes.resize(paths.size());
+        batch->remaining = static_cast<int>(paths.size());
+        for (int i = 0; i < paths.size(); ++i) {
+            pool()->start([batch, cancel, i, path = paths[i]]() {
+                batch->hashes[i] = hash_file(path, nullptr, cancel.get());
+                if (--batch->remaining == 0) {
+                    batch->promise.addResult(batch->hashes);
+                    batch->promise.finish();
+                }
+            });
+        }
+        return future;
+    }
+
+    double HashService::benchmark(const QStringList& paths, int rounds) {
+        qint64 bytes = 0;
+        for (const auto& path : paths)
+            bytes += QFileInfo(path).size();
+
+        // One warm-up round so the page cache is on equal footing for every measured one
+        hash_files(paths).waitForFinished();
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < rounds; ++i)
+            hash_files(paths).waitForFinished();
+        qint64 elapsed = qMax<qint64>(1, timer.nsecsElapsed());
+        return static_cast<double>(bytes) * rounds * 1e9 / static_cast<double>(elapsed);
+    }
+
+} // namespace sap::client
@@ -0,0 +1,367 @@
+#include "sap_cloud_client/importer.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QMutex>
+#include <QPointer>
+#include <QRegularExpression>
+#include <QSemaphore>
+#include <QStandardPaths>
+#include <QThreadPool>
+#include "sap_cloud_client/api_client.h"
+#include "sap_cloud_client/tar_reader.h"
+
+namespace {
+
+    constexpr qint64 k_ProgressIntervalMs = 250;
+
+    QString unquote(const QString& value) {
+        QString v = value.trimmed();
+        if (v.startsWith('"')) {
+            auto doc = QJsonDocument::fromJson(("[" + v + "]").toUtf8());
+            if (doc.isArray())
+                return doc.array().at(0).toString();
+        }
+        if (v.size() >= 2 && v.startsWith('\'') && v.endsWith('\''))
+            return v.mid(1, v.size() - 2).replace("''", "'");
+        return v;
+    }
+
+    // [a, "b"], a JSON array, or a bare comma-separated list
+    QVector<QString> parse_list(const QString& value) {
+        QString v = value.trimmed();
+        QVector<QString> out;
+        if (v.startsWith('[')) {
+            auto doc = QJsonDocument::fromJson(v.toUtf8());
+            if (doc.isArray()) {
+                for (const auto& t : doc.array()) {
+                    if (!t.toString().isEmpty())
+                        out.append(t.toString());
+                }
+                return out;
+            }
+            v = v.mid(1, v.endsWith(']') ? v.size() - 2 : -1);
+        }
+        for (const auto& part : v.split(',')) {
+            QString t = unquote(part);
+            if (!t.isEmpty())
+                out.append(t);
+        }
+        return out;
+    }
+
+    // Markdown with optional front matter; title falls back to the first heading, then the file name
+    sap::client::Note parse_markdown(const QString& text, const QString& fallback_title) {
+        static const QRegularExpression fence(R"(^---[ \t]*$)", QRegularExpression::MultilineOption);
+        static const QRegularExpression heading(R"(^#[ \t]+(.+?)[ \t#]*$)", QRegularExpression::MultilineOption);
+
+        sap::client::Note note;
+        QString body = text;
+
+        if (text.startsWith("---")) {
+            auto open = fence.match(text);
+            auto close = open.hasMatch() && open.capturedStart() == 0 ? fence.match(text, open.capturedEnd()) : QRegularExpressionMatch();
+            if (close.hasMatch()) {
+                QString front = text.mid(open.capturedEnd(), close.capturedStart() - open.capturedEnd());
+                body = text.mid(close.capturedEnd());
+
+                QString list_key;
+                for (const QString& raw : front.split('\n')) {
+                    QString line = raw.trimmed();
+                    if (line.isEmpty())
+                        continue;
+                    // YAML block list under the last key
+                    if (line.startsWith("- ") && list_key == "tags") {
+                        QString t = unquote(line.mid(2));
+                        if (!t.isEmpty())
+                            note.tags.append(t);
+                        continue;
+                    }
+                    qsizetype colon = line.indexOf(':');
+                    if (colon <= 0)
+                        continue;
+                    QString key = line.left(colon).trimmed().toLower();
+                    QString value = line.mid(colon + 1).trimmed();
+                    list_key = value.isEmpty() ? key : QString();
+                    if (key == "title")
+                        note.title = unquote(value);
+                    else if (key == "tags" && !value.isEmpty())
+                        note.tags = parse_list(value);
+                }
+            }
+        }
+
+        while (body.startsWith('\n') || body.startsWith("\r\n"))
+            body.remove(0, body.startsWith('\n') ? 1 : 2);
+        note.content = body;
+
+        if (note.title.isEmpty()) {
+            auto m = heading.match(body);
+            note.title = m.hasMatch() ? m.captured(1) : fallback_title;
+        }
+        return note;
+    }
+
+    QString note_key(const QString& name, const QString& content) {
+        QCryptographicHash hash(QCryptographicHash::Sha256);
+        hash.addData(name.toUtf8());
+        hash.addData(QByteArrayView("\0", 1));
+        hash.addData(content.toUtf8());
+        return "note:" + QString::fromLatin1(hash.result().toHex().left(32));
+    }
+
+} // anonymous namespace
+
+namespace sap::client {
+
+    // Handoff between the scanning thread and the importer.
+    // Slots bound how far scanning runs ahead; posting stops once the importer is gone.
+    struct Importer::Shared {
+        QSemaphore slots{k_MaxQueued};
+        QMutex mutex;
+        bool stopped = false;
+        Importer* owner = nullptr;
+
+        bool acquire() {
+            slots.acquire();
+            QMutexLocker lock(&mutex);
+            return !stopped;
+        }
+
+        void post(std::function<void(Importer*)> fn) {
+            QMutexLocker lock(&mutex);
+            if (stopped)
+                return;
+            Importer* o = owner;
+            QMetaObject::invokeMethod(o, [o, fn]() { fn(o); }, Qt::QueuedConnection);
+        }
+
+        void stop() {
+            {
+                QMutexLocker lock(&mutex);
+                stopped = true;
+            }
+            // Wake a producer blocked on a full queue so it can see the flag
+            slots.release(k_MaxQueued);
+        }
+    };
+
+    Importer::Importer(ApiClient* api, Source source, const QString& path, QObject* parent) :
+        QObject(parent), m_Api(api), m_Source(source), m_Path(path), m_Shared(std::make_shared<Shared>()) {
+        m_Shared->owner = this;
+
+        QByteArray id = QCryptographicHash::hash(QFileInfo(path).absoluteFilePath().toUtf8(), QCryptographicHash::Sha1).toHex();
+        QString dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/imports";
+        QDir().mkpath(dir);
+        m_State.setFileName(dir + "/" + QString::fromLatin1(id) + ".state");
+    }
+
+    Importer::~Importer() { m_Shared->stop(); }
+
+    void Importer::start() {
+        m_Clock.start();
+        load_state();
+        if (!m_State.open(QIODevice::WriteOnly | QIODevice::Append)) {
+            m_ScanError = "Cannot write import state: " + m_State.errorString();
+            complete(false);
+            return;
+        }
+
+        // Notes sent when the last run stopped are simply sent again: their idempotency key lets the
+        // server answer with the note it already created instead of making a second one
+        begin_scan();
+    }
+
+    void Importer::abort() {
+        if (m_Done)
+            return;
+        m_ScanError = "Import cancelled";
+        complete(false);
+    }
+
+    void Importer::load_state() {
+        if (!m_State.open(QIODevice::ReadOnly))
+            return;
+        while (!m_State.atEnd()) {
+            QString line = QString::fromUtf8(m_State.readLine()).chopped(1);
+            if (line.size() < 3)
+                continue;
+            qsizetype space = line.indexOf(' ', 2);
+            QString key = line.mid(2, space < 0 ? -1 : space - 2);
+            // "S" lines from older runs carry nothing a resend doesn't already handle
+            if (line[0] == 'D')
+                m_Completed.insert(key);
+        }
+        m_State.close();
+    }
+
+    void Importer::record(char op, const Item& item) {
+        QString line = QString(QChar(op)) + ' ' + item.key;
+        m_State.write((line + '\n').toUtf8());
+        m_State.flush();
+        if (op == 'D')
+            m_Completed.insert(item.key);
+    }
+
+    void Importer::begin_scan() {
+        QThreadPool::globalInstance()->start([shared = m_Shared, source = m_Source, path = m_Path]() {
+            int count = 0;
+            auto emit_item = [&](Item item) {
+                if (!shared->acquire())
+                    return false;
+                count++;
+                shared->post([item = std::move(item)](Importer* importer) { importer->on_item(item); });
+                return true;
+            };
+
+            QString error;
+            if (source == Source::MarkdownFolder) {
+                QDir root(path);
+                QDirIterator it(path, {"*.md", "*.markdown"}, QDir::Files, QDirIterator::Subdirectories);
+                while (it.hasNext()) {
+                    QString file_path = it.next();
+                    QFile file(file_path);
+                    if (!file.open(QIODevice::ReadOnly))
+                        continue;
+                    QString text = QString::fromUtf8(file.readAll());
+                    QString relative = root.relativeFilePath(file_path);
+
+                    Item item;
+                    item.kind = Item::Kind::Note;
+                    item.note = parse_markdown(text, QFileInfo(file_path).completeBaseName());
+                    item.key = note_key(relative, text);
+                    if (!emit_item(std::move(item)))
+                        return;
+                }
+            } else {
+                TarReader tar(path);
+                if (!tar.open()) {
+                    error = tar.last_error();
+                } else {
+                    while (auto entry = tar.next()) {
+                        Item item;
+                        if (entry->name.startsWith("notes/") && entry->name.endsWith(".md")) {
+                            QString text = QString::fromUtf8(tar.read(*entry));
+                            item.kind = Item::Kind::Note;
+                            item.note = parse_markdown(text, QFileInfo(entry->name).completeBaseName());
+                            item.key = note_key(entry->name, text);
+                        } else if (entry->name.startsWith("files/")) {
+                            // Restored straight from the archive window; path, size and mtime identify it
+                            item.kind = Item::Kind::File;
+                            item.remote_path = entry->name.mid(6);
+                            item.offset = entry->offset;
+                            item.size = entry->size;
+                            item.key = QString("file:%1:%2:%3").arg(item.remote_path).arg(entry->size).arg(entry->mtime_ms);
+                        } else {
+                            continue;
+                        }
+                        if (!emit_item(std::move(item)))
+                            return;
+                    }
+                    error = tar.last_error();
+                }
+            }
+            shared->post([count, error](Importer* importer) { importer->on_scan_done(count, error); });
+        });
+    }
+
+    void Importer::on_item(const Item& item) {
+        if (m_Done)
+            return;
+        if (m_Completed.contains(item.key)) {
+            m_Skipped++;
+            release_slot();
+            pump();
+            return;
+        }
+        m_Pending.push_back(item);
+        pump();
+    }
+
+    void Importer::on_scan_done(int total, const QString& error) {
+        if (m_Done)
+            return;
+        m_Total = total;
+        m_ScanError = error;
+        pump();
+    }
+
+    void Importer::pump() {
+        while (!m_Done && m_InFlight < k_MaxInFlight && !m_Pending.empty()) {
+            Item item = std::move(m_Pending.front());
+            m_Pending.pop_front();
+            send(item);
+        }
+        report_progress();
+
+        if (!m_Done && m_Total >= 0 && m_Pending.empty() && m_InFlight == 0 && m_Imported + m_Skipped + m_Failed >= m_Total)
+            complete(m_Failed == 0 && m_ScanError.isEmpty());
+    }
+
+    void Importer::send(const Item& item) {
+        m_InFlight++;
+        QPointer<Importer> self(this);
+
+        if (item.kind == Item::Kind::Note) {
+            m_Api->create_note(
+                item.note,
+                [self, item](bool ok, Note) {
+                    if (self && !self->m_Done)
+                        self->on_sent(item, ok);
+                },
+                item.key);
+            return;
+        }
+
+        auto* source = new UploadSource(m_Path, item.offset, item.size);
+        if (!source->open(QIODevice::ReadOnly)) {
+            delete source;
+            on_sent(item, false);
+            return;
+        }
+        m_Api->upload_file(item.remote_path, source, {}, [self, item](bool ok, QString) {
+            if (self && !self->m_Done)
+                self->on_sent(item, ok);
+        });
+    }
+
+    void Importer::on_sent(const Item& item, bool ok) {
+        m_InFlight--;
+        if (ok) {
+            record('D', item);
+            m_Imported++;
+        } else {
+            m_Failed++;
+        }
+        release_slot();
+        pump();
+    }
+
+    void Importer::release_slot() { m_Shared->slots.release(); }
+
+    void Importer::report_progress() {
+        qint64 now = m_Clock.elapsed();
+        if (m_LastReport >= 0 && now - m_LastReport < k_ProgressIntervalMs)
+            return;
+        m_LastReport = now;
+        int done = m_Imported + m_Skipped;
+        double rate = now > 0 ? m_Imported * 1000.0 / now : 0;
+        emit progress(done, m_Failed, m_Total, rate);
+    }
+
+    void Importer::complete(bool ok) {
+        m_Done = true;
+        m_Shared->stop();
+        m_State.close();
+        // A clean run leaves nothing to resume
+        if (ok)
+            m_State.remove();
+        m_LastReport = -1;
+        report_progress();
+        emit finished(ok, m_Imported, m_Skipped, m_Failed);
+    }
+
+} // namespace sap::client
@@ -1,4 +1,6 @@
 #include "sap_cloud_client/main_window.h"
+#include <QCheckBox>
+#include <QDate>
 #include <QDebug>
 #include <QDialog>
 #include <QDialogButtonBox>
@@ -10,10 +12,13 @@
 #include <QGraphicsDropShadowEffect>
 #include <QHBoxLayout>
 #include <QInputDialog>
+#include <QLocale>
 #include <QMessageBox>
 #include <QSettings>
+#include <QSpinBox>
 #include <QStatusBar>
 #include <QVBoxLayout>
+#include "sap_cloud_client/backup_exporter.h"
 #include "sap_cloud_client/drive_screen.h"
 #include "sap_cloud_client/notes_screen.h"
 #include "sap_cloud_client/theme.h"
@@ -23,9 +28,26 @@ namespace sap::client {
     MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent) {
         m_Api = new ApiClient(this);
         m_SshAuth = new SshAuth();
+        m_Scheduler = new TransferScheduler(this);
+        m_Transfers = new TransferManager(m_Api, m_Scheduler, this);
 
         QSettings settings("SapCloud", "Client");
         m_Api->set_server_url(settings.value("serverUrl", "http://localhost:8080").toString());
+        if (settings.value("encryptUploads", false).toBool() && !m_Transfers->set_encryption(true))
+            qWarning() << "Encryption unavailable:" << m_Transfers->encryption_error();
+        m_Sync = new SyncEngine(m_Api, this);
+        m_Offline = new OfflineStore(m_Api, m_Sync, m_Scheduler, this);
+        m_Offline->set_disk_limit(settings.value("offlineDiskLimit", OfflineStore::k_DefaultDiskLimit).toLongLong());
+        m_Offline->set_bandwidth_limit(settings.value("offlineBandwidthLimit", OfflineStore::k_DefaultBandwidthLimit).toLongLong());
+        m_Offline->set_prefetch_limit(settings.value("prefetchLimit", OfflineStore::k_DefaultPrefetchLimit).toLongLong());
+        m_Peers = new PeerCache(this);
+        // Files kept offline are private to this device unless the user opts in
+        if (settings.value("peerShareOffline", false).toBool())
+            m_Peers->add_source(&m_Offline->content_store());
+        m_Peers->set_disk_limit(settings.value("peerCacheLimit", PeerCache::k_DefaultDiskLimit).toLongLong());
+        if (settings.value("peerCache", false).toBool() && !set_peer_sharing(true))
+            qWarning() << "Peer sharing unavailable:" << m_Peers->last_error();
+        m_WebDav = new WebDavServer(m_Api, m_Sync, m_Transfers, m_Offline, this);
 
         connect(m_Api, &ApiClient::authenticated, this, &MainWindow::on_authenticated);
         connect(m_Api, &ApiClient::error, this, &MainWindow::on_auth_error);
@@ -142,8 +164,8 @@ namespace sap::client {
         content_layout->setSpacing(0);
 
         m_Stack = new QStackedWidget(this);
-        m_Drive = new DriveScreen(m_Api, this);
-        m_Notes = new NotesScreen(m_Api, this);
+        m_Drive = new DriveScreen(m_Api, m_Transfers, m_Sync, m_Offline, this);
+        m_Notes = new NotesScreen(m_Api, m_Offline, this);
 
         m_Stack->addWidget(m_Drive);
         m_Stack->addWidget(m_Notes);
@@ -252,6 +274,152 @@ namespace sap::client {
         });
         form->addWidget(browse_btn);
 
+        // Client-side encryption
+        auto* encrypt_check = new QCheckBox("Encrypt files before upload", &dialog);
+        encrypt_check->setChecked(m_Transfers->encryption_enabled());
+        encrypt_check->setToolTip("Key is kept in ~/.sapcloud/drive.key; without it encrypted files can't be read");
+        form->addWidget(encrypt_check);
+
+        // Offline copies
+        constexpr qint64 k_MiB = 1024 * 1024;
+        auto* offline_label = new QLabel("Offline copies (" + QLocale().formattedDataSize(m_Offline->disk_usage()) + " used)", &dialog);
+        offline_label->setStyleSheet("color: #8888aa; font-size: 12px;");
+        form->addWidget(offline_label);
+
+        auto* offline_row = new QHBoxLayout();
+        offline_row->setSpacing(8);
+        auto* disk_spin = new QSpinBox(&dialog);
+        disk_spin->setRange(64, 1024 * 1024);
+        disk_spin->setSingleStep(256);
+        disk_spin->setSuffix(" MB on disk");
+        disk_spin->setValue(static_cast<int>(m_Offline->disk_limit() / k_MiB));
+        offline_row->addWidget(disk_spin);
+        auto* bandwidth_spin = new QSpinBox(&dialog);
+        bandwidth_spin->setRange(0, 10000);
+        bandwidth_spin->setSuffix(" MB/s");
+        bandwidth_spin->setSpecialValueText("Unlimited");
+        bandwidth_spin->setToolTip("Average rate for fetching offline copies in the background");
+        bandwidth_spin->setValue(static_cast<int>(m_Offline->bandwidth_limit() / k_MiB));
+        offline_row->addWidget(bandwidth_spin);
+        form->addLayout(offline_row);
+
+        // How well predictive prefetching is doing this session
+        auto prefetch = m_Offline->prefetch_stats();
+        if (prefetch.hits + prefetch.misses > 0) {
+            auto* prefetch_label = new QLabel(QString("Prefetch: %1% of %2 opens served locally, %3 fetched, %4 unused")
+                                                  .arg(qRound(prefetch.hit_rate() * 100))
+                                                  .arg(prefetch.hits + prefetch.misses)
+                                                  .arg(QLocale().formattedDataSize(prefetch.bytes_fetched))
+                                                  .arg(QLocale().formattedDataSize(prefetch.bytes_wasted)),
+                                              &dialog);
+            prefetch_label->setStyleSheet("color: #8888aa; font-size: 12px;");
+            form->addWidget(prefetch_label);
+        }
+
+        // LAN peer sharing
+        auto* peer_check = new QCheckBox("Share downloads with clients on this network", &dialog);
+        peer_check->setChecked(m_Peers->is_running());
+        peer_check->setToolTip("Downloads try other clients on the LAN first; every copy is checked against its hash");
+        form->addWidget(peer_check);
+        auto* peer_offline_check = new QCheckBox("Also share files kept offline", &dialog);
+        peer_offline_check->setChecked(settings.value("peerShareOffline", false).toBool());
+        peer_offline_check->setToolTip("Only clients signed in to the same account can fetch anything");
+        form->addWidget(peer_offline_check);
+        auto peers = m_Peers->stats();
+        if (peers.hits + peers.misses > 0 || peers.bytes_served > 0) {
+            auto* peer_label = new QLabel(QString("Peers: %1 of %2 downloads, %3 not fetched from the server, %4 sent to others")
+                                              .arg(peers.hits)
+                                              .arg(peers.hits + peers.misses)
+                                              .arg(QLocale().formattedDataSize(peers.bytes_from_peers))
+                                              .arg(QLocale().formattedDataSize(peers.bytes_served)),
+                                          &dialog);
+            peer_label->setStyleSheet("color: #8888aa; font-size: 12px;");
+            form->addWidget(peer_label);
+        }
+
+        // Loopback WebDAV
+        auto* webdav_check = new QCheckBox("Open Drive files from other apps (WebDAV)", &dialog);
+        webdav_check->setChecked(settings.value("webdav", false).toBool());
+        webdav_check->setToolTip("Serves the Drive to this computer only; files are fetched as apps read them. "
+                                 "Not available while files are encrypted before upload");
+        form->addWidget(webdav_check);
+        if (m_WebDav->is_running()) {
+            auto cache = m_WebDav->cache()->stats();
+            qint64 reads = cache.hits + cache.misses;
+            auto* webdav_label = new QLabel(QString("Mount %1 as %2, password %3 (new every run)\n%4 fetched, %5% of block reads cached")
+                                                .arg(m_WebDav->url(), m_WebDav->user(), m_WebDav->password())
+                                                .arg(QLocale().formattedDataSize(cache.bytes_fetched))
+                                                .arg(reads > 0 ? qRound(100.0 * cache.hits / reads) : 0),
+                                            &dialog);
+            webdav_label->setTextInteractionFlags(Qt::TextSelectableByMouse);
+            webdav_label->setStyleSheet("color: #8888aa; font-size: 12px;");
+            form->addWidget(webdav_label);
+        }
+
+        // Backup
+        auto* backup_btn = new QPushButton(m_Backup ? "Cancel backup" : "Export backup...", &dialog);
+        backup_btn->setObjectName("secondary_button");
+        backup_btn->setCursor(Qt::PointingHandCursor);
+        connect(backup_btn, &QPushButton::clicked, [&]() {
+            dialog.reject();
+            if (m_Backup) {
+                m_Backup->abort();
+            } else {
+                // After the settings dialog has closed
+                QMetaObject::invokeMethod(this, &MainWindow::export_backup, Qt::QueuedConnection);
+            }
+        });
+        form->addWidget(backup_btn);
+
+        // Import
+        auto* import_row = new QHBoxLayout();
+        import_row->setSpacing(8);
+        if (m_Import) {
+            auto* cancel_import_btn = new QPushButton("Cancel import", &dialog);
+            cancel_import_btn->setObjectName("secondary_button");
+            cancel_import_btn->setCursor(Qt::PointingHandCursor);
+            connect(cancel_import_btn, &QPushButton::clicked, [&]() {
+                dialog.reject();
+                m_Import->abort();
+            });
+            import_row->addWidget(cancel_import_btn);
+        } else {
+            auto* import_notes_btn = new QPushButton("Import notes...", &dialog);
+            import_notes_btn->setObjectName("secondary_button");
+            import_notes_btn->setCursor(Qt::PointingHandCursor);
+            connect(import_notes_btn, &QPushButton::clicked, [&]() {
+                dialog.reject();
+                QMetaObject::invokeMethod(this, [this]() { start_import(Importer::Source::MarkdownFolder); }, Qt::QueuedConnection);
+            });
+            import_row->addWidget(import_notes_btn);
+
+            auto* restore_btn = new QPushButton("Restore backup...", &dialog);
+            restore_btn->setObjectName("secondary_button");
+            restore_btn->setCursor(Qt::PointingHandCursor);
+            connect(restore_btn, &QPushButton::clicked, [&]() {
+                dialog.reject();
+                QMetaObject::invokeMethod(this, [this]() { start_import(Importer::Source::BackupArchive); }, Qt::QueuedConnection);
+            });
+            import_row->addWidget(restore_btn);
+        }
+        form->addLayout(import_row);
+
+        // Folder sync
+        auto* sync_btn = new QPushButton(m_FolderSync ? "Stop syncing " + QDir(m_FolderSync->local_root()).dirName() : "Sync a folder...", &dialog);
+        sync_btn->setObjectName("secondary_button");
+        sync_btn->setCursor(Qt::PointingHandCursor);
+        connect(sync_btn, &QPushButton::clicked, [&]() {
+            dialog.reject();
+            if (m_FolderSync) {
+                QSettings("SapCloud", "Client").remove("syncFolder");
+                m_FolderSync->deleteLater();
+                statusBar()->showMessage("Folder sync stopped", 3000);
+            } else {
+                QMetaObject::invokeMethod(this, &MainWindow::choose_sync_folder, Qt::QueuedConnection);
+            }
+        });
+        form->addWidget(sync_btn);
+
         layout->addLayout(form);
         layout->addStretch();
 
@@ -277,19 +445,140 @@ namespace sap::client {
             QString ssh_path = ssh_input->text().trimmed();
 
             if (!url.isEmpty()) {
+                if (url != m_Api->server_url())
+                    m_Peers->set_account_key({});
                 settings.setValue("serverUrl", url);
                 m_Api->set_server_url(url);
             }
 
             settings.setValue("sshKeyPath", ssh_path);
 
+            m_Offline->set_disk_limit(disk_spin->value() * k_MiB);
+            m_Offline->set_bandwidth_limit(bandwidth_spin->value() * k_MiB);
+            settings.setValue("offlineDiskLimit", m_Offline->disk_limit());
+            settings.setValue("offlineBandwidthLimit", m_Offline->bandwidth_limit());
+
             // Use statusBar instead of QMessageBox to avoid Android OpenGL deadlock
-            statusBar()->showMessage("Settings saved successfully", 3000);
+            if (m_Transfers->set_encryption(encrypt_check->isChecked())) {
+                settings.setValue("encryptUploads", encrypt_check->isChecked());
+                statusBar()->showMessage("Settings saved successfully", 3000);
+            } else {
+                statusBar()->showMessage("Could not enable encryption: " + m_Transfers->encryption_error(), 5000);
+            }
+
+            settings.setValue("peerShareOffline", peer_offline_check->isChecked());
+            if (peer_offline_check->isChecked())
+                m_Peers->add_source(&m_Offline->content_store());
+            else
+                m_Peers->remove_source(&m_Offline->content_store());
+            if (peer_check->isChecked() != m_Peers->is_running()) {
+                if (set_peer_sharing(peer_check->isChecked()))
+                    settings.setValue("peerCache", peer_check->isChecked());
+                else
+                    statusBar()->showMessage("Could not share with peers: " + m_Peers->last_error(), 5000);
+            }
+
+            settings.setValue("webdav", webdav_check->isChecked());
+            if (!webdav_check->isChecked()) {
+                m_WebDav->stop();
+            } else if (m_Transfers->encryption_enabled()) {
+                m_WebDav->stop();
+                statusBar()->showMessage("WebDAV is off while files are encrypted before upload", 5000);
+            } else if (!m_WebDav->is_running() && m_Api->is_authenticated()) {
+                start_webdav();
+                if (!m_WebDav->is_running())
+                    statusBar()->showMessage("Could not start WebDAV: " + m_WebDav->last_error(), 5000);
+            }
         }
 
         update_nav_state();
     }
 
+    void MainWindow::export_backup() {
+        QString name = "sapcloud-backup-" + QDate::currentDate().toString("yyyyMMdd") + ".tar";
+        QString path = QFileDialog::getSaveFileName(this, "Export Backup", QDir::homePath() + "/" + name, "Tar archives (*.tar)");
+        if (path.isEmpty())
+            return;
+
+        m_Backup = new BackupExporter(m_Api, path, this);
+        connect(m_Backup, &BackupExporter::progress, this, [this](qint64 bytes_done, qint64 bytes_total, int done, int total) {
+            QLocale locale;
+            statusBar()->showMessage(QString("Backing up %1 of %2 · %3 of %4")
+                                         .arg(done)
+                                         .arg(total)
+                                         .arg(locale.formattedDataSize(bytes_done))
+                                         .arg(locale.formattedDataSize(bytes_total)));
+        });
+        connect(m_Backup, &BackupExporter::finished, this, [this, path](bool ok, const QStringList& errors) {
+            m_Backup->deleteLater();
+            if (!ok) {
+                statusBar()->showMessage("Backup failed: " + errors.value(errors.size() - 1), 8000);
+            } else if (!errors.isEmpty()) {
+                statusBar()->showMessage(QString("Backup saved to %1, %2 entries failed (see BACKUP_ERRORS.txt)").arg(path).arg(errors.size()), 8000);
+            } else {
+                statusBar()->showMessage("Backup saved to " + path, 5000);
+            }
+        });
+        m_Backup->start();
+    }
+
+    void MainWindow::start_import(Importer::Source source) {
+        QString path = source == Importer::Source::MarkdownFolder
+            ? QFileDialog::getExistingDirectory(this, "Import Markdown Notes", QDir::homePath())
+            : QFileDialog::getOpenFileName(this, "Restore Backup", QDir::homePath(), "Tar archives (*.tar)");
+        if (path.isEmpty())
+            return;
+
+        m_Import = new Importer(m_Api, source, path, this);
+        connect(m_Import, &Importer::progress, this, [this](int done, int failed, int total, double items_per_sec) {
+            QString text = total >= 0 ? QString("Importing %1 of %2").arg(done).arg(total) : QString("Importing %1").arg(done);
+            if (failed > 0)
+                text += QString(" · %1 failed").arg(failed);
+            text += QString(" · %1 items/s").arg(items_per_sec, 0, 'f', 1);
+            statusBar()->showMessage(text);
+        });
+        connect(m_Import, &Importer::finished, this, [this](bool ok, int imported, int skipped, int failed) {
+            m_Import->deleteLater();
+            QString text = QString("Import %1: %2 imported").arg(ok ? "complete" : "stopped").arg(imported);
+            if (skipped > 0)
+                text += QString(", %1 already done").arg(skipped);
+            if (failed > 0)
+                text += QString(", %1 failed (run it again to retry)").arg(failed);
+            statusBar()->showMessage(text, 8000);
+            if (imported > 0) {
+                m_Notes->refresh();
+                m_Drive->refresh();
+            }
+        });
+        m_Import->start();
+    }
+
+    void MainWindow::choose_sync_folder() {
+        QString dir = QFileDialog::getExistingDirectory(this, "Select Folder to Sync");
+        if (dir.isEmpty())
+            return;
+        QSettings("SapCloud", "Client").setValue("syncFolder", dir);
+        if (m_Api->is_authenticated())
+            start_folder_sync();
+        else
+            statusBar()->showMessage("Folder sync starts after signing in", 5000);
+    }
+
+    void MainWindow::start_folder_sync() {
+        QString dir = QSettings("SapCloud", "Client").value("syncFolder").toString();
+        if (dir.isEmpty() || m_FolderSync)
+            return;
+
+        // The folder maps to a top-level remote folder of the same name
+        m_FolderSync = new FolderSync(m_Api, m_Transfers, m_Sync, dir, QDir(dir).dirName() + '/', this);
+        if (!m_FolderSync->start()) {
+            statusBar()->showMessage("Folder sync unavailable: " + m_FolderSync->last_error(), 8000);
+            m_FolderSync->deleteLater();
+            return;
+        }
+        statusBar()->showMessage("Syncing " + dir, 3000);
+    }
+
     void MainWindow::authenticate() {
         QSettings settings("SapCloud", "Client");
         QString ssh_private_key_path = settings.value("sshKeyPath").toString();
@@ -336,8 +625,47 @@ namespace sap::client {
         });
     }
 
+    bool MainWindow::set_peer_sharing(bool enabled) {
+        if (!enabled) {
+            m_Transfers->set_peer_cache(nullptr);
+            m_Peers->stop();
+            return true;
+        }
+        if (!m_Peers->start())
+            return false;
+        m_Transfers->set_peer_cache(m_Peers);
+        if (m_Api->is_authenticated())
+            fetch_peer_key();
+        return true;
+    }
+
+    void MainWindow::fetch_peer_key() {
+        m_Api->get_peer_key([this](bool ok, QByteArray key) {
+            if (ok)
+                m_Peers->set_account_key(key);
+            else
+                qWarning() << "No peer key for this account; LAN sharing stays idle";
+        });
+    }
+
+    void MainWindow::start_webdav() {
+        QSettings settings("SapCloud", "Client");
+        if (!settings.value("webdav", false).toBool() || m_WebDav->is_running())
+            return;
+        if (!m_WebDav->start(static_cast<quint16>(settings.value("webdavPort", WebDavServer::k_DefaultPort).toUInt())))
+            qWarning() << "WebDAV endpoint unavailable:" << m_WebDav->last_error();
+    }
+
     void MainWindow::on_authenticated() {
         statusBar()->showMessage("Authenticated successfully", 3000);
+        // Pick up whatever was still in flight when the app last stopped
+        m_Transfers->resume_pending();
+        m_Sync->start();
+        m_Offline->start();
+        if (m_Peers->is_running())
+            fetch_peer_key();
+        start_folder_sync();
+        start_webdav();
         for (auto it = m_PostAuthenticationQueue.rbegin(); it != m_PostAuthenticationQueue.rend(); ++it) {
             (*it)();
         }
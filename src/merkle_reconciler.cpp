@@ -0,0 +1,91 @@
+#include "sap_cloud_client/merkle_reconciler.h"
+#include <QHash>
+#include <QPointer>
+#include "sap_cloud_client/api_client.h"
+#include "sap_cloud_client/merkle_tree.h"
+
+namespace sap::client {
+
+    MerkleReconciler::MerkleReconciler(ApiClient* api, const MerkleTree* tree, QObject* parent) :
+        QObject(parent), m_Api(api), m_Tree(tree) {}
+
+    void MerkleReconciler::start() {
+        // The root digest alone settles the common case
+        m_Requests++;
+        m_InFlight++;
+        QPointer<MerkleReconciler> self(this);
+        m_Api->get_merkle_node({}, false, [self](bool ok, MerkleNode node) {
+            if (!self || self->m_Done)
+                return;
+            self->m_InFlight--;
+            if (!ok) {
+                self->complete(false);
+                return;
+            }
+            if (node.hash == self->m_Tree->digest()) {
+                self->complete(true);
+                return;
+            }
+            self->m_Queue.append(QString());
+            self->pump();
+        });
+    }
+
+    void MerkleReconciler::abort() { m_Done = true; }
+
+    void MerkleReconciler::pump() {
+        while (!m_Done && m_InFlight < k_MaxInFlight && !m_Queue.isEmpty()) {
+            QString dir = m_Queue.takeFirst();
+            m_Requests++;
+            m_InFlight++;
+            QPointer<MerkleReconciler> self(this);
+            m_Api->get_merkle_node(dir, true, [self, dir](bool ok, MerkleNode node) {
+                if (self && !self->m_Done)
+                    self->on_node(dir, ok, node);
+            });
+        }
+        if (!m_Done && m_InFlight == 0 && m_Queue.isEmpty())
+            complete(true);
+    }
+
+    void MerkleReconciler::on_node(const QString& dir, bool ok, const MerkleNode& node) {
+        m_InFlight--;
+        if (!ok) {
+            complete(false);
+            return;
+        }
+
+        QHash<QString, MerkleEntry> local;
+        for (const auto& e : m_Tree->children(dir))
+            local.insert(e.is_dir ? e.name + '/' : e.name, e);
+
+        for (const auto& remote : node.children) {
+            QString key = remote.is_dir ? remote.name + '/' : remote.name;
+            auto it = local.find(key);
+            if (it == local.end()) {
+                m_Differing.append(dir + key);
+                continue;
+            }
+            if (it->hash != remote.hash) {
+                if (remote.is_dir)
+                    m_Queue.append(dir + key);
+                else
+                    m_Differing.append(dir + key);
+            }
+            local.erase(it);
+        }
+        // Whatever is left exists only locally
+        for (auto it = local.constBegin(); it != local.constEnd(); ++it)
+            m_Differing.append(dir + it.key());
+
+        pump();
+    }
+
+    void MerkleReconciler::complete(bool ok) {
+        if (m_Done)
+            return;
+        m_Done = true;
+        emit finished(ok, m_Differing);
+    }
+
+} // namespace sap::client
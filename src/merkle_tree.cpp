@@ -0,0 +1,129 @@
+#include "sap_cloud_client/merkle_tree.h"
+#include <QCryptographicHash>
+
+namespace sap::client {
+
+    namespace {
+
+        QString hex_sha256(const QByteArray& data) {
+            return QString::fromLatin1(QCryptographicHash::hash(data, QCryptographicHash::Sha256).toHex());
+        }
+
+        QString file_entry_digest(const QString& name, const QString& content_hash) {
+            QByteArray data("f", 2); // tag plus its NUL
+            data += name.toUtf8();
+            data += '\0';
+            data += content_hash.toLatin1();
+            return hex_sha256(data);
+        }
+
+    } // anonymous namespace
+
+    void MerkleTree::clear() { m_Dirs.clear(); }
+
+    QString MerkleTree::parent_of(const QString& dir) {
+        // "a/b/" -> "a/", "a/" -> ""
+        int slash = dir.lastIndexOf('/', dir.size() - 2);
+        return slash < 0 ? QString() : dir.left(slash + 1);
+    }
+
+    void MerkleTree::mark_stale(QString dir) {
+        for (;;) {
+            auto it = m_Dirs.find(dir);
+            if (it != m_Dirs.end())
+                it->stale = true;
+            if (dir.isEmpty())
+                return;
+            dir = parent_of(dir);
+        }
+    }
+
+    void MerkleTree::insert(const QString& path, const QString& content_hash) {
+        int slash = path.lastIndexOf('/');
+        QString dir = path.left(slash + 1);
+        QString name = path.mid(slash + 1);
+
+        m_Dirs[dir].files.insert(name, file_entry_digest(name, content_hash));
+        // Link each new directory into its parent up to the first one that already existed
+        for (QString child = dir; !child.isEmpty();) {
+            QString parent = parent_of(child);
+            QString child_name = child.mid(parent.size(), child.size() - parent.size() - 1);
+            Dir& p = m_Dirs[parent];
+            if (p.subdirs.contains(child_name))
+                break;
+            p.subdirs.insert(child_name);
+            child = parent;
+        }
+        mark_stale(dir);
+    }
+
+    void MerkleTree::remove(const QString& path) {
+        int slash = path.lastIndexOf('/');
+        QString dir = path.left(slash + 1);
+        auto it = m_Dirs.find(dir);
+        if (it == m_Dirs.end() || it->files.remove(path.mid(slash + 1)) == 0)
+            return;
+
+        // Drop directories the removal emptied; the root always stays
+        while (!dir.isEmpty()) {
+            auto d = m_Dirs.find(dir);
+            if (d == m_Dirs.end() || !d->files.isEmpty() || !d->subdirs.isEmpty())
+                break;
+            m_Dirs.erase(d);
+            QString parent = parent_of(dir);
+            m_Dirs[parent].subdirs.remove(dir.mid(parent.size(), dir.size() - parent.size() - 1));
+            dir = parent;
+        }
+        mark_stale(dir);
+    }
+
+    QString MerkleTree::digest(const QString& dir) const {
+        auto it = m_Dirs.constFind(dir);
+        if (it == m_Dirs.constEnd())
+            return dir.isEmpty() ? hex_sha256(QByteArray("d", 2)) : QString();
+        if (!it->stale)
+            return it->digest;
+
+        QMap<QString, QString> lines;
+        for (auto f = it->files.constBegin(); f != it->files.constEnd(); ++f)
+            lines.insert(f.key(), f.value());
+        for (const auto& name : it->subdirs)
+            lines.insert(name + '/', digest(dir + name + '/'));
+
+        QByteArray data("d", 2);
+        for (auto l = lines.constBegin(); l != lines.constEnd(); ++l) {
+            data += l.key().toUtf8();
+            data += '\0';
+            data += l.value().toLatin1();
+            data += '\n';
+        }
+        it->digest = hex_sha256(data);
+        it->stale = false;
+        return it->digest;
+    }
+
+    QVector<MerkleEntry> MerkleTree::children(const QString& dir) const {
+        QVector<MerkleEntry> entries;
+        auto it = m_Dirs.constFind(dir);
+        if (it == m_Dirs.constEnd())
+            return entries;
+        for (auto f = it->files.constBegin(); f != it->files.constEnd(); ++f)
+            entries.append({f.key(), f.value(), false});
+        for (const auto& name : it->subdirs)
+            entries.append({name, digest(dir + name + '/'), true});
+        return entries;
+    }
+
+    QStringList MerkleTree::files_under(const QString& dir) const {
+        QStringList paths;
+        auto it = m_Dirs.constFind(dir);
+        if (it == m_Dirs.constEnd())
+            return paths;
+        for (auto f = it->files.constBegin(); f != it->files.constEnd(); ++f)
+            paths.append(dir + f.key());
+        for (const auto& name : it->subdirs)
+            paths.append(files_under(dir + name + '/'));
+        return paths;
+    }
+
+} // namespace sap::client
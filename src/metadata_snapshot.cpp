@@ -0,0 +1,191 @@
+#include "sap_cloud_client/metadata_snapshot.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtEndian>
+#include <limits>
+
+namespace {
+
+    constexpr char k_Magic[4] = {'S', 'A', 'P', 'M'};
+    constexpr qint64 k_HeaderSize = 32;
+    constexpr qint64 k_FileRecordSize = 48;
+    constexpr qint64 k_TombstoneRecordSize = 16;
+    constexpr qint64 k_NoteRecordSize = 40;
+    // Joins a note's tags into one string; it can't be typed into a tag
+    constexpr char k_TagSeparator = '\x1f';
+
+    class Writer {
+    public:
+        template <typename T> void put(T v) {
+            qsizetype at = m_Records.size();
+            m_Records.resize(at + static_cast<qsizetype>(sizeof(T)));
+            qToLittleEndian<T>(v, m_Records.data() + at);
+        }
+
+        void put_string(const QString& s) {
+            QByteArray utf8 = s.toUtf8();
+            put<quint32>(static_cast<quint32>(m_Strings.size()));
+            put<quint32>(static_cast<quint32>(utf8.size()));
+            m_Strings += utf8;
+        }
+
+        const QByteArray& records() const { return m_Records; }
+        const QByteArray& strings() const { return m_Strings; }
+
+    private:
+        QByteArray m_Records;
+        QByteArray m_Strings;
+    };
+
+    // Walks the records of a mapped file; ok() turns false at the first ref outside the string table
+    class Reader {
+    public:
+        Reader(const char* records, const char* strings, qint64 string_bytes) :
+            m_Pos(records), m_Strings(strings), m_StringBytes(string_bytes) {}
+
+        template <typename T> T get() {
+            T v = qFromLittleEndian<T>(m_Pos);
+            m_Pos += sizeof(T);
+            return v;
+        }
+
+        QString get_string() {
+            qint64 offset = get<quint32>();
+            qint64 length = get<quint32>();
+            if (offset + length > m_StringBytes) {
+                m_Ok = false;
+                return {};
+            }
+            return QString::fromUtf8(m_Strings + offset, static_cast<qsizetype>(length));
+        }
+
+        bool ok() const { return m_Ok; }
+
+    private:
+        const char* m_Pos;
+        const char* m_Strings;
+        qint64 m_StringBytes;
+        bool m_Ok = true;
+    };
+
+} // anonymous namespace
+
+namespace sap::client {
+
+    QString MetadataSnapshot::path_for(const QString& kind, const QString& server_url) {
+        QByteArray key = QCryptographicHash::hash(server_url.toUtf8(), QCryptographicHash::Sha1).toHex();
+        return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/" + kind + "/" + key + ".snap";
+    }
+
+    std::optional<MetadataSnapshot> MetadataSnapshot::read(const QString& path) {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly))
+            return std::nullopt;
+        qint64 size = file.size();
+        if (size < k_HeaderSize)
+            return std::nullopt;
+
+        // Filesystems without mmap get a plain read
+        QByteArray fallback;
+        const char* data = reinterpret_cast<const char*>(file.map(0, size));
+        if (!data) {
+            fallback = file.readAll();
+            if (fallback.size() != size)
+                return std::nullopt;
+            data = fallback.constData();
+        }
+
+        if (QByteArrayView(data, 4) != QByteArrayView(k_Magic, 4) || qFromLittleEndian<quint32>(data + 4) != k_Version)
+            return std::nullopt;
+        MetadataSnapshot snapshot;
+        snapshot.cursor = qFromLittleEndian<qint64>(data + 8);
+        qint64 file_count = qFromLittleEndian<quint32>(data + 16);
+        qint64 tombstone_count = qFromLittleEndian<quint32>(data + 20);
+        qint64 note_count = qFromLittleEndian<quint32>(data + 24);
+        qint64 string_bytes = qFromLittleEndian<quint32>(data + 28);
+        qint64 records_size = file_count * k_FileRecordSize + tombstone_count * k_TombstoneRecordSize + note_count * k_NoteRecordSize;
+        if (k_HeaderSize + records_size + string_bytes != size)
+            return std::nullopt;
+
+        Reader reader(data + k_HeaderSize, data + k_HeaderSize + records_size, string_bytes);
+        snapshot.files.reserve(file_count);
+        for (qint64 i = 0; i < file_count; ++i) {
+            FileInfo f;
+            f.path = reader.get_string();
+            f.hash = reader.get_string();
+            f.size = reader.get<qint64>();
+            f.mtime = reader.get<qint64>();
+            f.created_at = reader.get<qint64>();
+            f.updated_at = reader.get<qint64>();
+            snapshot.files.append(std::move(f));
+        }
+        snapshot.tombstones.reserve(tombstone_count);
+        for (qint64 i = 0; i < tombstone_count; ++i) {
+            QString tomb_path = reader.get_string();
+            snapshot.tombstones.append({tomb_path, reader.get<qint64>()});
+        }
+        snapshot.notes.reserve(note_count);
+        for (qint64 i = 0; i < note_count; ++i) {
+            NoteItem n;
+            n.id = reader.get_string();
+            n.title = reader.get_string();
+            n.preview = reader.get_string();
+            QString tags = reader.get_string();
+            if (!tags.isEmpty())
+                n.tags = tags.split(QLatin1Char(k_TagSeparator));
+            n.updated_at = reader.get<qint64>();
+            snapshot.notes.append(std::move(n));
+        }
+        if (!reader.ok())
+            return std::nullopt;
+        return snapshot;
+    }
+
+    bool MetadataSnapshot::write(const QString& path) const {
+        Writer writer;
+        for (const auto& f : files) {
+            writer.put_string(f.path);
+            writer.put_string(f.hash);
+            writer.put<qint64>(f.size);
+            writer.put<qint64>(f.mtime);
+            writer.put<qint64>(f.created_at);
+            writer.put<qint64>(f.updated_at);
+        }
+        for (const auto& [tomb_path, time] : tombstones) {
+            writer.put_string(tomb_path);
+            writer.put<qint64>(time);
+        }
+        for (const auto& n : notes) {
+            writer.put_string(n.id);
+            writer.put_string(n.title);
+            writer.put_string(n.preview);
+            writer.put_string(n.tags.join(QLatin1Char(k_TagSeparator)));
+            writer.put<qint64>(n.updated_at);
+        }
+        if (writer.strings().size() > std::numeric_limits<quint32>::max())
+            return false;
+
+        QByteArray header(k_Magic, 4);
+        header.resize(k_HeaderSize);
+        qToLittleEndian<quint32>(k_Version, header.data() + 4);
+        qToLittleEndian<qint64>(cursor, header.data() + 8);
+        qToLittleEndian<quint32>(static_cast<quint32>(files.size()), header.data() + 16);
+        qToLittleEndian<quint32>(static_cast<quint32>(tombstones.size()), header.data() + 20);
+        qToLittleEndian<quint32>(static_cast<quint32>(notes.size()), header.data() + 24);
+        qToLittleEndian<quint32>(static_cast<quint32>(writer.strings().size()), header.data() + 28);
+
+        QDir().mkpath(QFileInfo(path).absolutePath());
+        QSaveFile file(path);
+        if (!file.open(QIODevice::WriteOnly))
+            return false;
+        file.write(header);
+        file.write(writer.records());
+        file.write(writer.strings());
+        return file.commit();
+    }
+
+} // namespace sap::client
@@ -1,17 +1,20 @@
 #include "sap_cloud_client/notes_screen.h"
 #include <QDateTime>
 #include <QHBoxLayout>
+#include <QInputDialog>
 #include <QKeySequence>
+#include <QMenu>
 #include <QMessageBox>
 #include <QRegularExpression>
 #include <QScrollBar>
 #include <QShortcut>
 #include <QVBoxLayout>
+#include "sap_cloud_client/metadata_snapshot.h"
 #include "sap_cloud_client/theme.h"
 
 namespace sap::client {
 
-    NotesScreen::NotesScreen(ApiClient* api, QWidget* parent) : QWidget(parent), m_Api(api) {
+    NotesScreen::NotesScreen(ApiClient* api, OfflineStore* offline, QWidget* parent) : QWidget(parent), m_Api(api), m_Offline(offline) {
         setup_ui();
 
         // Auto-save timer (saves 2 seconds after last edit)
@@ -28,6 +31,10 @@ namespace sap::client {
 
         auto* preview_shortcut = new QShortcut(QKeySequence(Qt::CTRL | Qt::Key_P), this);
         connect(preview_shortcut, &QShortcut::activated, this, &NotesScreen::on_toggle_preview);
+
+        // The last listing shows right away, before authentication; refresh() revalidates it
+        if (auto snapshot = MetadataSnapshot::read(MetadataSnapshot::path_for("notes", m_Api->server_url())))
+            show_notes(snapshot->notes);
     }
 
     void NotesScreen::setup_ui() {
@@ -85,7 +92,10 @@ namespace sap::client {
         m_List = new QListWidget(this);
         m_List->setVerticalScrollMode(QAbstractItemView::ScrollPerPixel);
         m_List->verticalScrollBar()->setSingleStep(15);
+        m_List->setSelectionMode(QAbstractItemView::ExtendedSelection);
+        m_List->setContextMenuPolicy(Qt::CustomContextMenu);
         connect(m_List, &QListWidget::itemClicked, this, &NotesScreen::on_note_clicked);
+        connect(m_List, &QListWidget::customContextMenuRequested, this, &NotesScreen::on_list_context_menu);
         sidebar_layout->addWidget(m_List, 1);
 
         // Collapse button
@@ -286,77 +296,104 @@ namespace sap::client {
     void NotesScreen::refresh() { load_notes(); }
 
     void NotesScreen::load_notes() {
-        m_Status->setText("Loading...");
+        if (m_Notes.isEmpty())
+            m_Status->setText("Loading...");
         m_Api->list_notes([this](bool ok, QVector<NoteItem> notes) {
-            if (!ok) {
+            if (ok) {
+                show_notes(notes);
+                MetadataSnapshot snapshot;
+                snapshot.notes = m_Notes;
+                snapshot.write(MetadataSnapshot::path_for("notes", m_Api->server_url()));
+                return;
+            }
+            // Offline: keep the listing from the snapshot, otherwise the pinned notes are still there
+            if (!m_Notes.isEmpty()) {
+                m_Status->setText(QString("Offline, %1 note%2").arg(m_Notes.size()).arg(m_Notes.size() != 1 ? "s" : ""));
+                return;
+            }
+            QVector<NoteItem> offline = m_Offline->offline_notes();
+            if (offline.isEmpty()) {
                 m_Status->setText("Failed to load notes");
                 return;
             }
+            show_notes(offline);
+            m_Status->setText(QString("Offline, %1 pinned note%2").arg(offline.size()).arg(offline.size() != 1 ? "s" : ""));
+        });
+    }
 
-            m_Notes = notes;
-            m_List->clear();
-
-            // Sort by updated_at descending
-            std::sort(m_Notes.begin(), m_Notes.end(), [](const NoteItem& a, const NoteItem& b) { return a.updated_at > b.updated_at; });
-
-            for (const auto& n : m_Notes) {
-                auto* item = new QListWidgetItem();
-
-                QString title = n.title.isEmpty() ? "Untitled" : n.title;
-                QString preview = n.preview.left(80).replace('\n', ' ');
-                if (preview.length() >= 80)
-                    preview += "...";
-
-                // Format date
-                QString date;
-                QDateTime dt = QDateTime::fromMSecsSinceEpoch(n.updated_at);
-                QDateTime now = QDateTime::currentDateTime();
-                if (dt.date() == now.date()) {
-                    date = dt.toString("h:mm AP");
-                } else if (dt.daysTo(now) < 7) {
-                    date = dt.toString("ddd");
-                } else {
-                    date = dt.toString("MMM d");
-                }
+    void NotesScreen::show_notes(const QVector<NoteItem>& notes) {
+        m_Notes = notes;
+        m_List->clear();
+
+        // Sort by updated_at descending
+        std::sort(m_Notes.begin(), m_Notes.end(), [](const NoteItem& a, const NoteItem& b) { return a.updated_at > b.updated_at; });
+
+        for (const auto& n : m_Notes) {
+            auto* item = new QListWidgetItem();
+
+            QString title = n.title.isEmpty() ? "Untitled" : n.title;
+            QString preview = n.preview.left(80).replace('\n', ' ');
+            if (preview.length() >= 80)
+                preview += "...";
+
+            // Format date
+            QString date;
+            QDateTime dt = QDateTime::fromMSecsSinceEpoch(n.updated_at);
+            QDateTime now = QDateTime::currentDateTime();
+            if (dt.date() == now.date()) {
+                date = dt.toString("h:mm AP");
+            } else if (dt.daysTo(now) < 7) {
+                date = dt.toString("ddd");
+            } else {
+                date = dt.toString("MMM d");
+            }
 
-                item->setText(title);
-                item->setData(Qt::UserRole, n.id);
-                item->setData(Qt::UserRole + 1, preview);
-                item->setData(Qt::UserRole + 2, date);
-                item->setToolTip(preview);
+            item->setText(title);
+            item->setData(Qt::UserRole, n.id);
+            item->setData(Qt::UserRole + 1, preview);
+            item->setData(Qt::UserRole + 2, date);
+            item->setToolTip(m_Offline->is_note_pinned(n.id) ? preview + "\n(available offline)" : preview);
 
-                m_List->addItem(item);
-            }
+            m_List->addItem(item);
+        }
 
-            m_Status->setText(QString("%1 note%2").arg(notes.size()).arg(notes.size() != 1 ? "s" : ""));
-        });
+        m_Status->setText(QString("%1 note%2").arg(notes.size()).arg(notes.size() != 1 ? "s" : ""));
     }
 
     void NotesScreen::load_note(const QString& id) {
+        // Pinned or prefetched notes open from their local copy without touching the network
+        if (auto offline = m_Offline->open_note(id)) {
+            show_note(id, *offline);
+            return;
+        }
+
         m_Status->setText("Loading...");
         m_Api->get_note(id, [this, id](bool ok, Note note) {
             if (!ok) {
                 m_Status->setText("Failed to load note");
                 return;
             }
+            show_note(id, note);
+        });
+    }
 
-            hide_empty_state();
+    void NotesScreen::show_note(const QString& id, const Note& note) {
+        hide_empty_state();
 
-            m_CurrentId = id;
-            m_Title->setText(note.title);
-            m_Editor->setPlainText(note.content);
-            m_Modified = false;
-            m_SaveBtn->setEnabled(false);
-            m_DeleteBtn->setEnabled(true);
+        m_CurrentId = id;
+        m_Title->setText(note.title);
+        m_Editor->setPlainText(note.content);
+        m_Modified = false;
+        m_SaveBtn->setEnabled(false);
+        m_DeleteBtn->setEnabled(true);
 
-            // Update preview if in preview mode
-            if (m_PreviewMode) {
-                m_Preview->setMarkdown(note.content);
-            }
+        // Update preview if in preview mode
+        if (m_PreviewMode) {
+            m_Preview->setMarkdown(note.content);
+        }
 
-            update_word_count();
-            m_Status->setText("Loaded");
-        });
+        update_word_count();
+        m_Status->setText("Loaded");
     }
 
     void NotesScreen::on_new_note() {
@@ -384,6 +421,12 @@ namespace sap::client {
     }
 
     void NotesScreen::on_delete_note() {
+        // With several notes selected in the sidebar the button deletes all of them
+        QStringList ids = selected_ids();
+        if (ids.size() > 1) {
+            delete_notes(ids);
+            return;
+        }
         if (m_CurrentId.isEmpty())
             return;
 
@@ -401,6 +444,7 @@ namespace sap::client {
         m_Status->setText("Deleting...");
         m_Api->delete_note(m_CurrentId, [this](bool ok) {
             if (ok) {
+                m_Offline->unpin_note(m_CurrentId);
                 clear_editor();
                 m_CurrentId.clear();
                 show_empty_state();
@@ -412,6 +456,129 @@ namespace sap::client {
         });
     }
 
+    QStringList NotesScreen::selected_ids() const {
+        QStringList ids;
+        for (auto* item : m_List->selectedItems())
+            ids.append(item->data(Qt::UserRole).toString());
+        return ids;
+    }
+
+    void NotesScreen::on_list_context_menu(const QPoint& pos) {
+        auto* item = m_List->itemAt(pos);
+        if (!item)
+            return;
+        if (!item->isSelected())
+            m_List->setCurrentItem(item);
+        QStringList ids = selected_ids();
+
+        QMenu menu(this);
+        menu.setStyleSheet(get_dark_stylesheet());
+
+        auto* add_tag_action = menu.addAction("Add tag...");
+        connect(add_tag_action, &QAction::triggered, this, [this, ids]() { edit_tags(ids, true); });
+
+        auto* remove_tag_action = menu.addAction("Remove tag...");
+        connect(remove_tag_action, &QAction::triggered, this, [this, ids]() { edit_tags(ids, false); });
+
+        bool pinned = m_Offline->is_note_pinned(ids.first());
+        auto* pin_action = menu.addAction(pinned ? "Remove offline copy" : "Make available offline");
+        connect(pin_action, &QAction::triggered, this, [this, ids]() { toggle_pins(ids); });
+
+        menu.addSeparator();
+
+        auto* delete_action = menu.addAction(ids.size() == 1 ? QString("Delete") : QString("Delete %1 notes").arg(ids.size()));
+        delete_action->setIcon(QIcon(":/icons/delete.svg"));
+        connect(delete_action, &QAction::triggered, this, [this, ids]() { delete_notes(ids); });
+
+        menu.exec(m_List->viewport()->mapToGlobal(pos));
+    }
+
+    void NotesScreen::delete_notes(const QStringList& ids) {
+        if (ids.isEmpty())
+            return;
+
+        QMessageBox msg(this);
+        msg.setWindowTitle("Delete Notes");
+        msg.setText(ids.size() == 1 ? QString("Are you sure you want to delete this note?")
+                                    : QString("Are you sure you want to delete %1 notes?").arg(ids.size()));
+        msg.setInformativeText("This action cannot be undone.");
+        msg.setStandardButtons(QMessageBox::Yes | QMessageBox::No);
+        msg.setDefaultButton(QMessageBox::No);
+        msg.setStyleSheet(get_dark_stylesheet());
+
+        if (msg.exec() != QMessageBox::Yes)
+            return;
+
+        QVector<BatchOp> ops;
+        for (const auto& id : ids)
+            ops.append({BatchOp::Kind::DeleteNote, id});
+
+        m_Status->setText("Deleting...");
+        m_Api->run_batch(ops, [this, ids](bool ok, QVector<BatchResult> results) {
+            int failed = 0;
+            for (int i = 0; i < results.size(); ++i) {
+                if (!results[i].ok) {
+                    failed++;
+                    continue;
+                }
+                m_Offline->unpin_note(ids[i]);
+                if (ids[i] == m_CurrentId) {
+                    clear_editor();
+                    m_CurrentId.clear();
+                    show_empty_state();
+                }
+            }
+            load_notes();
+            if (!ok || failed > 0)
+                m_Status->setText(QString("Deleted %1, %2 failed").arg(ids.size() - failed).arg(failed));
+            else
+                m_Status->setText("Deleted");
+        });
+    }
+
+    void NotesScreen::toggle_pins(const QStringList& ids) {
+        bool unpin = m_Offline->is_note_pinned(ids.first());
+        for (const auto& id : ids) {
+            if (unpin)
+                m_Offline->unpin_note(id);
+            else
+                m_Offline->pin_note(id);
+        }
+        // Refresh the markers without another round trip
+        show_notes(m_Notes);
+    }
+
+    void NotesScreen::edit_tags(const QStringList& ids, bool add) {
+        if (ids.isEmpty())
+            return;
+
+        bool accepted = false;
+        QString tag = QInputDialog::getText(this, add ? "Add Tag" : "Remove Tag", "Tag:", QLineEdit::Normal, {}, &accepted).trimmed();
+        if (!accepted || tag.isEmpty())
+            return;
+
+        QVector<BatchOp> ops;
+        for (const auto& id : ids) {
+            BatchOp op{BatchOp::Kind::TagNote, id};
+            (add ? op.add_tags : op.remove_tags).append(tag);
+            ops.append(op);
+        }
+
+        m_Status->setText("Updating tags...");
+        m_Api->run_batch(ops, [this, ids](bool ok, QVector<BatchResult> results) {
+            int failed = 0;
+            for (const auto& r : results) {
+                if (!r.ok)
+                    failed++;
+            }
+            load_notes();
+            if (!ok || failed > 0)
+                m_Status->setText(QString("Updated %1, %2 failed").arg(ids.size() - failed).arg(failed));
+            else
+                m_Status->setText("Tags updated");
+        });
+    }
+
     void NotesScreen::on_save_note() { save_current_note(); }
 
     void NotesScreen::on_auto_save() {
@@ -452,8 +619,11 @@ namespace sap::client {
                 }
             });
         } else {
-            m_Api->update_note(m_CurrentId, note, [this](bool ok, Note) {
+            m_Api->update_note(m_CurrentId, note, [this](bool ok, Note updated) {
                 if (ok) {
+                    if (updated.id.isEmpty())
+                        updated.id = m_CurrentId;
+                    m_Offline->store_note(updated);
                     m_Modified = false;
                     m_SaveBtn->setEnabled(false);
                     load_notes();
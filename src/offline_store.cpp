@@ -0,0 +1,622 @@
+#include "sap_cloud_client/offline_store.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QNetworkInformation>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <algorithm>
+#include <climits>
+#include "sap_cloud_client/download_verifier.h"
+
+namespace {
+
+    QString queue_key(bool note, const QString& key) { return (note ? "n:" : "f:") + key; }
+
+} // anonymous namespace
+
+namespace sap::client {
+
+    OfflineStore::OfflineStore(ApiClient* api, SyncEngine* sync, TransferScheduler* foreground, QObject* parent) :
+        QObject(parent), m_Api(api), m_Sync(sync), m_Foreground(foreground) {
+        m_PaceTimer.setSingleShot(true);
+        connect(&m_PaceTimer, &QTimer::timeout, this, &OfflineStore::pump);
+        m_NoteTimer.setInterval(k_NotePollMs);
+        connect(&m_NoteTimer, &QTimer::timeout, this, &OfflineStore::refresh_notes);
+        // The history changes on every open; writing it out can wait for a quiet moment
+        m_HistoryTimer.setSingleShot(true);
+        m_HistoryTimer.setInterval(k_HistorySaveDelayMs);
+        connect(&m_HistoryTimer, &QTimer::timeout, this, [this]() { m_Predictor.save(m_Dir + "/history.json"); });
+        connect(m_Sync, &SyncEngine::changed, this, &OfflineStore::on_sync_changed);
+        // User transfers go first; prefetching picks up again once they are done
+        connect(m_Foreground, &TransferScheduler::batch_finished, this, &OfflineStore::pump);
+        if (QNetworkInformation::loadDefaultBackend())
+            connect(QNetworkInformation::instance(), &QNetworkInformation::reachabilityChanged, this, &OfflineStore::pump);
+        load();
+    }
+
+    OfflineStore::~OfflineStore() {
+        if (m_HistoryTimer.isActive())
+            m_Predictor.save(m_Dir + "/history.json");
+    }
+
+    void OfflineStore::start() {
+        m_Running = true;
+        check_server();
+        queue_pinned_files({});
+        refresh_notes();
+        m_NoteTimer.start();
+        pump();
+    }
+
+    void OfflineStore::stop() {
+        m_Running = false;
+        ++m_Generation;
+        m_NoteTimer.stop();
+        m_PaceTimer.stop();
+        if (QNetworkReply* reply = m_Reply) {
+            m_Reply = nullptr;
+            reply->abort();
+        }
+        m_Busy = false;
+        m_Queue.clear();
+        m_Queued.clear();
+        m_Speculative.clear();
+    }
+
+    void OfflineStore::pin_path(const QString& path) {
+        if (path.isEmpty() || m_Paths.contains(path))
+            return;
+        m_Paths.insert(path);
+        save();
+        queue_pinned_files(path);
+        emit changed();
+        pump();
+    }
+
+    void OfflineStore::unpin_path(const QString& path) {
+        if (!m_Paths.remove(path))
+            return;
+        for (auto it = m_OverBudget.begin(); it != m_OverBudget.end();) {
+            if (is_pinned(*it))
+                ++it;
+            else
+                it = m_OverBudget.erase(it);
+        }
+        save();
+        // Queued fetches that lost their pin are skipped when they come up
+        m_GcPending = true;
+        if (!m_Busy && m_Queue.empty())
+            collect_garbage();
+        emit changed();
+    }
+
+    bool OfflineStore::is_pinned(const QString& path) const {
+        if (m_Paths.contains(path))
+            return true;
+        for (qsizetype i = path.indexOf('/'); i >= 0; i = path.indexOf('/', i + 1)) {
+            if (m_Paths.contains(path.left(i + 1)))
+                return true;
+        }
+        return false;
+    }
+
+    void OfflineStore::pin_note(const QString& id) {
+        if (id.isEmpty() || m_Notes.contains(id))
+            return;
+        m_Notes.insert(id, 0);
+        save();
+        enqueue({true, id});
+        emit changed();
+        pump();
+    }
+
+    void OfflineStore::unpin_note(const QString& id) {
+        if (!m_Notes.remove(id))
+            return;
+        QFile::remove(note_path(id));
+        save();
+        emit changed();
+    }
+
+    QString OfflineStore::local_copy(const QString& path) const {
+        if (!is_pinned(path))
+            return {};
+        auto f = m_Sync->file(path);
+        if (!f || !m_Store.contains(f->hash))
+            return {};
+        return m_Store.path(f->hash);
+    }
+
+    std::optional<Note> OfflineStore::note(const QString& id) const {
+        if (!m_Notes.contains(id))
+            return std::nullopt;
+        QFile file(note_path(id));
+        if (!file.open(QIODevice::ReadOnly))
+            return std::nullopt;
+        return Note::from_json(QJsonDocument::fromJson(file.readAll()).object());
+    }
+
+    QVector<NoteItem> OfflineStore::offline_notes() const {
+        QVector<NoteItem> items;
+        for (auto it = m_Notes.constBegin(); it != m_Notes.constEnd(); ++it) {
+            auto n = note(it.key());
+            if (!n)
+                continue;
+            NoteItem item;
+            item.id = n->id;
+            item.title = n->title;
+            item.tags = n->tags;
+            item.updated_at = n->updated_at;
+            item.preview = n->content.left(200);
+            items.append(item);
+        }
+        std::sort(items.begin(), items.end(), [](const NoteItem& a, const NoteItem& b) { return a.updated_at > b.updated_at; });
+        return items;
+    }
+
+    void OfflineStore::store_note(const Note& note) {
+        if (auto it = m_PrefetchedNotes.find(note.id); it != m_PrefetchedNotes.end())
+            *it = note;
+        if (!m_Notes.contains(note.id))
+            return;
+        QJsonObject obj = note.to_json();
+        obj["id"] = note.id;
+        obj["created_at"] = note.created_at;
+        obj["updated_at"] = note.updated_at;
+
+        QString path = note_path(note.id);
+        QDir().mkpath(QFileInfo(path).absolutePath());
+        QSaveFile file(path);
+        if (!file.open(QIODevice::WriteOnly) || file.write(QJsonDocument(obj).toJson(QJsonDocument::Compact)) < 0 || !file.commit()) {
+            qWarning() << "Cannot keep offline copy of note" << note.id << file.errorString();
+            return;
+        }
+        m_Notes[note.id] = note.updated_at;
+        save();
+        emit changed();
+    }
+
+    std::optional<Note> OfflineStore::open_note(const QString& id) {
+        QString key = queue_key(true, id);
+        std::optional<Note> found = note(id);
+        if (!found) {
+            auto cached = m_PrefetchedNotes.constFind(id);
+            Prefetched* entry = cached != m_PrefetchedNotes.constEnd() ? use_prefetched(key) : nullptr;
+            if (entry && QDateTime::currentMSecsSinceEpoch() - entry->at <= k_PrefetchedNoteTtlMs) {
+                found = *cached;
+                m_PrefetchStats.hits++;
+            } else {
+                m_PrefetchStats.misses++;
+            }
+        }
+        record_open(key);
+        return found;
+    }
+
+    QString OfflineStore::open_file(const QString& path) {
+        QString key = queue_key(false, path);
+        QString found = local_copy(path);
+        if (found.isEmpty()) {
+            // The blob only counts if it still is what the index has for the path
+            auto f = m_Sync->file(path);
+            Prefetched* entry = use_prefetched(key);
+            if (f && entry && entry->hash.compare(f->hash, Qt::CaseInsensitive) == 0 && m_Store.contains(f->hash)) {
+                found = m_Store.path(f->hash);
+                m_PrefetchStats.hits++;
+            } else {
+                m_PrefetchStats.misses++;
+            }
+        }
+        record_open(key);
+        return found;
+    }
+
+    void OfflineStore::set_prefetch_limit(qint64 bytes) {
+        m_PrefetchLimit = qMax<qint64>(0, bytes);
+        if (m_PrefetchLimit == 0)
+            m_Speculative.clear();
+        evict_prefetched();
+    }
+
+    void OfflineStore::record_open(const QString& key) {
+        m_Predictor.record(key, QDateTime::currentMSecsSinceEpoch());
+        m_HistoryTimer.start();
+        if (m_PrefetchLimit == 0)
+            return;
+
+        // Predictions for the previous open are stale now
+        m_Speculative.clear();
+        for (const auto& p : m_Predictor.predict(key, k_PrefetchFanout)) {
+            if (p.probability < k_MinProbability)
+                break;
+            bool note = p.key.startsWith("n:");
+            QString id = p.key.mid(2);
+            if (note ? m_Notes.contains(id) || m_PrefetchedNotes.contains(id) : is_pinned(id))
+                continue;
+            m_Speculative.push_back({note, id, true});
+        }
+        pump();
+    }
+
+    OfflineStore::Prefetched* OfflineStore::use_prefetched(const QString& key) {
+        auto it = std::find_if(m_Prefetched.begin(), m_Prefetched.end(), [&key](const Prefetched& e) { return e.key == key; });
+        if (it == m_Prefetched.end())
+            return nullptr;
+        Prefetched entry = *it;
+        entry.used = true;
+        m_Prefetched.erase(it);
+        m_Prefetched.push_back(entry);
+        return &m_Prefetched.back();
+    }
+
+    void OfflineStore::add_prefetched(const Prefetched& entry) {
+        m_Prefetched.push_back(entry);
+        m_PrefetchBytes += entry.bytes;
+        if (!entry.hash.isEmpty())
+            m_PrefetchFileBytes += entry.bytes;
+        m_PrefetchStats.fetched++;
+        m_PrefetchStats.bytes_fetched += entry.bytes;
+        evict_prefetched();
+    }
+
+    void OfflineStore::evict_prefetched() {
+        while (!m_Prefetched.empty() && m_PrefetchBytes > m_PrefetchLimit) {
+            const Prefetched& e = m_Prefetched.front();
+            if (!e.used)
+                m_PrefetchStats.bytes_wasted += e.bytes;
+            m_PrefetchBytes -= e.bytes;
+            if (e.hash.isEmpty()) {
+                m_PrefetchedNotes.remove(e.key.mid(2));
+            } else {
+                m_PrefetchFileBytes -= e.bytes;
+                m_GcPending = true;
+            }
+            m_Prefetched.pop_front();
+        }
+    }
+
+    void OfflineStore::drop_prefetch_cache() {
+        for (const auto& e : m_Prefetched) {
+            if (!e.used)
+                m_PrefetchStats.bytes_wasted += e.bytes;
+        }
+        m_Prefetched.clear();
+        m_PrefetchedNotes.clear();
+        m_PrefetchBytes = 0;
+        m_PrefetchFileBytes = 0;
+        m_Speculative.clear();
+    }
+
+    void OfflineStore::set_disk_limit(qint64 bytes) {
+        m_DiskLimit = qMax<qint64>(0, bytes);
+        // Whatever was skipped for lack of room gets another look
+        for (const auto& path : std::as_const(m_OverBudget))
+            enqueue({false, path});
+        pump();
+    }
+
+    void OfflineStore::set_bandwidth_limit(qint64 bytes_per_sec) { m_BandwidthLimit = qMax<qint64>(0, bytes_per_sec); }
+
+    void OfflineStore::on_sync_changed(const QStringList& updated, const QStringList& removed) {
+        check_server();
+        if (m_Paths.isEmpty())
+            return;
+        for (const auto& path : updated) {
+            if (is_pinned(path))
+                enqueue({false, path});
+        }
+        if (!removed.isEmpty())
+            m_GcPending = true;
+        pump();
+    }
+
+    void OfflineStore::queue_pinned_files(const QString& pin) {
+        // A file pin stands for itself; a prefix, or all pins at once, takes a pass over the index
+        if (!pin.isEmpty() && !pin.endsWith('/')) {
+            enqueue({false, pin});
+            return;
+        }
+        if (m_Paths.isEmpty())
+            return;
+        const auto& files = m_Sync->files();
+        for (auto it = files.constBegin(); it != files.constEnd(); ++it) {
+            if (pin.isEmpty() ? is_pinned(it.key()) : it.key().startsWith(pin))
+                enqueue({false, it.key()});
+        }
+    }
+
+    void OfflineStore::refresh_notes() {
+        if (!m_Running || m_Notes.isEmpty() || !network_ready())
+            return;
+        quint64 generation = m_Generation;
+        m_Api->list_notes([this, generation](bool ok, QVector<NoteItem> notes) {
+            if (!ok || generation != m_Generation)
+                return;
+            QHash<QString, Timestamp> listed;
+            for (const auto& n : notes)
+                listed.insert(n.id, n.updated_at);
+
+            bool dropped = false;
+            for (auto it = m_Notes.begin(); it != m_Notes.end();) {
+                auto found = listed.constFind(it.key());
+                if (found == listed.constEnd()) {
+                    // Deleted on the server; the pin goes with it
+                    QFile::remove(note_path(it.key()));
+                    it = m_Notes.erase(it);
+                    dropped = true;
+                    continue;
+                }
+                if (*found > it.value() || it.value() == 0)
+                    enqueue({true, it.key()});
+                ++it;
+            }
+            if (dropped) {
+                save();
+                emit changed();
+            }
+            pump();
+        });
+    }
+
+    void OfflineStore::enqueue(const Item& item) {
+        QString key = queue_key(item.note, item.key);
+        if (m_Queued.contains(key))
+            return;
+        m_Queued.insert(key);
+        m_Queue.push_back(item);
+    }
+
+    void OfflineStore::pump() {
+        if (!m_Running || m_Busy || m_PaceTimer.isActive())
+            return;
+        if (m_Queue.empty() && m_Speculative.empty()) {
+            if (m_GcPending)
+                collect_garbage();
+            return;
+        }
+        // batch_finished and reachabilityChanged call back in once these clear
+        if (!m_Foreground->is_idle() || !network_ready())
+            return;
+
+        // Pinned work first; guesses only fill the idle time after it
+        Item item;
+        if (!m_Queue.empty()) {
+            item = m_Queue.front();
+            m_Queue.pop_front();
+            m_Queued.remove(queue_key(item.note, item.key));
+        } else {
+            item = m_Speculative.front();
+            m_Speculative.pop_front();
+        }
+        if (item.note)
+            fetch_note(item);
+        else
+            fetch_file(item);
+    }
+
+    void OfflineStore::fetch_file(const Item& item) {
+        const QString& path = item.key;
+        auto f = m_Sync->file(path);
+        bool wanted = item.speculative ? !is_pinned(path) : is_pinned(path);
+        if (!f || f->hash.isEmpty() || !wanted || m_Store.contains(f->hash)) {
+            if (!item.speculative)
+                m_OverBudget.remove(path);
+            fetch_done(item, true, 0);
+            return;
+        }
+        if (item.speculative) {
+            // Worth it only if it doesn't push most of the cache out
+            if (f->size > m_PrefetchLimit / 2) {
+                fetch_done(item, true, 0);
+                return;
+            }
+        } else if (m_Store.usage() - m_PrefetchFileBytes + f->size > m_DiskLimit) {
+            m_OverBudget.insert(path);
+            fetch_done(item, true, 0);
+            return;
+        } else {
+            m_OverBudget.remove(path);
+        }
+
+        auto* file = new QFile(m_Store.prepare(f->hash), this);
+        if (!file->open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            qWarning() << "Cannot write offline copy" << file->fileName() << file->errorString();
+            delete file;
+            fetch_done(item, false, 0);
+            return;
+        }
+
+        m_Busy = true;
+        m_FetchTimer.start();
+        auto* verifier = new DownloadVerifier(f->hash, {}, this);
+        quint64 generation = m_Generation;
+        QString hash = f->hash;
+        qint64 size = f->size;
+        auto on_done = [this, item, file, verifier, hash, size, generation](bool ok) {
+            file->close();
+            file->deleteLater();
+            if (!ok || generation != m_Generation) {
+                verifier->deleteLater();
+                QFile::remove(file->fileName());
+                if (generation == m_Generation)
+                    fetch_done(item, false, 0);
+                return;
+            }
+            auto on_verified = [this, item, verifier, temp = file->fileName(), hash, size, generation](bool verified) {
+                verifier->deleteLater();
+                if (generation != m_Generation) {
+                    QFile::remove(temp);
+                    return;
+                }
+                if (!verified) {
+                    // Most likely changed since it was listed; the next delta queues it again
+                    QFile::remove(temp);
+                    fetch_done(item, false, size);
+                    return;
+                }
+                if (!m_Store.commit(hash)) {
+                    qWarning() << m_Store.last_error();
+                } else if (item.speculative) {
+                    add_prefetched({queue_key(false, item.key), hash, size, QDateTime::currentMSecsSinceEpoch()});
+                }
+                fetch_done(item, true, size);
+            };
+            connect(verifier, &DownloadVerifier::finished, this, on_verified);
+            verifier->finish();
+        };
+        m_Reply = m_Api->download_file(path, file, nullptr, on_done, verifier);
+    }
+
+    void OfflineStore::fetch_note(const Item& item) {
+        bool pinned = m_Notes.contains(item.key);
+        if (item.speculative ? pinned || m_PrefetchedNotes.contains(item.key) : !pinned) {
+            fetch_done(item, true, 0);
+            return;
+        }
+
+        m_Busy = true;
+        m_FetchTimer.start();
+        quint64 generation = m_Generation;
+        m_Api->get_note(item.key, [this, item, generation](bool ok, Note note) {
+            if (generation != m_Generation)
+                return;
+            qint64 bytes = ok ? note.content.toUtf8().size() : 0;
+            if (ok && item.speculative) {
+                m_PrefetchedNotes.insert(item.key, note);
+                add_prefetched({queue_key(true, item.key), {}, bytes, QDateTime::currentMSecsSinceEpoch()});
+            } else if (ok) {
+                store_note(note);
+            }
+            fetch_done(item, ok, bytes);
+        });
+    }
+
+    void OfflineStore::fetch_done(const Item& item, bool ok, qint64 bytes) {
+        m_Busy = false;
+        m_Reply = nullptr;
+        if (!ok && item.speculative) {
+            // A guess isn't worth a retry
+            QMetaObject::invokeMethod(this, &OfflineStore::pump, Qt::QueuedConnection);
+            return;
+        }
+        if (!ok) {
+            // Offline, a server error or content that changed mid-fetch: try again later
+            enqueue(item);
+            m_PaceTimer.start(k_RetryDelayMs);
+            emit changed();
+            return;
+        }
+        if (bytes > 0 && !item.speculative) {
+            // A new version of a file leaves the blob of the old one behind
+            m_GcPending = m_GcPending || !item.note;
+            emit changed();
+        }
+
+        // Bandwidth budget: wait until the average since this fetch began is back under the limit
+        if (m_BandwidthLimit > 0 && bytes > 0) {
+            qint64 wait = bytes * 1000 / m_BandwidthLimit - m_FetchTimer.elapsed();
+            if (wait > 0) {
+                m_PaceTimer.start(static_cast<int>(qMin<qint64>(wait, INT_MAX)));
+                return;
+            }
+        }
+        // Queued so a long run of files that need nothing doesn't recurse
+        QMetaObject::invokeMethod(this, &OfflineStore::pump, Qt::QueuedConnection);
+    }
+
+    bool OfflineStore::network_ready() const {
+        auto* info = QNetworkInformation::instance();
+        return !info || info->reachability() != QNetworkInformation::Reachability::Disconnected;
+    }
+
+    void OfflineStore::collect_garbage() {
+        m_GcPending = false;
+        QSet<QString> keep;
+        if (!m_Paths.isEmpty()) {
+            const auto& files = m_Sync->files();
+            for (auto it = files.constBegin(); it != files.constEnd(); ++it) {
+                if (is_pinned(it.key()))
+                    keep.insert(it->hash.toLower());
+            }
+        }
+        for (const auto& e : m_Prefetched) {
+            if (!e.hash.isEmpty())
+                keep.insert(e.hash.toLower());
+        }
+        qint64 freed = m_Store.retain(keep);
+        // Room was made, so whatever didn't fit may now
+        if (freed > 0) {
+            for (const auto& path : std::as_const(m_OverBudget))
+                enqueue({false, path});
+            pump();
+        }
+        emit changed();
+    }
+
+    QString OfflineStore::note_path(const QString& id) const { return m_Dir + "/notes/" + id + ".json"; }
+
+    void OfflineStore::check_server() {
+        if (m_Api->server_url() == m_LoadedFor)
+            return;
+        bool running = m_Running;
+        stop();
+        if (m_HistoryTimer.isActive()) {
+            m_HistoryTimer.stop();
+            m_Predictor.save(m_Dir + "/history.json");
+        }
+        drop_prefetch_cache();
+        m_OverBudget.clear();
+        load();
+        if (running)
+            start();
+        emit changed();
+    }
+
+    void OfflineStore::load() {
+        m_LoadedFor = m_Api->server_url();
+        QByteArray key = QCryptographicHash::hash(m_LoadedFor.toUtf8(), QCryptographicHash::Sha1).toHex();
+        m_Dir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/offline/" + key;
+        m_Paths.clear();
+        m_Notes.clear();
+        if (!m_Store.open(m_Dir + "/blobs"))
+            qWarning() << m_Store.last_error();
+        m_Predictor.load(m_Dir + "/history.json");
+
+        QFile file(m_Dir + "/pins.json");
+        if (!file.open(QIODevice::ReadOnly))
+            return;
+        QJsonObject obj = QJsonDocument::fromJson(file.readAll()).object();
+        for (const auto& v : obj["paths"].toArray())
+            m_Paths.insert(v.toString());
+        QJsonObject notes = obj["notes"].toObject();
+        for (auto it = notes.constBegin(); it != notes.constEnd(); ++it)
+            m_Notes.insert(it.key(), it.value().toInteger());
+    }
+
+    void OfflineStore::save() {
+        QJsonArray paths;
+        for (const auto& path : std::as_const(m_Paths))
+            paths.append(path);
+        QJsonObject notes;
+        for (auto it = m_Notes.constBegin(); it != m_Notes.constEnd(); ++it)
+            notes[it.key()] = it.value();
+        QJsonObject obj;
+        obj["paths"] = paths;
+        obj["notes"] = notes;
+
+        QDir().mkpath(m_Dir);
+        QSaveFile file(m_Dir + "/pins.json");
+        if (!file.open(QIODevice::WriteOnly))
+            return;
+        file.write(QJsonDocument(obj).toJson(QJsonDocument::Compact));
+        file.commit();
+    }
+
+} // namespace sap::client
@@ -0,0 +1,530 @@
+#include "sap_cloud_client/peer_cache.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QFuture>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMessageAuthenticationCode>
+#include <QNetworkDatagram>
+#include <QPromise>
+#include <QRandomGenerator>
+#include <QRegularExpression>
+#include <QStandardPaths>
+#include <QTcpSocket>
+#include <QThreadPool>
+#include <QTimer>
+#include <algorithm>
+#include <deque>
+#include <openssl/crypto.h>
+#include "sap_cloud_client/download_verifier.h"
+
+namespace {
+
+    constexpr char k_DiscoveryGroup[] = "239.255.77.42";
+    constexpr quint16 k_DiscoveryPort = 45832;
+    constexpr qint64 k_SendBlock = 256 * 1024;
+    constexpr qint64 k_SendBuffer = 1024 * 1024;
+    constexpr int k_MaxRequestLine = 256;
+    constexpr int k_ChallengeSize = 16;
+
+    bool valid_hash(const QString& hash) {
+        static const QRegularExpression re("^[0-9a-fA-F]{64}$");
+        return re.match(hash).hasMatch();
+    }
+
+} // anonymous namespace
+
+namespace sap::client {
+
+    struct PeerCache::Fetch {
+        quint64 nonce = 0;
+        QString hash;
+        qint64 size = 0;
+        QString target;
+        ProgressFn progress;
+        std::function<void(bool)> done;
+
+        std::deque<std::pair<QHostAddress, quint16>> peers;
+        QTimer* timer = nullptr; // answer window, then idle timeout while a peer sends
+        QTcpSocket* socket = nullptr;
+        QFile* file = nullptr;
+        DownloadVerifier* verifier = nullptr;
+        bool asked = false; // challenge answered with the request
+        bool header = false;
+        qint64 received = 0;
+
+        QString temp_path() const { return target + ".peer"; }
+    };
+
+    PeerCache::PeerCache(QObject* parent) : QObject(parent), m_Self(QRandomGenerator::global()->generate64()) {
+        connect(&m_Listen, &QUdpSocket::readyRead, this, &PeerCache::on_query);
+        connect(&m_Send, &QUdpSocket::readyRead, this, &PeerCache::on_answer);
+        connect(&m_Server, &QTcpServer::newConnection, this, [this]() {
+            while (QTcpSocket* socket = m_Server.nextPendingConnection())
+                serve(socket);
+        });
+    }
+
+    PeerCache::~PeerCache() {
+        stop();
+        // Connections still being served go down with m_Server; they must not call back in here
+        for (auto* socket : m_Server.findChildren<QTcpSocket*>())
+            socket->disconnect(this);
+    }
+
+    bool PeerCache::start() {
+        if (m_Running)
+            return true;
+        if (!m_Store.open(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/peer_cache")) {
+            m_LastError = m_Store.last_error();
+            return false;
+        }
+        m_Used.clear();
+        for (const auto& hash : m_Store.hashes())
+            m_Used.insert(hash, QFileInfo(m_Store.path(hash)).lastModified().toMSecsSinceEpoch());
+
+        if (!m_Server.listen(QHostAddress::AnyIPv4, 0)) {
+            m_LastError = "Cannot serve peers: " + m_Server.errorString();
+            return false;
+        }
+        // Shared so that several clients on one machine all see the queries
+        if (!m_Listen.bind(QHostAddress::AnyIPv4, k_DiscoveryPort, QUdpSocket::ShareAddress | QUdpSocket::ReuseAddressHint) ||
+            !m_Listen.joinMulticastGroup(QHostAddress(k_DiscoveryGroup)) || !m_Send.bind(QHostAddress::AnyIPv4, 0)) {
+            m_LastError = "Cannot join peer discovery: " + (m_Listen.error() != QAbstractSocket::UnknownSocketError ? m_Listen.errorString()
+                                                                                                                  : m_Send.errorString());
+            m_Server.close();
+            m_Listen.close();
+            m_Send.close();
+            return false;
+        }
+        // LAN only, and the sender's own machine counts
+        m_Send.setSocketOption(QAbstractSocket::MulticastTtlOption, 1);
+        m_Send.setSocketOption(QAbstractSocket::MulticastLoopbackOption, 1);
+        m_Running = true;
+        return true;
+    }
+
+    void PeerCache::stop() {
+        if (!m_Running)
+            return;
+        m_Running = false;
+        for (quint64 nonce : m_Fetches.keys())
+            end_fetch(nonce, false);
+        m_Server.close();
+        m_Listen.close();
+        m_Send.close();
+    }
+
+    void PeerCache::set_account_key(const QByteArray& key) {
+        if (key == m_AccountKey)
+            return;
+        // Fetches under the old key would only be answered by the old account's peers
+        for (quint64 nonce : m_Fetches.keys())
+            end_fetch(nonce, false);
+        m_AccountKey = key;
+    }
+
+    void PeerCache::add_source(const ContentStore* store) {
+        if (store && !m_Sources.contains(store))
+            m_Sources.append(store);
+    }
+
+    void PeerCache::remove_source(const ContentStore* store) { m_Sources.removeAll(store); }
+
+    QByteArray PeerCache::sign(const QByteArray& message) const {
+        return QMessageAuthenticationCode::hash(message, m_AccountKey, QCryptographicHash::Sha256).toHex();
+    }
+
+    bool PeerCache::verify(const QByteArray& message, const QString& mac) const {
+        if (m_AccountKey.isEmpty())
+            return false;
+        QByteArray expected = sign(message);
+        QByteArray given = mac.toLatin1().toLower();
+        return given.size() == expected.size() && CRYPTO_memcmp(given.constData(), expected.constData(), expected.size()) == 0;
+    }
+
+    void PeerCache::set_disk_limit(qint64 bytes) {
+        m_DiskLimit = qMax<qint64>(0, bytes);
+        if (m_Running)
+            trim();
+    }
+
+    QString PeerCache::blob_path(const QString& hash) const {
+        if (m_Store.contains(hash))
+            return m_Store.path(hash);
+        for (const auto* source : m_Sources) {
+            if (source->contains(hash))
+                return source->path(hash);
+        }
+        return {};
+    }
+
+    void PeerCache::touch(const QString& hash) {
+        if (m_Store.contains(hash))
+            m_Used[hash.toLower()] = QDateTime::currentMSecsSinceEpoch();
+    }
+
+    void PeerCache::trim() {
+        if (m_Store.usage() <= m_DiskLimit)
+            return;
+        QStringList hashes = m_Store.hashes();
+        std::sort(hashes.begin(), hashes.end(), [this](const QString& a, const QString& b) { return m_Used.value(a) > m_Used.value(b); });
+        QSet<QString> keep;
+        qint64 kept = 0;
+        for (const auto& hash : hashes) {
+            qint64 size = m_Store.blob_size(hash);
+            if (kept + size > m_DiskLimit)
+                break;
+            kept += size;
+            keep.insert(hash);
+        }
+        m_Store.retain(keep);
+        for (auto it = m_Used.begin(); it != m_Used.end();) {
+            if (keep.contains(it.key()))
+                ++it;
+            else
+                it = m_Used.erase(it);
+        }
+    }
+
+    void PeerCache::offer(const QString& path, const QString& hash, std::function<void()> then) {
+        qint64 size = QFileInfo(path).size();
+        if (!m_Running || !valid_hash(hash) || size < k_MinFileSize || size > m_DiskLimit || !blob_path(hash).isEmpty() ||
+            m_Offering.contains(hash.toLower())) {
+            then();
+            return;
+        }
+        m_Offering.insert(hash.toLower());
+
+        // Copied off the UI thread; the caller may change the file once then runs
+        QString temp = m_Store.prepare(hash);
+        auto promise = std::make_shared<QPromise<bool>>();
+        QFuture<bool> future = promise->future();
+        promise->start();
+        QThreadPool::globalInstance()->start([promise, path, temp]() {
+            QFile::remove(temp);
+            promise->addResult(QFile::copy(path, temp));
+            promise->finish();
+        });
+        future.then(this, [this, hash, temp, then](bool copied) {
+            m_Offering.remove(hash.toLower());
+            if (!copied || !m_Running) {
+                QFile::remove(temp);
+            } else if (m_Store.commit(hash)) {
+                touch(hash);
+                trim();
+            }
+            then();
+        });
+    }
+
+    std::function<void()> PeerCache::fetch(const QString& hash, qint64 size, const QString& target, ProgressFn progress,
+                                           std::function<void(bool)> done) {
+        if (!m_Running || m_AccountKey.isEmpty() || !valid_hash(hash) || size < k_MinFileSize) {
+            done(false);
+            return {};
+        }
+
+        auto f = std::make_shared<Fetch>();
+        f->nonce = QRandomGenerator::global()->generate64();
+        f->hash = hash.toLower();
+        f->size = size;
+        f->target = target;
+        f->progress = progress;
+        f->done = done;
+        f->timer = new QTimer(this);
+        f->timer->setSingleShot(true);
+        quint64 nonce = f->nonce;
+        connect(f->timer, &QTimer::timeout, this, [this, nonce]() {
+            // No answer in time, or the peer we were reading from went quiet
+            auto f = m_Fetches.value(nonce);
+            if (!f)
+                return;
+            if (f->socket)
+                drop_peer(f);
+            else
+                end_fetch(nonce, false);
+        });
+        m_Fetches.insert(nonce, f);
+
+        QByteArray n = QByteArray::number(nonce);
+        QJsonObject query{{"t", "q"},
+                          {"id", QString::number(m_Self)},
+                          {"n", QString::fromLatin1(n)},
+                          {"h", f->hash},
+                          {"m", QString::fromLatin1(sign("q:" + n + ':' + f->hash.toLatin1()))}};
+        m_Send.writeDatagram(QJsonDocument(query).toJson(QJsonDocument::Compact), QHostAddress(k_DiscoveryGroup), k_DiscoveryPort);
+        f->timer->start(k_QueryTimeoutMs);
+
+        return [this, nonce]() { end_fetch(nonce, false); };
+    }
+
+    void PeerCache::on_query() {
+        while (m_Listen.hasPendingDatagrams()) {
+            QNetworkDatagram datagram = m_Listen.receiveDatagram();
+            QJsonObject obj = QJsonDocument::fromJson(datagram.data()).object();
+            QString hash = obj["h"].toString().toLower();
+            QByteArray n = obj["n"].toString().toLatin1();
+            if (obj["t"].toString() != "q" || obj["id"].toString() == QString::number(m_Self) || !valid_hash(hash))
+                continue;
+            // Other accounts' clients don't learn what is cached here
+            if (!verify("q:" + n + ':' + hash.toLatin1(), obj["m"].toString()))
+                continue;
+            // Busy peers stay quiet rather than answer and then refuse
+            if (m_Serving >= k_MaxServing || blob_path(hash).isEmpty())
+                continue;
+            QByteArray port = QByteArray::number(m_Server.serverPort());
+            QJsonObject answer{{"t", "a"}, {"n", QString::fromLatin1(n)}, {"h", hash}, {"p", m_Server.serverPort()},
+                               {"m", QString::fromLatin1(sign("a:" + n + ':' + hash.toLatin1() + ':' + port))}};
+            m_Send.writeDatagram(QJsonDocument(answer).toJson(QJsonDocument::Compact), datagram.senderAddress(), datagram.senderPort());
+        }
+    }
+
+    void PeerCache::on_answer() {
+        while (m_Send.hasPendingDatagrams()) {
+            QNetworkDatagram datagram = m_Send.receiveDatagram();
+            QJsonObject obj = QJsonDocument::fromJson(datagram.data()).object();
+            if (obj["t"].toString() != "a")
+                continue;
+            auto f = m_Fetches.value(obj["n"].toString().toULongLong());
+            int port = obj["p"].toInt();
+            if (!f || obj["h"].toString() != f->hash || port <= 0 || port > 65535)
+                continue;
+            QByteArray signed_answer = "a:" + QByteArray::number(f->nonce) + ':' + f->hash.toLatin1() + ':' + QByteArray::number(port);
+            if (!verify(signed_answer, obj["m"].toString()))
+                continue;
+            f->peers.emplace_back(datagram.senderAddress(), static_cast<quint16>(port));
+            if (!f->socket)
+                connect_next(f->nonce);
+        }
+    }
+
+    void PeerCache::serve(QTcpSocket* socket) {
+        auto* idle = new QTimer(socket);
+        idle->setSingleShot(true);
+        connect(idle, &QTimer::timeout, socket, &QTcpSocket::abort);
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        idle->start(k_IdleTimeoutMs);
+
+        // The requester proves it holds the account key by signing this together with the hash
+        QByteArray challenge(k_ChallengeSize, Qt::Uninitialized);
+        QRandomGenerator::system()->fillRange(reinterpret_cast<quint32*>(challenge.data()), k_ChallengeSize / sizeof(quint32));
+        challenge = challenge.toHex();
+        socket->write("HELLO " + challenge + '\n');
+
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket, idle, challenge]() {
+            if (!socket->canReadLine()) {
+                if (socket->bytesAvailable() > k_MaxRequestLine)
+                    socket->abort();
+                return;
+            }
+            disconnect(socket, &QTcpSocket::readyRead, this, nullptr);
+            QStringList words = QString::fromLatin1(socket->readLine(k_MaxRequestLine)).trimmed().split(' ');
+            QString hash = words.size() == 3 && words[0] == "GET" ? words[1].toLower() : QString();
+            bool allowed = valid_hash(hash) && verify("get:" + challenge + ':' + hash.toLatin1(), words[2]);
+            QString path = allowed ? blob_path(hash) : QString();
+            auto* file = new QFile(path, socket);
+            if (path.isEmpty() || m_Serving >= k_MaxServing || !file->open(QIODevice::ReadOnly)) {
+                socket->write("NO\n");
+                socket->disconnectFromHost();
+                return;
+            }
+
+            ++m_Serving;
+            touch(hash);
+            connect(socket, &QObject::destroyed, this, [this]() { --m_Serving; });
+            socket->write("OK " + QByteArray::number(file->size()) + '\n');
+            // Keeps about k_SendBuffer in flight so large blobs never sit in memory whole
+            auto send = [this, socket, file, idle]() {
+                idle->start(k_IdleTimeoutMs);
+                while (socket->bytesToWrite() < k_SendBuffer && !file->atEnd()) {
+                    QByteArray block = file->read(k_SendBlock);
+                    if (block.isEmpty()) {
+                        socket->abort();
+                        return;
+                    }
+                    socket->write(block);
+                    m_Stats.bytes_served += block.size();
+                }
+                if (file->atEnd() && socket->bytesToWrite() == 0)
+                    socket->disconnectFromHost();
+            };
+            connect(socket, &QTcpSocket::bytesWritten, socket, send);
+            send();
+            emit stats_changed();
+        });
+    }
+
+    void PeerCache::connect_next(quint64 nonce) {
+        auto f = m_Fetches.value(nonce);
+        if (!f)
+            return;
+        if (f->peers.empty()) {
+            // More answers may still come in while the window is open
+            if (!f->timer->isActive())
+                end_fetch(nonce, false);
+            return;
+        }
+        auto [address, port] = f->peers.front();
+        f->peers.pop_front();
+
+        f->file = new QFile(f->temp_path(), this);
+        if (!f->file->open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            qWarning() << "Cannot write" << f->temp_path() << f->file->errorString();
+            end_fetch(nonce, false);
+            return;
+        }
+        f->verifier = new DownloadVerifier(f->hash, {}, this);
+        f->asked = false;
+        f->header = false;
+        f->received = 0;
+        f->socket = new QTcpSocket(this);
+        f->timer->start(k_IdleTimeoutMs);
+
+        QTcpSocket* socket = f->socket;
+        connect(socket, &QTcpSocket::readyRead, socket, [this, nonce]() { on_peer_data(nonce); });
+        connect(socket, &QTcpSocket::disconnected, socket, [this, nonce]() {
+            // The peer may close right after the last bytes; those are still in the buffer
+            on_peer_data(nonce);
+            auto f = m_Fetches.value(nonce);
+            if (f && f->socket && f->received < f->size)
+                drop_peer(f);
+        });
+        connect(socket, &QTcpSocket::errorOccurred, socket, [this, nonce](QAbstractSocket::SocketError error) {
+            if (error == QAbstractSocket::RemoteHostClosedError)
+                return;
+            auto f = m_Fetches.value(nonce);
+            if (f && f->socket)
+                drop_peer(f);
+        });
+        socket->connectToHost(address, port);
+    }
+
+    void PeerCache::on_peer_data(quint64 nonce) {
+        auto f = m_Fetches.value(nonce);
+        if (!f || !f->socket)
+            return;
+        QTcpSocket* socket = f->socket;
+        if (!f->asked) {
+            if (!socket->canReadLine())
+                return;
+            QByteArray line = socket->readLine(k_MaxRequestLine).trimmed();
+            QByteArray challenge = line.startsWith("HELLO ") ? line.mid(6) : QByteArray();
+            if (challenge.isEmpty()) {
+                drop_peer(f);
+                return;
+            }
+            QByteArray hash = f->hash.toLatin1();
+            socket->write("GET " + hash + ' ' + sign("get:" + challenge + ':' + hash) + '\n');
+            f->asked = true;
+        }
+        if (!f->header) {
+            if (!socket->canReadLine())
+                return;
+            QByteArray line = socket->readLine(k_MaxRequestLine).trimmed();
+            if (!line.startsWith("OK ") || line.mid(3).toLongLong() != f->size) {
+                drop_peer(f);
+                return;
+            }
+            f->header = true;
+        }
+
+        QByteArray data = socket->readAll();
+        if (data.isEmpty())
+            return;
+        f->timer->start(k_IdleTimeoutMs);
+        if (f->received + data.size() > f->size || f->file->write(data) != data.size()) {
+            drop_peer(f);
+            return;
+        }
+        f->verifier->add(data);
+        f->received += data.size();
+        if (f->progress)
+            f->progress(f->received, f->size);
+        if (f->received == f->size)
+            on_peer_complete(nonce);
+    }
+
+    void PeerCache::on_peer_complete(quint64 nonce) {
+        auto f = m_Fetches.value(nonce);
+        f->timer->stop();
+        f->socket->disconnect();
+        f->socket->deleteLater();
+        f->socket = nullptr;
+        f->file->close();
+
+        DownloadVerifier* verifier = f->verifier;
+        connect(verifier, &DownloadVerifier::finished, this, [this, nonce, verifier](bool ok) {
+            auto f = m_Fetches.value(nonce);
+            if (!f || f->verifier != verifier)
+                return;
+            if (!ok) {
+                qWarning() << "Peer sent a corrupt copy of" << f->hash;
+                drop_peer(f);
+                return;
+            }
+            QFile::remove(f->target);
+            if (!f->file->rename(f->target)) {
+                qWarning() << "Cannot move" << f->temp_path() << "into place";
+                end_fetch(nonce, false);
+                return;
+            }
+            m_Stats.bytes_from_peers += f->size;
+            end_fetch(nonce, true);
+        });
+        verifier->finish();
+    }
+
+    void PeerCache::drop_peer(const std::shared_ptr<Fetch>& f) {
+        if (f->socket) {
+            f->socket->disconnect();
+            f->socket->abort();
+            f->socket->deleteLater();
+            f->socket = nullptr;
+        }
+        if (f->verifier) {
+            f->verifier->disconnect(this);
+            f->verifier->deleteLater();
+            f->verifier = nullptr;
+        }
+        if (f->file) {
+            f->file->close();
+            f->file->remove();
+            delete f->file;
+            f->file = nullptr;
+        }
+        f->timer->stop();
+        connect_next(f->nonce);
+    }
+
+    void PeerCache::end_fetch(quint64 nonce, bool ok) {
+        auto f = m_Fetches.take(nonce);
+        if (!f)
+            return;
+        f->timer->deleteLater();
+        if (f->socket) {
+            f->socket->disconnect();
+            f->socket->abort();
+            f->socket->deleteLater();
+        }
+        if (f->verifier) {
+            f->verifier->disconnect(this);
+            f->verifier->deleteLater();
+        }
+        if (f->file) {
+            f->file->close();
+            if (!ok)
+                f->file->remove();
+            delete f->file;
+        }
+        if (ok)
+            m_Stats.hits++;
+        else
+            m_Stats.misses++;
+        emit stats_changed();
+        f->done(ok);
+    }
+
+} // namespace sap::client
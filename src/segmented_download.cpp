@@ -0,0 +1,452 @@
+#include "sap_cloud_client/segmented_download.h"
+#include <QDebug>
+#include <algorithm>
+#include "sap_cloud_client/api_client.h"
+#include "sap_cloud_client/download_verifier.h"
+
+namespace sap::client {
+
+    double SegmentedDownload::Segment::bytes_per_ms() const {
+        qint64 elapsed = timer.isValid() ? timer.elapsed() : 0;
+        return elapsed > 0 ? static_cast<double>(pos - attempt_pos) / elapsed : 0.0;
+    }
+
+    SegmentedDownload::SegmentedDownload(ApiClient* api, const QString& path, const QString& part_path, qint64 size,
+                                         const QString& expected_hash, QObject* parent) :
+        QObject(parent), m_Api(api), m_Path(path), m_PartPath(part_path), m_Size(size), m_ExpectedHash(expected_hash) {}
+
+    SegmentedDownload::~SegmentedDownload() {
+        m_Done = true;
+        for (auto& seg : m_Segments) {
+            if (QNetworkReply* reply = seg->reply) {
+                seg->reply = nullptr;
+                reply->abort();
+            }
+        }
+        if (m_StreamReply)
+            m_StreamReply->abort();
+    }
+
+    void SegmentedDownload::start() {
+        if (!m_ExpectedHash.isEmpty()) {
+            if (m_Api->supports(ApiClient::Feature::Manifests)) {
+                // Segments start meanwhile; what they write before the manifest arrives is read back
+                QPointer<SegmentedDownload> self(this);
+                m_Api->get_manifest(m_Path, [self](bool ok, FileManifest manifest) {
+                    if (!self || self->m_Done || self->m_Verifier)
+                        return;
+                    // A manifest of other content (the file changed since it was listed) can't vouch for any range
+                    bool matches = ok && manifest.hash.compare(self->m_ExpectedHash, Qt::CaseInsensitive) == 0;
+                    self->create_verifier(matches ? manifest.chunks : QVector<ChunkRef>{});
+                });
+            } else {
+                create_verifier({});
+            }
+        }
+
+        if (m_Size > 0) {
+            begin_segments();
+            return;
+        }
+
+        QPointer<SegmentedDownload> self(this);
+        m_Api->head_file(m_Path, [self](bool ok, qint64 size) {
+            if (!self || self->m_Done)
+                return;
+            if (!ok) {
+                self->complete(false);
+                return;
+            }
+            self->m_Size = size;
+            if (size > 0) {
+                self->begin_segments();
+            } else {
+                // No usable length to split on
+                self->fall_back_to_single_stream();
+            }
+        });
+    }
+
+    void SegmentedDownload::abort() {
+        if (m_Done)
+            return;
+        complete(false);
+    }
+
+    qint64 SegmentedDownload::contiguous_prefix() const {
+        if (m_SingleStream)
+            return m_Received;
+        if (m_Segments.empty())
+            return 0;
+        // Segments tile the file, so the lowest unfinished write position bounds the written prefix
+        qint64 prefix = m_Size;
+        for (const auto& seg : m_Segments) {
+            if (seg->pos < seg->end)
+                prefix = qMin(prefix, seg->pos);
+        }
+        return prefix;
+    }
+
+    void SegmentedDownload::begin_segments() {
+        m_File.setFileName(m_PartPath);
+        // Presize so every segment can write at its own offset; on most filesystems this stays sparse
+        if (!m_File.open(QIODevice::ReadWrite | QIODevice::Truncate) || !m_File.resize(m_Size)) {
+            fail("Cannot create " + m_PartPath + ": " + m_File.errorString());
+            return;
+        }
+
+        int count = static_cast<int>(std::clamp<qint64>(m_Size / k_MinSegmentSize, 1, k_InitialSegments));
+        qint64 step = m_Size / count;
+        for (int i = 0; i < count; ++i) {
+            auto seg = std::make_unique<Segment>();
+            seg->begin = i * step;
+            seg->pos = seg->begin;
+            seg->end = i == count - 1 ? m_Size : (i + 1) * step;
+            if (!open_segment(*seg)) {
+                fail("Cannot open " + m_PartPath + ": " + seg->file->errorString());
+                return;
+            }
+            m_Segments.push_back(std::move(seg));
+        }
+
+        for (auto& seg : m_Segments) {
+            launch(*seg);
+        }
+    }
+
+    bool SegmentedDownload::open_segment(Segment& seg) {
+        seg.file = std::make_unique<QFile>(m_PartPath);
+        // Unbuffered so contiguous_prefix() never counts bytes still sitting in a Qt buffer
+        return seg.file->open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+    }
+
+    void SegmentedDownload::launch(Segment& seg) {
+        if (!seg.file->seek(seg.pos)) {
+            fail("Cannot seek in " + m_PartPath);
+            return;
+        }
+        seg.attempt_pos = seg.pos;
+        seg.timer.start();
+
+        auto* reply = m_Api->get_file_range(m_Path, seg.pos, seg.end - seg.pos);
+        reply->setReadBufferSize(k_ReadChunk);
+        seg.reply = reply;
+
+        connect(reply, &QNetworkReply::metaDataChanged, this, [this, reply]() {
+            // 200 instead of 206: the server ignored Range and is sending the whole body
+            if (find(reply) && reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 200) {
+                fall_back_to_single_stream();
+            }
+        });
+        connect(reply, &QNetworkReply::readyRead, this, [this, reply]() {
+            if (Segment* seg = find(reply))
+                on_segment_data(*seg, reply);
+        });
+        connect(reply, &QNetworkReply::finished, this, [this, reply]() {
+            reply->deleteLater();
+            if (Segment* seg = find(reply))
+                on_segment_finished(*seg, reply);
+        });
+    }
+
+    void SegmentedDownload::on_segment_data(Segment& seg, QNetworkReply* reply) {
+        if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() != 206)
+            return;
+
+        while (reply->bytesAvailable() > 0 && seg.pos < seg.end) {
+            // Never write past end: after a split the tail belongs to another segment
+            QByteArray chunk = reply->read(qMin(k_ReadChunk, seg.end - seg.pos));
+            if (chunk.isEmpty())
+                break;
+            if (seg.file->write(chunk) != chunk.size()) {
+                fail("Failed to write " + m_PartPath + ": " + seg.file->errorString());
+                return;
+            }
+            if (m_Verifier && !m_Verifying && seg.pos == m_Verifier->fed())
+                m_Verifier->add(chunk);
+            seg.pos += chunk.size();
+            m_Received += chunk.size();
+        }
+        emit progress(m_Received, m_Size);
+
+        if (seg.pos >= seg.end) {
+            // Range satisfied (possibly shrunk by a split); drop the rest of the response
+            seg.reply = nullptr;
+            reply->abort();
+            segment_done(seg);
+        }
+    }
+
+    void SegmentedDownload::on_segment_finished(Segment& seg, QNetworkReply* reply) {
+        on_segment_data(seg, reply);
+        if (m_Done || seg.reply != reply)
+            return; // completed (and maybe relaunched) while draining
+
+        seg.reply = nullptr;
+        if (seg.pos >= seg.end) {
+            segment_done(seg);
+            return;
+        }
+        if (++seg.retries > k_MaxRetries) {
+            fail(reply->error() != QNetworkReply::NoError ? reply->errorString() : "Segment ended early: " + m_Path);
+            return;
+        }
+        // Resume from the last byte written
+        launch(seg);
+    }
+
+    void SegmentedDownload::segment_done(Segment& seg) {
+        if (m_Done)
+            return;
+
+        double finished_rate = seg.bytes_per_ms();
+        double total_rate = 0;
+        for (const auto& other : m_Segments) {
+            if (other->reply)
+                total_rate += other->bytes_per_ms();
+        }
+        int active = active_segments();
+        // The finished segment stays listed as the record of what is on disk for the hash frontier
+        seg.file->close();
+
+        // Put the idle connection to work on the slowest segment's tail
+        bool reused = split_slowest();
+
+        // A segment that ran at least as fast as the average means the link has headroom: add one more
+        if (reused && active + 1 < k_MaxSegments && active > 0 && finished_rate >= total_rate / active) {
+            split_slowest();
+        }
+
+        advance_hash();
+        if (m_ExpectedHash.isEmpty() && all_written())
+            finalize();
+    }
+
+    bool SegmentedDownload::split_slowest() {
+        Segment* victim = nullptr;
+        double worst_eta = 0;
+        for (auto& seg : m_Segments) {
+            if (!seg->reply || seg->repair || seg->remaining() < 2 * k_MinSegmentSize)
+                continue;
+            double rate = seg->bytes_per_ms();
+            // No throughput sample yet counts as the slowest possible
+            double eta = rate > 0 ? seg->remaining() / rate : static_cast<double>(seg->remaining()) * 1e6;
+            if (eta > worst_eta) {
+                worst_eta = eta;
+                victim = seg.get();
+            }
+        }
+        if (!victim)
+            return false;
+
+        auto slot = std::make_unique<Segment>();
+        if (!open_segment(*slot))
+            return false;
+
+        qint64 mid = victim->pos + victim->remaining() / 2;
+        slot->begin = mid;
+        slot->pos = mid;
+        slot->end = victim->end;
+        victim->end = mid;
+        m_Segments.push_back(std::move(slot));
+        launch(*m_Segments.back());
+        return true;
+    }
+
+    int SegmentedDownload::active_segments() const {
+        return static_cast<int>(std::count_if(m_Segments.begin(), m_Segments.end(), [](const auto& s) { return !s->reply.isNull(); }));
+    }
+
+    void SegmentedDownload::fall_back_to_single_stream() {
+        if (m_SingleStream || m_Done)
+            return;
+        m_SingleStream = true;
+
+        for (auto& seg : m_Segments) {
+            if (QNetworkReply* reply = seg->reply) {
+                seg->reply = nullptr;
+                reply->abort();
+            }
+        }
+        m_Segments.clear();
+        m_Received = 0;
+
+        // Chunks can't be refetched on their own from a plain stream, so it is checked as a whole
+        if (m_Verifier) {
+            disconnect(m_Verifier, nullptr, this, nullptr);
+            m_Verifier->deleteLater();
+            m_Verifier = nullptr;
+        }
+        m_Verifying = false;
+        if (!m_ExpectedHash.isEmpty())
+            create_verifier({});
+
+        if (!m_File.isOpen()) {
+            m_File.setFileName(m_PartPath);
+            if (!m_File.open(QIODevice::ReadWrite | QIODevice::Truncate)) {
+                fail("Cannot create " + m_PartPath + ": " + m_File.errorString());
+                return;
+            }
+        }
+        m_File.seek(0);
+
+        QPointer<SegmentedDownload> self(this);
+        auto on_progress = [self](qint64 received, qint64 total) {
+            if (!self)
+                return;
+            self->m_Received = received;
+            emit self->progress(received, total > 0 ? total : self->m_Size);
+        };
+        auto on_done = [self](bool ok) {
+            if (!self || self->m_Done)
+                return;
+            if (!ok) {
+                self->complete(false);
+                return;
+            }
+            self->m_File.resize(self->m_File.pos());
+            self->m_Size = self->m_File.size();
+            if (!self->m_Verifier) {
+                self->finalize();
+                return;
+            }
+            self->m_Verifying = true;
+            self->m_Verifier->finish();
+        };
+        m_StreamReply = m_Api->download_file(m_Path, &m_File, on_progress, on_done, m_Verifier);
+    }
+
+    void SegmentedDownload::create_verifier(const QVector<ChunkRef>& chunks) {
+        m_Verifier = new DownloadVerifier(m_ExpectedHash, chunks, this);
+        connect(m_Verifier, &DownloadVerifier::chunk_failed, this, &SegmentedDownload::on_chunk_failed);
+        connect(m_Verifier, &DownloadVerifier::finished, this, [this](bool ok) { on_verified(ok); });
+        advance_hash();
+    }
+
+    void SegmentedDownload::advance_hash() {
+        if (!m_Verifier || m_Verifying || m_SingleStream || m_Done || m_Segments.empty())
+            return;
+
+        while (m_Verifier->fed() < m_Size) {
+            qint64 frontier = m_Verifier->fed();
+            const Segment* seg = covering(frontier);
+            if (!seg || seg->pos <= frontier)
+                break;
+            // Written ahead of the frontier, so most likely still in the page cache
+            m_Verifier->add_file(m_PartPath, seg->pos - frontier);
+        }
+
+        if (m_Verifier->fed() >= m_Size && all_written()) {
+            m_Verifying = true;
+            m_Verifier->finish();
+        }
+    }
+
+    void SegmentedDownload::on_chunk_failed(qint64 offset, qint64 size) {
+        if (m_Done || m_SingleStream)
+            return;
+        if (++m_Repairs[offset] > k_MaxRetries) {
+            fail(QString("Corrupt data at offset %1 of %2").arg(offset).arg(m_Path));
+            return;
+        }
+        qWarning() << "Refetching corrupt range" << offset << "+" << size << "of" << m_Path;
+
+        m_Verifying = false;
+        m_Verifier->rewind(offset);
+        m_Received -= size;
+        emit progress(m_Received, m_Size);
+
+        auto seg = std::make_unique<Segment>();
+        seg->begin = offset;
+        seg->pos = offset;
+        seg->end = offset + size;
+        seg->repair = true;
+        if (!open_segment(*seg)) {
+            fail("Cannot open " + m_PartPath + ": " + seg->file->errorString());
+            return;
+        }
+        m_Segments.push_back(std::move(seg));
+        launch(*m_Segments.back());
+    }
+
+    void SegmentedDownload::on_verified(bool ok) {
+        if (m_Done)
+            return;
+        if (ok) {
+            finalize();
+            return;
+        }
+        // Nothing in this file can be trusted for a resume
+        m_Segments.clear();
+        m_File.close();
+        QFile::remove(m_PartPath);
+        m_Received = 0;
+        fail("Hash mismatch for " + m_Path);
+    }
+
+    bool SegmentedDownload::all_written() const {
+        return !m_Segments.empty() && active_segments() == 0 &&
+               std::all_of(m_Segments.begin(), m_Segments.end(), [](const auto& s) { return s->pos >= s->end; });
+    }
+
+    void SegmentedDownload::finalize() {
+        for (auto& seg : m_Segments) {
+            seg->file->close();
+        }
+        if (!m_File.flush()) {
+            fail("Failed to write " + m_PartPath + ": " + m_File.errorString());
+            return;
+        }
+        m_File.close();
+        complete(true);
+    }
+
+    void SegmentedDownload::fail(const QString& msg) {
+        if (m_Done)
+            return;
+        emit m_Api->error(msg);
+        complete(false);
+    }
+
+    void SegmentedDownload::complete(bool ok) {
+        if (m_Done)
+            return;
+        m_Done = true;
+
+        for (auto& seg : m_Segments) {
+            if (QNetworkReply* reply = seg->reply) {
+                seg->reply = nullptr;
+                reply->abort();
+            }
+            if (seg->file)
+                seg->file->close();
+        }
+        if (QNetworkReply* reply = m_StreamReply) {
+            m_StreamReply = nullptr;
+            reply->abort();
+        }
+        m_File.close();
+        emit finished(ok);
+    }
+
+    SegmentedDownload::Segment* SegmentedDownload::find(QNetworkReply* reply) {
+        for (auto& seg : m_Segments) {
+            if (seg->reply == reply)
+                return seg.get();
+        }
+        return nullptr;
+    }
+
+    const SegmentedDownload::Segment* SegmentedDownload::covering(qint64 offset) const {
+        const Segment* found = nullptr;
+        for (const auto& seg : m_Segments) {
+            if (offset < seg->begin || offset >= seg->end)
+                continue;
+            if (seg->repair && seg->pos < seg->end)
+                return seg.get();
+            found = seg.get();
+        }
+        return found;
+    }
+
+} // namespace sap::client
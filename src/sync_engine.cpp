@@ -0,0 +1,307 @@
+#include "sap_cloud_client/sync_engine.h"
+#include <QDateTime>
+#include <QFile>
+#include <QPointer>
+#include <algorithm>
+#include "sap_cloud_client/merkle_reconciler.h"
+#include "sap_cloud_client/metadata_snapshot.h"
+
+namespace sap::client {
+
+    namespace {
+
+        // When a record was last changed, in server time
+        Timestamp version_of(const FileInfo& f) { return f.updated_at > 0 ? f.updated_at : f.mtime; }
+
+    } // anonymous namespace
+
+    SyncEngine::SyncEngine(ApiClient* api, QObject* parent) : QObject(parent), m_Api(api) {
+        m_PollTimer.setSingleShot(true);
+        connect(&m_PollTimer, &QTimer::timeout, this, &SyncEngine::poll);
+        m_SaveTimer.setSingleShot(true);
+        m_SaveTimer.setInterval(k_SaveDelayMs);
+        connect(&m_SaveTimer, &QTimer::timeout, this, &SyncEngine::save);
+        m_VerifyTimer.setInterval(k_VerifyIntervalMs);
+        connect(&m_VerifyTimer, &QTimer::timeout, this, &SyncEngine::verify);
+        load();
+    }
+
+    SyncEngine::~SyncEngine() {
+        if (m_SaveTimer.isActive())
+            save();
+    }
+
+    void SyncEngine::start() {
+        m_Running = true;
+        m_VerifyTimer.start();
+        sync_now();
+    }
+
+    void SyncEngine::stop() {
+        m_Running = false;
+        m_PollTimer.stop();
+        m_VerifyTimer.stop();
+    }
+
+    void SyncEngine::verify() {
+        if (m_Verifying || m_InFlight || !has_snapshot() || !m_Api->supports(ApiClient::Feature::Merkle))
+            return;
+        m_Verifying = true;
+        m_VerifyPending = false;
+
+        // Deltas wait until the comparison is done so the tree doesn't change underneath it
+        m_PollTimer.stop();
+        quint64 generation = m_Generation;
+        auto* reconciler = new MerkleReconciler(m_Api, &m_Tree, this);
+        connect(reconciler, &MerkleReconciler::finished, this,
+                [this, reconciler, generation](bool ok, const QStringList& differing) {
+                    reconciler->deleteLater();
+                    if (m_Generation != generation)
+                        return;
+                    m_Verifying = false;
+                    // verified() reports the divergence; a full listing repairs it
+                    if (ok && !differing.isEmpty())
+                        m_Cursor = 0;
+                    if (ok)
+                        emit verified(differing.isEmpty(), reconciler->requests());
+                    sync_now();
+                });
+        reconciler->start();
+    }
+
+    void SyncEngine::sync_now() {
+        m_IntervalMs = k_MinPollMs;
+        if (m_InFlight) {
+            m_Again = true;
+            return;
+        }
+        m_PollTimer.stop();
+        poll();
+    }
+
+    void SyncEngine::reset() {
+        QStringList removed = m_Files.keys();
+        clear();
+        m_SaveTimer.stop();
+        QFile::remove(MetadataSnapshot::path_for("sync", m_LoadedFor));
+        if (!removed.isEmpty())
+            emit changed({}, removed);
+    }
+
+    void SyncEngine::switch_server() {
+        if (m_SaveTimer.isActive()) {
+            m_SaveTimer.stop();
+            save();
+        }
+        QStringList removed = m_Files.keys();
+        clear();
+        load();
+        QStringList updated = m_Files.keys();
+        if (!removed.isEmpty() || !updated.isEmpty())
+            emit changed(updated, removed);
+    }
+
+    void SyncEngine::clear() {
+        m_Files.clear();
+        m_Tombstones.clear();
+        m_Tree.clear();
+        m_Cursor = 0;
+        m_Verifying = false;
+        m_VerifyPending = true;
+        m_SkewKnown = false;
+        m_InFlight = false;
+        m_Again = false;
+        m_Generation++;
+    }
+
+    std::optional<FileInfo> SyncEngine::file(const QString& path) const {
+        auto it = m_Files.constFind(path);
+        if (it == m_Files.constEnd())
+            return std::nullopt;
+        return *it;
+    }
+
+    Timestamp SyncEngine::server_now() const { return QDateTime::currentMSecsSinceEpoch() + m_SkewMs; }
+
+    void SyncEngine::poll() {
+        // Each server has its own index
+        if (m_LoadedFor != m_Api->server_url())
+            switch_server();
+
+        if (m_Verifying)
+            return;
+        m_InFlight = true;
+        bool full = m_Cursor == 0 || server_now() - m_Cursor > k_MaxDeltaAgeMs;
+        std::optional<Timestamp> since;
+        if (!full)
+            since = std::max<Timestamp>(0, m_Cursor - k_OverlapMs);
+
+        qint64 sent_at = QDateTime::currentMSecsSinceEpoch();
+        quint64 generation = m_Generation;
+        QPointer<SyncEngine> self(this);
+        m_Api->get_sync_state(
+            [self, full, sent_at, generation](bool ok, SyncState state) {
+                if (!self || self->m_Generation != generation)
+                    return;
+                self->on_state(ok, state, full, sent_at);
+            },
+            since);
+    }
+
+    void SyncEngine::on_state(bool ok, const SyncState& state, bool full, qint64 sent_at) {
+        m_InFlight = false;
+        if (!ok) {
+            emit sync_failed();
+            schedule_next(false);
+            return;
+        }
+
+        note_skew(state.server_time, sent_at);
+
+        QStringList updated;
+        QStringList removed;
+        if (full) {
+            apply_full(state, updated, removed);
+        } else {
+            for (const auto& f : state.files)
+                apply_delta(f, updated, removed);
+        }
+        // A server that doesn't report its time leaves the cursor where it was, except on the first sync
+        if (state.server_time > 0)
+            m_Cursor = std::max(m_Cursor, state.server_time);
+        else if (m_Cursor == 0)
+            m_Cursor = server_now();
+        compact_tombstones();
+        m_SaveTimer.start();
+
+        bool any = !updated.isEmpty() || !removed.isEmpty();
+        if (any)
+            emit changed(updated, removed);
+        // A full listing is correct by construction; an index restored from disk is worth checking once
+        if (full)
+            m_VerifyPending = false;
+        if (m_VerifyPending && !m_Again) {
+            verify();
+            if (m_Verifying)
+                return;
+        }
+        schedule_next(any);
+    }
+
+    void SyncEngine::apply_full(const SyncState& state, QStringList& updated, QStringList& removed) {
+        QHash<QString, FileInfo> next;
+        next.reserve(state.files.size());
+        for (const auto& f : state.files) {
+            if (!f.is_deleted)
+                next.insert(f.path, f);
+        }
+        for (auto it = m_Files.constBegin(); it != m_Files.constEnd(); ++it) {
+            if (!next.contains(it.key()))
+                removed.append(it.key());
+        }
+        for (auto it = next.constBegin(); it != next.constEnd(); ++it) {
+            auto old = m_Files.constFind(it.key());
+            if (old == m_Files.constEnd() || !old->same_version(*it))
+                updated.append(it.key());
+        }
+        // A full listing is authoritative, so there is nothing left for tombstones to guard
+        m_Files = std::move(next);
+        m_Tombstones.clear();
+        m_Tree.clear();
+        for (const auto& f : m_Files)
+            m_Tree.insert(f.path, f.hash);
+    }
+
+    void SyncEngine::apply_delta(const FileInfo& f, QStringList& updated, QStringList& removed) {
+        // Records replayed from the overlap window may be older than what is already applied
+        Timestamp version = version_of(f);
+        auto tomb = m_Tombstones.constFind(f.path);
+        if (tomb != m_Tombstones.constEnd() && *tomb > version)
+            return;
+        auto live = m_Files.find(f.path);
+        if (live != m_Files.end() && version_of(*live) > version)
+            return;
+
+        if (f.is_deleted) {
+            m_Tombstones.insert(f.path, version);
+            if (live != m_Files.end()) {
+                m_Files.erase(live);
+                m_Tree.remove(f.path);
+                removed.append(f.path);
+            }
+            return;
+        }
+
+        m_Tombstones.remove(f.path);
+        if (live == m_Files.end()) {
+            m_Files.insert(f.path, f);
+            m_Tree.insert(f.path, f.hash);
+            updated.append(f.path);
+        } else if (!live->same_version(f)) {
+            *live = f;
+            m_Tree.insert(f.path, f.hash);
+            updated.append(f.path);
+        }
+    }
+
+    void SyncEngine::compact_tombstones() {
+        // Anything older than the next request's window can no longer be contradicted by a replay
+        Timestamp horizon = m_Cursor - 2 * k_OverlapMs;
+        for (auto it = m_Tombstones.begin(); it != m_Tombstones.end();) {
+            if (*it < horizon)
+                it = m_Tombstones.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    void SyncEngine::schedule_next(bool changed) {
+        if (m_Again) {
+            m_Again = false;
+            m_IntervalMs = k_MinPollMs;
+            poll();
+            return;
+        }
+        if (!m_Running)
+            return;
+        m_IntervalMs = changed ? k_MinPollMs : std::min(m_IntervalMs * 2, k_MaxPollMs);
+        m_PollTimer.start(m_IntervalMs);
+    }
+
+    void SyncEngine::note_skew(Timestamp server_time, qint64 sent_at) {
+        if (server_time <= 0)
+            return;
+        // Assume the server stamped the response halfway through the round trip
+        qint64 now = QDateTime::currentMSecsSinceEpoch();
+        qint64 sample = server_time - (sent_at + (now - sent_at) / 2);
+        m_SkewMs = m_SkewKnown ? m_SkewMs + (sample - m_SkewMs) / 8 : sample;
+        m_SkewKnown = true;
+    }
+
+    void SyncEngine::load() {
+        m_LoadedFor = m_Api->server_url();
+        if (auto snapshot = MetadataSnapshot::read(MetadataSnapshot::path_for("sync", m_LoadedFor))) {
+            m_Cursor = snapshot->cursor;
+            m_Files.reserve(snapshot->files.size());
+            for (auto& f : snapshot->files) {
+                m_Tree.insert(f.path, f.hash);
+                m_Files.insert(f.path, std::move(f));
+            }
+            for (const auto& [path, time] : std::as_const(snapshot->tombstones))
+                m_Tombstones.insert(path, time);
+        }
+    }
+
+    void SyncEngine::save() {
+        MetadataSnapshot snapshot;
+        snapshot.cursor = m_Cursor;
+        snapshot.files.reserve(m_Files.size());
+        for (const auto& f : std::as_const(m_Files))
+            snapshot.files.append(f);
+        snapshot.tombstones.reserve(m_Tombstones.size());
+        for (auto it = m_Tombstones.constBegin(); it != m_Tombstones.constEnd(); ++it)
+            snapshot.tombstones.append({it.key(), it.value()});
+        snapshot.write(MetadataSnapshot::path_for("sync", m_LoadedFor));
+    }
+
+} // namespace sap::client
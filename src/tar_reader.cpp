@@ -0,0 +1,119 @@
+#include "sap_cloud_client/tar_reader.h"
+#include <QHash>
+
+namespace {
+
+    constexpr qint64 k_BlockSize = 512;
+
+    qint64 padded(qint64 size) { return (size + k_BlockSize - 1) / k_BlockSize * k_BlockSize; }
+
+    QByteArray field(const QByteArray& block, int offset, int width) {
+        QByteArray f = block.mid(offset, width);
+        qsizetype nul = f.indexOf('\0');
+        return nul >= 0 ? f.left(nul) : f;
+    }
+
+    qint64 octal(const QByteArray& block, int offset, int width) {
+        bool ok = false;
+        qint64 v = field(block, offset, width).trimmed().toLongLong(&ok, 8);
+        return ok ? v : -1;
+    }
+
+    bool checksum_ok(const QByteArray& block) {
+        unsigned sum = 0;
+        for (int i = 0; i < k_BlockSize; ++i)
+            sum += (i >= 148 && i < 156) ? ' ' : static_cast<unsigned char>(block[i]);
+        return octal(block, 148, 8) == static_cast<qint64>(sum);
+    }
+
+    // "<len> key=value\n" records
+    QHash<QByteArray, QByteArray> parse_pax(const QByteArray& data) {
+        QHash<QByteArray, QByteArray> out;
+        qsizetype pos = 0;
+        while (pos < data.size()) {
+            qsizetype space = data.indexOf(' ', pos);
+            if (space < 0)
+                break;
+            qint64 len = data.mid(pos, space - pos).toLongLong();
+            if (len <= 0 || pos + len > data.size())
+                break;
+            QByteArray record = data.mid(space + 1, pos + len - space - 2);
+            qsizetype eq = record.indexOf('=');
+            if (eq > 0)
+                out.insert(record.left(eq), record.mid(eq + 1));
+            pos += len;
+        }
+        return out;
+    }
+
+} // anonymous namespace
+
+namespace sap::client {
+
+    TarReader::TarReader(const QString& path) : m_File(path) {}
+
+    bool TarReader::open() {
+        if (!m_File.open(QIODevice::ReadOnly)) {
+            m_LastError = "Cannot open " + m_File.fileName() + ": " + m_File.errorString();
+            return false;
+        }
+        m_Pos = 0;
+        return true;
+    }
+
+    std::optional<TarReader::Entry> TarReader::next() {
+        QHash<QByteArray, QByteArray> pax;
+        while (true) {
+            if (!m_File.seek(m_Pos))
+                return std::nullopt;
+            QByteArray block = m_File.read(k_BlockSize);
+            if (block.size() < k_BlockSize || block.count('\0') == k_BlockSize)
+                return std::nullopt;
+            if (!checksum_ok(block)) {
+                m_LastError = QString("Corrupt tar header at offset %1").arg(m_Pos);
+                return std::nullopt;
+            }
+
+            qint64 size = octal(block, 124, 12);
+            if (pax.contains("size"))
+                size = pax.value("size").toLongLong();
+            if (size < 0) {
+                m_LastError = QString("Corrupt tar header at offset %1").arg(m_Pos);
+                return std::nullopt;
+            }
+            char type = block[156];
+            qint64 data = m_Pos + k_BlockSize;
+            m_Pos = data + padded(size);
+
+            if (type == 'x') {
+                m_File.seek(data);
+                pax = parse_pax(m_File.read(size));
+                continue;
+            }
+            if (type != '0' && type != '\0') {
+                pax.clear();
+                continue;
+            }
+
+            Entry e;
+            QByteArray name = field(block, 0, 100);
+            QByteArray prefix = field(block, 345, 155);
+            if (!prefix.isEmpty())
+                name = prefix + '/' + name;
+            if (pax.contains("path"))
+                name = pax.value("path");
+            e.name = QString::fromUtf8(name);
+            e.offset = data;
+            e.size = size;
+            e.mtime_ms = qMax<qint64>(0, octal(block, 136, 12)) * 1000;
+            return e;
+        }
+    }
+
+    QByteArray TarReader::read(const Entry& entry) {
+        if (!m_File.seek(entry.offset))
+            return {};
+        return m_File.read(entry.size);
+    }
+
+} // namespace sap::client
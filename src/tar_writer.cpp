@@ -0,0 +1,156 @@
+#include "sap_cloud_client/tar_writer.h"
+#include <cstring>
+
+namespace {
+
+    constexpr qint64 k_MaxOctalSize = 077777777777LL; // 11 octal digits
+    constexpr int k_NameSize = 100;
+    constexpr int k_PrefixSize = 155;
+
+    qint64 padded(qint64 size) {
+        constexpr qint64 block = sap::client::TarWriter::k_BlockSize;
+        return (size + block - 1) / block * block;
+    }
+
+    void put_octal(char* field, int width, qint64 value) {
+        QByteArray digits = QByteArray::number(value, 8).rightJustified(width - 1, '0');
+        std::memcpy(field, digits.constData(), width - 1);
+        field[width - 1] = '\0';
+    }
+
+    // ustar splits long names at a '/' into prefix (155) and name (100)
+    bool split_name(const QByteArray& path, QByteArray& prefix, QByteArray& name) {
+        if (path.size() <= k_NameSize) {
+            name = path;
+            return true;
+        }
+        for (qsizetype i = path.size() - 1; i > 0; --i) {
+            if (path[i] != '/')
+                continue;
+            if (i > k_PrefixSize)
+                continue;
+            if (path.size() - i - 1 > k_NameSize)
+                return false;
+            prefix = path.left(i);
+            name = path.mid(i + 1);
+            return true;
+        }
+        return false;
+    }
+
+    // "<len> key=value\n" where len counts the whole record including its own digits
+    QByteArray pax_record(const QByteArray& key, const QByteArray& value) {
+        qsizetype body = key.size() + value.size() + 3;
+        qsizetype len = body + QByteArray::number(body).size();
+        if (QByteArray::number(len).size() + body != len)
+            len++;
+        return QByteArray::number(len) + ' ' + key + '=' + value + '\n';
+    }
+
+    // Archive names are relative and never climb out of the extraction directory
+    QByteArray clean_name(const QString& name) {
+        QStringList parts;
+        for (const auto& part : name.split('/', Qt::SkipEmptyParts)) {
+            if (part == "." || part == "..")
+                continue;
+            parts.append(part);
+        }
+        return parts.join('/').toUtf8();
+    }
+
+} // anonymous namespace
+
+namespace sap::client {
+
+    TarWriter::TarWriter(const QString& path) : m_File(path) {}
+
+    bool TarWriter::open() {
+        // Unbuffered: entries are written at scattered offsets, so a write buffer would only reorder them
+        if (!m_File.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered)) {
+            m_LastError = "Cannot create " + m_File.fileName() + ": " + m_File.errorString();
+            return false;
+        }
+        m_End = 0;
+        return true;
+    }
+
+    bool TarWriter::write_header(const QByteArray& name, qint64 size, Timestamp mtime_ms, char type) {
+        QByteArray block(k_BlockSize, '\0');
+        char* h = block.data();
+
+        QByteArray prefix, short_name;
+        QByteArray pax;
+        if (!split_name(name, prefix, short_name)) {
+            pax += pax_record("path", name);
+            prefix.clear();
+            short_name = name.right(k_NameSize);
+        }
+        if (size > k_MaxOctalSize)
+            pax += pax_record("size", QByteArray::number(size));
+
+        if (!pax.isEmpty()) {
+            if (!write_header("PaxHeaders/" + short_name.right(k_NameSize - 11), pax.size(), mtime_ms, 'x'))
+                return false;
+            if (!write_at(m_End, pax.constData(), pax.size()))
+                return false;
+            m_End += padded(pax.size());
+        }
+
+        std::memcpy(h, short_name.constData(), qMin<qsizetype>(short_name.size(), k_NameSize));
+        put_octal(h + 100, 8, 0644);
+        put_octal(h + 108, 8, 0);
+        put_octal(h + 116, 8, 0);
+        put_octal(h + 124, 12, qMin(size, k_MaxOctalSize));
+        put_octal(h + 136, 12, qMax<qint64>(0, mtime_ms / 1000));
+        h[156] = type;
+        std::memcpy(h + 257, "ustar", 6);
+        std::memcpy(h + 263, "00", 2);
+        std::memcpy(h + 345, prefix.constData(), qMin<qsizetype>(prefix.size(), k_PrefixSize));
+
+        // Checksum is computed with its own field set to spaces
+        std::memset(h + 148, ' ', 8);
+        unsigned sum = 0;
+        for (char c : block)
+            sum += static_cast<unsigned char>(c);
+        put_octal(h + 148, 7, sum);
+        h[155] = ' ';
+
+        if (!write_at(m_End, block.constData(), k_BlockSize))
+            return false;
+        m_End += k_BlockSize;
+        return true;
+    }
+
+    qint64 TarWriter::reserve(const QString& name, qint64 size, Timestamp mtime_ms) {
+        if (!write_header(clean_name(name), size, mtime_ms, '0'))
+            return -1;
+        qint64 data = m_End;
+        m_End += padded(size);
+        return data;
+    }
+
+    bool TarWriter::write_at(qint64 offset, const char* data, qint64 length) {
+        if (!m_File.seek(offset) || m_File.write(data, length) != length) {
+            m_LastError = "Cannot write " + m_File.fileName() + ": " + m_File.errorString();
+            return false;
+        }
+        return true;
+    }
+
+    bool TarWriter::append(const QString& name, const QByteArray& data, Timestamp mtime_ms) {
+        qint64 offset = reserve(name, data.size(), mtime_ms);
+        return offset >= 0 && write_at(offset, data.constData(), data.size());
+    }
+
+    bool TarWriter::finish() {
+        if (!m_File.isOpen())
+            return false;
+        // Two zero blocks end the archive; resizing also materializes any trailing unwritten region
+        bool ok = m_File.resize(m_End + 2 * k_BlockSize);
+        if (!ok)
+            m_LastError = "Cannot write " + m_File.fileName() + ": " + m_File.errorString();
+        m_File.close();
+        return ok;
+    }
+
+} // namespace sap::client
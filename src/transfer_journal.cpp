@@ -0,0 +1,239 @@
+#include "sap_cloud_client/transfer_journal.h"
+#include <QDataStream>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <array>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+namespace {
+
+    constexpr char k_Magic[4] = {'S', 'A', 'P', 'J'};
+    constexpr int k_HeaderSize = 8;
+    constexpr int k_RecordHeaderSize = 8;
+    // A sane upper bound for one entry; anything larger is garbage from a torn write
+    constexpr quint32 k_MaxRecordSize = 1024 * 1024;
+
+    // CRC-32 (IEEE 802.3), table generated at compile time
+    constexpr std::array<quint32, 256> make_crc_table() {
+        std::array<quint32, 256> table{};
+        for (quint32 i = 0; i < 256; ++i) {
+            quint32 c = i;
+            for (int k = 0; k < 8; ++k) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+        return table;
+    }
+
+    constexpr auto k_CrcTable = make_crc_table();
+
+    quint32 crc32(const QByteArray& data) {
+        quint32 c = 0xFFFFFFFFu;
+        for (char ch : data) {
+            c = k_CrcTable[(c ^ static_cast<quint8>(ch)) & 0xFF] ^ (c >> 8);
+        }
+        return c ^ 0xFFFFFFFFu;
+    }
+
+    void put_u32(QByteArray& out, quint32 v) {
+        out.append(static_cast<char>(v & 0xFF));
+        out.append(static_cast<char>((v >> 8) & 0xFF));
+        out.append(static_cast<char>((v >> 16) & 0xFF));
+        out.append(static_cast<char>((v >> 24) & 0xFF));
+    }
+
+    quint32 get_u32(const char* p) {
+        return static_cast<quint8>(p[0]) | (static_cast<quint8>(p[1]) << 8) | (static_cast<quint8>(p[2]) << 16) |
+            (static_cast<quint32>(static_cast<quint8>(p[3])) << 24);
+    }
+
+    QByteArray encode(const sap::client::TransferJournal::Entry& e) {
+        QByteArray out;
+        QDataStream ds(&out, QIODevice::WriteOnly);
+        ds.setVersion(QDataStream::Qt_6_0);
+        ds << e.id << static_cast<quint8>(e.kind) << e.remote_path << e.local_path << e.expected_hash << e.size << e.committed
+           << e.upload_id << e.part_size << e.acked_parts << e.local_mtime << static_cast<qint32>(e.attempts);
+        return out;
+    }
+
+    bool decode(const QByteArray& data, sap::client::TransferJournal::Entry& e) {
+        QDataStream ds(data);
+        ds.setVersion(QDataStream::Qt_6_0);
+        quint8 kind = 0;
+        qint32 attempts = 0;
+        ds >> e.id >> kind >> e.remote_path >> e.local_path >> e.expected_hash >> e.size >> e.committed >> e.upload_id >> e.part_size >>
+            e.acked_parts >> e.local_mtime >> attempts;
+        e.kind = static_cast<sap::client::TransferJournal::Kind>(kind);
+        e.attempts = attempts;
+        return ds.status() == QDataStream::Ok;
+    }
+
+    void sync_to_disk(QFile& file) {
+        file.flush();
+#ifdef Q_OS_UNIX
+        ::fsync(file.handle());
+#endif
+    }
+
+} // anonymous namespace
+
+namespace sap::client {
+
+    TransferJournal::TransferJournal(const QString& path) : m_File(path) {}
+
+    bool TransferJournal::open() {
+        m_LastError.clear();
+        m_Entries.clear();
+        m_Records = 0;
+        QDir().mkpath(QFileInfo(m_File.fileName()).absolutePath());
+
+        if (!m_File.open(QIODevice::ReadWrite)) {
+            m_LastError = "Cannot open transfer journal: " + m_File.errorString();
+            return false;
+        }
+
+        QByteArray header = m_File.read(k_HeaderSize);
+        if (header.size() < k_HeaderSize || !header.startsWith(QByteArray(k_Magic, 4)) || get_u32(header.constData() + 4) != k_Version) {
+            // Empty, foreign or from an incompatible version: nothing to resume
+            m_File.resize(0);
+            m_File.seek(0);
+            if (!write_header(m_File)) {
+                m_LastError = "Cannot write transfer journal: " + m_File.errorString();
+                return false;
+            }
+            return true;
+        }
+
+        qint64 good_end = m_File.pos();
+        while (true) {
+            QByteArray rec_header = m_File.read(k_RecordHeaderSize);
+            if (rec_header.size() < k_RecordHeaderSize)
+                break;
+            quint32 length = get_u32(rec_header.constData());
+            quint32 crc = get_u32(rec_header.constData() + 4);
+            if (length == 0 || length > k_MaxRecordSize)
+                break;
+            QByteArray payload = m_File.read(length);
+            if (payload.size() != static_cast<int>(length) || crc32(payload) != crc)
+                break;
+
+            auto op = static_cast<Op>(payload.at(0));
+            QByteArray body = payload.mid(1);
+            if (op == Op::Put) {
+                Entry e;
+                if (!decode(body, e))
+                    break;
+                m_Entries.insert(e.id, e);
+                m_NextId = qMax(m_NextId, e.id + 1);
+            } else if (op == Op::Remove) {
+                QDataStream ds(body);
+                quint64 id = 0;
+                ds >> id;
+                m_Entries.remove(id);
+                m_NextId = qMax(m_NextId, id + 1);
+            } else {
+                break;
+            }
+            m_Records++;
+            good_end = m_File.pos();
+        }
+
+        // Drop a torn tail so new records start on a clean boundary
+        if (good_end < m_File.size())
+            m_File.resize(good_end);
+        m_File.seek(good_end);
+
+        compact();
+        return true;
+    }
+
+    quint64 TransferJournal::add(Entry entry) {
+        entry.id = m_NextId++;
+        update(entry);
+        return entry.id;
+    }
+
+    void TransferJournal::update(const Entry& entry) {
+        m_Entries.insert(entry.id, entry);
+        append(Op::Put, encode(entry));
+    }
+
+    void TransferJournal::remove(quint64 id) {
+        if (!m_Entries.remove(id))
+            return;
+        QByteArray body;
+        QDataStream ds(&body, QIODevice::WriteOnly);
+        ds << id;
+        append(Op::Remove, body);
+        compact();
+    }
+
+    const TransferJournal::Entry* TransferJournal::find(quint64 id) const {
+        auto it = m_Entries.constFind(id);
+        return it == m_Entries.constEnd() ? nullptr : &it.value();
+    }
+
+    bool TransferJournal::append(Op op, const QByteArray& payload) {
+        if (!m_File.isOpen())
+            return false;
+
+        QByteArray body;
+        body.append(static_cast<char>(op));
+        body.append(payload);
+
+        QByteArray record;
+        put_u32(record, static_cast<quint32>(body.size()));
+        put_u32(record, crc32(body));
+        record.append(body);
+
+        if (m_File.write(record) != record.size()) {
+            m_LastError = "Cannot write transfer journal: " + m_File.errorString();
+            return false;
+        }
+        sync_to_disk(m_File);
+        m_Records++;
+        return true;
+    }
+
+    bool TransferJournal::write_header(QIODevice& file) {
+        QByteArray header(k_Magic, 4);
+        put_u32(header, k_Version);
+        return file.write(header) == header.size();
+    }
+
+    void TransferJournal::compact() {
+        // Only worth it once most records are superseded updates
+        if (m_Records < 64 || m_Records < 4 * m_Entries.size())
+            return;
+
+        QSaveFile out(m_File.fileName());
+        if (!out.open(QIODevice::WriteOnly) || !write_header(out))
+            return;
+        for (const auto& e : m_Entries) {
+            QByteArray body;
+            body.append(static_cast<char>(Op::Put));
+            body.append(encode(e));
+            QByteArray record;
+            put_u32(record, static_cast<quint32>(body.size()));
+            put_u32(record, crc32(body));
+            record.append(body);
+            out.write(record);
+        }
+        if (!out.commit())
+            return;
+
+        // The old handle points at the replaced inode; reopen at the end of the new log
+        m_File.close();
+        if (m_File.open(QIODevice::ReadWrite | QIODevice::Append)) {
+            m_Records = m_Entries.size();
+        } else {
+            m_LastError = "Cannot reopen transfer journal: " + m_File.errorString();
+        }
+    }
+
+} // namespace sap::client
@@ -0,0 +1,622 @@
+#include "sap_cloud_client/transfer_manager.h"
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QFuture>
+#include <QNetworkInformation>
+#include <QPointer>
+#include <QPromise>
+#include <QStandardPaths>
+#include <QThreadPool>
+#include <QTimer>
+#include <atomic>
+#include <memory>
+#include <utility>
+#include "sap_cloud_client/dedup_upload.h"
+#include "sap_cloud_client/hash_service.h"
+#include "sap_cloud_client/segmented_download.h"
+#include "sap_cloud_client/tree_scanner.h"
+#include "sap_cloud_client/upload_session.h"
+
+namespace {
+
+    QString key_path() { return QDir::homePath() + "/.sapcloud/drive.key"; }
+
+} // anonymous namespace
+
+namespace sap::client {
+
+    TransferManager::TransferManager(ApiClient* api, TransferScheduler* scheduler, QObject* parent) :
+        QObject(parent), m_Api(api), m_Scheduler(scheduler),
+        m_Journal(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/transfers.journal"),
+        m_ChunkIndex(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/chunks.index") {
+        m_Clock.start();
+        // Running jobs see the cancel through their abort function; queued ones only through this
+        connect(m_Scheduler, &TransferScheduler::job_finished, this, [this](TransferScheduler::JobId job, bool) {
+            auto it = m_JobEntries.constFind(job);
+            const auto* state = m_Scheduler->job(job);
+            if (it != m_JobEntries.constEnd() && state && state->state == TransferScheduler::JobState::Cancelled)
+                finish_entry(it.value(), false, true);
+        });
+        if (!m_Journal.open()) {
+            qWarning() << m_Journal.last_error();
+        }
+        if (!m_ChunkIndex.open()) {
+            qWarning() << m_ChunkIndex.last_error();
+        }
+        // Without a key, sealed downloads are kept as they are
+        m_Cipher.load_key(key_path());
+
+        // Coming back online is the natural moment to pick up interrupted transfers
+        if (QNetworkInformation::loadDefaultBackend()) {
+            connect(QNetworkInformation::instance(), &QNetworkInformation::reachabilityChanged, this,
+                    [this](QNetworkInformation::Reachability reachability) {
+                        if (reachability == QNetworkInformation::Reachability::Online && m_Api->is_authenticated())
+                            resume_pending();
+                    });
+        }
+    }
+
+    TransferScheduler::JobId TransferManager::download(const FileInfo& file, const QString& local_path) {
+        TransferJournal::Entry entry;
+        entry.kind = TransferJournal::Kind::Download;
+        entry.remote_path = file.path;
+        entry.local_path = local_path;
+        entry.expected_hash = file.hash;
+        entry.size = file.size;
+        return enqueue_entry(m_Journal.add(entry));
+    }
+
+    TransferScheduler::JobId TransferManager::upload(const QString& local_path, const QString& remote_path) {
+        TransferJournal::Entry entry;
+        entry.kind = TransferJournal::Kind::Upload;
+        entry.remote_path = remote_path;
+        entry.local_path = local_path;
+        entry.size = QFileInfo(local_path).size();
+        return enqueue_entry(m_Journal.add(entry));
+    }
+
+    bool TransferManager::set_encryption(bool enabled) {
+        if (enabled && !m_Cipher.has_key()) {
+            // A key file we can't read is still the only key for everything sealed with it
+            if (QFile::exists(key_path())) {
+                if (!m_Cipher.load_key(key_path()))
+                    return false;
+            } else if (!m_Cipher.generate_key() || !m_Cipher.save_key(key_path())) {
+                return false;
+            }
+        }
+        m_EncryptUploads = enabled;
+        return true;
+    }
+
+    void TransferManager::upload_batch(const QVector<UploadItem>& items) {
+        if (items.isEmpty())
+            return;
+        // Plaintext hashes say nothing about sealed content, and linking could store it unencrypted
+        if (m_EncryptUploads || !m_Api->supports(ApiClient::Feature::Preflight)) {
+            for (const auto& item : items)
+                upload(item.local_path, item.remote_path);
+            return;
+        }
+
+        QString label = items.size() == 1 ? QFileInfo(items.first().remote_path).fileName() : QString("%1 files").arg(items.size());
+        m_Scheduler->enqueue(TransferScheduler::JobKind::Other, label, 0,
+                             [this, items](ProgressFn, TransferScheduler::DoneFn done) { return run_preflight(items, done); });
+    }
+
+    void TransferManager::upload_tree(const QString& local_dir, const QString& remote_prefix) {
+        QString label = QString("Scanning %1").arg(QFileInfo(local_dir).fileName());
+        m_Scheduler->enqueue(TransferScheduler::JobKind::Other, label, 0,
+                             [this, local_dir, remote_prefix](ProgressFn, TransferScheduler::DoneFn done) {
+                                 return run_tree_scan(local_dir, remote_prefix, done);
+                             });
+    }
+
+    void TransferManager::resume_pending() {
+        for (const auto& entry : m_Journal.entries()) {
+            if (!m_Active.contains(entry.id))
+                enqueue_entry(entry.id);
+        }
+    }
+
+    TransferManager::UploadStats TransferManager::take_upload_stats() { return std::exchange(m_UploadStats, {}); }
+
+    TransferScheduler::JobId TransferManager::enqueue_entry(quint64 entry_id) {
+        const auto* entry = m_Journal.find(entry_id);
+        if (!entry)
+            return 0;
+
+        bool is_download = entry->kind == TransferJournal::Kind::Download;
+        auto kind = is_download ? TransferScheduler::JobKind::Download : TransferScheduler::JobKind::Upload;
+        auto job = m_Scheduler->enqueue(kind, QFileInfo(entry->remote_path).fileName(), entry->size,
+                                        [this, entry_id, is_download](ProgressFn progress, TransferScheduler::DoneFn done) {
+                                            return is_download ? run_download(entry_id, progress, done) : run_upload(entry_id, progress, done);
+                                        });
+        m_Active.insert(entry_id, job);
+        m_JobEntries.insert(job, entry_id);
+        return job;
+    }
+
+    TransferScheduler::AbortFn TransferManager::run_download(quint64 entry_id, ProgressFn progress, TransferScheduler::DoneFn done) {
+        const auto* found = m_Journal.find(entry_id);
+        if (!found) {
+            done(false);
+            return {};
+        }
+        TransferJournal::Entry entry = *found;
+        entry.attempts++;
+        m_Journal.update(entry);
+
+        auto cancelled = std::make_shared<bool>(false);
+        auto finish = [this, entry_id, cancelled, done, local_path = entry.local_path, hash = entry.expected_hash](bool ok) {
+            if (!ok || *cancelled) {
+                finish_entry(entry_id, ok, *cancelled);
+                done(ok);
+                return;
+            }
+            auto decrypt = [this, entry_id, cancelled, done, local_path]() {
+                decrypt_download(local_path, [this, entry_id, cancelled, done](bool decrypted) {
+                    // The bytes matched the server, so fetching them again would fail the same way
+                    finish_entry(entry_id, decrypted, *cancelled, !decrypted);
+                    done(decrypted);
+                });
+            };
+            // Peers get the file as the server has it, so the copy has to happen before decryption
+            if (m_Peers)
+                m_Peers->offer(local_path, hash, decrypt);
+            else
+                decrypt();
+        };
+
+        // Only trust the journaled offset if the part file still backs it
+        qint64 offset = 0;
+        QFileInfo part(entry.part_path());
+        if (entry.committed > 0 && part.exists() && part.size() >= entry.committed)
+            offset = entry.committed;
+
+        if (offset > 0 || !m_Peers || !m_Peers->is_running() || entry.size < PeerCache::k_MinFileSize)
+            return run_server_download(entry_id, offset, progress, finish, cancelled);
+
+        // A peer on the LAN first; whatever it can't deliver comes from the server
+        auto abort = std::make_shared<TransferScheduler::AbortFn>();
+        auto peer_abort = m_Peers->fetch(entry.expected_hash, entry.size, entry.local_path, progress,
+                                         [this, entry_id, progress, finish, abort, cancelled](bool ok) {
+                                             if (ok || *cancelled) {
+                                                 finish(ok);
+                                                 return;
+                                             }
+                                             *abort = run_server_download(entry_id, 0, progress, finish, cancelled);
+                                         });
+        // Empty when the fetch gave up on the spot and the server download has already taken over
+        if (peer_abort)
+            *abort = peer_abort;
+        return [abort, cancelled]() {
+            *cancelled = true;
+            if (*abort)
+                (*abort)();
+        };
+    }
+
+    TransferScheduler::AbortFn TransferManager::run_server_download(quint64 entry_id, qint64 offset, ProgressFn progress,
+                                                                    std::function<void(bool)> finish, std::shared_ptr<bool> cancelled) {
+        const auto* found = m_Journal.find(entry_id);
+        if (!found) {
+            finish(false);
+            return {};
+        }
+        TransferJournal::Entry entry = *found;
+
+        if (offset == 0 && entry.size >= SegmentedDownload::k_MinFileSize) {
+            FileInfo info;
+            info.path = entry.remote_path;
+            info.size = entry.size;
+            info.hash = entry.expected_hash;
+
+            auto holder = std::make_shared<QPointer<SegmentedDownload>>();
+            auto on_progress = [this, entry_id, progress, holder](qint64 received, qint64 total) {
+                progress(received, total);
+                if (*holder)
+                    record_committed(entry_id, (*holder)->contiguous_prefix());
+            };
+            auto on_done = [this, entry_id, holder, finish](bool ok) {
+                // Still alive here (deleted later), so capture the final prefix for a resume
+                if (!ok && *holder)
+                    record_committed(entry_id, (*holder)->contiguous_prefix());
+                finish(ok);
+            };
+            *holder = m_Api->download_file_segmented(info, entry.local_path, on_progress, on_done);
+            return [holder, cancelled]() {
+                *cancelled = true;
+                if (*holder)
+                    (*holder)->abort();
+            };
+        }
+
+        auto on_progress = [this, entry_id, progress](qint64 written, qint64 total) {
+            progress(written, total);
+            record_committed(entry_id, written);
+        };
+        QPointer<QNetworkReply> reply = m_Api->resume_download(entry.remote_path, entry.local_path, offset, entry.expected_hash, on_progress,
+                                                                    finish);
+        return [reply, cancelled]() {
+            *cancelled = true;
+            if (reply)
+                reply->abort();
+        };
+    }
+
+    TransferScheduler::AbortFn TransferManager::run_tree_scan(const QString& local_dir, const QString& remote_prefix,
+                                                              TransferScheduler::DoneFn done) {
+        auto* scanner = new TreeScanner(local_dir, this);
+        QString root = scanner->root() + '/';
+        QString prefix = remote_prefix.isEmpty() || remote_prefix.endsWith('/') ? remote_prefix : remote_prefix + '/';
+
+        connect(scanner, &TreeScanner::batch, this, [this, root, prefix](const QStringList& relative_paths) {
+            QVector<UploadItem> items;
+            items.reserve(relative_paths.size());
+            for (const auto& relative : relative_paths)
+                items.append({root + relative, prefix + relative});
+            upload_batch(items);
+        });
+        connect(scanner, &TreeScanner::finished, this, [scanner, done](bool ok) {
+            // Files that were found are uploaded either way; ok only reports unreadable directories
+            if (!ok)
+                qWarning() << "Some folders under" << scanner->root() << "could not be read";
+            scanner->deleteLater();
+            done(ok);
+        });
+        scanner->start();
+
+        QPointer<TreeScanner> guard(scanner);
+        return [guard]() {
+            if (guard) {
+                guard->abort();
+                guard->deleteLater();
+            }
+        };
+    }
+
+    TransferScheduler::AbortFn TransferManager::run_preflight(const QVector<UploadItem>& items, TransferScheduler::DoneFn done) {
+        auto cancelled = std::make_shared<std::atomic<bool>>(false);
+
+        // Unreadable files get an empty hash and go through a normal upload, which reports the error
+        QStringList paths;
+        for (const auto& item : items)
+            paths.append(item.local_path);
+        QFuture<QStringList> future = HashService::hash_files(paths, cancelled);
+
+        future.then(this, [this, items, cancelled, done](QStringList hashes) {
+            if (*cancelled)
+                return;
+
+            QVector<FileCandidate> candidates;
+            QHash<QString, int> by_path;
+            for (int i = 0; i < items.size(); ++i) {
+                if (hashes[i].isEmpty()) {
+                    upload(items[i].local_path, items[i].remote_path);
+                    continue;
+                }
+                by_path.insert(items[i].remote_path, i);
+                candidates.append({items[i].remote_path, hashes[i], QFileInfo(items[i].local_path).size()});
+            }
+            if (candidates.isEmpty()) {
+                done(true);
+                return;
+            }
+
+            m_Api->preflight_files(candidates, [this, items, candidates, by_path, cancelled, done](bool ok, QHash<QString, PreflightStatus> results) {
+                if (*cancelled)
+                    return;
+                // The preflight is only an optimization: without an answer everything is uploaded
+                QVector<FileCandidate> known;
+                for (const auto& c : candidates) {
+                    auto status = ok ? results.value(c.path, PreflightStatus::Missing) : PreflightStatus::Missing;
+                    if (status == PreflightStatus::Exists) {
+                        m_UploadStats.files_unchanged++;
+                    } else if (status == PreflightStatus::Known) {
+                        known.append(c);
+                    } else {
+                        const auto& item = items[by_path.value(c.path)];
+                        upload(item.local_path, item.remote_path);
+                    }
+                }
+                if (known.isEmpty()) {
+                    done(true);
+                    return;
+                }
+
+                m_Api->link_files(known, [this, items, known, by_path, cancelled, done](bool ok, QStringList failed) {
+                    if (*cancelled)
+                        return;
+                    for (const auto& c : known) {
+                        if (ok && !failed.contains(c.path)) {
+                            m_UploadStats.files_linked++;
+                            continue;
+                        }
+                        const auto& item = items[by_path.value(c.path)];
+                        upload(item.local_path, item.remote_path);
+                    }
+                    done(true);
+                });
+            });
+        });
+
+        return [cancelled]() { *cancelled = true; };
+    }
+
+    TransferScheduler::AbortFn TransferManager::run_upload(quint64 entry_id, ProgressFn progress, TransferScheduler::DoneFn done) {
+        const auto* found = m_Journal.find(entry_id);
+        if (!found) {
+            done(false);
+            return {};
+        }
+        TransferJournal::Entry entry = *found;
+        entry.attempts++;
+        m_Journal.update(entry);
+
+        auto abort = std::make_shared<TransferScheduler::AbortFn>();
+        auto cancelled = std::make_shared<bool>(false);
+        start_upload(entry_id, progress, done, abort, cancelled);
+        return [abort, cancelled]() {
+            *cancelled = true;
+            if (*abort)
+                (*abort)();
+        };
+    }
+
+    void TransferManager::start_upload(quint64 entry_id, ProgressFn progress, TransferScheduler::DoneFn done,
+                                       std::shared_ptr<TransferScheduler::AbortFn> abort, std::shared_ptr<bool> cancelled) {
+        const auto* entry = m_Journal.find(entry_id);
+        if (!entry) {
+            done(false);
+            return;
+        }
+
+        // Sealed bodies have a fresh salt per attempt, so they can't be resumed in parts or deduplicated
+        if (m_EncryptUploads) {
+            run_plain_upload(entry_id, progress, done, abort, cancelled);
+        } else if (entry->size >= DedupUpload::k_MinFileSize && entry->upload_id.isEmpty() && m_Api->supports(ApiClient::Feature::ContentChunks)) {
+            run_dedup_upload(entry_id, progress, done, abort, cancelled);
+        } else if (entry->size >= UploadSession::k_MinFileSize && m_Api->supports(ApiClient::Feature::UploadSessions)) {
+            run_session_upload(entry_id, progress, done, abort, cancelled);
+        } else {
+            run_plain_upload(entry_id, progress, done, abort, cancelled);
+        }
+    }
+
+    void TransferManager::run_dedup_upload(quint64 entry_id, ProgressFn progress, TransferScheduler::DoneFn done,
+                                           std::shared_ptr<TransferScheduler::AbortFn> abort, std::shared_ptr<bool> cancelled) {
+        const auto* entry = m_Journal.find(entry_id);
+        auto* upload = new DedupUpload(m_Api, &m_ChunkIndex, entry->local_path, entry->remote_path, this);
+
+        connect(upload, &DedupUpload::progress, this, [progress](qint64 done, qint64 total) { progress(done, total); });
+        connect(upload, &DedupUpload::finished, this, [this, entry_id, upload, progress, done, abort, cancelled](bool ok) {
+            upload->deleteLater();
+            if (!ok && !*cancelled && !m_Api->supports(ApiClient::Feature::ContentChunks)) {
+                start_upload(entry_id, progress, done, abort, cancelled);
+                return;
+            }
+            if (ok) {
+                m_UploadStats.bytes_total += upload->bytes_total();
+                m_UploadStats.bytes_sent += upload->bytes_sent();
+            }
+            finish_entry(entry_id, ok, *cancelled);
+            done(ok);
+        });
+
+        QPointer<DedupUpload> guard(upload);
+        *abort = [guard]() {
+            if (guard)
+                guard->abort();
+        };
+        upload->start();
+    }
+
+    void TransferManager::run_session_upload(quint64 entry_id, ProgressFn progress, TransferScheduler::DoneFn done,
+                                             std::shared_ptr<TransferScheduler::AbortFn> abort, std::shared_ptr<bool> cancelled) {
+        const auto* entry = m_Journal.find(entry_id);
+        auto* session = new UploadSession(m_Api, entry->local_path, entry->remote_path, this);
+
+        connect(session, &UploadSession::session_created, this, [this, entry_id, session](const QString& upload_id, qint64 part_size) {
+            if (const auto* e = m_Journal.find(entry_id)) {
+                TransferJournal::Entry updated = *e;
+                updated.upload_id = upload_id;
+                updated.part_size = part_size;
+                updated.acked_parts.clear();
+                updated.local_mtime = session->local_mtime();
+                m_Journal.update(updated);
+            }
+        });
+        connect(session, &UploadSession::part_acked, this, [this, entry_id](int part) {
+            if (const auto* e = m_Journal.find(entry_id)) {
+                TransferJournal::Entry updated = *e;
+                if (updated.acked_parts.size() <= part)
+                    updated.acked_parts.resize(part + 1);
+                updated.acked_parts.setBit(part);
+                m_Journal.update(updated);
+            }
+        });
+        connect(session, &UploadSession::progress, this, [progress](qint64 sent, qint64 total) { progress(sent, total); });
+        connect(session, &UploadSession::finished, this, [this, entry_id, session, progress, done, abort, cancelled](bool ok, const FileInfo&) {
+            session->deleteLater();
+            // The server turned out not to have upload sessions: send it in one piece instead
+            if (!ok && !*cancelled && !m_Api->supports(ApiClient::Feature::UploadSessions)) {
+                start_upload(entry_id, progress, done, abort, cancelled);
+                return;
+            }
+            finish_entry(entry_id, ok, *cancelled);
+            done(ok);
+        });
+
+        QPointer<UploadSession> guard(session);
+        *abort = [guard]() {
+            if (guard)
+                guard->abort();
+        };
+        if (entry->upload_id.isEmpty()) {
+            session->start();
+        } else {
+            session->resume(entry->upload_id, entry->local_mtime);
+        }
+    }
+
+    void TransferManager::run_plain_upload(quint64 entry_id, ProgressFn progress, TransferScheduler::DoneFn done,
+                                           std::shared_ptr<TransferScheduler::AbortFn> abort, std::shared_ptr<bool> cancelled) {
+        const auto* entry = m_Journal.find(entry_id);
+        UploadSource* source = nullptr;
+        if (entry)
+            source = m_EncryptUploads ? new UploadSource(entry->local_path, &m_Cipher) : new UploadSource(entry->local_path);
+        if (!source || !source->open(QIODevice::ReadOnly)) {
+            delete source;
+            finish_entry(entry_id, false, false);
+            done(false);
+            return;
+        }
+
+        QPointer<QNetworkReply> reply = m_Api->upload_file(entry->remote_path, source, progress, [this, entry_id, cancelled, done](bool ok, QString) {
+            finish_entry(entry_id, ok, *cancelled);
+            done(ok);
+        });
+        *abort = [api = m_Api, reply]() { api->abort(reply); };
+    }
+
+    void TransferManager::decrypt_download(const QString& local_path, std::function<void(bool)> done) {
+        switch (m_Cipher.probe_file(local_path)) {
+        case DriveCipher::Probe::Plain:
+            done(true);
+            return;
+        case DriveCipher::Probe::Unreadable:
+            emit m_Api->error("Cannot decrypt " + local_path + " with this key, kept it as downloaded");
+            done(true);
+            return;
+        case DriveCipher::Probe::Sealed:
+            break;
+        }
+
+        // Chunk-by-chunk through the file on the pool into a save file; a failed tag leaves the download as it was
+        auto promise = std::make_shared<QPromise<QString>>();
+        QFuture<QString> future = promise->future();
+        promise->start();
+        // The task decrypts with the key it was queued under, even if set_encryption() swaps it meanwhile
+        QThreadPool::globalInstance()->start([promise, cipher = m_Cipher, local_path]() {
+            QString error;
+            cipher.decrypt_file(local_path, local_path, &error);
+            promise->addResult(error);
+            promise->finish();
+        });
+        future.then(this, [this, done, local_path](QString error) {
+            if (!error.isEmpty())
+                emit m_Api->error(error + ", kept " + local_path + " encrypted");
+            done(error.isEmpty());
+        });
+    }
+
+    void TransferManager::restore_copy(const QString& source, const QString& local_path, std::function<void(bool)> done) {
+        DriveCipher::Probe probe = m_Cipher.probe_file(source);
+        if (probe == DriveCipher::Probe::Unreadable) {
+            emit m_Api->error("Cannot decrypt the offline copy of " + local_path + " with this key");
+            done(false);
+            return;
+        }
+
+        // Both paths replace local_path only once the new content is complete
+        bool sealed = probe == DriveCipher::Probe::Sealed;
+        auto promise = std::make_shared<QPromise<QString>>();
+        QFuture<QString> future = promise->future();
+        promise->start();
+        QThreadPool::globalInstance()->start([promise, cipher = m_Cipher, source, local_path, sealed]() {
+            QString error;
+            if (sealed) {
+                cipher.decrypt_file(source, local_path, &error);
+            } else {
+                QString temp = local_path + ".restoring";
+                QFile::remove(temp);
+                if (!QFile::copy(source, temp)) {
+                    error = "Cannot copy offline copy to " + local_path;
+                } else {
+                    QFile::remove(local_path);
+                    if (!QFile::rename(temp, local_path))
+                        error = "Cannot copy offline copy to " + local_path;
+                }
+                QFile::remove(temp);
+            }
+            promise->addResult(error);
+            promise->finish();
+        });
+        future.then(this, [this, done](QString error) {
+            if (!error.isEmpty())
+                emit m_Api->error(error);
+            done(error.isEmpty());
+        });
+    }
+
+    void TransferManager::record_committed(quint64 entry_id, qint64 committed) {
+        auto& rec = m_Recorded[entry_id];
+        rec.latest = committed;
+        qint64 now = m_Clock.elapsed();
+        if (committed - rec.committed < k_RecordIntervalBytes && now - rec.at < k_RecordIntervalMs)
+            return;
+
+        const auto* entry = m_Journal.find(entry_id);
+        if (!entry || entry->committed == committed)
+            return;
+        TransferJournal::Entry updated = *entry;
+        updated.committed = committed;
+        m_Journal.update(updated);
+        rec.committed = committed;
+        rec.at = now;
+    }
+
+    void TransferManager::finish_entry(quint64 entry_id, bool ok, bool cancelled, bool permanent) {
+        auto active = m_Active.constFind(entry_id);
+        if (active != m_Active.constEnd()) {
+            m_JobEntries.remove(active.value());
+            m_Active.erase(active);
+        }
+        bool has_progress = m_Recorded.contains(entry_id);
+        Recorded rec = m_Recorded.take(entry_id);
+
+        const auto* entry = m_Journal.find(entry_id);
+        if (!entry)
+            return;
+
+        // Progress skipped by throttling still counts for the resume offset
+        if (!ok && !cancelled && has_progress && entry->kind == TransferJournal::Kind::Download && rec.latest != entry->committed) {
+            TransferJournal::Entry updated = *entry;
+            updated.committed = rec.latest;
+            m_Journal.update(updated);
+            entry = m_Journal.find(entry_id);
+        }
+
+        bool is_upload = entry->kind == TransferJournal::Kind::Upload;
+        QString local_path = entry->local_path;
+        if (ok) {
+            m_Journal.remove(entry_id);
+            if (is_upload)
+                emit upload_finished(local_path, true);
+            return;
+        }
+
+        if (cancelled || permanent || entry->attempts >= k_MaxAttempts) {
+            if (!is_upload) {
+                QFile::remove(entry->part_path());
+            } else if (!entry->upload_id.isEmpty()) {
+                m_Api->abort_upload(entry->upload_id, [](bool) {});
+            }
+            m_Journal.remove(entry_id);
+            if (is_upload)
+                emit upload_finished(local_path, false);
+            return;
+        }
+
+        // Transient failure: keep the partial state and retry with exponential backoff
+        int delay_ms = 1000 << qMin(entry->attempts, 6);
+        QTimer::singleShot(delay_ms, this, [this, entry_id]() {
+            if (!m_Active.contains(entry_id) && m_Journal.find(entry_id))
+                enqueue_entry(entry_id);
+        });
+    }
+
+} // namespace sap::client
@@ -0,0 +1,278 @@
+#include "sap_cloud_client/transfer_scheduler.h"
+#include <QPointer>
+#include <algorithm>
+#include <utility>
+
+namespace sap::client {
+
+    TransferScheduler::TransferScheduler(QObject* parent) : QObject(parent) {
+        m_Clock.start();
+
+        m_StatsTimer = new QTimer(this);
+        m_StatsTimer->setSingleShot(true);
+        m_StatsTimer->setInterval(k_StatsIntervalMs);
+        connect(m_StatsTimer, &QTimer::timeout, this, [this]() {
+            update_rate();
+            emit stats_changed();
+        });
+    }
+
+    void TransferScheduler::set_concurrency_bounds(int min_limit, int max_limit) {
+        m_MinLimit = qMax(1, min_limit);
+        m_MaxLimit = qMax(m_MinLimit, max_limit);
+        m_Limit = std::clamp(m_Limit, static_cast<double>(m_MinLimit), static_cast<double>(m_MaxLimit));
+        pump();
+    }
+
+    TransferScheduler::JobId TransferScheduler::enqueue(JobKind kind, const QString& label, qint64 bytes, StartFn start) {
+        if (is_idle() && m_Jobs.isEmpty()) {
+            // First job of a new batch: restart the throughput window
+            m_RateSampleAt = m_Clock.elapsed();
+            m_RateSampleBytes = 0;
+            m_BytesPerSec = 0;
+            m_RoundStart = m_RateSampleAt;
+            m_VerifyBase = DownloadVerifier::totals();
+        }
+
+        Job job;
+        job.id = m_NextId++;
+        job.kind = kind;
+        job.label = label;
+        job.bytes_total = qMax<qint64>(0, bytes);
+        m_Jobs.insert(job.id, job);
+        m_Starters.insert(job.id, std::move(start));
+        m_Queue.push_back(job.id);
+
+        schedule_stats();
+        // Defer so a caller enqueuing thousands of jobs in a loop isn't interleaved with their completions
+        QMetaObject::invokeMethod(this, &TransferScheduler::pump, Qt::QueuedConnection);
+        return job.id;
+    }
+
+    void TransferScheduler::cancel(JobId id) {
+        auto it = m_Jobs.find(id);
+        if (it == m_Jobs.end())
+            return;
+
+        if (it->state == JobState::Queued) {
+            it->state = JobState::Cancelled;
+            it->finished_at = m_Clock.elapsed();
+            m_Queue.erase(std::remove(m_Queue.begin(), m_Queue.end(), id), m_Queue.end());
+            m_Starters.remove(id);
+            // Never started, so nothing else will report it; owners still have to clean up
+            emit job_finished(id, false);
+        } else if (it->state == JobState::Running) {
+            it->state = JobState::Cancelled;
+            it->finished_at = m_Clock.elapsed();
+            // Taken out of m_Running first so a synchronous done() from abort() is ignored
+            AbortFn abort = m_Running.take(id);
+            if (abort)
+                abort();
+            emit job_finished(id, false);
+        } else {
+            return;
+        }
+
+        schedule_stats();
+        pump();
+        finish_batch_if_idle();
+    }
+
+    void TransferScheduler::cancel_all() {
+        // Taken first: a job_finished handler may enqueue more work
+        const std::deque<JobId> queued = std::exchange(m_Queue, {});
+        for (JobId id : queued) {
+            Job& job = m_Jobs[id];
+            job.state = JobState::Cancelled;
+            job.finished_at = m_Clock.elapsed();
+            m_Starters.remove(id);
+        }
+        for (JobId id : queued)
+            emit job_finished(id, false);
+
+        const auto running = m_Running.keys();
+        for (JobId id : running) {
+            cancel(id);
+        }
+        finish_batch_if_idle();
+    }
+
+    const TransferScheduler::Job* TransferScheduler::job(JobId id) const {
+        auto it = m_Jobs.constFind(id);
+        return it == m_Jobs.constEnd() ? nullptr : &it.value();
+    }
+
+    TransferScheduler::Stats TransferScheduler::stats() const {
+        Stats s;
+        for (const auto& job : m_Jobs) {
+            switch (job.state) {
+                case JobState::Queued:
+                    s.queued++;
+                    break;
+                case JobState::Running:
+                    s.running++;
+                    break;
+                case JobState::Succeeded:
+                    s.succeeded++;
+                    break;
+                case JobState::Failed:
+                    s.failed++;
+                    break;
+                case JobState::Cancelled:
+                    s.cancelled++;
+                    continue;
+            }
+            s.bytes_total += job.bytes_total;
+            s.bytes_done += job.bytes_done;
+        }
+        s.bytes_per_sec = m_BytesPerSec;
+        if (m_BytesPerSec > 0 && s.bytes_total > s.bytes_done) {
+            s.eta_ms = static_cast<qint64>((s.bytes_total - s.bytes_done) / m_BytesPerSec * 1000);
+        }
+        s.concurrency_limit = concurrency_limit();
+
+        DownloadVerifier::Totals verified = DownloadVerifier::totals();
+        verified.bytes -= m_VerifyBase.bytes;
+        verified.busy_ns -= m_VerifyBase.busy_ns;
+        s.bytes_verified = verified.bytes;
+        s.verify_bytes_per_sec = verified.bytes_per_sec();
+        return s;
+    }
+
+    void TransferScheduler::pump() {
+        while (!m_Queue.empty() && m_Running.size() < concurrency_limit()) {
+            JobId id = m_Queue.front();
+            m_Queue.pop_front();
+            start_job(id);
+        }
+    }
+
+    void TransferScheduler::start_job(JobId id) {
+        Job& job = m_Jobs[id];
+        job.state = JobState::Running;
+        job.started_at = m_Clock.elapsed();
+        StartFn start = m_Starters.take(id);
+        // Placeholder so the job counts against the limit even if start() completes synchronously
+        m_Running.insert(id, {});
+
+        QPointer<TransferScheduler> self(this);
+        auto progress = [self, id](qint64 done, qint64 total) {
+            if (self)
+                self->on_job_progress(id, done, total);
+        };
+        auto done = [self, id](bool ok) {
+            if (self)
+                self->on_job_done(id, ok);
+        };
+
+        AbortFn abort = start(progress, done);
+        // Still running: remember how to abort it
+        if (m_Running.contains(id)) {
+            m_Running[id] = std::move(abort);
+        }
+    }
+
+    void TransferScheduler::on_job_progress(JobId id, qint64 done, qint64 total) {
+        auto it = m_Jobs.find(id);
+        if (it == m_Jobs.end() || it->state != JobState::Running)
+            return;
+        if (total > 0)
+            it->bytes_total = total;
+        it->bytes_done = qMax(it->bytes_done, done);
+        schedule_stats();
+    }
+
+    void TransferScheduler::on_job_done(JobId id, bool ok) {
+        if (!m_Running.contains(id))
+            return; // cancelled, result is moot
+        m_Running.remove(id);
+
+        Job& job = m_Jobs[id];
+        job.state = ok ? JobState::Succeeded : JobState::Failed;
+        job.finished_at = m_Clock.elapsed();
+        if (ok)
+            job.bytes_done = job.bytes_total;
+
+        adapt(job, ok);
+        emit job_finished(id, ok);
+        schedule_stats();
+        pump();
+        finish_batch_if_idle();
+    }
+
+    void TransferScheduler::adapt(const Job& job, bool ok) {
+        if (!ok) {
+            // Treat a failure like loss: back off hard
+            m_Limit = qMax<double>(m_MinLimit, m_Limit / 2);
+            m_RoundStart = m_Clock.elapsed();
+            m_RoundBytes = 0;
+            m_RoundJobs = 0;
+            m_RoundLatency = 0;
+            return;
+        }
+
+        qint64 latency = job.finished_at - job.started_at;
+        m_RoundBytes += job.bytes_total;
+        m_RoundJobs++;
+        m_RoundLatency += latency;
+
+        // One round = as many completions as we allow in flight
+        if (m_RoundJobs < qMax(1, concurrency_limit()))
+            return;
+
+        qint64 now = m_Clock.elapsed();
+        double elapsed = qMax<qint64>(1, now - m_RoundStart) / 1000.0;
+        // Byte throughput for transfers, operation rate for metadata-only jobs like deletes
+        double rate = m_RoundBytes > 0 ? m_RoundBytes / elapsed : m_RoundJobs / elapsed;
+        qint64 avg_latency = m_RoundLatency / m_RoundJobs;
+        if (m_BaseLatency == 0 || avg_latency < m_BaseLatency)
+            m_BaseLatency = qMax<qint64>(1, avg_latency);
+
+        bool gained = rate >= m_LastRoundRate * 1.05;
+        if (avg_latency > 2 * m_BaseLatency && !gained) {
+            // More parallelism only added queueing somewhere between us and the server
+            m_Limit = qMax<double>(m_MinLimit, m_Limit * 0.75);
+        } else if (rate >= m_LastRoundRate * 0.95) {
+            m_Limit = qMin<double>(m_MaxLimit, m_Limit + 1);
+        }
+
+        m_LastRoundRate = rate;
+        m_RoundStart = now;
+        m_RoundBytes = 0;
+        m_RoundJobs = 0;
+        m_RoundLatency = 0;
+    }
+
+    void TransferScheduler::update_rate() {
+        qint64 now = m_Clock.elapsed();
+        qint64 dt = now - m_RateSampleAt;
+        if (dt < k_StatsIntervalMs)
+            return;
+
+        qint64 bytes = 0;
+        for (const auto& job : m_Jobs) {
+            if (job.state != JobState::Cancelled)
+                bytes += job.bytes_done;
+        }
+        double sample = (bytes - m_RateSampleBytes) * 1000.0 / dt;
+        m_BytesPerSec = m_BytesPerSec == 0 ? sample : 0.3 * sample + 0.7 * m_BytesPerSec;
+        m_RateSampleAt = now;
+        m_RateSampleBytes = bytes;
+    }
+
+    void TransferScheduler::schedule_stats() {
+        if (!m_StatsTimer->isActive())
+            m_StatsTimer->start();
+    }
+
+    void TransferScheduler::finish_batch_if_idle() {
+        if (!is_idle() || m_Jobs.isEmpty())
+            return;
+
+        Stats s = stats();
+        m_StatsTimer->stop();
+        m_Jobs.clear();
+        emit batch_finished(s.succeeded, s.failed, s.cancelled);
+    }
+
+} // namespace sap::client
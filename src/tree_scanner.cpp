@@ -0,0 +1,125 @@
+#include "sap_cloud_client/tree_scanner.h"
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QMutex>
+#include <QThreadPool>
+#include <atomic>
+
+namespace sap::client {
+
+    // State shared with the pool tasks; they keep it alive after the scanner is gone
+    struct TreeScanner::Shared {
+        QMutex mutex;
+        QStringList found;           // guarded by mutex
+        bool stopped = false;        // guarded by mutex
+        bool flush_posted = false;   // guarded by mutex
+        TreeScanner* owner = nullptr;
+        std::atomic<int> pending{0}; // directories queued or being listed
+        std::atomic<bool> failed{false};
+
+        // Runs fn on the owner's thread unless the scanner has been stopped
+        template <typename Fn>
+        void post_locked(Fn fn) {
+            if (stopped)
+                return;
+            TreeScanner* o = owner;
+            QMetaObject::invokeMethod(o, [o, fn]() { fn(o); }, Qt::QueuedConnection);
+        }
+
+        bool is_stopped() {
+            QMutexLocker lock(&mutex);
+            return stopped;
+        }
+    };
+
+    void TreeScanner::spawn(const std::shared_ptr<Shared>& shared, const QString& dir, const QString& prefix) {
+        shared->pending++;
+        QThreadPool::globalInstance()->start([shared, dir, prefix]() { scan_directory(shared, dir, prefix); });
+    }
+
+    void TreeScanner::scan_directory(const std::shared_ptr<Shared>& shared, const QString& dir, const QString& prefix) {
+        if (!shared->is_stopped()) {
+            QStringList files;
+            QDirIterator it(dir, QDir::Files | QDir::Dirs | QDir::Hidden | QDir::NoDotAndDotDot);
+            if (!QFileInfo(dir).isReadable())
+                shared->failed = true;
+            while (it.hasNext()) {
+                QFileInfo info = it.nextFileInfo();
+                QString relative = prefix + info.fileName();
+                if (info.isDir()) {
+                    // Following symlinked directories risks cycles and uploading outside the tree
+                    if (!info.isSymLink())
+                        spawn(shared, info.filePath(), relative + '/');
+                } else {
+                    files.append(relative);
+                }
+            }
+
+            // One lock per directory rather than per file
+            if (!files.isEmpty()) {
+                QMutexLocker lock(&shared->mutex);
+                shared->found.append(files);
+                if (shared->found.size() >= TreeScanner::k_BatchSize && !shared->flush_posted) {
+                    shared->flush_posted = true;
+                    shared->post_locked([](TreeScanner* scanner) { scanner->flush(); });
+                }
+            }
+        }
+
+        if (--shared->pending == 0) {
+            QMutexLocker lock(&shared->mutex);
+            shared->post_locked([](TreeScanner* scanner) { scanner->on_walk_done(); });
+        }
+    }
+
+    TreeScanner::TreeScanner(const QString& root, QObject* parent) :
+        QObject(parent), m_Root(QDir(root).absolutePath()), m_Shared(std::make_shared<Shared>()) {
+        m_Shared->owner = this;
+        m_FlushTimer.setInterval(k_BatchIntervalMs);
+        connect(&m_FlushTimer, &QTimer::timeout, this, &TreeScanner::flush);
+    }
+
+    TreeScanner::~TreeScanner() {
+        QMutexLocker lock(&m_Shared->mutex);
+        m_Shared->stopped = true;
+    }
+
+    void TreeScanner::start() {
+        m_FlushTimer.start();
+        spawn(m_Shared, m_Root, QString());
+    }
+
+    void TreeScanner::abort() {
+        m_Done = true;
+        m_FlushTimer.stop();
+        QMutexLocker lock(&m_Shared->mutex);
+        m_Shared->stopped = true;
+    }
+
+    void TreeScanner::flush() {
+        QStringList paths;
+        {
+            QMutexLocker lock(&m_Shared->mutex);
+            paths.swap(m_Shared->found);
+            m_Shared->flush_posted = false;
+        }
+        if (m_Done || paths.isEmpty())
+            return;
+
+        for (qsizetype i = 0; i < paths.size(); i += k_BatchSize) {
+            m_Found += static_cast<int>(qMin<qsizetype>(k_BatchSize, paths.size() - i));
+            emit batch(paths.mid(i, k_BatchSize));
+        }
+    }
+
+    void TreeScanner::on_walk_done() {
+        if (m_Done)
+            return;
+        flush();
+        m_Done = true;
+        m_FlushTimer.stop();
+        emit finished(!m_Shared->failed);
+    }
+
+} // namespace sap::client
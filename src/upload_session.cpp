@@ -0,0 +1,257 @@
+#include "sap_cloud_client/upload_session.h"
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QTimer>
+#include <algorithm>
+#include "sap_cloud_client/api_client.h"
+#include "sap_cloud_client/hash_service.h"
+
+namespace sap::client {
+
+    double UploadSession::s_PartBandwidth = 0;
+
+    qint64 UploadSession::choose_part_size(qint64 file_size) {
+        constexpr qint64 k_Align = 1024 * 1024;
+
+        // Nothing measured yet: start at the minimum and let the first parts calibrate
+        qint64 size = s_PartBandwidth > 0 ? static_cast<qint64>(s_PartBandwidth * k_TargetPartSeconds) : k_MinPartSize;
+        // Keep every connection busy: at least one part per concurrent slot when the file allows it
+        size = qMin(size, qMax(k_MinPartSize, file_size / k_MaxConcurrentParts));
+        // Servers cap the part count, so huge files need bigger parts regardless
+        size = qMax(size, (file_size + k_MaxParts - 1) / k_MaxParts);
+        size = std::clamp(size, k_MinPartSize, k_MaxPartSize);
+        return (size + k_Align - 1) / k_Align * k_Align;
+    }
+
+    UploadSession::UploadSession(ApiClient* api, const QString& local_path, const QString& remote_path, QObject* parent) :
+        QObject(parent), m_Api(api), m_LocalPath(local_path), m_RemotePath(remote_path) {}
+
+    void UploadSession::start() {
+        QFileInfo info(m_LocalPath);
+        m_Size = info.size();
+        m_Mtime = info.lastModified().toMSecsSinceEpoch();
+        m_Id.clear();
+        m_Completing = false;
+        m_PartSize = choose_part_size(m_Size);
+
+        QPointer<UploadSession> self(this);
+        m_Api->create_upload(m_RemotePath, m_Size, m_PartSize, [self](bool ok, UploadStatus status) {
+            if (!self || self->m_Done)
+                return;
+            if (!ok || status.id.isEmpty()) {
+                self->complete(false);
+                return;
+            }
+            self->begin(status);
+            emit self->session_created(self->m_Id, self->m_PartSize);
+            self->pump();
+        });
+    }
+
+    void UploadSession::resume(const QString& upload_id, qint64 local_mtime) {
+        QFileInfo info(m_LocalPath);
+        m_Size = info.size();
+        m_Mtime = info.lastModified().toMSecsSinceEpoch();
+        // Edited since the acknowledged parts were read: they are someone else's bytes now
+        if (m_Mtime != local_mtime) {
+            m_Api->abort_upload(upload_id, [](bool) {});
+            start();
+            return;
+        }
+
+        QPointer<UploadSession> self(this);
+        m_Api->get_upload(upload_id, [self, upload_id](bool ok, UploadStatus status) {
+            if (!self || self->m_Done)
+                return;
+            // Expired session, or the local file changed size since: start over
+            if (!ok || status.size != self->m_Size || status.part_size <= 0) {
+                if (ok)
+                    self->m_Api->abort_upload(upload_id, [](bool) {});
+                self->start();
+                return;
+            }
+            self->begin(status);
+            self->pump();
+        });
+    }
+
+    void UploadSession::abort() {
+        if (m_Done)
+            return;
+        complete(false);
+    }
+
+    void UploadSession::begin(const UploadStatus& status) {
+        m_Id = status.id;
+        if (status.part_size > 0)
+            m_PartSize = status.part_size;
+
+        int parts = static_cast<int>((m_Size + m_PartSize - 1) / m_PartSize);
+        m_Acked = QBitArray(qMax(parts, 1));
+        for (int part : status.parts) {
+            if (part >= 0 && part < m_Acked.size())
+                m_Acked.setBit(part);
+        }
+        m_InFlight.clear();
+        m_Retries.clear();
+        report_progress();
+        start_hash();
+    }
+
+    void UploadSession::start_hash() {
+        if (m_HashCancel)
+            *m_HashCancel = true;
+        m_ContentHash.clear();
+        auto cancel = std::make_shared<std::atomic<bool>>(false);
+        m_HashCancel = cancel;
+        HashService::hash_files({m_LocalPath}, cancel).then(this, [this, cancel](const QStringList& hashes) {
+            if (m_Done || m_HashCancel != cancel)
+                return;
+            if (hashes.value(0).isEmpty()) {
+                emit m_Api->error("Cannot read " + m_LocalPath);
+                complete(false);
+                return;
+            }
+            m_ContentHash = hashes.first();
+            pump();
+        });
+    }
+
+    void UploadSession::on_complete_failed() {
+        // Usually the parts don't add up to the hashed file: it changed in a way size and mtime
+        // didn't show, or during this upload. Starting over reads it all again.
+        if (m_Restarted) {
+            complete(false);
+            return;
+        }
+        m_Restarted = true;
+        m_Api->abort_upload(m_Id, [](bool) {});
+        start();
+    }
+
+    void UploadSession::pump() {
+        if (m_Done || m_Completing)
+            return;
+
+        for (int part = 0; part < m_Acked.size() && m_InFlight.size() < k_MaxConcurrentParts; ++part) {
+            if (!m_Acked.testBit(part) && !m_InFlight.contains(part))
+                send_part(part);
+            if (m_Done)
+                return;
+        }
+
+        if (!m_InFlight.isEmpty() || m_Acked.count(true) != m_Acked.size() || m_ContentHash.isEmpty())
+            return;
+
+        m_Completing = true;
+        QPointer<UploadSession> self(this);
+        m_Api->complete_upload(m_Id, m_ContentHash, [self](bool ok, FileInfo file) {
+            if (!self || self->m_Done)
+                return;
+            if (ok)
+                self->complete(true, file);
+            else
+                self->on_complete_failed();
+        });
+    }
+
+    void UploadSession::send_part(int part) {
+        auto* source = new UploadSource(m_LocalPath, part * m_PartSize, part_length(part));
+        if (!source->open(QIODevice::ReadOnly)) {
+            emit m_Api->error("Cannot open " + m_LocalPath + ": " + source->errorString());
+            delete source;
+            complete(false);
+            return;
+        }
+
+        QPointer<UploadSession> self(this);
+        auto timer = std::make_shared<QElapsedTimer>();
+        timer->start();
+
+        auto on_progress = [self, part](qint64 sent, qint64) {
+            if (!self || !self->m_InFlight.contains(part))
+                return;
+            self->m_InFlight[part].sent = sent;
+            self->report_progress();
+        };
+        // Placeholder first: upload_part may fail synchronously
+        m_InFlight.insert(part, {});
+        QNetworkReply* reply = m_Api->upload_part(m_Id, part, source, on_progress, [self, part, timer](bool ok) {
+            if (self && !self->m_Done)
+                self->on_part_finished(part, ok, timer->elapsed());
+        });
+        if (m_InFlight.contains(part))
+            m_InFlight[part].reply = reply;
+    }
+
+    void UploadSession::on_part_finished(int part, bool ok, qint64 elapsed_ms) {
+        m_InFlight.remove(part);
+
+        if (ok) {
+            qint64 length = part_length(part);
+            if (elapsed_ms > 0) {
+                double sample = length * 1000.0 / elapsed_ms;
+                s_PartBandwidth = s_PartBandwidth == 0 ? sample : 0.3 * sample + 0.7 * s_PartBandwidth;
+            }
+            m_Acked.setBit(part);
+            emit part_acked(part);
+            report_progress();
+            pump();
+            return;
+        }
+
+        int& retries = m_Retries[part];
+        if (++retries > k_MaxPartRetries) {
+            complete(false);
+            return;
+        }
+        report_progress();
+
+        // Back off this part only; the others keep going. The parked slot stops pump() resending it early.
+        QPointer<UploadSession> self(this);
+        m_InFlight.insert(part, {});
+        QTimer::singleShot(500 << retries, this, [self, part]() {
+            if (!self || self->m_Done)
+                return;
+            self->m_InFlight.remove(part);
+            self->pump();
+        });
+    }
+
+    void UploadSession::report_progress() {
+        qint64 sent = acked_bytes();
+        for (const auto& f : m_InFlight) {
+            sent += f.sent;
+        }
+        emit progress(sent, m_Size);
+    }
+
+    qint64 UploadSession::part_length(int part) const { return qMin(m_PartSize, m_Size - part * m_PartSize); }
+
+    qint64 UploadSession::acked_bytes() const {
+        qint64 total = 0;
+        for (int i = 0; i < m_Acked.size(); ++i) {
+            if (m_Acked.testBit(i))
+                total += part_length(i);
+        }
+        return total;
+    }
+
+    void UploadSession::complete(bool ok, const FileInfo& file) {
+        if (m_Done)
+            return;
+        m_Done = true;
+        if (m_HashCancel)
+            *m_HashCancel = true;
+        for (auto& f : m_InFlight) {
+            if (QNetworkReply* reply = f.reply) {
+                f.reply = nullptr;
+                m_Api->abort(reply);
+            }
+        }
+        m_InFlight.clear();
+        emit finished(ok, file);
+    }
+
+} // namespace sap::client
@@ -0,0 +1,134 @@
+#include "sap_cloud_client/upload_source.h"
+#include <cstring>
+#include "sap_cloud_client/types.h"
+
+namespace sap::client {
+
+    UploadSource::UploadSource(const QString& local_path, QObject* parent) :
+        QIODevice(parent), m_File(local_path) {}
+
+    UploadSource::UploadSource(const QString& local_path, qint64 offset, qint64 length, QObject* parent) :
+        QIODevice(parent), m_File(local_path), m_Offset(offset), m_Length(length) {}
+
+    UploadSource::UploadSource(const QString& local_path, const DriveCipher* cipher, QObject* parent) :
+        QIODevice(parent), m_File(local_path), m_Cipher(cipher) {}
+
+    UploadSource::~UploadSource() { close(); }
+
+    bool UploadSource::open(OpenMode mode) {
+        if (mode & WriteOnly) {
+            setErrorString("UploadSource is read-only");
+            return false;
+        }
+        // Unbuffered: reads are random-access windows and the network stack already buffers
+        if (!m_File.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+            setErrorString(m_File.errorString());
+            return false;
+        }
+        qint64 available = qMax<qint64>(0, m_File.size() - m_Offset);
+        m_PlainSize = m_Length < 0 ? available : qMin(m_Length, available);
+        m_Size = m_PlainSize;
+        m_Pos = 0;
+        m_Hash.reset();
+        m_Hashed = 0;
+
+        if (m_Cipher) {
+            // One salt per open: a reopened source is a new ciphertext, never a reused nonce
+            m_FileKey = m_Cipher->new_file_key();
+            if (!m_FileKey.is_valid()) {
+                setErrorString("Encryption key unavailable");
+                m_File.close();
+                return false;
+            }
+            m_Size = DriveCipher::encrypted_size(m_PlainSize);
+            m_SealedIndex = -1;
+        }
+
+        return QIODevice::open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+    }
+
+    void UploadSource::close() {
+        m_File.close();
+        QIODevice::close();
+    }
+
+    bool UploadSource::seek(qint64 pos) {
+        if (pos < 0 || pos > m_Size || !QIODevice::seek(pos))
+            return false;
+        m_Pos = pos;
+        return true;
+    }
+
+    qint64 UploadSource::read_plain(qint64 pos, char* data, qint64 count) {
+        if (!m_File.seek(m_Offset + pos))
+            return -1;
+        qint64 n = m_File.read(data, count);
+        // Shrunk since open(): report it instead of sending a body short of its Content-Length
+        if (n == 0 && count > 0)
+            setErrorString("File changed while uploading: " + m_File.fileName());
+        return n > 0 ? n : -1;
+    }
+
+    qint64 UploadSource::read_sealed(char* data, qint64 count) {
+        qint64 copied = 0;
+        while (copied < count && m_Pos + copied < m_Size) {
+            qint64 pos = m_Pos + copied;
+            if (pos < DriveCipher::k_HeaderSize) {
+                qint64 n = qMin(count - copied, DriveCipher::k_HeaderSize - pos);
+                std::memcpy(data + copied, m_FileKey.header.constData() + pos, n);
+                copied += n;
+                continue;
+            }
+
+            qint64 index = (pos - DriveCipher::k_HeaderSize) / DriveCipher::k_SealedChunkSize;
+            qint64 within = (pos - DriveCipher::k_HeaderSize) % DriveCipher::k_SealedChunkSize;
+            if (index != m_SealedIndex) {
+                qint64 plain_pos = index * DriveCipher::k_ChunkSize;
+                qint64 len = qMin(DriveCipher::k_ChunkSize, m_PlainSize - plain_pos);
+                QByteArray plain(len, Qt::Uninitialized);
+                if (len > 0 && read_plain(plain_pos, plain.data(), len) != len) {
+                    setErrorString("File changed while uploading: " + m_File.fileName());
+                    return copied > 0 ? copied : -1;
+                }
+                m_Sealed.resize(len + DriveCipher::k_TagSize);
+                bool last = index == DriveCipher::chunk_count(m_PlainSize) - 1;
+                if (!DriveCipher::seal_chunk(m_FileKey, index, last, plain, m_Sealed.data())) {
+                    setErrorString("Encryption failed");
+                    return copied > 0 ? copied : -1;
+                }
+                m_SealedIndex = index;
+            }
+            qint64 n = qMin(count - copied, m_Sealed.size() - within);
+            std::memcpy(data + copied, m_Sealed.constData() + within, n);
+            copied += n;
+        }
+        return copied;
+    }
+
+    qint64 UploadSource::readData(char* data, qint64 max_size) {
+        qint64 count = qMin(max_size, m_Size - m_Pos);
+        if (count <= 0)
+            return 0;
+
+        count = m_Cipher ? read_sealed(data, count) : read_plain(m_Pos, data, count);
+        if (count <= 0)
+            return count;
+
+        // Only the part of this read that extends the hashed prefix is new to the hash
+        qint64 end = m_Pos + count;
+        if (m_Pos <= m_Hashed && end > m_Hashed) {
+            qint64 skip = m_Hashed - m_Pos;
+            m_Hash.add(QByteArrayView(data + skip, count - skip));
+            m_Hashed = end;
+        }
+        m_Pos = end;
+        return count;
+    }
+
+    QString UploadSource::hash() const {
+        if (m_Hashed != m_Size)
+            return {};
+        return m_Hash.result();
+    }
+
+} // namespace sap::client
@@ -0,0 +1,904 @@
+#include "sap_cloud_client/webdav_server.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QLocale>
+#include <QMimeDatabase>
+#include <QRandomGenerator>
+#include <QStandardPaths>
+#include <QTcpSocket>
+#include <QUrl>
+#include <QUuid>
+#include <QXmlStreamReader>
+
+namespace {
+
+    constexpr qint64 k_SendBlock = 256 * 1024;
+    constexpr qint64 k_SendBuffer = 1024 * 1024;
+    // Spooled PUT bodies older than this belong to uploads of an earlier session
+    constexpr qint64 k_SpoolMaxAgeSecs = 24 * 60 * 60;
+    constexpr char k_Allow[] = "OPTIONS, PROPFIND, PROPPATCH, GET, HEAD, PUT, DELETE, MKCOL, MOVE, LOCK, UNLOCK";
+
+    QByteArray reason(int status) {
+        switch (status) {
+            case 100: return "Continue";
+            case 200: return "OK";
+            case 201: return "Created";
+            case 204: return "No Content";
+            case 206: return "Partial Content";
+            case 207: return "Multi-Status";
+            case 400: return "Bad Request";
+            case 401: return "Unauthorized";
+            case 403: return "Forbidden";
+            case 404: return "Not Found";
+            case 405: return "Method Not Allowed";
+            case 409: return "Conflict";
+            case 411: return "Length Required";
+            case 412: return "Precondition Failed";
+            case 413: return "Content Too Large";
+            case 415: return "Unsupported Media Type";
+            case 416: return "Range Not Satisfiable";
+            case 431: return "Request Header Fields Too Large";
+            case 500: return "Internal Server Error";
+            case 502: return "Bad Gateway";
+            default: return "Unknown";
+        }
+    }
+
+    QByteArray http_date(qint64 ms) {
+        return QLocale::c().toString(QDateTime::fromMSecsSinceEpoch(ms).toUTC(), "ddd, dd MMM yyyy hh:mm:ss 'GMT'").toLatin1();
+    }
+
+    // "/a%20b/c/" -> "a b/c"; nullopt for paths that try to climb out
+    std::optional<QString> drive_path(const QString& target) {
+        QString path = QUrl::fromPercentEncoding(target.section('?', 0, 0).toUtf8());
+        QStringList parts;
+        for (const auto& part : path.split('/', Qt::SkipEmptyParts)) {
+            if (part == "." || part == "..")
+                return std::nullopt;
+            parts.append(part);
+        }
+        return parts.join('/');
+    }
+
+    QByteArray href(const QString& path, bool folder) {
+        QByteArray out = "/";
+        for (const auto& part : path.split('/', Qt::SkipEmptyParts))
+            out += QUrl::toPercentEncoding(part) + '/';
+        if (!folder && out.size() > 1)
+            out.chop(1);
+        return out;
+    }
+
+    QString parent_of(const QString& path) { return path.contains('/') ? path.left(path.lastIndexOf('/')) : QString(); }
+
+    bool is_loopback_host(QByteArray host) {
+        if (host.isEmpty())
+            return true;
+        if (host.startsWith('['))
+            return host.startsWith("[::1]");
+        host = host.section(':', 0, 0).toLower();
+        return host == "127.0.0.1" || host == "localhost";
+    }
+
+} // anonymous namespace
+
+namespace sap::client {
+
+    struct WebDavServer::Connection {
+        enum class State { Head, Body, Busy };
+        enum class Chunk { Size, Data, DataEnd, Trailers };
+
+        QTcpSocket* socket = nullptr;
+        QByteArray buffer;
+        State state = State::Head;
+        bool keep_alive = true;
+        int error = 0; // set while reading the body
+
+        QByteArray method;
+        QString path;
+        QHash<QByteArray, QByteArray> headers; // lowercase names
+        QByteArray body;                       // everything but PUT
+
+        // Request body framing
+        bool chunked = false;
+        Chunk chunk = Chunk::Size;
+        qint64 left = 0; // of the Content-Length, or of the current chunk
+        QFile* spool = nullptr;
+
+        // GET body being sent, [pos, end) of file
+        bool streaming = false;
+        bool waiting = false;
+        FileInfo file;
+        QFile* local = nullptr;
+        qint64 pos = 0;
+        qint64 end = 0;
+
+        // The spool stays on disk: an upload may still be reading it
+        ~Connection() {
+            delete local;
+            delete spool;
+        }
+
+        QByteArray header(const char* name) const { return headers.value(name); }
+
+        void reset_request() {
+            method.clear();
+            path.clear();
+            headers.clear();
+            body.clear();
+            chunked = false;
+            chunk = Chunk::Size;
+            left = 0;
+            error = 0;
+            streaming = false;
+            waiting = false;
+            delete local;
+            local = nullptr;
+            if (spool) {
+                spool->remove();
+                delete spool;
+                spool = nullptr;
+            }
+        }
+    };
+
+    WebDavServer::WebDavServer(ApiClient* api, SyncEngine* sync, TransferManager* transfers, OfflineStore* offline, QObject* parent) :
+        QObject(parent), m_Api(api), m_Sync(sync), m_Transfers(transfers), m_Offline(offline), m_Cache(api) {
+        quint32 secret[4];
+        QRandomGenerator::system()->fillRange(secret);
+        QByteArray bytes(reinterpret_cast<const char*>(secret), sizeof(secret));
+        m_Password = QString::fromLatin1(bytes.toBase64(QByteArray::Base64UrlEncoding | QByteArray::OmitTrailingEquals));
+        m_Authorization = "Basic " + (QByteArray(k_User) + ':' + m_Password.toLatin1()).toBase64();
+        connect(&m_Server, &QTcpServer::newConnection, this, [this]() {
+            while (QTcpSocket* socket = m_Server.nextPendingConnection())
+                on_connection(socket);
+        });
+        connect(m_Sync, &SyncEngine::changed, this, &WebDavServer::on_sync_changed);
+        connect(m_Transfers, &TransferManager::upload_finished, this, &WebDavServer::on_upload_finished);
+    }
+
+    WebDavServer::~WebDavServer() { stop(); }
+
+    bool WebDavServer::start(quint16 port) {
+        if (is_running())
+            return true;
+        // Blocks are served as stored, which for sealed files is ciphertext under a ciphertext size
+        if (m_Transfers->encryption_enabled()) {
+            m_LastError = "WebDAV is unavailable while client-side encryption is on";
+            return false;
+        }
+        m_SpoolDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/webdav";
+        if (!QDir().mkpath(m_SpoolDir)) {
+            m_LastError = "Cannot create " + m_SpoolDir;
+            return false;
+        }
+        QDirIterator it(m_SpoolDir, QDir::Files);
+        while (it.hasNext()) {
+            QFileInfo info = it.nextFileInfo();
+            if (info.lastModified().secsTo(QDateTime::currentDateTime()) > k_SpoolMaxAgeSecs)
+                QFile::remove(info.filePath());
+        }
+
+        // Loopback only; other machines never see it
+        if (!m_Server.listen(QHostAddress::LocalHost, port)) {
+            m_LastError = "Cannot listen on port " + QString::number(port) + ": " + m_Server.errorString();
+            return false;
+        }
+        rebuild_index();
+        return true;
+    }
+
+    void WebDavServer::stop() {
+        m_Server.close();
+        const auto connections = m_Connections.values();
+        for (const auto& c : connections)
+            close(c);
+    }
+
+    QString WebDavServer::url() const { return QString("http://127.0.0.1:%1/").arg(m_Server.serverPort()); }
+
+    void WebDavServer::on_connection(QTcpSocket* socket) {
+        auto c = std::make_shared<Connection>();
+        c->socket = socket;
+        m_Connections.insert(socket, c);
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]() { on_ready_read(socket); });
+        connect(socket, &QTcpSocket::bytesWritten, this, [this, socket]() {
+            auto c = m_Connections.value(socket);
+            if (c && c->streaming)
+                pump_body(c);
+        });
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+            if (auto c = m_Connections.value(socket))
+                close(c);
+        });
+    }
+
+    void WebDavServer::close(const std::shared_ptr<Connection>& c) {
+        if (!c->socket)
+            return;
+        QTcpSocket* socket = c->socket;
+        m_Connections.remove(socket);
+        c->socket = nullptr;
+        socket->disconnect(this);
+        socket->abort();
+        socket->deleteLater();
+        // An upload in flight keeps its spool; on_upload_finished deals with it
+        bool uploading = false;
+        for (const auto& waiting : std::as_const(m_Uploads))
+            uploading = uploading || waiting == c;
+        if (!uploading)
+            c->reset_request();
+    }
+
+    void WebDavServer::on_ready_read(QTcpSocket* socket) {
+        auto c = m_Connections.value(socket);
+        if (!c)
+            return;
+        c->buffer += socket->readAll();
+
+        if (c->state == Connection::State::Head) {
+            qsizetype head_end = c->buffer.indexOf("\r\n\r\n");
+            if (head_end < 0) {
+                if (c->buffer.size() > k_MaxHeaderSize) {
+                    c->keep_alive = false;
+                    respond(c, 431);
+                }
+                return;
+            }
+            if (int status = parse_head(*c, head_end + 4)) {
+                c->keep_alive = false;
+                Headers headers;
+                if (status == 401)
+                    headers.append({"WWW-Authenticate", "Basic realm=\"SapCloud\", charset=\"UTF-8\""});
+                respond(c, status, {}, headers);
+                return;
+            }
+            c->state = Connection::State::Body;
+        }
+        if (c->state == Connection::State::Body) {
+            bool complete = read_body(*c);
+            if (c->error) {
+                c->keep_alive = false;
+                respond(c, c->error);
+                return;
+            }
+            if (!complete)
+                return;
+            // Pipelined requests wait in the buffer until this one is answered
+            c->state = Connection::State::Busy;
+            dispatch(c);
+        }
+    }
+
+    int WebDavServer::parse_head(Connection& c, qsizetype head_size) {
+        QList<QByteArray> lines = c.buffer.left(head_size - 4).split('\n');
+        c.buffer.remove(0, head_size);
+
+        QList<QByteArray> request_line = lines.takeFirst().trimmed().split(' ');
+        if (request_line.size() != 3 || !request_line[2].startsWith("HTTP/1."))
+            return 400;
+        c.method = request_line[0].toUpper();
+        auto path = drive_path(QString::fromUtf8(request_line[1]));
+        if (!path)
+            return 403;
+        c.path = *path;
+        for (const auto& line : lines) {
+            qsizetype colon = line.indexOf(':');
+            if (colon > 0)
+                c.headers.insert(line.left(colon).trimmed().toLower(), line.mid(colon + 1).trimmed());
+        }
+
+        QByteArray connection = c.header("connection").toLower();
+        c.keep_alive = request_line[2] == "HTTP/1.1" ? !connection.contains("close") : connection.contains("keep-alive");
+        // A web page that got a rebound name to resolve to 127.0.0.1 still sends its own Host
+        if (!is_loopback_host(c.header("host")))
+            return 403;
+        // Before anything touches the spool directory or the Drive
+        if (c.header("authorization") != m_Authorization)
+            return 401;
+
+        c.chunked = c.header("transfer-encoding").toLower().contains("chunked");
+        if (!c.chunked) {
+            bool ok = true;
+            QByteArray length = c.header("content-length");
+            c.left = length.isEmpty() ? 0 : length.toLongLong(&ok);
+            if (!ok || c.left < 0)
+                return 400;
+        }
+        if (c.method == "PUT") {
+            c.spool = new QFile(m_SpoolDir + '/' + QUuid::createUuid().toString(QUuid::WithoutBraces));
+            if (!c.spool->open(QIODevice::WriteOnly))
+                return 500;
+        } else if (!c.chunked && c.left > k_MaxXmlBody) {
+            return 413;
+        }
+        if (c.header("expect").toLower() == "100-continue")
+            c.socket->write("HTTP/1.1 100 Continue\r\n\r\n");
+        return 0;
+    }
+
+    bool WebDavServer::read_body(Connection& c) {
+        auto take = [&c](qint64 n) {
+            QByteArray data = c.buffer.left(n);
+            c.buffer.remove(0, data.size());
+            if (c.spool) {
+                if (c.spool->write(data) != data.size())
+                    c.error = 500;
+            } else if (c.body.size() + data.size() > k_MaxXmlBody) {
+                c.error = 413;
+            } else {
+                c.body += data;
+            }
+            c.left -= data.size();
+        };
+
+        if (!c.chunked) {
+            take(qMin<qint64>(c.left, c.buffer.size()));
+            return !c.error && c.left == 0;
+        }
+        while (!c.error) {
+            switch (c.chunk) {
+                case Connection::Chunk::Data:
+                    take(qMin<qint64>(c.left, c.buffer.size()));
+                    if (c.left > 0)
+                        return false;
+                    c.chunk = Connection::Chunk::DataEnd;
+                    break;
+
+                case Connection::Chunk::DataEnd:
+                    if (c.buffer.size() < 2)
+                        return false;
+                    if (!c.buffer.startsWith("\r\n")) {
+                        c.error = 400;
+                        return false;
+                    }
+                    c.buffer.remove(0, 2);
+                    c.chunk = Connection::Chunk::Size;
+                    break;
+
+                case Connection::Chunk::Size: {
+                    qsizetype eol = c.buffer.indexOf("\r\n");
+                    if (eol < 0)
+                        return false;
+                    bool ok = false;
+                    c.left = c.buffer.left(eol).split(';').first().trimmed().toLongLong(&ok, 16);
+                    c.buffer.remove(0, eol + 2);
+                    if (!ok || c.left < 0) {
+                        c.error = 400;
+                        return false;
+                    }
+                    c.chunk = c.left == 0 ? Connection::Chunk::Trailers : Connection::Chunk::Data;
+                    break;
+                }
+
+                case Connection::Chunk::Trailers: {
+                    // Trailer fields are ignored; the empty line ends the body
+                    qsizetype eol = c.buffer.indexOf("\r\n");
+                    if (eol < 0)
+                        return false;
+                    c.buffer.remove(0, eol + 2);
+                    if (eol == 0)
+                        return true;
+                    break;
+                }
+            }
+        }
+        return false;
+    }
+
+    void WebDavServer::dispatch(const std::shared_ptr<Connection>& c) {
+        const QByteArray& m = c->method;
+        if (m == "OPTIONS")
+            handle_options(c);
+        else if (m == "PROPFIND")
+            handle_propfind(c);
+        else if (m == "PROPPATCH")
+            handle_proppatch(c);
+        else if (m == "GET" || m == "HEAD")
+            handle_get(c, m == "HEAD");
+        else if (m == "PUT")
+            handle_put(c);
+        else if (m == "DELETE")
+            handle_delete(c);
+        else if (m == "MKCOL")
+            handle_mkcol(c);
+        else if (m == "MOVE")
+            handle_move(c);
+        else if (m == "LOCK")
+            handle_lock(c);
+        else if (m == "UNLOCK")
+            respond(c, 204);
+        else
+            respond(c, 405, {}, {{"Allow", k_Allow}});
+    }
+
+    void WebDavServer::send_head(const std::shared_ptr<Connection>& c, int status, qint64 length, const Headers& headers) {
+        QByteArray head = "HTTP/1.1 " + QByteArray::number(status) + ' ' + reason(status) + "\r\n";
+        head += "Date: " + http_date(QDateTime::currentMSecsSinceEpoch()) + "\r\n";
+        head += "Server: SapCloud\r\n";
+        head += "Content-Length: " + QByteArray::number(length) + "\r\n";
+        head += c->keep_alive ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+        for (const auto& [name, value] : headers)
+            head += name + ": " + value + "\r\n";
+        head += "\r\n";
+        c->socket->write(head);
+    }
+
+    void WebDavServer::respond(const std::shared_ptr<Connection>& c, int status, const QByteArray& body, const Headers& headers) {
+        if (!c->socket)
+            return;
+        Headers all = headers;
+        if (!body.isEmpty() && !body.startsWith("<?xml"))
+            all.append({"Content-Type", "text/plain; charset=utf-8"});
+        else if (!body.isEmpty())
+            all.append({"Content-Type", "application/xml; charset=utf-8"});
+        send_head(c, status, body.size(), all);
+        if (c->method != "HEAD")
+            c->socket->write(body);
+        finish_response(c);
+    }
+
+    void WebDavServer::finish_response(const std::shared_ptr<Connection>& c) {
+        if (!c->socket)
+            return;
+        if (!c->keep_alive) {
+            c->socket->disconnectFromHost();
+            return;
+        }
+        c->reset_request();
+        c->state = Connection::State::Head;
+        if (!c->buffer.isEmpty()) {
+            QTcpSocket* socket = c->socket;
+            QMetaObject::invokeMethod(this, [this, socket]() { on_ready_read(socket); }, Qt::QueuedConnection);
+        }
+    }
+
+    std::optional<FileInfo> WebDavServer::file(const QString& path) const {
+        auto written = m_Written.constFind(path);
+        if (written != m_Written.constEnd())
+            return written->info;
+        return path.isEmpty() ? std::nullopt : m_Sync->file(path);
+    }
+
+    bool WebDavServer::is_folder(const QString& path) const { return path.isEmpty() || m_Folders.contains(path) || m_Children.contains(path); }
+
+    void WebDavServer::update_index(const QString& path) {
+        QString parent = parent_of(path);
+        bool present = m_Written.contains(path) || m_Folders.contains(path) || m_Sync->file(path).has_value();
+        bool indexed = m_Children.value(parent).contains(path);
+        if (present == indexed)
+            return;
+
+        QString child = path;
+        if (present) {
+            // Up until an ancestor that already lists its child
+            while (!child.isEmpty()) {
+                auto& children = m_Children[parent_of(child)];
+                if (children.contains(child))
+                    break;
+                children.insert(child);
+                child = parent_of(child);
+            }
+            return;
+        }
+        // Folders go with their last entry, unless MKCOL made them
+        while (!child.isEmpty()) {
+            QString up = parent_of(child);
+            auto it = m_Children.find(up);
+            if (it == m_Children.end())
+                break;
+            it->remove(child);
+            if (!it->isEmpty() || up.isEmpty())
+                break;
+            m_Children.erase(it);
+            if (m_Folders.contains(up))
+                break;
+            child = up;
+        }
+    }
+
+    void WebDavServer::rebuild_index() {
+        m_Children.clear();
+        const auto& files = m_Sync->files();
+        for (auto it = files.constBegin(); it != files.constEnd(); ++it)
+            update_index(it.key());
+        for (auto it = m_Written.constBegin(); it != m_Written.constEnd(); ++it)
+            update_index(it.key());
+        for (const auto& folder : std::as_const(m_Folders))
+            update_index(folder);
+    }
+
+    QByteArray WebDavServer::prop_response(const QString& path, const FileInfo* file) const {
+        QString name = path.isEmpty() ? QString("Drive") : path.section('/', -1);
+        QByteArray xml = "<D:response><D:href>" + href(path, !file) + "</D:href><D:propstat><D:prop>";
+        xml += "<D:displayname>" + name.toHtmlEscaped().toUtf8() + "</D:displayname>";
+        if (!file) {
+            xml += "<D:resourcetype><D:collection/></D:resourcetype>";
+        } else {
+            static const QMimeDatabase mime;
+            xml += "<D:resourcetype/>";
+            xml += "<D:getcontentlength>" + QByteArray::number(file->size) + "</D:getcontentlength>";
+            xml += "<D:getlastmodified>" + http_date(file->mtime) + "</D:getlastmodified>";
+            xml += "<D:getcontenttype>" + mime.mimeTypeForFile(name, QMimeDatabase::MatchExtension).name().toUtf8() + "</D:getcontenttype>";
+            if (!file->hash.isEmpty())
+                xml += "<D:getetag>\"" + file->hash.toUtf8() + "\"</D:getetag>";
+        }
+        xml += "<D:supportedlock><D:lockentry><D:lockscope><D:exclusive/></D:lockscope><D:locktype><D:write/></D:locktype>"
+               "</D:lockentry></D:supportedlock>";
+        xml += "</D:prop><D:status>HTTP/1.1 200 OK</D:status></D:propstat></D:response>";
+        return xml;
+    }
+
+    void WebDavServer::handle_options(const std::shared_ptr<Connection>& c) {
+        respond(c, 200, {}, {{"DAV", "1, 2"}, {"MS-Author-Via", "DAV"}, {"Allow", k_Allow}, {"Accept-Ranges", "bytes"}});
+    }
+
+    void WebDavServer::handle_propfind(const std::shared_ptr<Connection>& c) {
+        QByteArray xml = "<?xml version=\"1.0\" encoding=\"utf-8\"?><D:multistatus xmlns:D=\"DAV:\">";
+        if (auto f = file(c->path)) {
+            xml += prop_response(c->path, &*f);
+        } else if (is_folder(c->path)) {
+            xml += prop_response(c->path, nullptr);
+            // Depth infinity is answered like 1; clients walk further themselves
+            if (c->header("depth") != "0") {
+                const QSet<QString> children = m_Children.value(c->path);
+                for (const auto& child : children) {
+                    if (auto entry = file(child))
+                        xml += prop_response(child, &*entry);
+                    else
+                        xml += prop_response(child, nullptr);
+                }
+            }
+        } else {
+            respond(c, 404);
+            return;
+        }
+        xml += "</D:multistatus>";
+        respond(c, 207, xml);
+    }
+
+    void WebDavServer::handle_proppatch(const std::shared_ptr<Connection>& c) {
+        // Dead properties aren't stored; every property set or removed is reported as done so that
+        // clients touching timestamps or attributes after a write don't treat it as failed
+        QByteArray props;
+        QXmlStreamReader reader(c->body);
+        int depth_in_prop = 0;
+        while (!reader.atEnd()) {
+            reader.readNext();
+            if (reader.isStartElement()) {
+                if (depth_in_prop == 1) {
+                    props += "<x:" + reader.name().toUtf8() + " xmlns:x=\"" + reader.namespaceUri().toString().toHtmlEscaped().toUtf8() +
+                             "\"/>";
+                }
+                if (depth_in_prop > 0 || (reader.name() == QLatin1String("prop") && reader.namespaceUri() == QLatin1String("DAV:")))
+                    depth_in_prop++;
+            } else if (reader.isEndElement() && depth_in_prop > 0) {
+                depth_in_prop--;
+            }
+        }
+        if (reader.hasError()) {
+            respond(c, 400);
+            return;
+        }
+        if (!file(c->path) && !is_folder(c->path)) {
+            respond(c, 404);
+            return;
+        }
+        QByteArray xml = "<?xml version=\"1.0\" encoding=\"utf-8\"?><D:multistatus xmlns:D=\"DAV:\"><D:response><D:href>" +
+                         href(c->path, !file(c->path)) + "</D:href><D:propstat><D:prop>" + props +
+                         "</D:prop><D:status>HTTP/1.1 200 OK</D:status></D:propstat></D:response></D:multistatus>";
+        respond(c, 207, xml);
+    }
+
+    void WebDavServer::handle_get(const std::shared_ptr<Connection>& c, bool head) {
+        auto f = file(c->path);
+        if (!f) {
+            respond(c, is_folder(c->path) ? 405 : 404, {}, {{"Allow", k_Allow}});
+            return;
+        }
+
+        // Only single ranges; a multi-range request gets the whole body, which HTTP allows
+        qint64 start = 0;
+        qint64 end = f->size;
+        bool partial = false;
+        QByteArray range = c->header("range");
+        if (range.startsWith("bytes=") && !range.contains(',')) {
+            QByteArray spec = range.mid(6).trimmed();
+            qsizetype dash = spec.indexOf('-');
+            bool ok_first = true;
+            bool ok_last = true;
+            QByteArray first = spec.left(dash).trimmed();
+            QByteArray last = spec.mid(dash + 1).trimmed();
+            if (dash < 0 || (first.isEmpty() && last.isEmpty())) {
+                partial = false;
+            } else if (first.isEmpty()) {
+                qint64 suffix = last.toLongLong(&ok_last);
+                start = qMax<qint64>(0, f->size - suffix);
+                partial = ok_last && suffix > 0;
+            } else {
+                start = first.toLongLong(&ok_first);
+                if (!last.isEmpty())
+                    end = qMin(f->size, last.toLongLong(&ok_last) + 1);
+                partial = ok_first && ok_last;
+            }
+            if (partial && (start >= f->size || start >= end)) {
+                respond(c, 416, {}, {{"Content-Range", "bytes */" + QByteArray::number(f->size)}});
+                return;
+            }
+            if (!partial) {
+                start = 0;
+                end = f->size;
+            }
+        }
+
+        static const QMimeDatabase mime;
+        Headers headers{{"Accept-Ranges", "bytes"},
+                        {"Last-Modified", http_date(f->mtime)},
+                        {"Content-Type", mime.mimeTypeForFile(c->path, QMimeDatabase::MatchExtension).name().toUtf8()}};
+        if (!f->hash.isEmpty())
+            headers.append({"ETag", '"' + f->hash.toUtf8() + '"'});
+        if (partial)
+            headers.append({"Content-Range", "bytes " + QByteArray::number(start) + '-' + QByteArray::number(end - 1) + '/' +
+                                                 QByteArray::number(f->size)});
+
+        // Local bytes when there are any: a fresh write, or an offline copy of this exact content
+        QString local = m_Written.contains(c->path) ? m_Written.value(c->path).spool : m_Offline->local_copy(c->path);
+        if (!head && !local.isEmpty()) {
+            c->local = new QFile(local);
+            if (!c->local->open(QIODevice::ReadOnly) || !c->local->seek(start)) {
+                delete c->local;
+                c->local = nullptr;
+            }
+        }
+        if (!head && !c->local && f->hash.isEmpty()) {
+            respond(c, 409);
+            return;
+        }
+
+        send_head(c, partial ? 206 : 200, end - start, headers);
+        if (head || start == end) {
+            finish_response(c);
+            return;
+        }
+        c->file = *f;
+        c->pos = start;
+        c->end = end;
+        c->streaming = true;
+        pump_body(c);
+    }
+
+    void WebDavServer::pump_body(const std::shared_ptr<Connection>& c) {
+        while (c->socket && c->streaming && !c->waiting && c->pos < c->end && c->socket->bytesToWrite() < k_SendBuffer) {
+            if (c->local) {
+                QByteArray data = c->local->read(qMin(k_SendBlock, c->end - c->pos));
+                if (data.isEmpty()) {
+                    close(c);
+                    return;
+                }
+                c->socket->write(data);
+                c->pos += data.size();
+                continue;
+            }
+
+            qint64 index = c->pos / BlockCache::k_BlockSize;
+            // The next block is fetched while this one is sent
+            if (c->end > (index + 1) * BlockCache::k_BlockSize)
+                m_Cache.prefetch(c->file, index + 1);
+            c->waiting = true;
+            std::weak_ptr<Connection> weak = c;
+            m_Cache.read(c->file, index, [this, weak, index](bool ok, const QByteArray& block) {
+                auto c = weak.lock();
+                if (!c || !c->socket || !c->streaming)
+                    return;
+                c->waiting = false;
+                if (!ok) {
+                    // The status line is gone already; a cut connection is the only way to report it
+                    close(c);
+                    return;
+                }
+                qint64 within = c->pos - index * BlockCache::k_BlockSize;
+                qint64 n = qMin<qint64>(block.size() - within, c->end - c->pos);
+                c->socket->write(block.mid(within, n));
+                c->pos += n;
+                pump_body(c);
+            });
+            return;
+        }
+        if (c->socket && c->streaming && !c->waiting && c->pos >= c->end) {
+            c->streaming = false;
+            finish_response(c);
+        }
+    }
+
+    void WebDavServer::handle_put(const std::shared_ptr<Connection>& c) {
+        if (c->path.isEmpty() || is_folder(c->path)) {
+            respond(c, 405, {}, {{"Allow", k_Allow}});
+            return;
+        }
+        if (!is_folder(parent_of(c->path))) {
+            respond(c, 409);
+            return;
+        }
+        c->spool->close();
+        bool existed = file(c->path).has_value();
+        c->headers.insert("x-existed", existed ? "1" : "0");
+        // The regular upload path: journaled, resumable, and sealed if encryption is on
+        m_Uploads.insert(c->spool->fileName(), c);
+        m_Transfers->upload(c->spool->fileName(), c->path);
+    }
+
+    void WebDavServer::on_upload_finished(const QString& spool_path, bool ok) {
+        auto c = m_Uploads.take(spool_path);
+        if (!c)
+            return;
+        QFile* spool = c->spool;
+        c->spool = nullptr;
+        if (!ok) {
+            spool->remove();
+            delete spool;
+            if (c->socket)
+                respond(c, 502);
+            return;
+        }
+
+        // Reads go to the spooled copy until the index has the file
+        FileInfo info;
+        info.path = c->path;
+        info.size = QFileInfo(spool->fileName()).size();
+        info.mtime = QDateTime::currentMSecsSinceEpoch();
+        auto previous = m_Written.value(c->path);
+        if (!previous.spool.isEmpty())
+            QFile::remove(previous.spool);
+        m_Written.insert(c->path, {info, spool->fileName()});
+        update_index(c->path);
+        // Listed through its new file from now on
+        m_Folders.remove(parent_of(c->path));
+        delete spool;
+        m_Sync->sync_now();
+        if (c->socket)
+            respond(c, c->header("x-existed") == "1" ? 204 : 201);
+    }
+
+    void WebDavServer::on_sync_changed(const QStringList& updated, const QStringList& removed) {
+        for (const QStringList* paths : {&updated, &removed}) {
+            for (const auto& path : *paths) {
+                auto it = m_Written.find(path);
+                if (it != m_Written.end()) {
+                    QFile::remove(it->spool);
+                    m_Written.erase(it);
+                }
+                update_index(path);
+            }
+        }
+    }
+
+    void WebDavServer::handle_delete(const std::shared_ptr<Connection>& c) {
+        if (c->path.isEmpty()) {
+            respond(c, 403);
+            return;
+        }
+        std::weak_ptr<Connection> weak = c;
+        auto done = [this, weak, path = c->path](bool ok) {
+            if (ok) {
+                if (m_Written.contains(path)) {
+                    QFile::remove(m_Written.take(path).spool);
+                    update_index(path);
+                }
+                m_Sync->sync_now();
+            }
+            if (auto c = weak.lock())
+                respond(c, ok ? 204 : 502);
+        };
+
+        if (file(c->path)) {
+            m_Api->delete_file(c->path, done);
+            return;
+        }
+        if (!is_folder(c->path)) {
+            respond(c, 404);
+            return;
+        }
+        QVector<BatchOp> ops;
+        QStringList empty;
+        QStringList pending{c->path};
+        while (!pending.isEmpty()) {
+            QString folder = pending.takeLast();
+            if (m_Folders.contains(folder))
+                empty.append(folder);
+            const QSet<QString> children = m_Children.value(folder);
+            for (const auto& child : children) {
+                if (m_Sync->file(child))
+                    ops.append({BatchOp::Kind::DeleteFile, child});
+                else if (is_folder(child))
+                    pending.append(child);
+            }
+        }
+        for (const auto& folder : std::as_const(empty)) {
+            m_Folders.remove(folder);
+            update_index(folder);
+        }
+        if (ops.isEmpty()) {
+            respond(c, 204);
+            return;
+        }
+        m_Api->run_batch(ops, [done](bool ok, QVector<BatchResult> results) {
+            for (const auto& r : results)
+                ok = ok && r.ok;
+            done(ok);
+        });
+    }
+
+    void WebDavServer::handle_mkcol(const std::shared_ptr<Connection>& c) {
+        if (!c->body.isEmpty()) {
+            respond(c, 415);
+            return;
+        }
+        if (c->path.isEmpty() || file(c->path) || is_folder(c->path)) {
+            respond(c, 405, {}, {{"Allow", k_Allow}});
+            return;
+        }
+        if (!is_folder(parent_of(c->path))) {
+            respond(c, 409);
+            return;
+        }
+        // Drive folders only exist through their files; this one lives here until something is put in it
+        m_Folders.insert(c->path);
+        update_index(c->path);
+        m_Folders.remove(parent_of(c->path));
+        respond(c, 201);
+    }
+
+    void WebDavServer::handle_move(const std::shared_ptr<Connection>& c) {
+        QUrl destination(QString::fromUtf8(c->header("destination")));
+        auto to = drive_path(destination.isRelative() ? destination.toString() : destination.path(QUrl::FullyEncoded));
+        if (!to || to->isEmpty() || c->path.isEmpty() || *to == c->path || to->startsWith(c->path + '/')) {
+            respond(c, to ? 403 : 400);
+            return;
+        }
+        if (!is_folder(parent_of(*to))) {
+            respond(c, 409);
+            return;
+        }
+        bool exists = file(*to).has_value() || is_folder(*to);
+        if (exists && c->header("overwrite").toUpper() == "F") {
+            respond(c, 412);
+            return;
+        }
+
+        std::weak_ptr<Connection> weak = c;
+        auto done = [this, weak, exists](bool ok) {
+            if (ok)
+                m_Sync->sync_now();
+            if (auto c = weak.lock())
+                respond(c, ok ? (exists ? 204 : 201) : 502);
+        };
+        if (file(c->path)) {
+            m_Api->move_file(c->path, *to, done);
+        } else if (m_Folders.contains(c->path)) {
+            m_Folders.remove(c->path);
+            update_index(c->path);
+            m_Folders.insert(*to);
+            update_index(*to);
+            done(true);
+        } else if (is_folder(c->path)) {
+            m_Api->move_prefix(c->path + '/', *to + '/', [done](bool ok, int) { done(ok); });
+        } else {
+            respond(c, 404);
+        }
+    }
+
+    void WebDavServer::handle_lock(const std::shared_ptr<Connection>& c) {
+        // Tokens satisfy clients that insist on locking before a write; nothing is enforced
+        QByteArray token = "opaquelocktoken:" + QUuid::createUuid().toString(QUuid::WithoutBraces).toLatin1();
+        QByteArray xml = "<?xml version=\"1.0\" encoding=\"utf-8\"?><D:prop xmlns:D=\"DAV:\"><D:lockdiscovery><D:activelock>"
+                         "<D:locktype><D:write/></D:locktype><D:lockscope><D:exclusive/></D:lockscope><D:depth>0</D:depth>"
+                         "<D:timeout>Second-3600</D:timeout><D:locktoken><D:href>" +
+                         token + "</D:href></D:locktoken></D:activelock></D:lockdiscovery></D:prop>";
+        respond(c, 200, xml, {{"Lock-Token", '<' + token + '>'}});
+    }
+
+} // namespace sap::client
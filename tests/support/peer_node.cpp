@@ -0,0 +1,30 @@
+#include <QCoreApplication>
+#include <cstdio>
+#include "sap_cloud_client/peer_cache.h"
+
+using namespace sap::client;
+
+// peer_node <account key hex> <file> <content hash>: another client on the LAN.
+// Offers the file to peers of that account, prints "READY <port>" and serves until killed.
+// Its cache lives under AppDataLocation, so give each node its own XDG_DATA_HOME.
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    app.setApplicationName(QString("peer_node-%1").arg(QCoreApplication::applicationPid()));
+    if (argc != 4) {
+        std::fprintf(stderr, "Usage: peer_node <account key hex> <file> <content hash>\n");
+        return 2;
+    }
+
+    PeerCache cache;
+    cache.set_account_key(QByteArray::fromHex(argv[1]));
+    if (!cache.start()) {
+        std::printf("FAIL %s\n", qPrintable(cache.last_error()));
+        std::fflush(stdout);
+        return 1;
+    }
+    cache.offer(QString::fromLocal8Bit(argv[2]), QString::fromLatin1(argv[3]), [&cache]() {
+        std::printf("READY %u\n", static_cast<unsigned>(cache.port()));
+        std::fflush(stdout);
+    });
+    return app.exec();
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <QProcess>
+#include <QProcessEnvironment>
+#include <QString>
+
+namespace sap::client::test {
+
+    // Starts a peer_node process serving file to peers of the account with the given key, with
+    // its cache under data_home. Returns the TCP port it serves on, or 0 with error set.
+    inline quint16 start_peer_node(QProcess& process, const QByteArray& key, const QString& file, const QString& hash,
+                                   const QString& data_home, QString* error = nullptr) {
+        QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
+        env.insert("XDG_DATA_HOME", data_home);
+        process.setProcessEnvironment(env);
+        process.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+        process.start(PEER_NODE_PATH, {QString::fromLatin1(key.toHex()), file, hash});
+
+        QByteArray line;
+        if (process.waitForStarted()) {
+            while (!process.canReadLine() && process.waitForReadyRead(10000)) {
+            }
+            line = process.readLine().trimmed();
+        }
+        if (line.startsWith("READY "))
+            return static_cast<quint16>(line.mid(6).toUInt());
+        if (error)
+            *error = line.startsWith("FAIL ") ? QString::fromLocal8Bit(line.mid(5)) : "peer_node did not start: " + process.errorString();
+        process.kill();
+        process.waitForFinished();
+        return 0;
+    }
+
+} // namespace sap::client::test
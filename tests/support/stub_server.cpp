@@ -0,0 +1,656 @@
+#include "stub_server.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QUrl>
+#include <QtEndian>
+
+namespace {
+
+    constexpr char k_Api[] = "/api/v1/";
+    constexpr qint64 k_WriteBlock = 64 * 1024;
+    constexpr qint64 k_WriteBuffer = 1024 * 1024;
+    constexpr int k_PaceIntervalMs = 5;
+
+    QByteArray reason(int status) {
+        switch (status) {
+        case 200:
+            return "OK";
+        case 206:
+            return "Partial Content";
+        case 400:
+            return "Bad Request";
+        case 404:
+            return "Not Found";
+        case 409:
+            return "Conflict";
+        case 415:
+            return "Unsupported Media Type";
+        case 416:
+            return "Range Not Satisfiable";
+        default:
+            return "Unknown";
+        }
+    }
+
+    // "bytes=a-" or "bytes=a-b" against a body of size bytes; false if it can't be served
+    bool parse_range(const QByteArray& header, qint64 size, qint64& first, qint64& last) {
+        if (!header.startsWith("bytes="))
+            return false;
+        QList<QByteArray> ends = header.mid(6).split('-');
+        if (ends.size() != 2 || ends[0].isEmpty())
+            return false;
+        bool ok = false;
+        first = ends[0].toLongLong(&ok);
+        if (!ok || first >= size)
+            return false;
+        last = ends[1].isEmpty() ? size - 1 : qMin(ends[1].toLongLong(&ok), size - 1);
+        return ok && last >= first;
+    }
+
+    // "Content-Encoding: deflate" is a zlib stream; qUncompress wants a size hint in front and grows past it
+    QByteArray inflate(const QByteArray& body) {
+        QByteArray framed(4, '\0');
+        qToBigEndian<quint32>(static_cast<quint32>(qMin<qint64>(body.size() * 8LL, 64 * 1024 * 1024)), framed.data());
+        return qUncompress(framed + body);
+    }
+
+    QString hex_sha256(const QByteArray& data) {
+        return QString::fromLatin1(QCryptographicHash::hash(data, QCryptographicHash::Sha256).toHex());
+    }
+
+    // Written from the digest definition in merkle_tree.h rather than by reusing MerkleTree,
+    // so a client that drifts from it fails against this server
+    QString file_entry_digest(const QString& name, const QString& content_hash) {
+        QByteArray data("f", 2);
+        data += name.toUtf8();
+        data += '\0';
+        data += content_hash.toLatin1();
+        return hex_sha256(data);
+    }
+
+} // anonymous namespace
+
+namespace sap::client::test {
+
+    StubServer::StubServer(QObject* parent) : QObject(parent) {
+        connect(&m_Server, &QTcpServer::newConnection, this, &StubServer::on_new_connection);
+    }
+
+    StubServer::~StubServer() {
+        // Sockets go down with m_Server after the members they report to
+        for (auto* socket : m_Connections.keys())
+            socket->disconnect(this);
+        m_Server.close();
+    }
+
+    bool StubServer::listen() { return m_Server.listen(QHostAddress::LocalHost, 0); }
+
+    QString StubServer::url() const { return "http://127.0.0.1:" + QString::number(port()); }
+
+    QString StubServer::hash_of(const QByteArray& data) { return hex_sha256(data); }
+
+    qint64 StubServer::tick() {
+        m_Clock = qMax(m_Clock + 1, QDateTime::currentMSecsSinceEpoch() + m_Faults.clock_offset_ms);
+        return m_Clock;
+    }
+
+    void StubServer::put_file(const QString& path, const QByteArray& data) {
+        m_Files.insert(path, {data, hash_of(data), tick()});
+        m_Tombstones.remove(path);
+        m_Manifests.remove(path);
+    }
+
+    void StubServer::put_chunked_file(const QString& path, const QByteArray& data, qint64 chunk_size) {
+        QJsonArray chunks;
+        for (qint64 offset = 0; offset < data.size(); offset += chunk_size) {
+            QByteArray chunk = data.mid(offset, chunk_size);
+            QString hash = hash_of(chunk);
+            m_Chunks.insert(hash, chunk);
+            chunks.append(QJsonObject{{"hash", hash}, {"offset", offset}, {"size", chunk.size()}});
+        }
+        put_file(path, data);
+        m_Manifests.insert(path, QJsonObject{{"path", path}, {"hash", hash_of(data)}, {"size", data.size()}, {"chunks", chunks}});
+    }
+
+    bool StubServer::remove(const QString& path) {
+        if (!m_Files.remove(path))
+            return false;
+        m_Manifests.remove(path);
+        m_Tombstones.insert(path, tick());
+        return true;
+    }
+
+    bool StubServer::move(const QString& from, const QString& to) {
+        auto it = m_Files.constFind(from);
+        if (it == m_Files.constEnd())
+            return false;
+        StoredFile f = *it;
+        QJsonObject manifest = m_Manifests.value(from);
+        remove(from);
+        f.updated_at = tick();
+        m_Files.insert(to, f);
+        m_Tombstones.remove(to);
+        if (!manifest.isEmpty()) {
+            manifest["path"] = to;
+            m_Manifests.insert(to, manifest);
+        }
+        return true;
+    }
+
+    int StubServer::total_requests() const {
+        int total = 0;
+        for (int n : m_Requests)
+            total += n;
+        return total;
+    }
+
+    void StubServer::reset_counters() {
+        m_Requests.clear();
+        m_BytesReceived = 0;
+        m_Ranges.clear();
+        m_SyncSince.clear();
+    }
+
+    void StubServer::on_new_connection() {
+        while (QTcpSocket* socket = m_Server.nextPendingConnection()) {
+            m_Connections.insert(socket, {});
+            connect(socket, &QTcpSocket::readyRead, this, [this, socket]() {
+                m_Connections[socket].buffer += socket->readAll();
+                process(socket);
+            });
+            connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+                m_Connections.remove(socket);
+                socket->deleteLater();
+            });
+        }
+    }
+
+    void StubServer::process(QTcpSocket* socket) {
+        auto it = m_Connections.find(socket);
+        if (it == m_Connections.end() || it->busy)
+            return;
+        qsizetype head_end = it->buffer.indexOf("\r\n\r\n");
+        if (head_end < 0)
+            return;
+
+        Request req;
+        QList<QByteArray> lines = it->buffer.left(head_end).split('\n');
+        QList<QByteArray> request_line = lines.value(0).trimmed().split(' ');
+        if (request_line.size() < 2) {
+            socket->abort();
+            return;
+        }
+        req.method = request_line[0];
+        QUrl url(QString::fromLatin1(request_line[1]));
+        req.path = url.path(QUrl::FullyDecoded);
+        req.query = QUrlQuery(url);
+        for (qsizetype i = 1; i < lines.size(); ++i) {
+            qsizetype colon = lines[i].indexOf(':');
+            if (colon > 0)
+                req.headers.insert(lines[i].left(colon).trimmed().toLower(), lines[i].mid(colon + 1).trimmed());
+        }
+
+        qint64 length = req.headers.value("content-length").toLongLong();
+        if (it->buffer.size() < head_end + 4 + length)
+            return;
+        req.body = it->buffer.mid(head_end + 4, length);
+        it->buffer.remove(0, head_end + 4 + length);
+        it->busy = true;
+        m_BytesReceived += length;
+        if (m_Faults.accept_deflate && !m_Faults.reject_deflate && req.headers.value("content-encoding") == "deflate") {
+            req.body = inflate(req.body);
+            req.headers.remove("content-encoding");
+        }
+
+        m_Requests[QString::fromLatin1(req.method) + ' ' + route_name(req)]++;
+        send(socket, route(req));
+    }
+
+    void StubServer::response_done(QTcpSocket* socket) {
+        auto it = m_Connections.find(socket);
+        if (it == m_Connections.end())
+            return;
+        it->busy = false;
+        // A request that arrived behind this one waits in the buffer
+        QTimer::singleShot(0, socket, [this, socket]() { process(socket); });
+    }
+
+    QString StubServer::route_name(const Request& req) {
+        QString rest = req.path.mid(sizeof(k_Api) - 1);
+        if (rest == "files/move")
+            return "move";
+        if (rest.startsWith("files"))
+            return "files";
+        if (rest.startsWith("uploads/") && rest.contains("/parts/"))
+            return "part";
+        if (rest.startsWith("uploads/") && rest.endsWith("/complete"))
+            return "complete";
+        if (rest.startsWith("uploads"))
+            return "uploads";
+        if (rest == "chunks/missing")
+            return "missing";
+        if (rest.startsWith("chunks/"))
+            return "chunk";
+        if (rest.startsWith("manifests"))
+            return "manifests";
+        if (rest == "sync/state")
+            return "state";
+        if (rest == "sync/merkle")
+            return "merkle";
+        if (rest == "peers/key")
+            return "peer-key";
+        return rest;
+    }
+
+    StubServer::Response StubServer::json(int status, const QJsonObject& obj) {
+        Response r;
+        r.status = status;
+        r.body = QJsonDocument(obj).toJson(QJsonDocument::Compact);
+        return r;
+    }
+
+    StubServer::Response StubServer::not_found_endpoint() {
+        Response r;
+        r.status = 404;
+        r.type = "text/plain";
+        r.body = "Not Found";
+        return r;
+    }
+
+    StubServer::Response StubServer::route(const Request& req) {
+        if (!req.path.startsWith(k_Api))
+            return not_found_endpoint();
+        for (const auto& prefix : std::as_const(m_Faults.missing_endpoints)) {
+            if (req.path.startsWith(prefix))
+                return not_found_endpoint();
+        }
+        if (m_Faults.reject_deflate && req.headers.contains("content-encoding"))
+            return json(415, {{"error", "Request bodies must not be encoded"}});
+        if (m_Faults.drop_requests > 0 && !m_Faults.drop_prefix.isEmpty() && req.path.startsWith(m_Faults.drop_prefix)) {
+            m_Faults.drop_requests--;
+            Response r = json(200, {{"dropped", true}});
+            r.cut_after = 0;
+            return r;
+        }
+
+        QString rest = req.path.mid(sizeof(k_Api) - 1);
+        QJsonObject body = QJsonDocument::fromJson(req.body).object();
+
+        if (rest == "files/" && req.method == "GET") {
+            QJsonArray arr;
+            for (auto it = m_Files.constBegin(); it != m_Files.constEnd(); ++it)
+                arr.append(file_json(it.key()));
+            Response r;
+            r.body = QJsonDocument(arr).toJson(QJsonDocument::Compact);
+            return r;
+        }
+        if (rest == "files/move" && req.method == "POST")
+            return handle_move(req);
+        if (rest.startsWith("files/"))
+            return handle_file(req, rest.mid(6));
+        if (rest.startsWith("uploads"))
+            return handle_uploads(req, rest.split('/'));
+        if (rest == "chunks/missing" && req.method == "POST") {
+            QJsonArray missing;
+            for (const auto& v : body["hashes"].toArray()) {
+                if (!m_Chunks.contains(v.toString()))
+                    missing.append(v);
+            }
+            return json(200, {{"missing", missing}});
+        }
+        if (rest.startsWith("chunks/") && req.method == "PUT") {
+            QString hash = rest.mid(7);
+            if (hash_of(req.body) != hash)
+                return json(400, {{"error", "Chunk does not match its hash"}});
+            m_Chunks.insert(hash, req.body);
+            return json(200, {});
+        }
+        if (rest.startsWith("manifests"))
+            return handle_manifest(req);
+        if (rest == "batch" && req.method == "POST")
+            return handle_batch(req);
+        if (rest == "sync/state" && req.method == "GET")
+            return handle_state(req);
+        if (rest == "sync/merkle" && req.method == "GET")
+            return handle_merkle(req);
+        if (rest == "notes" && req.method == "GET")
+            return json(200, {{"notes", QJsonArray()}});
+        if (rest == "peers/key" && req.method == "GET") {
+            if (m_PeerKey.isEmpty())
+                return json(404, {{"error", "No peer key"}});
+            return json(200, {{"key", QString::fromLatin1(m_PeerKey.toBase64())}});
+        }
+        return not_found_endpoint();
+    }
+
+    StubServer::Response StubServer::handle_file(const Request& req, const QString& path) {
+        if (req.method == "PUT") {
+            put_file(path, req.body);
+            return json(200, file_json(path));
+        }
+        if (req.method == "DELETE")
+            return remove(path) ? json(200, {}) : json(404, {{"error", "No such file"}});
+        // e.g. POST files/preflight: endpoints this stub doesn't have
+        if (req.method != "GET" && req.method != "HEAD")
+            return not_found_endpoint();
+
+        auto it = m_Files.constFind(path);
+        if (it == m_Files.constEnd())
+            return json(404, {{"error", "No such file"}});
+
+        Response r;
+        r.type = "application/octet-stream";
+        r.body = it->data;
+        r.head_only = req.method == "HEAD";
+        r.bytes_per_sec = m_Faults.bytes_per_sec;
+
+        qint64 first = 0;
+        QByteArray range = req.headers.value("range");
+        if (req.method == "GET" && !range.isEmpty()) {
+            m_Ranges.append(range);
+            if (!m_Faults.ignore_range) {
+                qint64 last = 0;
+                if (!parse_range(range, it->data.size(), first, last))
+                    return json(416, {{"error", "Bad range"}});
+                r.status = 206;
+                r.body = it->data.mid(first, last - first + 1);
+                if (first == m_Faults.slow_offset)
+                    r.bytes_per_sec = m_Faults.slow_bytes_per_sec;
+                r.headers.append({"Content-Range", "bytes " + QByteArray::number(first) + '-' + QByteArray::number(last) + '/' +
+                                                       QByteArray::number(it->data.size())});
+            }
+        }
+        // first stays 0 for a whole-file body
+        qint64 corrupt = m_Faults.corrupt_at - first;
+        if (req.method == "GET" && m_Faults.corrupt_count > 0 && corrupt >= 0 && corrupt < r.body.size()) {
+            m_Faults.corrupt_count--;
+            r.body[corrupt] = static_cast<char>(r.body[corrupt] ^ 0x5a);
+        }
+        if (req.method == "GET" && m_Faults.drop_count > 0 && m_Faults.drop_after >= 0) {
+            m_Faults.drop_count--;
+            r.cut_after = m_Faults.drop_after;
+        }
+        return r;
+    }
+
+    StubServer::Response StubServer::handle_move(const Request& req) {
+        QJsonObject body = QJsonDocument::fromJson(req.body).object();
+        if (body.contains("from_prefix")) {
+            QString from = body["from_prefix"].toString();
+            QString to = body["to_prefix"].toString();
+            int moved = 0;
+            for (const auto& path : m_Files.keys()) {
+                if (path.startsWith(from) && move(path, to + path.mid(from.size())))
+                    moved++;
+            }
+            return json(200, {{"moved", moved}});
+        }
+        if (!move(body["from"].toString(), body["to"].toString()))
+            return json(404, {{"error", "No such file"}});
+        return json(200, {});
+    }
+
+    QJsonObject StubServer::session_json(const QString& id) const {
+        const Session& s = m_Sessions[id];
+        QJsonArray parts;
+        for (int part : s.parts.keys())
+            parts.append(part);
+        return {{"upload_id", id}, {"path", s.path}, {"size", s.size}, {"part_size", s.part_size}, {"parts", parts}};
+    }
+
+    StubServer::Response StubServer::handle_uploads(const Request& req, const QStringList& parts) {
+        // uploads | uploads/<id> | uploads/<id>/parts/<n> | uploads/<id>/complete
+        if (parts.size() == 1 && req.method == "POST") {
+            QJsonObject body = QJsonDocument::fromJson(req.body).object();
+            Session s;
+            s.path = body["path"].toString();
+            s.size = body["size"].toInteger();
+            s.part_size = body["part_size"].toInteger();
+            if (s.path.isEmpty() || s.part_size <= 0)
+                return json(400, {{"error", "Bad upload"}});
+            QString id = QString::number(m_NextSession++);
+            m_Sessions.insert(id, s);
+            return json(200, session_json(id));
+        }
+
+        QString id = parts.value(1);
+        auto it = m_Sessions.find(id);
+        if (it == m_Sessions.end())
+            return json(404, {{"error", "No such upload"}});
+
+        if (parts.size() == 2 && req.method == "GET")
+            return json(200, session_json(id));
+        if (parts.size() == 2 && req.method == "DELETE") {
+            m_Sessions.erase(it);
+            return json(200, {});
+        }
+        if (parts.size() == 4 && parts[2] == "parts" && req.method == "PUT") {
+            it->parts.insert(parts[3].toInt(), req.body);
+            return json(200, {});
+        }
+        if (parts.size() == 3 && parts[2] == "complete" && req.method == "POST") {
+            QByteArray data;
+            int count = static_cast<int>((it->size + it->part_size - 1) / it->part_size);
+            for (int part = 0; part < count; ++part) {
+                if (!it->parts.contains(part))
+                    return json(400, {{"error", "Missing part " + QString::number(part)}});
+                data += it->parts[part];
+            }
+            if (data.size() != it->size)
+                return json(400, {{"error", "Parts don't add up to the upload size"}});
+            // Parts sent before and after a local edit don't make the file the client hashed
+            QString hash = QJsonDocument::fromJson(req.body).object()["hash"].toString();
+            if (!hash.isEmpty() && hash != hash_of(data))
+                return json(409, {{"error", "Content hash mismatch"}});
+            QString path = it->path;
+            m_Sessions.erase(it);
+            put_file(path, data);
+            return json(200, file_json(path));
+        }
+        return not_found_endpoint();
+    }
+
+    StubServer::Response StubServer::handle_manifest(const Request& req) {
+        QString rest = req.path.mid(sizeof(k_Api) - 1);
+        if (rest.startsWith("manifests/") && req.method == "GET") {
+            QString path = rest.mid(10);
+            if (!m_Manifests.contains(path))
+                return json(404, {{"error", "Not stored as chunks"}});
+            return json(200, m_Manifests[path]);
+        }
+        if (rest != "manifests" || req.method != "POST")
+            return not_found_endpoint();
+
+        QJsonObject manifest = QJsonDocument::fromJson(req.body).object();
+        QJsonArray missing;
+        for (const auto& v : manifest["chunks"].toArray()) {
+            QString hash = v.toObject()["hash"].toString();
+            if (!m_Chunks.contains(hash) && !missing.contains(hash))
+                missing.append(hash);
+        }
+        if (!missing.isEmpty())
+            return json(409, {{"missing", missing}});
+
+        QByteArray data;
+        for (const auto& v : manifest["chunks"].toArray()) {
+            QJsonObject chunk = v.toObject();
+            QByteArray bytes = m_Chunks[chunk["hash"].toString()];
+            if (chunk["offset"].toInteger() != data.size() || chunk["size"].toInteger() != bytes.size())
+                return json(400, {{"error", "Chunks don't tile the file"}});
+            data += bytes;
+        }
+        QString path = manifest["path"].toString();
+        QString hash = manifest["hash"].toString();
+        if (data.size() != manifest["size"].toInteger() || (!hash.isEmpty() && hash != hash_of(data)))
+            return json(400, {{"error", "Manifest doesn't match its chunks"}});
+        put_file(path, data);
+        m_Manifests.insert(path, manifest);
+        return json(200, file_json(path));
+    }
+
+    StubServer::Response StubServer::handle_batch(const Request& req) {
+        QJsonArray results;
+        for (const auto& v : QJsonDocument::fromJson(req.body).object()["ops"].toArray()) {
+            QJsonObject op = v.toObject();
+            QString kind = op["op"].toString();
+            bool ok = false;
+            if (kind == "delete_file")
+                ok = remove(op["path"].toString());
+            else if (kind == "move_file")
+                ok = move(op["from"].toString(), op["to"].toString());
+            // No notes here, so note ops always miss
+            QJsonObject result{{"status", ok ? 200 : 404}};
+            if (!ok)
+                result["error"] = "Not found";
+            results.append(result);
+        }
+        return json(200, {{"results", results}});
+    }
+
+    StubServer::Response StubServer::handle_state(const Request& req) {
+        QJsonArray files;
+        bool delta = req.query.hasQueryItem("since");
+        qint64 since = req.query.queryItemValue("since").toLongLong();
+        m_SyncSince.append(delta ? since : -1);
+        for (auto it = m_Files.constBegin(); it != m_Files.constEnd(); ++it) {
+            if (!delta || it->updated_at >= since)
+                files.append(file_json(it.key()));
+        }
+        if (delta) {
+            for (auto it = m_Tombstones.constBegin(); it != m_Tombstones.constEnd(); ++it) {
+                if (it.value() >= since)
+                    files.append(QJsonObject{{"path", it.key()}, {"updated_at", it.value()}, {"is_deleted", true}});
+            }
+        }
+        return json(200, {{"server_time", tick()}, {"files", files}});
+    }
+
+    QMap<QString, QString> StubServer::merkle_children(const QString& dir) const {
+        QMap<QString, QString> children;
+        for (auto it = m_Files.lowerBound(dir); it != m_Files.constEnd() && it.key().startsWith(dir); ++it) {
+            QString rest = it.key().mid(dir.size());
+            qsizetype slash = rest.indexOf('/');
+            if (slash < 0) {
+                children.insert(rest, file_entry_digest(rest, it->hash));
+                continue;
+            }
+            QString key = rest.left(slash + 1);
+            if (!children.contains(key))
+                children.insert(key, merkle_digest(dir + key));
+        }
+        return children;
+    }
+
+    QString StubServer::merkle_digest(const QString& dir) const {
+        QMap<QString, QString> children = merkle_children(dir);
+        QByteArray data("d", 2);
+        for (auto it = children.constBegin(); it != children.constEnd(); ++it) {
+            data += it.key().toUtf8();
+            data += '\0';
+            data += it.value().toLatin1();
+            data += '\n';
+        }
+        return hex_sha256(data);
+    }
+
+    StubServer::Response StubServer::handle_merkle(const Request& req) {
+        QString dir = req.query.queryItemValue("path", QUrl::FullyDecoded);
+        QMap<QString, QString> children = merkle_children(dir);
+        if (!dir.isEmpty() && children.isEmpty())
+            return json(404, {{"error", "No such directory"}});
+
+        QJsonObject node{{"hash", merkle_digest(dir)}};
+        if (req.query.queryItemValue("children") != "0") {
+            QJsonArray arr;
+            for (auto it = children.constBegin(); it != children.constEnd(); ++it) {
+                bool is_dir = it.key().endsWith('/');
+                arr.append(QJsonObject{{"name", is_dir ? it.key().chopped(1) : it.key()}, {"hash", it.value()}, {"dir", is_dir}});
+            }
+            node["children"] = arr;
+        }
+        return json(200, node);
+    }
+
+    QJsonObject StubServer::file_json(const QString& path) const {
+        const StoredFile& f = m_Files[path];
+        return {{"path", path},
+                {"hash", f.hash},
+                {"size", qint64(f.data.size())},
+                {"mtime", f.updated_at},
+                {"created_at", f.updated_at},
+                {"updated_at", f.updated_at}};
+    }
+
+    void StubServer::send(QTcpSocket* socket, Response resp) {
+        if (m_Faults.accept_deflate || m_Faults.reject_deflate)
+            resp.headers.append({"Accept-Encoding", "deflate"});
+        if (m_Faults.latency_ms <= 0) {
+            write(socket, resp);
+            return;
+        }
+        QTimer::singleShot(m_Faults.latency_ms, socket, [this, socket, resp]() { write(socket, resp); });
+    }
+
+    void StubServer::write(QTcpSocket* socket, const Response& resp) {
+        QByteArray head = "HTTP/1.1 " + QByteArray::number(resp.status) + ' ' + reason(resp.status) + "\r\n";
+        head += "Content-Type: " + resp.type + "\r\n";
+        head += "Content-Length: " + QByteArray::number(resp.body.size()) + "\r\n";
+        for (const auto& [name, value] : resp.headers)
+            head += name + ": " + value + "\r\n";
+        head += "\r\n";
+        socket->write(head);
+
+        auto w = std::make_shared<Writer>();
+        w->body = resp.body;
+        w->end = resp.head_only ? 0 : resp.body.size();
+        if (resp.cut_after >= 0 && resp.cut_after < w->end) {
+            w->end = resp.cut_after;
+            w->cut = true;
+        }
+        w->bytes_per_sec = resp.bytes_per_sec;
+        w->clock.start();
+        w->context = new QObject(socket);
+        connect(socket, &QTcpSocket::bytesWritten, w->context, [this, socket, w]() { pump_body(socket, w); });
+        pump_body(socket, w);
+    }
+
+    void StubServer::pump_body(QTcpSocket* socket, const std::shared_ptr<Writer>& w) {
+        if (w->done)
+            return;
+        while (w->pos < w->end && socket->bytesToWrite() < k_WriteBuffer) {
+            qint64 n = qMin(k_WriteBlock, w->end - w->pos);
+            if (w->bytes_per_sec > 0) {
+                qint64 allowed = w->clock.elapsed() * w->bytes_per_sec / 1000 - w->pos;
+                if (allowed <= 0) {
+                    if (!w->waiting) {
+                        w->waiting = true;
+                        QTimer::singleShot(k_PaceIntervalMs, w->context, [this, socket, w]() {
+                            w->waiting = false;
+                            pump_body(socket, w);
+                        });
+                    }
+                    return;
+                }
+                n = qMin(n, allowed);
+            }
+            socket->write(w->body.constData() + w->pos, n);
+            w->pos += n;
+        }
+        if (w->pos < w->end)
+            return;
+
+        w->done = true;
+        w->context->deleteLater();
+        if (w->cut) {
+            // Whatever was written still goes out first; the client sees a body cut short
+            socket->disconnectFromHost();
+            return;
+        }
+        response_done(socket);
+    }
+
+} // namespace sap::client::test
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QJsonObject>
+#include <QMap>
+#include <QObject>
+#include <QStringList>
+#include <QTcpServer>
+#include <QUrlQuery>
+#include <memory>
+
+class QTcpSocket;
+
+namespace sap::client::test {
+
+    // In-memory stand-in for the server API, for tests and benchmarks.
+    // Speaks just enough HTTP/1.1 for QNetworkAccessManager: Content-Length bodies, keep-alive
+    // and single byte ranges. Implements:
+    // - files: listing, GET (with Range), HEAD, PUT, DELETE, move (single and by prefix)
+    // - multipart upload sessions, content chunks and manifests, batches
+    // - sync state, the Merkle tree of the namespace, the account's peer key, an empty notes list
+    // Faults are set through faults() and apply to later requests.
+    // Not thread-safe: use it only from the thread it lives in (benchmarks give it its own).
+    class StubServer : public QObject {
+        Q_OBJECT
+
+    public:
+        struct Faults {
+            // The next drop_count file GETs close the connection after drop_after body bytes
+            qint64 drop_after = -1;
+            int drop_count = 0;
+            // The next drop_requests requests whose path starts with drop_prefix are read, not
+            // applied, and answered with a response that breaks off before its body
+            QString drop_prefix;
+            int drop_requests = 0;
+            // Range requests get the whole file with 200 instead of 206
+            bool ignore_range = false;
+            // Path prefixes answered with a plain 404, as from a server without that endpoint
+            QStringList missing_endpoints;
+            // Advertise deflate in Accept-Encoding and take deflated request bodies
+            bool accept_deflate = false;
+            // Advertise deflate in Accept-Encoding, then answer deflated bodies with 415
+            bool reject_deflate = false;
+            int latency_ms = 0;
+            qint64 bytes_per_sec = 0; // file bodies only; 0 is unlimited
+            // Range GETs starting at slow_offset are paced at slow_bytes_per_sec instead, so that one
+            // segment of a parallel download lags behind the others
+            qint64 slow_offset = -1;
+            qint64 slow_bytes_per_sec = 0;
+            // Added to the server clock, as on a server whose clock is off from this machine's
+            qint64 clock_offset_ms = 0;
+            // The next corrupt_count file GETs whose body covers byte corrupt_at carry it flipped
+            qint64 corrupt_at = -1;
+            int corrupt_count = 0;
+        };
+
+        explicit StubServer(QObject* parent = nullptr);
+        ~StubServer() override;
+
+        // Listens on a free loopback port
+        bool listen();
+        quint16 port() const { return m_Server.serverPort(); }
+        QString url() const;
+
+        Faults& faults() { return m_Faults; }
+
+        void put_file(const QString& path, const QByteArray& data);
+        // Stores data as chunks of chunk_size with a manifest, as a chunked upload would
+        void put_chunked_file(const QString& path, const QByteArray& data, qint64 chunk_size);
+        // Deletes as the API would, leaving a tombstone for the sync feed
+        bool remove_file(const QString& path) { return remove(path); }
+        bool has_file(const QString& path) const { return m_Files.contains(path); }
+        QByteArray file(const QString& path) const { return m_Files.value(path).data; }
+        QStringList paths() const { return m_Files.keys(); }
+        bool has_chunk(const QString& hash) const { return m_Chunks.contains(hash); }
+        void set_peer_key(const QByteArray& key) { m_PeerKey = key; }
+        static QString hash_of(const QByteArray& data);
+
+        // Requests seen per route, named "<METHOD> <route>": files, move, uploads, part, complete,
+        // missing, chunk, manifests, batch, state, merkle, notes, peer-key
+        int requests(const QString& route) const { return m_Requests.value(route); }
+        int total_requests() const;
+        // Request body bytes received, and the Range headers of file GETs, since the last reset
+        qint64 bytes_received() const { return m_BytesReceived; }
+        QList<QByteArray> ranges() const { return m_Ranges; }
+        // The since of each sync state request, -1 for a full listing
+        QList<qint64> sync_since() const { return m_SyncSince; }
+        void reset_counters();
+
+    private:
+        struct Request {
+            QByteArray method;
+            QString path;
+            QUrlQuery query;
+            QHash<QByteArray, QByteArray> headers; // lowercase names
+            QByteArray body;
+        };
+
+        struct Response {
+            int status = 200;
+            QByteArray type = "application/json";
+            QByteArray body;
+            QList<QPair<QByteArray, QByteArray>> headers;
+            bool head_only = false; // HEAD: Content-Length of body, but no body
+            qint64 cut_after = -1;  // drop the connection after this many body bytes
+            qint64 bytes_per_sec = 0; // body pacing; 0 is unlimited
+        };
+
+        struct StoredFile {
+            QByteArray data;
+            QString hash;
+            qint64 updated_at = 0;
+        };
+
+        struct Session {
+            QString path;
+            qint64 size = 0;
+            qint64 part_size = 0;
+            QMap<int, QByteArray> parts;
+        };
+
+        struct Connection {
+            QByteArray buffer;
+            bool busy = false; // a response is still going out
+        };
+
+        // A response body going out in blocks, paced when bandwidth is capped
+        struct Writer {
+            QByteArray body;
+            qint64 pos = 0;
+            qint64 end = 0;
+            bool cut = false;
+            qint64 bytes_per_sec = 0;
+            QElapsedTimer clock;
+            QObject* context = nullptr; // owns the bytesWritten connection and pacing timers
+            bool waiting = false;
+            bool done = false;
+        };
+
+        void on_new_connection();
+        void process(QTcpSocket* socket);
+        Response route(const Request& req);
+        static QString route_name(const Request& req);
+        void send(QTcpSocket* socket, Response resp);
+        void write(QTcpSocket* socket, const Response& resp);
+        void pump_body(QTcpSocket* socket, const std::shared_ptr<Writer>& w);
+        void response_done(QTcpSocket* socket);
+
+        Response handle_file(const Request& req, const QString& path);
+        Response handle_move(const Request& req);
+        Response handle_uploads(const Request& req, const QStringList& parts);
+        Response handle_manifest(const Request& req);
+        Response handle_batch(const Request& req);
+        Response handle_merkle(const Request& req);
+        Response handle_state(const Request& req);
+
+        bool move(const QString& from, const QString& to);
+        bool remove(const QString& path);
+        // Key -> digest for every child of dir; subdirectory keys end in '/'
+        QMap<QString, QString> merkle_children(const QString& dir) const;
+        QString merkle_digest(const QString& dir) const;
+        QJsonObject file_json(const QString& path) const;
+        QJsonObject session_json(const QString& id) const;
+        qint64 tick();
+
+        static Response json(int status, const QJsonObject& obj);
+        static Response not_found_endpoint();
+
+        QTcpServer m_Server;
+        QHash<QTcpSocket*, Connection> m_Connections;
+        Faults m_Faults;
+
+        QMap<QString, StoredFile> m_Files;
+        QHash<QString, qint64> m_Tombstones;
+        QHash<QString, QByteArray> m_Chunks;
+        QHash<QString, QJsonObject> m_Manifests;
+        QHash<QString, Session> m_Sessions;
+        int m_NextSession = 1;
+        qint64 m_Clock = 0;
+        QByteArray m_PeerKey;
+
+        QHash<QString, int> m_Requests;
+        qint64 m_BytesReceived = 0;
+        QList<QByteArray> m_Ranges;
+        QList<qint64> m_SyncSince;
+    };
+
+} // namespace sap::client::test
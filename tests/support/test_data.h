@@ -0,0 +1,31 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QRandomGenerator>
+#include <QString>
+
+namespace sap::client::test {
+
+    // Incompressible bytes, the same for the same seed
+    inline QByteArray random_bytes(qint64 size, quint32 seed) {
+        QByteArray data(size, Qt::Uninitialized);
+        QRandomGenerator rng(seed);
+        qint64 words = size / qint64(sizeof(quint32));
+        rng.fillRange(reinterpret_cast<quint32*>(data.data()), words);
+        for (qint64 i = words * qint64(sizeof(quint32)); i < size; ++i)
+            data[i] = static_cast<char>(rng.generate());
+        return data;
+    }
+
+    inline bool write_file(const QString& path, const QByteArray& data) {
+        QFile file(path);
+        return file.open(QIODevice::WriteOnly | QIODevice::Truncate) && file.write(data) == data.size();
+    }
+
+    inline QByteArray read_file(const QString& path) {
+        QFile file(path);
+        return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+    }
+
+} // namespace sap::client::test
@@ -0,0 +1,121 @@
+#include <QTemporaryDir>
+#include <QtTest>
+#include "sap_cloud_client/access_predictor.h"
+
+using namespace sap::client;
+
+class TestAccessPredictor : public QObject {
+    Q_OBJECT
+
+private slots:
+    void predicts_what_usually_follows();
+    void links_only_within_a_session();
+    void old_habits_fade();
+    void keeps_the_strongest_successors();
+    void forgets_the_least_recent_rows();
+    void round_trips();
+};
+
+void TestAccessPredictor::predicts_what_usually_follows() {
+    AccessPredictor predictor;
+    qint64 now = 1000;
+    for (const char* key : {"a", "b", "a", "b", "a", "c", "a"})
+        predictor.record(key, now += 1000);
+
+    auto predictions = predictor.predict("a", 5);
+    QCOMPARE(predictions.size(), qsizetype(2));
+    QCOMPARE(predictions[0].key, QString("b"));
+    QCOMPARE(predictions[0].probability, 2.0 / 3);
+    QCOMPARE(predictions[1].key, QString("c"));
+    QCOMPARE(predictor.predict("a", 1).size(), qsizetype(1));
+    QCOMPARE(predictor.predict("c", 5).first().key, QString("a"));
+    QVERIFY(predictor.predict("unknown", 5).isEmpty());
+}
+
+void TestAccessPredictor::links_only_within_a_session() {
+    AccessPredictor predictor;
+    predictor.record("a", 0);
+    predictor.record("b", AccessPredictor::k_SessionGapMs + 1);
+    QVERIFY(predictor.predict("a", 5).isEmpty());
+
+    // Reopening the same key is not a successor of itself
+    predictor.record("b", AccessPredictor::k_SessionGapMs + 2);
+    QVERIFY(predictor.predict("b", 5).isEmpty());
+    predictor.record("c", AccessPredictor::k_SessionGapMs + 3);
+    QCOMPARE(predictor.predict("b", 5).first().key, QString("c"));
+}
+
+void TestAccessPredictor::old_habits_fade() {
+    AccessPredictor predictor;
+    qint64 now = 0;
+    for (int i = 0; i < 200; ++i) {
+        predictor.record("a", ++now);
+        predictor.record("old", ++now);
+    }
+    for (int i = 0; i < 200; ++i) {
+        predictor.record("a", ++now);
+        predictor.record("new", ++now);
+    }
+    // Equal counts without decay; the halving leaves the recent habit well ahead
+    auto predictions = predictor.predict("a", 5);
+    QCOMPARE(predictions.first().key, QString("new"));
+    QVERIFY(predictions.first().probability > 0.75);
+}
+
+void TestAccessPredictor::keeps_the_strongest_successors() {
+    AccessPredictor predictor;
+    qint64 now = 0;
+    // "first" follows a twice; then more one-off successors than a row keeps
+    for (int i = 0; i < 2; ++i) {
+        predictor.record("a", ++now);
+        predictor.record("first", ++now);
+    }
+    for (int i = 0; i < AccessPredictor::k_MaxSuccessors + 4; ++i) {
+        predictor.record("a", ++now);
+        predictor.record(QString("once%1").arg(i), ++now);
+    }
+    auto predictions = predictor.predict("a", 100);
+    QCOMPARE(predictions.size(), qsizetype(AccessPredictor::k_MaxSuccessors));
+    QCOMPARE(predictions.first().key, QString("first"));
+    double sum = 0;
+    for (const auto& p : predictions)
+        sum += p.probability;
+    QVERIFY(qAbs(sum - 1.0) < 1e-9);
+}
+
+void TestAccessPredictor::forgets_the_least_recent_rows() {
+    AccessPredictor predictor;
+    qint64 now = 0;
+    predictor.record("a", ++now);
+    predictor.record("b", ++now);
+    QVERIFY(!predictor.predict("a", 1).isEmpty());
+    for (int i = 0; i < AccessPredictor::k_MaxRows; ++i)
+        predictor.record(QString("key%1").arg(i), ++now);
+    QVERIFY(predictor.predict("a", 1).isEmpty());
+    QVERIFY(!predictor.predict("key0", 1).isEmpty());
+}
+
+void TestAccessPredictor::round_trips() {
+    QTemporaryDir dir;
+    QString path = dir.filePath("history/history.json");
+    AccessPredictor predictor;
+    qint64 now = 0;
+    for (const char* key : {"a", "b", "a", "c", "a", "b"})
+        predictor.record(key, ++now);
+    QVERIFY(predictor.save(path));
+
+    AccessPredictor loaded;
+    QVERIFY(loaded.load(path));
+    auto expected = predictor.predict("a", 5);
+    auto actual = loaded.predict("a", 5);
+    QCOMPARE(actual.size(), expected.size());
+    for (qsizetype i = 0; i < expected.size(); ++i) {
+        QCOMPARE(actual[i].key, expected[i].key);
+        QCOMPARE(actual[i].probability, expected[i].probability);
+    }
+    QVERIFY(!loaded.load(dir.filePath("missing.json")));
+    QVERIFY(loaded.predict("a", 5).isEmpty());
+}
+
+QTEST_GUILESS_MAIN(TestAccessPredictor)
+#include "tst_access_predictor.moc"
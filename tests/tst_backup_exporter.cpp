@@ -0,0 +1,126 @@
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QtTest>
+#include "sap_cloud_client/api_client.h"
+#include "sap_cloud_client/backup_exporter.h"
+#include "sap_cloud_client/tar_reader.h"
+#include "support/stub_server.h"
+#include "support/test_data.h"
+
+using namespace sap::client;
+using namespace sap::client::test;
+
+class TestBackupExporter : public QObject {
+    Q_OBJECT
+
+private slots:
+    void init();
+    void exports_through_dropped_connections();
+    void exports_when_range_is_ignored();
+    void lists_files_that_keep_failing();
+
+private:
+    // Runs an export to completion; returns the finished() arguments
+    QList<QVariant> run_export();
+    // Archive entry name -> contents
+    QMap<QString, QByteArray> read_archive();
+    QString archive() const { return m_Dir->filePath("backup.tar"); }
+
+    std::unique_ptr<StubServer> m_Server;
+    std::unique_ptr<ApiClient> m_Api;
+    std::unique_ptr<QTemporaryDir> m_Dir;
+};
+
+void TestBackupExporter::init() {
+    m_Dir = std::make_unique<QTemporaryDir>();
+    m_Server = std::make_unique<StubServer>();
+    QVERIFY(m_Server->listen());
+    m_Api = std::make_unique<ApiClient>();
+    m_Api->set_server_url(m_Server->url());
+    m_Api->set_token("token");
+}
+
+QList<QVariant> TestBackupExporter::run_export() {
+    BackupExporter exporter(m_Api.get(), archive());
+    QSignalSpy finished(&exporter, &BackupExporter::finished);
+    exporter.start();
+    if (!finished.wait(30000))
+        return {};
+    return finished.first();
+}
+
+QMap<QString, QByteArray> TestBackupExporter::read_archive() {
+    QMap<QString, QByteArray> entries;
+    TarReader reader(archive());
+    if (!reader.open())
+        return entries;
+    while (auto entry = reader.next())
+        entries.insert(entry->name, reader.read(*entry));
+    return entries;
+}
+
+void TestBackupExporter::exports_through_dropped_connections() {
+    QMap<QString, QByteArray> files{
+        {"empty.txt", {}},
+        {"docs/a.txt", "hello"},
+        {"docs/deep/b.bin", random_bytes(300000, 30)},
+        // Three segments
+        {"video/big.bin", random_bytes(2 * BackupExporter::k_SegmentSize + 12345, 31)},
+    };
+    for (auto it = files.constBegin(); it != files.constEnd(); ++it)
+        m_Server->put_file(it.key(), it.value());
+    m_Server->faults().drop_after = 100000;
+    m_Server->faults().drop_count = 3;
+
+    QList<QVariant> result = run_export();
+    QCOMPARE(result.size(), 2);
+    QVERIFY2(result[0].toBool(), qPrintable(result[1].toStringList().join('\n')));
+    QVERIFY(result[1].toStringList().isEmpty());
+
+    QMap<QString, QByteArray> entries = read_archive();
+    QCOMPARE(entries.size(), files.size());
+    for (auto it = files.constBegin(); it != files.constEnd(); ++it)
+        QCOMPARE(entries.value("files/" + it.key()), it.value());
+    // Retries pick up where the dropped body stopped instead of refetching the segment
+    bool resumed = false;
+    for (const auto& range : m_Server->ranges()) {
+        if (!range.startsWith("bytes=0-") && !range.startsWith("bytes=" + QByteArray::number(BackupExporter::k_SegmentSize) + '-') &&
+            !range.startsWith("bytes=" + QByteArray::number(2 * BackupExporter::k_SegmentSize) + '-'))
+            resumed = true;
+    }
+    QVERIFY(resumed);
+}
+
+void TestBackupExporter::exports_when_range_is_ignored() {
+    QByteArray big = random_bytes(BackupExporter::k_SegmentSize + 4321, 32);
+    m_Server->put_file("big.bin", big);
+    m_Server->put_file("small.txt", "small");
+    m_Server->faults().ignore_range = true;
+
+    QList<QVariant> result = run_export();
+    QCOMPARE(result.size(), 2);
+    QVERIFY(result[0].toBool());
+    QMap<QString, QByteArray> entries = read_archive();
+    QCOMPARE(entries.value("files/big.bin"), big);
+    QCOMPARE(entries.value("files/small.txt"), QByteArray("small"));
+}
+
+void TestBackupExporter::lists_files_that_keep_failing() {
+    m_Server->put_file("flaky.bin", random_bytes(50000, 33));
+    m_Server->faults().drop_after = 10;
+    m_Server->faults().drop_count = 1 + BackupExporter::k_MaxRetries;
+
+    QList<QVariant> result = run_export();
+    QCOMPARE(result.size(), 2);
+    QStringList errors = result[1].toStringList();
+    QCOMPARE(errors.size(), qsizetype(1));
+    QVERIFY(errors.first().startsWith("flaky.bin"));
+
+    // The entry keeps its place, and the archive says what is missing
+    QMap<QString, QByteArray> entries = read_archive();
+    QCOMPARE(entries.value("files/flaky.bin").size(), qsizetype(50000));
+    QVERIFY(entries.value("BACKUP_ERRORS.txt").contains("flaky.bin"));
+}
+
+QTEST_GUILESS_MAIN(TestBackupExporter)
+#include "tst_backup_exporter.moc"
@@ -0,0 +1,119 @@
+#include <QtTest>
+#include "sap_cloud_client/api_client.h"
+#include "support/stub_server.h"
+
+using namespace sap::client;
+using namespace sap::client::test;
+
+class TestBatch : public QObject {
+    Q_OBJECT
+
+private slots:
+    void init();
+    void reports_each_op();
+    void falls_back_without_batch_endpoint();
+    void splits_large_batches();
+
+private:
+    // Runs a batch to completion; ok receives the overall result
+    QVector<BatchResult> run(const QVector<BatchOp>& ops, bool* ok = nullptr);
+    static BatchOp op(BatchOp::Kind kind, const QString& target, const QString& destination = {});
+
+    std::unique_ptr<StubServer> m_Server;
+    std::unique_ptr<ApiClient> m_Api;
+};
+
+void TestBatch::init() {
+    m_Server = std::make_unique<StubServer>();
+    QVERIFY(m_Server->listen());
+    m_Api = std::make_unique<ApiClient>();
+    m_Api->set_server_url(m_Server->url());
+    m_Api->set_token("token");
+    for (const char* path : {"a.txt", "b.txt", "c.txt"})
+        m_Server->put_file(path, path);
+}
+
+QVector<BatchResult> TestBatch::run(const QVector<BatchOp>& ops, bool* ok) {
+    bool done = false;
+    QVector<BatchResult> results;
+    m_Api->run_batch(ops, [&](bool all_sent, QVector<BatchResult> r) {
+        if (ok)
+            *ok = all_sent;
+        results = r;
+        done = true;
+    });
+    QTest::qWaitFor([&]() { return done; }, 20000);
+    return results;
+}
+
+BatchOp TestBatch::op(BatchOp::Kind kind, const QString& target, const QString& destination) {
+    BatchOp o;
+    o.kind = kind;
+    o.target = target;
+    o.destination = destination;
+    return o;
+}
+
+void TestBatch::reports_each_op() {
+    BatchOp tag = op(BatchOp::Kind::TagNote, "no-such-note");
+    tag.add_tags = {"work"};
+    bool ok = false;
+    QVector<BatchResult> results = run({op(BatchOp::Kind::DeleteFile, "a.txt"), op(BatchOp::Kind::MoveFile, "b.txt", "moved/b.txt"),
+                                        op(BatchOp::Kind::MoveFile, "missing.txt", "x.txt"), op(BatchOp::Kind::DeleteFile, "gone.txt"), tag},
+                                       &ok);
+    QVERIFY(ok);
+    QCOMPARE(results.size(), qsizetype(5));
+    QVERIFY(results[0].ok);
+    QVERIFY(results[1].ok);
+    QVERIFY(!results[2].ok);
+    QCOMPARE(results[2].status, 404);
+    // Deleting what is already gone counts as done
+    QVERIFY(results[3].ok);
+    QVERIFY(!results[4].ok);
+
+    QCOMPARE(m_Server->requests("POST batch"), 1);
+    QCOMPARE(m_Server->total_requests(), 1);
+    QCOMPARE(m_Server->paths(), QStringList({"c.txt", "moved/b.txt"}));
+}
+
+void TestBatch::falls_back_without_batch_endpoint() {
+    m_Server->faults().missing_endpoints = {"/api/v1/batch"};
+    bool ok = false;
+    QVector<BatchResult> results = run({op(BatchOp::Kind::DeleteFile, "a.txt"), op(BatchOp::Kind::MoveFile, "b.txt", "moved/b.txt"),
+                                        op(BatchOp::Kind::DeleteFile, "gone.txt")},
+                                       &ok);
+    QVERIFY(ok);
+    QCOMPARE(results.size(), qsizetype(3));
+    for (const auto& r : results)
+        QVERIFY(r.ok);
+    QVERIFY(!m_Api->supports(ApiClient::Feature::Batch));
+    QCOMPARE(m_Server->paths(), QStringList({"c.txt", "moved/b.txt"}));
+
+    // Known to be missing now, so the next batch goes straight to single requests
+    m_Server->reset_counters();
+    results = run({op(BatchOp::Kind::DeleteFile, "c.txt")});
+    QCOMPARE(results.size(), qsizetype(1));
+    QVERIFY(results[0].ok);
+    QCOMPARE(m_Server->requests("POST batch"), 0);
+    QCOMPARE(m_Server->requests("DELETE files"), 1);
+}
+
+void TestBatch::splits_large_batches() {
+    QVector<BatchOp> ops;
+    for (int i = 0; i < 2 * ApiClient::k_MaxBatchOps + 10; ++i) {
+        QString path = QString("bulk/%1.txt").arg(i);
+        m_Server->put_file(path, path.toUtf8());
+        ops.append(op(BatchOp::Kind::DeleteFile, path));
+    }
+    bool ok = false;
+    QVector<BatchResult> results = run(ops, &ok);
+    QVERIFY(ok);
+    QCOMPARE(results.size(), ops.size());
+    for (const auto& r : results)
+        QVERIFY(r.ok);
+    QCOMPARE(m_Server->requests("POST batch"), 3);
+    QCOMPARE(m_Server->paths(), QStringList({"a.txt", "b.txt", "c.txt"}));
+}
+
+QTEST_GUILESS_MAIN(TestBatch)
+#include "tst_batch.moc"
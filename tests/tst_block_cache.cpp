@@ -0,0 +1,143 @@
+#include <QtTest>
+#include "sap_cloud_client/block_cache.h"
+#include "support/stub_server.h"
+#include "support/test_data.h"
+
+using namespace sap::client;
+using namespace sap::client::test;
+
+class TestBlockCache : public QObject {
+    Q_OBJECT
+
+private slots:
+    void init();
+    void shares_concurrent_reads();
+    void keys_blocks_by_hash();
+    void evicts_past_limit();
+    void first_block_survives_ignored_range();
+
+private:
+    // Reads block index of file and waits for it; ok is false if it failed
+    void read(BlockCache& cache, qint64 index, QByteArray* block, bool* ok);
+    FileInfo remote() const;
+
+    std::unique_ptr<StubServer> m_Server;
+    std::unique_ptr<ApiClient> m_Api;
+    QByteArray m_Data;
+};
+
+void TestBlockCache::init() {
+    m_Server = std::make_unique<StubServer>();
+    QVERIFY(m_Server->listen());
+    m_Api = std::make_unique<ApiClient>();
+    m_Api->set_server_url(m_Server->url());
+    m_Api->set_token("token");
+    m_Data = random_bytes(3 * BlockCache::k_BlockSize + 1000, 7);
+    m_Server->put_file("big.bin", m_Data);
+}
+
+FileInfo TestBlockCache::remote() const {
+    FileInfo info;
+    info.path = "big.bin";
+    info.size = m_Data.size();
+    info.hash = StubServer::hash_of(m_Data);
+    return info;
+}
+
+void TestBlockCache::read(BlockCache& cache, qint64 index, QByteArray* block, bool* ok) {
+    bool done = false;
+    cache.read(remote(), index, [&](bool read_ok, const QByteArray& data) {
+        *ok = read_ok;
+        *block = data;
+        done = true;
+    });
+    QTRY_VERIFY(done);
+}
+
+void TestBlockCache::shares_concurrent_reads() {
+    BlockCache cache(m_Api.get());
+    int done = 0;
+    for (int i = 0; i < 3; ++i) {
+        cache.read(remote(), 1, [&](bool ok, const QByteArray& data) {
+            QVERIFY(ok);
+            QCOMPARE(data, m_Data.mid(BlockCache::k_BlockSize, BlockCache::k_BlockSize));
+            done++;
+        });
+    }
+    QTRY_COMPARE(done, 3);
+    QCOMPARE(m_Server->requests("GET files"), 1);
+
+    // The short last block
+    QByteArray block;
+    bool ok = false;
+    read(cache, 3, &block, &ok);
+    QVERIFY(ok);
+    QCOMPARE(block, m_Data.right(1000));
+    read(cache, 1, &block, &ok);
+    QCOMPARE(m_Server->requests("GET files"), 2);
+    QCOMPARE(cache.stats().hits, qint64(1));
+    QCOMPARE(cache.stats().misses, qint64(4));
+    QCOMPARE(cache.stats().bytes_fetched, BlockCache::k_BlockSize + 1000);
+}
+
+void TestBlockCache::keys_blocks_by_hash() {
+    BlockCache cache(m_Api.get());
+    QByteArray block;
+    bool ok = false;
+    read(cache, 0, &block, &ok);
+    QVERIFY(ok);
+
+    // Same path, new content: the cached block is someone else's now
+    m_Data = random_bytes(m_Data.size(), 8);
+    m_Server->put_file("big.bin", m_Data);
+    read(cache, 0, &block, &ok);
+    QVERIFY(ok);
+    QCOMPARE(block, m_Data.left(BlockCache::k_BlockSize));
+    QCOMPARE(m_Server->requests("GET files"), 2);
+
+    // Out of range, and without a hash to key on
+    read(cache, 4, &block, &ok);
+    QVERIFY(!ok);
+    FileInfo unhashed = remote();
+    unhashed.hash.clear();
+    bool called = false;
+    cache.read(unhashed, 0, [&](bool read_ok, const QByteArray&) {
+        QVERIFY(!read_ok);
+        called = true;
+    });
+    QVERIFY(called);
+}
+
+void TestBlockCache::evicts_past_limit() {
+    BlockCache cache(m_Api.get());
+    cache.set_limit(2 * BlockCache::k_BlockSize);
+    QByteArray block;
+    bool ok = false;
+    for (qint64 index : {0, 1, 2}) {
+        read(cache, index, &block, &ok);
+        QVERIFY(ok);
+    }
+    QCOMPARE(m_Server->requests("GET files"), 3);
+    // Block 0 was the least recently used
+    read(cache, 2, &block, &ok);
+    QCOMPARE(m_Server->requests("GET files"), 3);
+    read(cache, 0, &block, &ok);
+    QVERIFY(ok);
+    QCOMPARE(m_Server->requests("GET files"), 4);
+}
+
+void TestBlockCache::first_block_survives_ignored_range() {
+    m_Server->faults().ignore_range = true;
+    BlockCache cache(m_Api.get());
+    QByteArray block;
+    bool ok = false;
+    read(cache, 0, &block, &ok);
+    QVERIFY(ok);
+    QCOMPARE(block, m_Data.left(BlockCache::k_BlockSize));
+    // Any later block would need the whole file before it: refused rather than downloaded
+    read(cache, 1, &block, &ok);
+    QVERIFY(!ok);
+}
+
+QTEST_GUILESS_MAIN(TestBlockCache)
+#include "tst_block_cache.moc"
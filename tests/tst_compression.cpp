@@ -0,0 +1,133 @@
+#include <QTemporaryDir>
+#include <QtTest>
+#include "sap_cloud_client/api_client.h"
+#include "sap_cloud_client/upload_source.h"
+#include "support/stub_server.h"
+#include "support/test_data.h"
+
+using namespace sap::client;
+using namespace sap::client::test;
+
+class TestCompression : public QObject {
+    Q_OBJECT
+
+private slots:
+    void init();
+    void deflates_compressible_bodies();
+    void sends_incompressible_bodies_as_they_are();
+    void deflates_streamed_uploads();
+    void resends_uncompressed_after_415();
+    void respects_upload_compression_off();
+
+private:
+    // Any response tells the client which request codings the server takes
+    void learn_encodings();
+    bool upload(const QString& path, const QByteArray& data);
+    static QByteArray text(qint64 size);
+
+    std::unique_ptr<StubServer> m_Server;
+    std::unique_ptr<ApiClient> m_Api;
+};
+
+void TestCompression::init() {
+    m_Server = std::make_unique<StubServer>();
+    QVERIFY(m_Server->listen());
+    m_Api = std::make_unique<ApiClient>();
+    m_Api->set_server_url(m_Server->url());
+    m_Api->set_token("token");
+}
+
+void TestCompression::learn_encodings() {
+    bool done = false;
+    m_Api->list_files([&](bool, QVector<FileInfo>) { done = true; });
+    QTRY_VERIFY(done);
+    m_Server->reset_counters();
+}
+
+bool TestCompression::upload(const QString& path, const QByteArray& data) {
+    bool done = false;
+    bool result = false;
+    m_Api->upload_file(path, data, [&](bool ok) {
+        result = ok;
+        done = true;
+    });
+    return QTest::qWaitFor([&]() { return done; }, 20000) && result;
+}
+
+QByteArray TestCompression::text(qint64 size) {
+    QByteArray out;
+    for (int line = 0; out.size() < size; ++line)
+        out += "line " + QByteArray::number(line) + ": the quick brown fox jumps over the lazy dog\n";
+    out.truncate(size);
+    return out;
+}
+
+void TestCompression::deflates_compressible_bodies() {
+    m_Server->faults().accept_deflate = true;
+    learn_encodings();
+    QByteArray data = text(1024 * 1024);
+    QVERIFY(upload("notes.txt", data));
+    QCOMPARE(m_Server->file("notes.txt"), data);
+    QVERIFY(m_Server->bytes_received() < data.size() / 4);
+}
+
+void TestCompression::sends_incompressible_bodies_as_they_are() {
+    m_Server->faults().accept_deflate = true;
+    learn_encodings();
+    QByteArray data = random_bytes(1024 * 1024, 50);
+    QVERIFY(upload("photo.jpg", data));
+    QCOMPARE(m_Server->file("photo.jpg"), data);
+    QCOMPARE(m_Server->bytes_received(), qint64(data.size()));
+}
+
+void TestCompression::deflates_streamed_uploads() {
+    m_Server->faults().accept_deflate = true;
+    learn_encodings();
+    QTemporaryDir dir;
+    QString local = dir.filePath("log.txt");
+    QByteArray data = text(2 * 1024 * 1024);
+    QVERIFY(write_file(local, data));
+
+    auto* source = new UploadSource(local);
+    QVERIFY(source->open(QIODevice::ReadOnly));
+    bool done = false;
+    bool ok = false;
+    QString hash;
+    m_Api->upload_file("log.txt", source, {}, [&](bool sent, QString content_hash) {
+        ok = sent;
+        hash = content_hash;
+        done = true;
+    });
+    QTRY_VERIFY(done);
+    QVERIFY(ok);
+    // The hash is of the content, not of what went over the wire
+    QCOMPARE(hash, StubServer::hash_of(data));
+    QCOMPARE(m_Server->file("log.txt"), data);
+    QVERIFY(m_Server->bytes_received() < data.size() / 4);
+}
+
+void TestCompression::resends_uncompressed_after_415() {
+    m_Server->faults().reject_deflate = true;
+    learn_encodings();
+    QByteArray data = text(256 * 1024);
+    QVERIFY(upload("a.txt", data));
+    QCOMPARE(m_Server->file("a.txt"), data);
+    QCOMPARE(m_Server->requests("PUT files"), 2);
+
+    // Rejected once is enough: the next body goes uncompressed right away
+    QVERIFY(upload("b.txt", data));
+    QCOMPARE(m_Server->requests("PUT files"), 3);
+    QCOMPARE(m_Server->file("b.txt"), data);
+}
+
+void TestCompression::respects_upload_compression_off() {
+    m_Server->faults().accept_deflate = true;
+    m_Api->set_upload_compression(false);
+    learn_encodings();
+    QByteArray data = text(1024 * 1024);
+    QVERIFY(upload("plain.txt", data));
+    QCOMPARE(m_Server->bytes_received(), qint64(data.size()));
+}
+
+QTEST_GUILESS_MAIN(TestCompression)
+#include "tst_compression.moc"
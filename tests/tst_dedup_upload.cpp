@@ -0,0 +1,140 @@
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QtTest>
+#include "sap_cloud_client/api_client.h"
+#include "sap_cloud_client/chunk_index.h"
+#include "sap_cloud_client/chunker.h"
+#include "sap_cloud_client/dedup_upload.h"
+#include "support/stub_server.h"
+#include "support/test_data.h"
+
+using namespace sap::client;
+using namespace sap::client::test;
+
+class TestDedupUpload : public QObject {
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cuts_within_bounds();
+    void insert_moves_few_boundaries();
+    void edited_file_sends_only_the_edit();
+    void resends_chunks_the_server_lost();
+
+private:
+    // Uploads local through a DedupUpload; returns the bytes it sent, or -1 on failure
+    qint64 upload(ApiClient* api, const QString& local, const QString& remote);
+
+    std::unique_ptr<StubServer> m_Server;
+    std::unique_ptr<ApiClient> m_Api;
+    std::unique_ptr<ChunkIndex> m_Index;
+    std::unique_ptr<QTemporaryDir> m_Dir;
+};
+
+void TestDedupUpload::init() {
+    m_Dir = std::make_unique<QTemporaryDir>();
+    m_Server = std::make_unique<StubServer>();
+    QVERIFY(m_Server->listen());
+    m_Api = std::make_unique<ApiClient>();
+    m_Api->set_server_url(m_Server->url());
+    m_Api->set_token("token");
+    m_Index = std::make_unique<ChunkIndex>(m_Dir->filePath("chunks.index"));
+    QVERIFY(m_Index->open());
+}
+
+qint64 TestDedupUpload::upload(ApiClient* api, const QString& local, const QString& remote) {
+    DedupUpload upload(api, m_Index.get(), local, remote);
+    QSignalSpy finished(&upload, &DedupUpload::finished);
+    upload.start();
+    if (!finished.wait(20000) || !finished.first().first().toBool())
+        return -1;
+    return upload.bytes_sent();
+}
+
+void TestDedupUpload::cuts_within_bounds() {
+    QByteArray data = random_bytes(24 * 1024 * 1024, 7);
+    const auto* bytes = reinterpret_cast<const uchar*>(data.constData());
+    qint64 offset = 0;
+    int chunks = 0;
+    while (offset < data.size()) {
+        qint64 length = Chunker::cut(bytes + offset, data.size() - offset);
+        QVERIFY(length > 0);
+        QVERIFY(length <= Chunker::k_MaxSize);
+        if (offset + length < data.size())
+            QVERIFY(length >= Chunker::k_MinSize);
+        offset += length;
+        chunks++;
+    }
+    QCOMPARE(offset, qint64(data.size()));
+    // Normalized chunking keeps the count near size / k_AvgSize
+    QVERIFY(chunks >= 24 / 2);
+    QVERIFY(chunks <= 24 * 2);
+}
+
+void TestDedupUpload::insert_moves_few_boundaries() {
+    QByteArray data = random_bytes(24 * 1024 * 1024, 8);
+    QByteArray edited = data;
+    edited.insert(data.size() / 2, random_bytes(1000, 9));
+    QString a = m_Dir->filePath("a.bin");
+    QString b = m_Dir->filePath("b.bin");
+    QVERIFY(write_file(a, data));
+    QVERIFY(write_file(b, edited));
+
+    auto before = Chunker::manifest_for_file(a);
+    auto after = Chunker::manifest_for_file(b);
+    QVERIFY(before && after);
+    QCOMPARE(before->hash, StubServer::hash_of(data));
+    QCOMPARE(after->size, qint64(edited.size()));
+
+    QSet<QString> old_hashes;
+    for (const auto& chunk : before->chunks)
+        old_hashes.insert(chunk.hash);
+    int changed = 0;
+    for (const auto& chunk : after->chunks) {
+        if (!old_hashes.contains(chunk.hash))
+            changed++;
+    }
+    // The edited chunk, and at most one neighbour whose boundary moved
+    QVERIFY2(changed <= 2, qPrintable(QString("%1 chunks changed").arg(changed)));
+}
+
+void TestDedupUpload::edited_file_sends_only_the_edit() {
+    QByteArray data = random_bytes(DedupUpload::k_MinFileSize + 16 * 1024 * 1024, 10);
+    QString local = m_Dir->filePath("big.bin");
+    QVERIFY(write_file(local, data));
+
+    QCOMPARE(upload(m_Api.get(), local, "big.bin"), qint64(data.size()));
+    QCOMPARE(m_Server->file("big.bin"), data);
+
+    data.replace(data.size() / 3, 4096, random_bytes(4096, 11));
+    QVERIFY(write_file(local, data));
+    m_Server->reset_counters();
+
+    qint64 sent = upload(m_Api.get(), local, "big.bin");
+    QVERIFY(sent > 0);
+    QVERIFY2(sent <= 2 * Chunker::k_MaxSize, qPrintable(QString("sent %1 bytes").arg(sent)));
+    QVERIFY(m_Server->bytes_received() < data.size() / 4);
+    QCOMPARE(m_Server->file("big.bin"), data);
+}
+
+void TestDedupUpload::resends_chunks_the_server_lost() {
+    QByteArray data = random_bytes(DedupUpload::k_MinFileSize + 1024 * 1024, 12);
+    QString local = m_Dir->filePath("big.bin");
+    QVERIFY(write_file(local, data));
+    QVERIFY(upload(m_Api.get(), local, "big.bin") > 0);
+
+    // A server that never saw these chunks, while the index still lists them
+    StubServer other;
+    QVERIFY(other.listen());
+    ApiClient api;
+    api.set_server_url(other.url());
+    api.set_token("token");
+
+    QCOMPARE(upload(&api, local, "big.bin"), qint64(data.size()));
+    QCOMPARE(other.requests("POST missing"), 0);
+    QCOMPARE(other.requests("POST manifests"), 2);
+    QCOMPARE(other.file("big.bin"), data);
+}
+
+QTEST_GUILESS_MAIN(TestDedupUpload)
+#include "tst_dedup_upload.moc"
@@ -0,0 +1,176 @@
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QtTest>
+#include "sap_cloud_client/download_verifier.h"
+#include "support/stub_server.h"
+#include "support/test_data.h"
+
+using namespace sap::client;
+using namespace sap::client::test;
+
+class TestDownloadVerifier : public QObject {
+    Q_OBJECT
+
+private slots:
+    void init();
+    void verifies_bytes_and_files();
+    void reports_a_wrong_hash();
+    void stalls_on_a_bad_chunk_until_rewound();
+    void rewinds_to_the_start();
+    void refuses_a_rewind_elsewhere();
+    void ignores_a_manifest_that_does_not_tile();
+
+private:
+    static constexpr qint64 k_ChunkSize = 64 * 1024;
+
+    // Chunk refs tiling m_Data
+    QVector<ChunkRef> chunks() const;
+    // Waits for finished(); ok and hash are its arguments
+    static void wait_finished(QSignalSpy& finished, bool* ok, QString* hash);
+
+    QByteArray m_Data;
+};
+
+void TestDownloadVerifier::init() { m_Data = random_bytes(5 * k_ChunkSize + 1000, 11); }
+
+QVector<ChunkRef> TestDownloadVerifier::chunks() const {
+    QVector<ChunkRef> refs;
+    for (qint64 offset = 0; offset < m_Data.size(); offset += k_ChunkSize) {
+        QByteArray chunk = m_Data.mid(offset, k_ChunkSize);
+        refs.append({StubServer::hash_of(chunk), offset, chunk.size()});
+    }
+    return refs;
+}
+
+void TestDownloadVerifier::wait_finished(QSignalSpy& finished, bool* ok, QString* hash) {
+    QTRY_COMPARE(finished.size(), 1);
+    *ok = finished.first().at(0).toBool();
+    *hash = finished.first().at(1).toString();
+}
+
+void TestDownloadVerifier::verifies_bytes_and_files() {
+    QTemporaryDir dir;
+    QString path = dir.filePath("file.part");
+    QVERIFY(write_file(path, m_Data));
+
+    // Some bytes from the network, the rest read back from what segments wrote
+    DownloadVerifier verifier(StubServer::hash_of(m_Data), chunks());
+    QVERIFY(verifier.has_chunks());
+    QSignalSpy failed(&verifier, &DownloadVerifier::chunk_failed);
+    QSignalSpy finished(&verifier, &DownloadVerifier::finished);
+    verifier.add(m_Data.left(1000));
+    verifier.add(m_Data.mid(1000, k_ChunkSize));
+    QCOMPARE(verifier.fed(), k_ChunkSize + 1000);
+    verifier.add_file(path, m_Data.size() - verifier.fed());
+    QCOMPARE(verifier.fed(), qint64(m_Data.size()));
+    verifier.finish();
+
+    bool ok = false;
+    QString hash;
+    wait_finished(finished, &ok, &hash);
+    QVERIFY(ok);
+    QCOMPARE(hash, StubServer::hash_of(m_Data));
+    QCOMPARE(failed.size(), 0);
+}
+
+void TestDownloadVerifier::reports_a_wrong_hash() {
+    // Without a manifest the mismatch only shows at the end
+    DownloadVerifier verifier(StubServer::hash_of("something else"));
+    QVERIFY(!verifier.has_chunks());
+    QSignalSpy finished(&verifier, &DownloadVerifier::finished);
+    verifier.add(m_Data);
+    verifier.finish();
+
+    bool ok = true;
+    QString hash;
+    wait_finished(finished, &ok, &hash);
+    QVERIFY(!ok);
+    QCOMPARE(hash, StubServer::hash_of(m_Data));
+}
+
+void TestDownloadVerifier::stalls_on_a_bad_chunk_until_rewound() {
+    DownloadVerifier verifier(StubServer::hash_of(m_Data), chunks());
+    QSignalSpy failed(&verifier, &DownloadVerifier::chunk_failed);
+    QSignalSpy finished(&verifier, &DownloadVerifier::finished);
+    QByteArray corrupt = m_Data;
+    corrupt[2 * k_ChunkSize + 7] = static_cast<char>(corrupt[2 * k_ChunkSize + 7] ^ 1);
+    verifier.add(corrupt);
+    verifier.finish();
+
+    QTRY_COMPARE(failed.size(), 1);
+    QCOMPARE(failed.first().at(0).toLongLong(), 2 * k_ChunkSize);
+    QCOMPARE(failed.first().at(1).toLongLong(), k_ChunkSize);
+    // Bytes past the bad chunk, and the finish, wait for the repair
+    QTest::qWait(200);
+    QCOMPARE(failed.size(), 1);
+    QCOMPARE(finished.size(), 0);
+
+    verifier.rewind(2 * k_ChunkSize);
+    QCOMPARE(verifier.fed(), 2 * k_ChunkSize);
+    verifier.add(m_Data.mid(2 * k_ChunkSize));
+    verifier.finish();
+    bool ok = false;
+    QString hash;
+    wait_finished(finished, &ok, &hash);
+    QVERIFY(ok);
+    QCOMPARE(failed.size(), 1);
+}
+
+void TestDownloadVerifier::rewinds_to_the_start() {
+    DownloadVerifier verifier(StubServer::hash_of(m_Data));
+    QSignalSpy finished(&verifier, &DownloadVerifier::finished);
+    verifier.add(random_bytes(3000, 12));
+    verifier.rewind(0);
+    QCOMPARE(verifier.fed(), qint64(0));
+    verifier.add(m_Data);
+    verifier.finish();
+
+    bool ok = false;
+    QString hash;
+    wait_finished(finished, &ok, &hash);
+    QVERIFY(ok);
+}
+
+void TestDownloadVerifier::refuses_a_rewind_elsewhere() {
+    // Only 0 or the start of the chunk last reported bad can be rewound to
+    DownloadVerifier verifier(StubServer::hash_of(m_Data), chunks());
+    QSignalSpy finished(&verifier, &DownloadVerifier::finished);
+    verifier.add(m_Data.left(k_ChunkSize + 10));
+    verifier.rewind(10);
+    verifier.add(m_Data.mid(10));
+    verifier.finish();
+
+    bool ok = true;
+    QString hash;
+    wait_finished(finished, &ok, &hash);
+    QVERIFY(!ok);
+    QVERIFY(hash.isEmpty());
+}
+
+void TestDownloadVerifier::ignores_a_manifest_that_does_not_tile() {
+    QVector<ChunkRef> gap = chunks();
+    gap.removeAt(1);
+    QVector<ChunkRef> late = chunks();
+    late.removeFirst();
+    QVector<ChunkRef> unhashed = chunks();
+    unhashed[2].hash.clear();
+    for (const auto& refs : {gap, late, unhashed}) {
+        DownloadVerifier verifier(StubServer::hash_of(m_Data), refs);
+        QVERIFY(!verifier.has_chunks());
+    }
+
+    // Still checks the whole file
+    DownloadVerifier verifier(StubServer::hash_of(m_Data), gap);
+    QSignalSpy failed(&verifier, &DownloadVerifier::chunk_failed);
+    QSignalSpy finished(&verifier, &DownloadVerifier::finished);
+    verifier.add(m_Data);
+    verifier.finish();
+    bool ok = false;
+    QString hash;
+    wait_finished(finished, &ok, &hash);
+    QVERIFY(ok);
+    QCOMPARE(failed.size(), 0);
+}
+
+QTEST_GUILESS_MAIN(TestDownloadVerifier)
+#include "tst_download_verifier.moc"
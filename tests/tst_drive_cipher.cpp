@@ -0,0 +1,175 @@
+#include <QTemporaryDir>
+#include <QtTest>
+#include "sap_cloud_client/drive_cipher.h"
+#include "sap_cloud_client/upload_source.h"
+#include "support/stub_server.h"
+#include "support/test_data.h"
+
+using namespace sap::client;
+using namespace sap::client::test;
+
+class TestDriveCipher : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void round_trip_data();
+    void round_trip();
+    void detects_tampering();
+    void detects_truncation();
+    void plaintext_with_magic_is_plain();
+    void other_key_is_unreadable();
+    void chunks_are_bound_to_their_index();
+    void key_file_round_trip();
+    void copy_keeps_its_key();
+
+private:
+    // Seals plain through UploadSource into <name>.sap and returns its path
+    QString seal(const QByteArray& plain, const QString& name);
+
+    QTemporaryDir m_Dir;
+    DriveCipher m_Cipher;
+};
+
+void TestDriveCipher::initTestCase() { QVERIFY(m_Cipher.generate_key()); }
+
+QString TestDriveCipher::seal(const QByteArray& plain, const QString& name) {
+    QString local = m_Dir.filePath(name);
+    QString sealed = local + ".sap";
+    if (!write_file(local, plain))
+        return {};
+    UploadSource source(local, &m_Cipher);
+    if (!source.open(QIODevice::ReadOnly))
+        return {};
+    QByteArray bytes = source.readAll();
+    // The hash the upload reports is of what the server stores
+    if (source.hash() != StubServer::hash_of(bytes) || !write_file(sealed, bytes))
+        return {};
+    return sealed;
+}
+
+void TestDriveCipher::round_trip_data() {
+    QTest::addColumn<qint64>("size");
+    QTest::newRow("empty") << qint64(0);
+    QTest::newRow("one byte") << qint64(1);
+    QTest::newRow("one chunk") << DriveCipher::k_ChunkSize;
+    QTest::newRow("chunks and a tail") << 3 * DriveCipher::k_ChunkSize + 100;
+}
+
+void TestDriveCipher::round_trip() {
+    QFETCH(qint64, size);
+    QByteArray plain = random_bytes(size, 20);
+    QString sealed = seal(plain, "round_trip.bin");
+    QVERIFY(!sealed.isEmpty());
+    QCOMPARE(QFileInfo(sealed).size(), DriveCipher::encrypted_size(size));
+    QCOMPARE(DriveCipher::plain_size(DriveCipher::encrypted_size(size)), size);
+    QCOMPARE(m_Cipher.probe_file(sealed), DriveCipher::Probe::Sealed);
+
+    QString out = m_Dir.filePath("round_trip.out");
+    QString error;
+    QVERIFY2(m_Cipher.decrypt_file(sealed, out, &error), qPrintable(error));
+    QCOMPARE(read_file(out), plain);
+}
+
+void TestDriveCipher::detects_tampering() {
+    QByteArray plain = random_bytes(3 * DriveCipher::k_ChunkSize, 21);
+    QString sealed = seal(plain, "tamper.bin");
+    QVERIFY(!sealed.isEmpty());
+
+    QByteArray bytes = read_file(sealed);
+    qint64 second_chunk = DriveCipher::k_HeaderSize + DriveCipher::k_SealedChunkSize + 10;
+    bytes[second_chunk] = static_cast<char>(bytes[second_chunk] ^ 0x01);
+    QVERIFY(write_file(sealed, bytes));
+
+    QString out = m_Dir.filePath("tamper.out");
+    QVERIFY(write_file(out, "previous contents"));
+    QVERIFY(!m_Cipher.decrypt_file(sealed, out));
+    // A failed decryption leaves the target as it was
+    QCOMPARE(read_file(out), QByteArray("previous contents"));
+}
+
+void TestDriveCipher::detects_truncation() {
+    QByteArray plain = random_bytes(3 * DriveCipher::k_ChunkSize, 22);
+    QString sealed = seal(plain, "truncate.bin");
+    QVERIFY(!sealed.isEmpty());
+
+    // Dropping whole chunks keeps the layout's size arithmetic valid; the last-chunk flag catches it
+    QByteArray bytes = read_file(sealed);
+    bytes.chop(DriveCipher::k_SealedChunkSize);
+    QVERIFY(write_file(sealed, bytes));
+    QVERIFY(!m_Cipher.decrypt_file(sealed, m_Dir.filePath("truncate.out")));
+}
+
+void TestDriveCipher::plaintext_with_magic_is_plain() {
+    QString local = m_Dir.filePath("magic.txt");
+    QVERIFY(write_file(local, "SAPE: notes\n" + random_bytes(DriveCipher::k_HeaderSize + DriveCipher::k_SealedChunkSize, 23)));
+    QCOMPARE(m_Cipher.probe_file(local), DriveCipher::Probe::Plain);
+
+    // Our magic and version, but a size no sealed file can have
+    QByteArray header = m_Cipher.new_file_key().header;
+    QVERIFY(write_file(local, header + QByteArray(5, 'x')));
+    QCOMPARE(m_Cipher.probe_file(local), DriveCipher::Probe::Plain);
+}
+
+void TestDriveCipher::other_key_is_unreadable() {
+    QString sealed = seal(random_bytes(100000, 24), "other.bin");
+    QVERIFY(!sealed.isEmpty());
+
+    DriveCipher other;
+    QCOMPARE(other.probe_file(sealed), DriveCipher::Probe::Unreadable);
+    QVERIFY(other.generate_key());
+    QCOMPARE(other.probe_file(sealed), DriveCipher::Probe::Unreadable);
+    QVERIFY(!other.decrypt_file(sealed, m_Dir.filePath("other.out")));
+}
+
+void TestDriveCipher::chunks_are_bound_to_their_index() {
+    DriveCipher::FileKey key = m_Cipher.new_file_key();
+    QVERIFY(key.is_valid());
+    QVERIFY(DriveCipher::is_encrypted(key.header));
+
+    QByteArray plain = random_bytes(1000, 25);
+    QByteArray sealed(plain.size() + DriveCipher::k_TagSize, Qt::Uninitialized);
+    QVERIFY(DriveCipher::seal_chunk(key, 2, false, plain, sealed.data()));
+
+    QByteArray opened(plain.size(), Qt::Uninitialized);
+    QVERIFY(DriveCipher::open_chunk(key, 2, false, sealed, opened.data()));
+    QCOMPARE(opened, plain);
+    QVERIFY(!DriveCipher::open_chunk(key, 3, false, sealed, opened.data()));
+    QVERIFY(!DriveCipher::open_chunk(key, 2, true, sealed, opened.data()));
+    // Same master key, another file's salt
+    QVERIFY(!DriveCipher::open_chunk(m_Cipher.new_file_key(), 2, false, sealed, opened.data()));
+    // The header alone recovers the file's key
+    QVERIFY(DriveCipher::open_chunk(m_Cipher.file_key(key.header), 2, false, sealed, opened.data()));
+}
+
+void TestDriveCipher::key_file_round_trip() {
+    QString path = m_Dir.filePath("keys/drive.key");
+    QVERIFY(m_Cipher.save_key(path));
+    QCOMPARE(QFileInfo(path).size(), qint64(DriveCipher::k_KeySize));
+    QVERIFY(!(QFile::permissions(path) & (QFile::ReadGroup | QFile::ReadOther)));
+
+    QString sealed = seal(random_bytes(70000, 26), "key.bin");
+    DriveCipher loaded;
+    QVERIFY(loaded.load_key(path));
+    QCOMPARE(loaded.probe_file(sealed), DriveCipher::Probe::Sealed);
+}
+
+void TestDriveCipher::copy_keeps_its_key() {
+    QByteArray plain = random_bytes(2 * DriveCipher::k_ChunkSize + 5, 27);
+    QString sealed = seal(plain, "copied");
+    QVERIFY(!sealed.isEmpty());
+
+    // What a queued decryption holds while the settings swap the key
+    DriveCipher queued = m_Cipher;
+    DriveCipher replaced = m_Cipher;
+    QVERIFY(replaced.generate_key());
+    QCOMPARE(replaced.probe_file(sealed), DriveCipher::Probe::Unreadable);
+
+    QString out = m_Dir.filePath("copied.out");
+    QString error;
+    QVERIFY2(queued.decrypt_file(sealed, out, &error), qPrintable(error));
+    QCOMPARE(read_file(out), plain);
+}
+
+QTEST_GUILESS_MAIN(TestDriveCipher)
+#include "tst_drive_cipher.moc"
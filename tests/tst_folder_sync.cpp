@@ -0,0 +1,180 @@
+#include <QDir>
+#include <QSignalSpy>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QtTest>
+#include "sap_cloud_client/folder_sync.h"
+#include "support/stub_server.h"
+#include "support/test_data.h"
+
+using namespace sap::client;
+using namespace sap::client::test;
+
+class TestFolderSync : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+    void pushes_and_pulls_on_start();
+    void local_changes_are_pushed();
+    void remote_changes_are_pulled();
+    void both_sides_changed_keeps_both();
+
+private:
+    static constexpr int k_TimeoutMs = 10000;
+
+    // A FolderSync on the temporary folder, started once the remote index is in
+    void start_folder();
+    // Starts the folder and waits for the first push of a.txt and pull of b.txt
+    void start_and_settle();
+    // Whether activity(path, uploaded) was emitted
+    static bool seen(const QSignalSpy& activity, const QString& path, bool uploaded);
+    QString path(const QString& relative) const { return m_Dir->filePath(relative); }
+
+    std::unique_ptr<StubServer> m_Server;
+    std::unique_ptr<ApiClient> m_Api;
+    std::unique_ptr<SyncEngine> m_Sync;
+    std::unique_ptr<TransferScheduler> m_Scheduler;
+    std::unique_ptr<TransferManager> m_Transfers;
+    std::unique_ptr<QTemporaryDir> m_Dir;
+    std::unique_ptr<FolderSync> m_Folder;
+    std::unique_ptr<QSignalSpy> m_Activity;
+};
+
+void TestFolderSync::initTestCase() { QStandardPaths::setTestModeEnabled(true); }
+
+void TestFolderSync::init() {
+    // No sync index or folder records from an earlier test
+    QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)).removeRecursively();
+    m_Dir = std::make_unique<QTemporaryDir>();
+    QVERIFY(write_file(path("a.txt"), "local a"));
+    m_Server = std::make_unique<StubServer>();
+    QVERIFY(m_Server->listen());
+    m_Server->put_file("Sync/b.txt", "remote b");
+    m_Server->put_file("elsewhere.txt", "not synced");
+    m_Api = std::make_unique<ApiClient>();
+    m_Api->set_server_url(m_Server->url());
+    m_Api->set_token("token");
+    m_Sync = std::make_unique<SyncEngine>(m_Api.get());
+    m_Scheduler = std::make_unique<TransferScheduler>();
+    m_Transfers = std::make_unique<TransferManager>(m_Api.get(), m_Scheduler.get());
+    m_Sync->start();
+    QTRY_VERIFY(m_Sync->has_snapshot());
+}
+
+void TestFolderSync::cleanup() {
+    m_Activity.reset();
+    m_Folder.reset();
+    m_Transfers.reset();
+    m_Scheduler.reset();
+    m_Sync.reset();
+    m_Api.reset();
+    m_Server.reset();
+    m_Dir.reset();
+}
+
+void TestFolderSync::start_folder() {
+    m_Activity.reset();
+    m_Folder = std::make_unique<FolderSync>(m_Api.get(), m_Transfers.get(), m_Sync.get(), m_Dir->path(), "Sync");
+    m_Activity = std::make_unique<QSignalSpy>(m_Folder.get(), &FolderSync::activity);
+    QVERIFY(m_Folder->start());
+}
+
+void TestFolderSync::start_and_settle() {
+    start_folder();
+    QTRY_VERIFY_WITH_TIMEOUT(seen(*m_Activity, "a.txt", true), k_TimeoutMs);
+    QTRY_VERIFY_WITH_TIMEOUT(seen(*m_Activity, "b.txt", false), k_TimeoutMs);
+    // The upload shows up in the index
+    QTRY_VERIFY_WITH_TIMEOUT(m_Sync->file("Sync/a.txt").has_value(), k_TimeoutMs);
+    m_Activity->clear();
+}
+
+bool TestFolderSync::seen(const QSignalSpy& activity, const QString& path, bool uploaded) {
+    for (const auto& args : activity) {
+        if (args.at(0).toString() == path && args.at(1).toBool() == uploaded)
+            return true;
+    }
+    return false;
+}
+
+void TestFolderSync::pushes_and_pulls_on_start() {
+    start_and_settle();
+    QCOMPARE(m_Server->file("Sync/a.txt"), QByteArray("local a"));
+    QCOMPARE(read_file(path("b.txt")), QByteArray("remote b"));
+    QVERIFY(!QFile::exists(path("elsewhere.txt")));
+
+    // Writing b.txt raised watcher events; they match the record and aren't echoed back
+    QTest::qWait(3 * FolderWatcher::k_SettleMs);
+    QVERIFY(m_Activity->isEmpty());
+    QCOMPARE(m_Server->file("Sync/b.txt"), QByteArray("remote b"));
+}
+
+void TestFolderSync::local_changes_are_pushed() {
+    start_and_settle();
+
+    QVERIFY(write_file(path("a.txt"), "local a, edited"));
+    QVERIFY(QDir(m_Dir->path()).mkpath("new/deeper"));
+    QVERIFY(write_file(path("new/deeper/c.txt"), "c"));
+    QTRY_VERIFY_WITH_TIMEOUT(seen(*m_Activity, "a.txt", true), k_TimeoutMs);
+    QTRY_VERIFY_WITH_TIMEOUT(seen(*m_Activity, "new/deeper/c.txt", true), k_TimeoutMs);
+    QCOMPARE(m_Server->file("Sync/a.txt"), QByteArray("local a, edited"));
+    QCOMPARE(m_Server->file("Sync/new/deeper/c.txt"), QByteArray("c"));
+
+    // A local delete removes the remote copy
+    QTRY_VERIFY_WITH_TIMEOUT(m_Sync->file("Sync/new/deeper/c.txt").has_value(), k_TimeoutMs);
+    QVERIFY(QFile::remove(path("new/deeper/c.txt")));
+    QTRY_VERIFY_WITH_TIMEOUT(!m_Server->has_file("Sync/new/deeper/c.txt"), k_TimeoutMs);
+    QVERIFY(m_Server->has_file("Sync/a.txt"));
+}
+
+void TestFolderSync::remote_changes_are_pulled() {
+    start_and_settle();
+
+    m_Server->put_file("Sync/b.txt", "remote b, edited");
+    m_Server->put_file("Sync/dir/e.txt", "e");
+    m_Sync->sync_now();
+    QTRY_VERIFY_WITH_TIMEOUT(seen(*m_Activity, "b.txt", false), k_TimeoutMs);
+    QTRY_VERIFY_WITH_TIMEOUT(seen(*m_Activity, "dir/e.txt", false), k_TimeoutMs);
+    QCOMPARE(read_file(path("b.txt")), QByteArray("remote b, edited"));
+    QCOMPARE(read_file(path("dir/e.txt")), QByteArray("e"));
+
+    // A remote delete removes the local copy that still matches what was pulled
+    QVERIFY(m_Server->remove_file("Sync/b.txt"));
+    m_Sync->sync_now();
+    QTRY_VERIFY_WITH_TIMEOUT(!QFile::exists(path("b.txt")), k_TimeoutMs);
+    // ...and that local delete isn't sent back as a change
+    QTest::qWait(3 * FolderWatcher::k_SettleMs);
+    QVERIFY(!seen(*m_Activity, "b.txt", true));
+    QVERIFY(!m_Server->has_file("Sync/b.txt"));
+    QVERIFY(m_Server->has_file("Sync/dir/e.txt"));
+}
+
+void TestFolderSync::both_sides_changed_keeps_both() {
+    // Records for a.txt and b.txt are saved when the first FolderSync goes away
+    start_and_settle();
+    m_Activity.reset();
+    m_Folder.reset();
+
+    // Both sides edit b.txt while nothing is watching
+    QVERIFY(write_file(path("b.txt"), "local edit"));
+    m_Server->put_file("Sync/b.txt", "remote edit");
+    m_Sync->sync_now();
+    QTRY_VERIFY_WITH_TIMEOUT(m_Sync->file("Sync/b.txt")->hash == StubServer::hash_of("remote edit"), k_TimeoutMs);
+
+    start_folder();
+    QTRY_VERIFY_WITH_TIMEOUT(seen(*m_Activity, "b.txt", false), k_TimeoutMs);
+    QCOMPARE(read_file(path("b.txt")), QByteArray("remote edit"));
+    QCOMPARE(m_Server->file("Sync/b.txt"), QByteArray("remote edit"));
+
+    // The local edit was set aside under a new name, and that is uploaded as a file of its own
+    QStringList conflicts = QDir(m_Dir->path()).entryList({"b (conflict *).txt"}, QDir::Files);
+    QCOMPARE(conflicts.size(), qsizetype(1));
+    QCOMPARE(read_file(path(conflicts.first())), QByteArray("local edit"));
+    QTRY_VERIFY_WITH_TIMEOUT(seen(*m_Activity, conflicts.first(), true), k_TimeoutMs);
+    QCOMPARE(m_Server->file("Sync/" + conflicts.first()), QByteArray("local edit"));
+}
+
+QTEST_GUILESS_MAIN(TestFolderSync)
+#include "tst_folder_sync.moc"
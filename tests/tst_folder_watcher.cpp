@@ -0,0 +1,130 @@
+#include <QDir>
+#include <QElapsedTimer>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QtTest>
+#include "sap_cloud_client/folder_watcher.h"
+#include "support/test_data.h"
+
+using namespace sap::client;
+using namespace sap::client::test;
+
+class TestFolderWatcher : public QObject {
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    void coalesces_a_burst();
+    void folds_paths_under_a_new_directory();
+    void ignores_part_files();
+    void flushes_a_steady_stream();
+
+private:
+    // Watches are added from the thread pool; give them a moment before changing anything
+    static void settle_watches() { QTest::qWait(200); }
+    // Whether some reported path is file or a directory above it
+    static bool covers(const QStringList& paths, const QString& file);
+    // Every path reported by the spy so far
+    static QStringList reported(const QSignalSpy& spy);
+    QString path(const QString& relative) const { return m_Dir->filePath(relative); }
+
+    std::unique_ptr<QTemporaryDir> m_Dir;
+    std::unique_ptr<FolderWatcher> m_Watcher;
+};
+
+void TestFolderWatcher::init() {
+    m_Dir = std::make_unique<QTemporaryDir>();
+    QVERIFY(QDir(m_Dir->path()).mkpath("old/deep"));
+    m_Watcher = std::make_unique<FolderWatcher>(m_Dir->path());
+    QVERIFY(m_Watcher->start());
+    settle_watches();
+}
+
+void TestFolderWatcher::cleanup() {
+    m_Watcher.reset();
+    m_Dir.reset();
+}
+
+bool TestFolderWatcher::covers(const QStringList& paths, const QString& file) {
+    for (const auto& p : paths) {
+        if (p == file || p.isEmpty() || (p.endsWith('/') && file.startsWith(p)))
+            return true;
+    }
+    return false;
+}
+
+QStringList TestFolderWatcher::reported(const QSignalSpy& spy) {
+    QStringList paths;
+    for (const auto& args : spy)
+        paths += args.first().toStringList();
+    return paths;
+}
+
+void TestFolderWatcher::coalesces_a_burst() {
+    QSignalSpy changed(m_Watcher.get(), &FolderWatcher::changed);
+    QVERIFY(write_file(path("a.txt"), "a"));
+    QVERIFY(write_file(path("b.txt"), "b"));
+    QVERIFY(write_file(path("old/deep/c.txt"), "c"));
+
+    QTRY_COMPARE(changed.size(), 1);
+    QStringList paths = changed.first().first().toStringList();
+    for (const QString file : {"a.txt", "b.txt", "old/deep/c.txt"})
+        QVERIFY2(covers(paths, file), qPrintable(paths.join(", ")));
+    // Nothing more once it has settled
+    QTest::qWait(FolderWatcher::k_SettleMs * 2);
+    QCOMPARE(changed.size(), 1);
+}
+
+void TestFolderWatcher::folds_paths_under_a_new_directory() {
+    QSignalSpy changed(m_Watcher.get(), &FolderWatcher::changed);
+    QVERIFY(QDir(m_Dir->path()).mkdir("new"));
+    QVERIFY(write_file(path("new/x.txt"), "x"));
+    QTRY_COMPARE(changed.size(), 1);
+    QStringList paths = changed.first().first().toStringList();
+    QVERIFY(covers(paths, "new/x.txt"));
+#ifdef Q_OS_LINUX
+    // The directory stands for everything under it
+    QCOMPARE(paths, QStringList({"new/"}));
+#endif
+
+    // The new directory got a watch of its own
+    settle_watches();
+    changed.clear();
+    QVERIFY(write_file(path("new/y.txt"), "y"));
+    QTRY_COMPARE(changed.size(), 1);
+    QVERIFY(covers(changed.first().first().toStringList(), "new/y.txt"));
+}
+
+void TestFolderWatcher::ignores_part_files() {
+#ifndef Q_OS_LINUX
+    QSKIP("The fallback watcher only reports which directory changed");
+#endif
+    QSignalSpy changed(m_Watcher.get(), &FolderWatcher::changed);
+    QVERIFY(write_file(path("download.bin.part"), "partial"));
+    QTest::qWait(FolderWatcher::k_SettleMs * 2);
+    QCOMPARE(changed.size(), 0);
+
+    // Renamed into place, it counts
+    QVERIFY(QFile::rename(path("download.bin.part"), path("download.bin")));
+    QTRY_COMPARE(changed.size(), 1);
+    QCOMPARE(changed.first().first().toStringList(), QStringList({"download.bin"}));
+}
+
+void TestFolderWatcher::flushes_a_steady_stream() {
+    QSignalSpy changed(m_Watcher.get(), &FolderWatcher::changed);
+    // Writes closer together than k_SettleMs never let the timer run out
+    QElapsedTimer timer;
+    timer.start();
+    int i = 0;
+    while (changed.isEmpty() && timer.elapsed() < 3 * FolderWatcher::k_MaxDelayMs) {
+        QVERIFY(write_file(path(QString("stream%1.txt").arg(i++)), "s"));
+        QTest::qWait(FolderWatcher::k_SettleMs / 3);
+    }
+    QVERIFY(!changed.isEmpty());
+    QVERIFY(timer.elapsed() < FolderWatcher::k_MaxDelayMs + FolderWatcher::k_SettleMs);
+    QVERIFY(covers(reported(changed), "stream0.txt"));
+}
+
+QTEST_GUILESS_MAIN(TestFolderWatcher)
+#include "tst_folder_watcher.moc"
@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <QSignalSpy>
+#include <QtTest>
+#include "sap_cloud_client/api_client.h"
+#include "sap_cloud_client/merkle_reconciler.h"
+#include "sap_cloud_client/merkle_tree.h"
+#include "support/stub_server.h"
+
+using namespace sap::client;
+using namespace sap::client::test;
+
+class TestMerkle : public QObject {
+    Q_OBJECT
+
+private slots:
+    void init();
+    void digests_match_the_server();
+    void tracks_inserts_and_removals();
+    void in_sync_costs_one_request();
+    void deep_change_descends_one_path();
+    void reports_one_sided_entries();
+    void fails_without_merkle_endpoint();
+
+private:
+    // Runs a reconcile to completion; returns the finished() arguments
+    QList<QVariant> reconcile(MerkleReconciler& reconciler);
+    void put(const QString& path, const QByteArray& data);
+
+    std::unique_ptr<StubServer> m_Server;
+    std::unique_ptr<ApiClient> m_Api;
+    MerkleTree m_Tree;
+};
+
+void TestMerkle::init() {
+    m_Server = std::make_unique<StubServer>();
+    QVERIFY(m_Server->listen());
+    m_Api = std::make_unique<ApiClient>();
+    m_Api->set_server_url(m_Server->url());
+    m_Api->set_token("token");
+
+    m_Tree.clear();
+    for (int i = 0; i < 200; ++i)
+        put(QString("dir%1/sub%2/file%3.txt").arg(i % 7).arg(i % 3).arg(i), QByteArray::number(i));
+    put("top.txt", "top");
+    put("a/b/c/d/deep.txt", "deep");
+}
+
+QList<QVariant> TestMerkle::reconcile(MerkleReconciler& reconciler) {
+    QSignalSpy finished(&reconciler, &MerkleReconciler::finished);
+    reconciler.start();
+    if (!finished.wait(20000))
+        return {};
+    return finished.first();
+}
+
+void TestMerkle::put(const QString& path, const QByteArray& data) {
+    m_Server->put_file(path, data);
+    m_Tree.insert(path, StubServer::hash_of(data));
+}
+
+void TestMerkle::digests_match_the_server() {
+    for (const QString& dir : {QString(), QString("dir3/"), QString("dir3/sub1/"), QString("a/b/c/d/")}) {
+        bool done = false;
+        MerkleNode node;
+        m_Api->get_merkle_node(dir, true, [&](bool ok, MerkleNode n) {
+            QVERIFY(ok);
+            node = n;
+            done = true;
+        });
+        QTRY_VERIFY(done);
+        QCOMPARE(node.hash, m_Tree.digest(dir));
+
+        QVector<MerkleEntry> local = m_Tree.children(dir);
+        QCOMPARE(node.children.size(), local.size());
+        for (const auto& remote : node.children) {
+            auto it = std::find_if(local.cbegin(), local.cend(), [&](const MerkleEntry& e) { return e.name == remote.name; });
+            QVERIFY(it != local.cend());
+            QCOMPARE(it->is_dir, remote.is_dir);
+            QCOMPARE(it->hash, remote.hash);
+        }
+    }
+}
+
+void TestMerkle::tracks_inserts_and_removals() {
+    QString root = m_Tree.digest();
+    QString dir = m_Tree.digest("dir2/");
+    m_Tree.insert("new/file.txt", StubServer::hash_of("new"));
+    QVERIFY(m_Tree.digest() != root);
+    // Siblings of the change keep their digests
+    QCOMPARE(m_Tree.digest("dir2/"), dir);
+
+    m_Tree.remove("new/file.txt");
+    QCOMPARE(m_Tree.digest(), root);
+    QVERIFY(!m_Tree.contains_dir("new/"));
+    QCOMPARE(m_Tree.files_under("a/").size(), qsizetype(1));
+}
+
+void TestMerkle::in_sync_costs_one_request() {
+    MerkleReconciler reconciler(m_Api.get(), &m_Tree);
+    QList<QVariant> result = reconcile(reconciler);
+    QCOMPARE(result.size(), 2);
+    QVERIFY(result[0].toBool());
+    QVERIFY(result[1].toStringList().isEmpty());
+    QCOMPARE(reconciler.requests(), 1);
+    QCOMPARE(m_Server->requests("GET merkle"), 1);
+}
+
+void TestMerkle::deep_change_descends_one_path() {
+    m_Server->put_file("a/b/c/d/deep.txt", "changed");
+
+    MerkleReconciler reconciler(m_Api.get(), &m_Tree);
+    QList<QVariant> result = reconcile(reconciler);
+    QCOMPARE(result.size(), 2);
+    QVERIFY(result[0].toBool());
+    QCOMPARE(result[1].toStringList(), QStringList({"a/b/c/d/deep.txt"}));
+    // The root digest, then one node per level: "", a/, a/b/, a/b/c/, a/b/c/d/
+    QCOMPARE(reconciler.requests(), 6);
+    QCOMPARE(m_Server->requests("GET merkle"), 6);
+}
+
+void TestMerkle::reports_one_sided_entries() {
+    m_Server->put_file("dir1/sub1/remote_only.txt", "remote");
+    m_Tree.insert("local_only/x.txt", StubServer::hash_of("x"));
+    m_Tree.remove("top.txt");
+
+    MerkleReconciler reconciler(m_Api.get(), &m_Tree);
+    QList<QVariant> result = reconcile(reconciler);
+    QCOMPARE(result.size(), 2);
+    QVERIFY(result[0].toBool());
+    QStringList differing = result[1].toStringList();
+    differing.sort();
+    QCOMPARE(differing, QStringList({"dir1/sub1/remote_only.txt", "local_only/", "top.txt"}));
+}
+
+void TestMerkle::fails_without_merkle_endpoint() {
+    m_Server->faults().missing_endpoints = {"/api/v1/sync/merkle"};
+    MerkleReconciler reconciler(m_Api.get(), &m_Tree);
+    QList<QVariant> result = reconcile(reconciler);
+    QCOMPARE(result.size(), 2);
+    QVERIFY(!result[0].toBool());
+    QVERIFY(!m_Api->supports(ApiClient::Feature::Merkle));
+}
+
+QTEST_GUILESS_MAIN(TestMerkle)
+#include "tst_merkle.moc"
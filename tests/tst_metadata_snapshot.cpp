@@ -0,0 +1,182 @@
+#include <QTemporaryDir>
+#include <QtEndian>
+#include <QtTest>
+#include "sap_cloud_client/metadata_snapshot.h"
+#include "support/test_data.h"
+
+using namespace sap::client;
+using namespace sap::client::test;
+
+class TestMetadataSnapshot : public QObject {
+    Q_OBJECT
+
+private slots:
+    void round_trips();
+    void reads_an_empty_snapshot();
+    void rejects_every_truncation();
+    void rejects_a_bad_header();
+    void rejects_string_refs_out_of_bounds();
+    void rejects_counts_that_disagree_with_the_size();
+
+private:
+    QString path() const { return m_Dir.filePath("sync/index.snap"); }
+    static MetadataSnapshot sample();
+    // A valid snapshot on disk, returned as its bytes
+    void write_sample(QByteArray* bytes);
+    // Writes bytes over the snapshot and expects it to read as nothing
+    void expect_rejected(const QByteArray& bytes);
+
+    QTemporaryDir m_Dir;
+};
+
+MetadataSnapshot TestMetadataSnapshot::sample() {
+    MetadataSnapshot snapshot;
+    snapshot.cursor = 1700000000000;
+    for (int i = 0; i < 3; ++i) {
+        FileInfo f;
+        f.path = QString("dir/file %1 é.bin").arg(i);
+        f.hash = QString(64, QChar(u'a' + i));
+        f.size = 1000 * i;
+        f.mtime = 10 + i;
+        f.created_at = 20 + i;
+        f.updated_at = 30 + i;
+        snapshot.files.append(f);
+    }
+    snapshot.tombstones.append({"gone.txt", 1699999999000});
+    NoteItem note;
+    note.id = "n1";
+    note.title = "Title";
+    note.preview = "First line";
+    note.tags = {"work", "todo"};
+    note.updated_at = 42;
+    snapshot.notes.append(note);
+    NoteItem untagged;
+    untagged.id = "n2";
+    snapshot.notes.append(untagged);
+    return snapshot;
+}
+
+void TestMetadataSnapshot::write_sample(QByteArray* bytes) {
+    QVERIFY(sample().write(path()));
+    *bytes = read_file(path());
+    QVERIFY(!bytes->isEmpty());
+}
+
+void TestMetadataSnapshot::expect_rejected(const QByteArray& bytes) {
+    QVERIFY(write_file(path(), bytes));
+    QVERIFY(!MetadataSnapshot::read(path()).has_value());
+}
+
+void TestMetadataSnapshot::round_trips() {
+    MetadataSnapshot written = sample();
+    QVERIFY(written.write(path()));
+    auto read = MetadataSnapshot::read(path());
+    QVERIFY(read.has_value());
+
+    QCOMPARE(read->cursor, written.cursor);
+    QCOMPARE(read->files.size(), written.files.size());
+    for (qsizetype i = 0; i < written.files.size(); ++i) {
+        const FileInfo& a = read->files[i];
+        const FileInfo& b = written.files[i];
+        QCOMPARE(a.path, b.path);
+        QCOMPARE(a.hash, b.hash);
+        QCOMPARE(a.size, b.size);
+        QCOMPARE(a.mtime, b.mtime);
+        QCOMPARE(a.created_at, b.created_at);
+        QCOMPARE(a.updated_at, b.updated_at);
+    }
+    QCOMPARE(read->tombstones, written.tombstones);
+    QCOMPARE(read->notes.size(), qsizetype(2));
+    QCOMPARE(read->notes[0].title, QString("Title"));
+    QCOMPARE(read->notes[0].preview, QString("First line"));
+    QCOMPARE(read->notes[0].tags, written.notes[0].tags);
+    QCOMPARE(read->notes[0].updated_at, qint64(42));
+    QVERIFY(read->notes[1].tags.isEmpty());
+}
+
+void TestMetadataSnapshot::reads_an_empty_snapshot() {
+    QVERIFY(!MetadataSnapshot::read(m_Dir.filePath("missing.snap")).has_value());
+    QVERIFY(MetadataSnapshot().write(path()));
+    auto read = MetadataSnapshot::read(path());
+    QVERIFY(read.has_value());
+    QCOMPARE(read->cursor, Timestamp(0));
+    QVERIFY(read->files.isEmpty());
+    QVERIFY(read->tombstones.isEmpty());
+    QVERIFY(read->notes.isEmpty());
+}
+
+void TestMetadataSnapshot::rejects_every_truncation() {
+    QByteArray bytes;
+    write_sample(&bytes);
+    // Torn anywhere: inside the header, a record, or the string table
+    for (qsizetype size = 0; size < bytes.size(); ++size) {
+        expect_rejected(bytes.left(size));
+        if (QTest::currentTestFailed())
+            QFAIL(qPrintable(QString("Accepted %1 of %2 bytes").arg(size).arg(bytes.size())));
+    }
+    // Trailing bytes are as wrong as missing ones
+    expect_rejected(bytes + '\0');
+}
+
+void TestMetadataSnapshot::rejects_a_bad_header() {
+    QByteArray bytes;
+    write_sample(&bytes);
+
+    QByteArray magic = bytes;
+    magic[0] = 'X';
+    expect_rejected(magic);
+
+    QByteArray version = bytes;
+    qToLittleEndian<quint32>(MetadataSnapshot::k_Version + 1, version.data() + 4);
+    expect_rejected(version);
+
+    expect_rejected(QByteArray("not a snapshot, just some text that is long enough"));
+}
+
+void TestMetadataSnapshot::rejects_string_refs_out_of_bounds() {
+    QByteArray bytes;
+    write_sample(&bytes);
+    quint32 string_bytes = qFromLittleEndian<quint32>(bytes.constData() + 28);
+    // The first file's path ref sits right after the 32-byte header: (u32 offset, u32 length)
+    constexpr qsizetype k_FirstRef = 32;
+
+    QByteArray long_string = bytes;
+    qToLittleEndian<quint32>(string_bytes + 1, long_string.data() + k_FirstRef + 4);
+    expect_rejected(long_string);
+
+    QByteArray far_offset = bytes;
+    qToLittleEndian<quint32>(string_bytes, far_offset.data() + k_FirstRef);
+    qToLittleEndian<quint32>(1, far_offset.data() + k_FirstRef + 4);
+    expect_rejected(far_offset);
+
+    // Offset + length past 4 GiB must not wrap around into range
+    QByteArray wrapping = bytes;
+    qToLittleEndian<quint32>(0xffffffffu, wrapping.data() + k_FirstRef);
+    qToLittleEndian<quint32>(2, wrapping.data() + k_FirstRef + 4);
+    expect_rejected(wrapping);
+
+    // The last string in the table, ending exactly at its end, is fine
+    QByteArray edge = bytes;
+    qToLittleEndian<quint32>(string_bytes - 1, edge.data() + k_FirstRef);
+    qToLittleEndian<quint32>(1, edge.data() + k_FirstRef + 4);
+    QVERIFY(write_file(path(), edge));
+    QVERIFY(MetadataSnapshot::read(path()).has_value());
+}
+
+void TestMetadataSnapshot::rejects_counts_that_disagree_with_the_size() {
+    QByteArray bytes;
+    write_sample(&bytes);
+    // Counts claiming more records than the file holds; the largest would overflow 32-bit math
+    for (qsizetype field : {16, 20, 24, 28}) {
+        for (quint32 count : {quint32(0), quint32(1000), quint32(0xffffffffu)}) {
+            QByteArray patched = bytes;
+            if (qFromLittleEndian<quint32>(patched.constData() + field) == count)
+                continue;
+            qToLittleEndian<quint32>(count, patched.data() + field);
+            expect_rejected(patched);
+        }
+    }
+}
+
+QTEST_GUILESS_MAIN(TestMetadataSnapshot)
+#include "tst_metadata_snapshot.moc"
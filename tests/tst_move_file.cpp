@@ -0,0 +1,111 @@
+#include <QDir>
+#include <QtTest>
+#include "sap_cloud_client/api_client.h"
+#include "support/stub_server.h"
+#include "support/test_data.h"
+
+using namespace sap::client;
+using namespace sap::client::test;
+
+class TestMoveFile : public QObject {
+    Q_OBJECT
+
+private slots:
+    void init();
+    void moves_on_the_server();
+    void missing_source_is_not_a_missing_endpoint();
+    void copies_without_move_endpoint();
+    void moves_prefix_data();
+    void moves_prefix();
+
+private:
+    bool move(const QString& from, const QString& to);
+    static QStringList move_temp_files() { return QDir(QDir::tempPath()).entryList({"sapcloud-move-*"}, QDir::Files); }
+
+    std::unique_ptr<StubServer> m_Server;
+    std::unique_ptr<ApiClient> m_Api;
+    QByteArray m_Data;
+};
+
+void TestMoveFile::init() {
+    m_Server = std::make_unique<StubServer>();
+    QVERIFY(m_Server->listen());
+    m_Api = std::make_unique<ApiClient>();
+    m_Api->set_server_url(m_Server->url());
+    m_Api->set_token("token");
+    m_Data = random_bytes(3 * 1024 * 1024, 40);
+    m_Server->put_file("docs/report.pdf", m_Data);
+}
+
+bool TestMoveFile::move(const QString& from, const QString& to) {
+    bool done = false;
+    bool result = false;
+    m_Api->move_file(from, to, [&](bool ok) {
+        result = ok;
+        done = true;
+    });
+    return QTest::qWaitFor([&]() { return done; }, 20000) && result;
+}
+
+void TestMoveFile::moves_on_the_server() {
+    QVERIFY(move("docs/report.pdf", "archive/report.pdf"));
+    QCOMPARE(m_Server->paths(), QStringList({"archive/report.pdf"}));
+    QCOMPARE(m_Server->file("archive/report.pdf"), m_Data);
+    // Metadata only: no content went either way
+    QCOMPARE(m_Server->total_requests(), 1);
+    QCOMPARE(m_Server->requests("POST move"), 1);
+}
+
+void TestMoveFile::missing_source_is_not_a_missing_endpoint() {
+    QVERIFY(!move("docs/none.pdf", "archive/none.pdf"));
+    QVERIFY(m_Api->supports(ApiClient::Feature::Move));
+    QCOMPARE(m_Server->total_requests(), 1);
+}
+
+void TestMoveFile::copies_without_move_endpoint() {
+    m_Server->faults().missing_endpoints = {"/api/v1/files/move"};
+    QStringList temp_before = move_temp_files();
+
+    QVERIFY(move("docs/report.pdf", "archive/report.pdf"));
+    QVERIFY(!m_Api->supports(ApiClient::Feature::Move));
+    QCOMPARE(m_Server->paths(), QStringList({"archive/report.pdf"}));
+    QCOMPARE(m_Server->file("archive/report.pdf"), m_Data);
+    QCOMPARE(m_Server->requests("GET files"), 1);
+    QCOMPARE(m_Server->requests("PUT files"), 1);
+    QCOMPARE(m_Server->requests("DELETE files"), 1);
+    // The temporary copy is gone once the upload is done with it
+    QTRY_COMPARE(move_temp_files(), temp_before);
+}
+
+void TestMoveFile::moves_prefix_data() {
+    QTest::addColumn<bool>("endpoint");
+    QTest::newRow("move endpoint") << true;
+    QTest::newRow("batch fallback") << false;
+}
+
+void TestMoveFile::moves_prefix() {
+    QFETCH(bool, endpoint);
+    if (!endpoint)
+        m_Server->faults().missing_endpoints = {"/api/v1/files/move"};
+    m_Server->put_file("docs/sub/notes.txt", "notes");
+    m_Server->put_file("docs-old/keep.txt", "keep");
+
+    bool done = false;
+    bool ok = false;
+    int moved = 0;
+    m_Api->move_prefix("docs/", "archive/docs/", [&](bool all, int count) {
+        ok = all;
+        moved = count;
+        done = true;
+    });
+    QTRY_VERIFY(done);
+    QVERIFY(ok);
+    QCOMPARE(moved, 2);
+    QCOMPARE(m_Server->paths(), QStringList({"archive/docs/report.pdf", "archive/docs/sub/notes.txt", "docs-old/keep.txt"}));
+    QCOMPARE(m_Server->file("archive/docs/report.pdf"), m_Data);
+    if (!endpoint)
+        QCOMPARE(m_Server->requests("POST batch"), 1);
+}
+
+QTEST_GUILESS_MAIN(TestMoveFile)
+#include "tst_move_file.moc"
@@ -0,0 +1,207 @@
+#include <QDir>
+#include <QElapsedTimer>
+#include <QStandardPaths>
+#include <QtTest>
+#include "sap_cloud_client/offline_store.h"
+#include "support/stub_server.h"
+#include "support/test_data.h"
+
+using namespace sap::client;
+using namespace sap::client::test;
+
+class TestOfflineStore : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+    void fetches_pinned_files();
+    void keeps_to_the_disk_limit();
+    void paces_fetches_to_the_bandwidth_limit();
+    void collects_unpinned_blobs();
+    void prefetches_what_usually_follows();
+
+private:
+    static constexpr qint64 k_FileSize = 256 * 1024;
+
+    // An OfflineStore on the stub server's index, started
+    void start_store();
+    // Content of the offline copy of path, empty if there is none
+    QByteArray offline(const QString& path) const { return read_file(m_Offline->local_copy(path)); }
+
+    std::unique_ptr<StubServer> m_Server;
+    std::unique_ptr<ApiClient> m_Api;
+    std::unique_ptr<SyncEngine> m_Sync;
+    std::unique_ptr<TransferScheduler> m_Scheduler;
+    std::unique_ptr<OfflineStore> m_Offline;
+};
+
+void TestOfflineStore::initTestCase() { QStandardPaths::setTestModeEnabled(true); }
+
+void TestOfflineStore::init() {
+    // No pins, blobs or history from an earlier test
+    QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)).removeRecursively();
+    m_Server = std::make_unique<StubServer>();
+    QVERIFY(m_Server->listen());
+    for (int i = 0; i < 4; ++i)
+        m_Server->put_file(QString("docs/%1.bin").arg(i), random_bytes(k_FileSize, 20 + i));
+    m_Server->put_file("other.bin", random_bytes(k_FileSize, 30));
+    m_Api = std::make_unique<ApiClient>();
+    m_Api->set_server_url(m_Server->url());
+    m_Api->set_token("token");
+    m_Sync = std::make_unique<SyncEngine>(m_Api.get());
+    m_Sync->start();
+    QTRY_VERIFY(m_Sync->has_snapshot());
+    m_Scheduler = std::make_unique<TransferScheduler>();
+}
+
+void TestOfflineStore::cleanup() {
+    m_Offline.reset();
+    m_Scheduler.reset();
+    m_Sync.reset();
+    m_Api.reset();
+    m_Server.reset();
+}
+
+void TestOfflineStore::start_store() {
+    m_Offline = std::make_unique<OfflineStore>(m_Api.get(), m_Sync.get(), m_Scheduler.get());
+    m_Offline->set_bandwidth_limit(0);
+    m_Offline->start();
+}
+
+void TestOfflineStore::fetches_pinned_files() {
+    start_store();
+    m_Offline->pin_path("docs/");
+    m_Offline->pin_path("docs/0.bin");
+    QVERIFY(m_Offline->is_pinned("docs/3.bin"));
+    QVERIFY(!m_Offline->is_pinned("other.bin"));
+    QTRY_COMPARE(m_Offline->pending(), 0);
+    for (int i = 0; i < 4; ++i) {
+        QString path = QString("docs/%1.bin").arg(i);
+        QCOMPARE(offline(path), m_Server->file(path));
+    }
+    QVERIFY(m_Offline->local_copy("other.bin").isEmpty());
+    QCOMPARE(m_Server->requests("GET files"), 4);
+    QCOMPARE(m_Offline->disk_usage(), 4 * k_FileSize);
+
+    // A new version is fetched through the delta feed; the old blob goes
+    QByteArray edited = random_bytes(k_FileSize / 2, 40);
+    m_Server->put_file("docs/1.bin", edited);
+    m_Sync->sync_now();
+    QTRY_COMPARE(offline("docs/1.bin"), edited);
+    QTRY_COMPARE(m_Offline->disk_usage(), 3 * k_FileSize + k_FileSize / 2);
+    QCOMPARE(m_Offline->content_store().hashes().size(), qsizetype(4));
+
+    // Pins outlive the store
+    m_Offline.reset();
+    start_store();
+    QVERIFY(m_Offline->is_pinned_directly("docs/"));
+    QCOMPARE(offline("docs/1.bin"), edited);
+}
+
+void TestOfflineStore::keeps_to_the_disk_limit() {
+    start_store();
+    m_Offline->set_disk_limit(2 * k_FileSize + 1000);
+    m_Offline->pin_path("docs/");
+    QTRY_COMPARE(m_Offline->pending(), 0);
+    QCOMPARE(m_Offline->over_budget(), 2);
+    QCOMPARE(m_Offline->disk_usage(), 2 * k_FileSize);
+    QCOMPARE(m_Server->requests("GET files"), 2);
+
+    // Room for the rest
+    m_Offline->set_disk_limit(4 * k_FileSize);
+    QTRY_COMPARE(m_Offline->over_budget(), 0);
+    QTRY_COMPARE(m_Offline->pending(), 0);
+    QCOMPARE(m_Offline->disk_usage(), 4 * k_FileSize);
+    QCOMPARE(m_Server->requests("GET files"), 4);
+
+    // Unpinning what didn't fit forgets it
+    m_Offline->set_disk_limit(0);
+    m_Offline->pin_path("other.bin");
+    QTRY_COMPARE(m_Offline->over_budget(), 1);
+    m_Offline->unpin_path("other.bin");
+    QCOMPARE(m_Offline->over_budget(), 0);
+}
+
+void TestOfflineStore::paces_fetches_to_the_bandwidth_limit() {
+    start_store();
+    // A quarter of a second per file, waited out after each fetch
+    m_Offline->set_bandwidth_limit(4 * k_FileSize);
+    QElapsedTimer timer;
+    timer.start();
+    m_Offline->pin_path("docs/");
+    QTRY_COMPARE_WITH_TIMEOUT(m_Server->requests("GET files"), 4, 10000);
+    QVERIFY(timer.elapsed() >= 3 * 250 - 50);
+
+    // Lifted, nothing waits
+    QByteArray other = m_Server->file("other.bin");
+    m_Offline->set_bandwidth_limit(0);
+    QTRY_COMPARE(m_Offline->pending(), 0);
+    timer.restart();
+    m_Offline->pin_path("other.bin");
+    QTRY_COMPARE(offline("other.bin"), other);
+    QVERIFY(timer.elapsed() < 1000);
+}
+
+void TestOfflineStore::collects_unpinned_blobs() {
+    start_store();
+    m_Offline->pin_path("docs/");
+    m_Offline->pin_path("other.bin");
+    QTRY_COMPARE(m_Offline->pending(), 0);
+    QCOMPARE(m_Offline->disk_usage(), 5 * k_FileSize);
+
+    m_Offline->unpin_path("docs/");
+    QTRY_COMPARE(m_Offline->disk_usage(), k_FileSize);
+    QVERIFY(m_Offline->local_copy("docs/0.bin").isEmpty());
+    QCOMPARE(offline("other.bin"), m_Server->file("other.bin"));
+
+    // Removed on the server: the delta feed drops its blob too
+    QVERIFY(m_Server->remove_file("other.bin"));
+    m_Sync->sync_now();
+    QTRY_COMPARE(m_Offline->disk_usage(), qint64(0));
+    QVERIFY(m_Offline->content_store().hashes().isEmpty());
+}
+
+void TestOfflineStore::prefetches_what_usually_follows() {
+    start_store();
+    const QString a = "docs/0.bin";
+    const QString b = "docs/1.bin";
+    const QString c = "docs/2.bin";
+    // a is pinned, so it is served offline and never guessed at
+    m_Offline->pin_path(a);
+    QTRY_COMPARE(m_Offline->pending(), 0);
+    QCOMPARE(read_file(m_Offline->open_file(a)), m_Server->file(a));
+    QVERIFY(m_Offline->open_file(b).isEmpty());
+    QCOMPARE(m_Server->requests("GET files"), 1);
+
+    // b has followed a every time: opening a fetches it ahead
+    m_Offline->open_file(a);
+    QTRY_COMPARE(m_Offline->prefetch_stats().fetched, 1);
+    QCOMPARE(m_Offline->prefetch_stats().bytes_fetched, k_FileSize);
+    QCOMPARE(read_file(m_Offline->open_file(b)), m_Server->file(b));
+    QCOMPARE(m_Offline->prefetch_stats().hits, 1);
+
+    // Now c follows b too
+    QVERIFY(m_Offline->open_file(c).isEmpty());
+    QCOMPARE(read_file(m_Offline->open_file(b)), m_Server->file(b));
+    QTRY_COMPARE(m_Offline->prefetch_stats().fetched, 2);
+    QCOMPARE(m_Server->requests("GET files"), 3);
+    OfflineStore::PrefetchStats stats = m_Offline->prefetch_stats();
+    QCOMPARE(stats.hits, 2);
+    QCOMPARE(stats.misses, 2);
+    QCOMPARE(stats.hit_rate(), 0.5);
+    QCOMPARE(stats.bytes_wasted, qint64(0));
+    // A prefetched blob is not an offline copy
+    QVERIFY(m_Offline->local_copy(c).isEmpty());
+
+    // c was never opened: dropping the cache wastes it, while b was used
+    m_Offline->set_prefetch_limit(0);
+    QCOMPARE(m_Offline->prefetch_stats().bytes_wasted, k_FileSize);
+    QVERIFY(m_Offline->open_file(c).isEmpty());
+    QCOMPARE(m_Offline->prefetch_stats().misses, 3);
+    QCOMPARE(m_Server->requests("GET files"), 3);
+}
+
+QTEST_GUILESS_MAIN(TestOfflineStore)
+#include "tst_offline_store.moc"
@@ -0,0 +1,164 @@
+#include <QMessageAuthenticationCode>
+#include <QSignalSpy>
+#include <QStandardPaths>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+#include <QtTest>
+#include "sap_cloud_client/peer_cache.h"
+#include "support/peer_node.h"
+#include "support/stub_server.h"
+#include "support/test_data.h"
+
+using namespace sap::client;
+using namespace sap::client::test;
+
+// Each peer is a separate peer_node process, so discovery goes through the real multicast group
+class TestPeerCache : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+    void fetches_from_a_peer_of_the_same_account();
+    void ignores_peers_of_other_accounts();
+    void serves_only_signed_requests();
+    void misses_when_the_peer_is_gone();
+
+private:
+    // Starts a peer holding the test blob; 0 if it couldn't start
+    quint16 start_peer(const QByteArray& key);
+    // Runs a fetch of the test blob to completion
+    bool fetch(const QString& target);
+    // Raw TCP request to a peer: reads the challenge, sends GET with the MAC sign returns, reads the answer line
+    QByteArray request(quint16 port, const std::function<QByteArray(const QByteArray&)>& sign);
+
+    std::unique_ptr<QTemporaryDir> m_Dir;
+    std::unique_ptr<PeerCache> m_Cache;
+    std::vector<std::unique_ptr<QProcess>> m_Peers;
+    QByteArray m_Key = QByteArray(32, 'k');
+    QByteArray m_Data;
+    QString m_Blob;
+    QString m_Hash;
+};
+
+void TestPeerCache::initTestCase() { QStandardPaths::setTestModeEnabled(true); }
+
+void TestPeerCache::init() {
+    m_Dir = std::make_unique<QTemporaryDir>();
+    m_Data = random_bytes(2 * PeerCache::k_MinFileSize + 777, 60);
+    m_Hash = StubServer::hash_of(m_Data);
+    m_Blob = m_Dir->filePath("blob.bin");
+    QVERIFY(write_file(m_Blob, m_Data));
+
+    m_Cache = std::make_unique<PeerCache>();
+    m_Cache->set_account_key(m_Key);
+    if (!m_Cache->start())
+        QSKIP(qPrintable("No peer discovery here: " + m_Cache->last_error()));
+}
+
+void TestPeerCache::cleanup() {
+    m_Cache.reset();
+    for (auto& peer : m_Peers) {
+        peer->kill();
+        peer->waitForFinished();
+    }
+    m_Peers.clear();
+}
+
+quint16 TestPeerCache::start_peer(const QByteArray& key) {
+    auto process = std::make_unique<QProcess>();
+    QString error;
+    quint16 port = start_peer_node(*process, key, m_Blob, m_Hash, m_Dir->filePath(QString("peer%1").arg(m_Peers.size())), &error);
+    if (!port)
+        qWarning() << error;
+    m_Peers.push_back(std::move(process));
+    return port;
+}
+
+bool TestPeerCache::fetch(const QString& target) {
+    bool done = false;
+    bool result = false;
+    m_Cache->fetch(m_Hash, m_Data.size(), target, {}, [&](bool ok) {
+        result = ok;
+        done = true;
+    });
+    return QTest::qWaitFor([&]() { return done; }, 20000) && result;
+}
+
+QByteArray TestPeerCache::request(quint16 port, const std::function<QByteArray(const QByteArray&)>& sign) {
+    QTcpSocket socket;
+    socket.connectToHost(QHostAddress::LocalHost, port);
+    if (!QTest::qWaitFor([&]() { return socket.canReadLine(); }, 5000))
+        return {};
+    QByteArray hello = socket.readLine().trimmed();
+    if (!hello.startsWith("HELLO "))
+        return {};
+    socket.write("GET " + m_Hash.toLatin1() + ' ' + sign(hello.mid(6)) + '\n');
+    if (!QTest::qWaitFor([&]() { return socket.canReadLine(); }, 5000))
+        return {};
+    QByteArray answer = socket.readLine().trimmed();
+    if (answer.startsWith("OK ")) {
+        qint64 size = answer.mid(3).toLongLong();
+        QTest::qWaitFor([&]() { return socket.bytesAvailable() >= size; }, 10000);
+        if (socket.readAll() != m_Data)
+            return "OK with the wrong content";
+    }
+    return answer;
+}
+
+void TestPeerCache::fetches_from_a_peer_of_the_same_account() {
+    QVERIFY(start_peer(m_Key));
+    QString target = m_Dir->filePath("fetched.bin");
+    QVERIFY(fetch(target));
+    QCOMPARE(read_file(target), m_Data);
+    QVERIFY(!QFile::exists(target + ".peer"));
+    QCOMPARE(m_Cache->stats().hits, 1);
+    QCOMPARE(m_Cache->stats().bytes_from_peers, qint64(m_Data.size()));
+}
+
+void TestPeerCache::ignores_peers_of_other_accounts() {
+    QVERIFY(start_peer(QByteArray(32, 'x')));
+    QString target = m_Dir->filePath("fetched.bin");
+    QVERIFY(!fetch(target));
+    QVERIFY(!QFile::exists(target));
+    QCOMPARE(m_Cache->stats().misses, 1);
+}
+
+void TestPeerCache::serves_only_signed_requests() {
+    quint16 port = start_peer(m_Key);
+    QVERIFY(port);
+    QCOMPARE(request(port,
+                     [this](const QByteArray& challenge) {
+                         // Another account's key
+                         return QMessageAuthenticationCode::hash("get:" + challenge + ':' + m_Hash.toLatin1(), QByteArray(32, 'x'),
+                                                                 QCryptographicHash::Sha256)
+                             .toHex();
+                     }),
+             QByteArray("NO"));
+    QCOMPARE(request(port,
+                     [this](const QByteArray&) {
+                         // Right key, but signed over another connection's challenge
+                         QByteArray stale(32, 'a');
+                         return QMessageAuthenticationCode::hash("get:" + stale + ':' + m_Hash.toLatin1(), m_Key, QCryptographicHash::Sha256)
+                             .toHex();
+                     }),
+             QByteArray("NO"));
+    QByteArray answer = request(port, [this](const QByteArray& challenge) {
+        return QMessageAuthenticationCode::hash("get:" + challenge + ':' + m_Hash.toLatin1(), m_Key, QCryptographicHash::Sha256).toHex();
+    });
+    QCOMPARE(answer, "OK " + QByteArray::number(m_Data.size()));
+}
+
+void TestPeerCache::misses_when_the_peer_is_gone() {
+    QVERIFY(start_peer(m_Key));
+    m_Peers.back()->kill();
+    m_Peers.back()->waitForFinished();
+    QString target = m_Dir->filePath("fetched.bin");
+    QVERIFY(!fetch(target));
+    QVERIFY(!QFile::exists(target));
+    QVERIFY(!QFile::exists(target + ".peer"));
+}
+
+QTEST_GUILESS_MAIN(TestPeerCache)
+#include "tst_peer_cache.moc"
@@ -0,0 +1,103 @@
+#include <QTemporaryDir>
+#include <QtTest>
+#include "sap_cloud_client/api_client.h"
+#include "support/stub_server.h"
+#include "support/test_data.h"
+
+using namespace sap::client;
+using namespace sap::client::test;
+
+class TestResumeDownload : public QObject {
+    Q_OBJECT
+
+private slots:
+    void init();
+    void resumes_after_dropped_connection();
+    void restarts_when_range_is_ignored();
+    void corrupt_prefix_fails_and_removes_part();
+
+private:
+    // Runs one resume_download to completion; committed receives the bytes known to be in the part file
+    bool download(qint64 offset, const QString& expected_hash, qint64* committed = nullptr);
+    QString local() const { return m_Dir.filePath("big.bin"); }
+
+    std::unique_ptr<StubServer> m_Server;
+    std::unique_ptr<ApiClient> m_Api;
+    QTemporaryDir m_Dir;
+    QByteArray m_Data;
+};
+
+void TestResumeDownload::init() {
+    m_Server = std::make_unique<StubServer>();
+    QVERIFY(m_Server->listen());
+    m_Api = std::make_unique<ApiClient>();
+    m_Api->set_server_url(m_Server->url());
+    m_Api->set_token("token");
+    m_Data = random_bytes(3 * 1024 * 1024 + 17, 1);
+    m_Server->put_file("big.bin", m_Data);
+    QFile::remove(local());
+    QFile::remove(local() + ".part");
+}
+
+bool TestResumeDownload::download(qint64 offset, const QString& expected_hash, qint64* committed) {
+    bool done = false;
+    bool result = false;
+    qint64 reached = offset;
+    m_Api->resume_download(
+        "big.bin", local(), offset, expected_hash, [&](qint64 written, qint64) { reached = written; },
+        [&](bool ok) {
+            result = ok;
+            done = true;
+        });
+    if (!QTest::qWaitFor([&]() { return done; }, 20000))
+        return false;
+    if (committed)
+        *committed = reached;
+    return result;
+}
+
+void TestResumeDownload::resumes_after_dropped_connection() {
+    m_Server->faults().drop_after = 1024 * 1024 + 5;
+    m_Server->faults().drop_count = 1;
+
+    qint64 committed = 0;
+    QVERIFY(!download(0, {}, &committed));
+    QVERIFY(committed > 0);
+    QVERIFY(committed <= m_Server->faults().drop_after);
+    QVERIFY(QFile::exists(local() + ".part"));
+    QVERIFY(!QFile::exists(local()));
+
+    QVERIFY(download(committed, StubServer::hash_of(m_Data)));
+    QCOMPARE(read_file(local()), m_Data);
+    QVERIFY(!QFile::exists(local() + ".part"));
+    // The second request only asked for what was missing
+    QCOMPARE(m_Server->ranges().size(), qsizetype(1));
+    QCOMPARE(m_Server->ranges().first(), "bytes=" + QByteArray::number(committed) + "-");
+}
+
+void TestResumeDownload::restarts_when_range_is_ignored() {
+    // A stale prefix the server's 200 must overwrite rather than extend
+    QVERIFY(write_file(local() + ".part", QByteArray(4096, 'x')));
+    m_Server->faults().ignore_range = true;
+
+    QVERIFY(download(4096, StubServer::hash_of(m_Data)));
+    QCOMPARE(m_Server->ranges().size(), qsizetype(1));
+    QCOMPARE(read_file(local()), m_Data);
+}
+
+void TestResumeDownload::corrupt_prefix_fails_and_removes_part() {
+    QByteArray prefix = m_Data.left(100000);
+    prefix[500] = static_cast<char>(prefix[500] ^ 0x01);
+    QVERIFY(write_file(local() + ".part", prefix));
+
+    QVERIFY(!download(prefix.size(), StubServer::hash_of(m_Data)));
+    QVERIFY(!QFile::exists(local() + ".part"));
+    QVERIFY(!QFile::exists(local()));
+
+    // Starting over from nothing then succeeds
+    QVERIFY(download(0, StubServer::hash_of(m_Data)));
+    QCOMPARE(read_file(local()), m_Data);
+}
+
+QTEST_GUILESS_MAIN(TestResumeDownload)
+#include "tst_resume_download.moc"
@@ -0,0 +1,158 @@
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QtTest>
+#include "sap_cloud_client/api_client.h"
+#include "sap_cloud_client/segmented_download.h"
+#include "support/stub_server.h"
+#include "support/test_data.h"
+
+using namespace sap::client;
+using namespace sap::client::test;
+
+class TestSegmentedDownload : public QObject {
+    Q_OBJECT
+
+private slots:
+    void init();
+    void splits_the_slowest_segment();
+    void resumes_dropped_segments();
+    void falls_back_when_range_is_ignored();
+    void asks_for_the_size_when_unknown();
+    void fails_on_a_hash_mismatch();
+    void refetches_a_corrupt_chunk();
+    void gives_up_on_a_chunk_that_stays_corrupt();
+
+private:
+    // Runs one download of big.bin to completion
+    bool download(qint64 size, const QString& expected_hash, qint64* prefix = nullptr);
+    void use_file(qint64 size);
+    QString part() const { return m_Dir.filePath("big.bin.part"); }
+    // Offsets the Range requests so far started at
+    QList<qint64> range_starts() const;
+
+    std::unique_ptr<StubServer> m_Server;
+    std::unique_ptr<ApiClient> m_Api;
+    QTemporaryDir m_Dir;
+    QByteArray m_Data;
+};
+
+void TestSegmentedDownload::init() {
+    m_Server = std::make_unique<StubServer>();
+    QVERIFY(m_Server->listen());
+    m_Api = std::make_unique<ApiClient>();
+    m_Api->set_server_url(m_Server->url());
+    m_Api->set_token("token");
+    QFile::remove(part());
+    // Four segments of 4 MiB
+    use_file(16 * 1024 * 1024);
+}
+
+void TestSegmentedDownload::use_file(qint64 size) {
+    m_Data = random_bytes(size, 4);
+    m_Server->put_file("big.bin", m_Data);
+}
+
+bool TestSegmentedDownload::download(qint64 size, const QString& expected_hash, qint64* prefix) {
+    SegmentedDownload download(m_Api.get(), "big.bin", part(), size, expected_hash);
+    QSignalSpy finished(&download, &SegmentedDownload::finished);
+    download.start();
+    if (!QTest::qWaitFor([&]() { return finished.size() > 0; }, 30000))
+        return false;
+    if (prefix)
+        *prefix = download.contiguous_prefix();
+    return finished.size() == 1 && finished.first().first().toBool();
+}
+
+QList<qint64> TestSegmentedDownload::range_starts() const {
+    QList<qint64> starts;
+    for (const auto& range : m_Server->ranges())
+        starts.append(range.mid(6).split('-').first().toLongLong());
+    return starts;
+}
+
+void TestSegmentedDownload::splits_the_slowest_segment() {
+    // Four segments of 16 MiB; the first crawls while the rest finish at once
+    use_file(64 * 1024 * 1024);
+    m_Server->faults().slow_offset = 0;
+    m_Server->faults().slow_bytes_per_sec = 4 * 1024 * 1024;
+
+    QVERIFY(download(m_Data.size(), StubServer::hash_of(m_Data)));
+    QCOMPARE(read_file(part()), m_Data);
+
+    // The idle connections took over the back half of the first segment
+    QList<qint64> starts = range_starts();
+    QVERIFY(starts.size() > 4);
+    qint64 step = m_Data.size() / 4;
+    bool split = false;
+    for (qint64 start : starts)
+        split = split || (start > 0 && start < step);
+    QVERIFY(split);
+}
+
+void TestSegmentedDownload::resumes_dropped_segments() {
+    m_Server->faults().drop_after = 1024 * 1024 + 5;
+    m_Server->faults().drop_count = 2;
+
+    qint64 prefix = 0;
+    QVERIFY(download(m_Data.size(), StubServer::hash_of(m_Data), &prefix));
+    QCOMPARE(read_file(part()), m_Data);
+    QCOMPARE(prefix, qint64(m_Data.size()));
+    // Four segments, and two of them picked up again where their connection broke
+    QList<qint64> starts = range_starts();
+    QCOMPARE(starts.size(), qsizetype(6));
+    int resumed = 0;
+    for (qint64 start : starts)
+        resumed += start % (m_Data.size() / 4) != 0 ? 1 : 0;
+    QCOMPARE(resumed, 2);
+}
+
+void TestSegmentedDownload::falls_back_when_range_is_ignored() {
+    m_Server->faults().ignore_range = true;
+
+    QVERIFY(download(m_Data.size(), StubServer::hash_of(m_Data)));
+    QCOMPARE(read_file(part()), m_Data);
+    // The first 200 stopped the other segments; one plain GET carried the whole body
+    QCOMPARE(m_Server->requests("GET files"), int(m_Server->ranges().size()) + 1);
+}
+
+void TestSegmentedDownload::asks_for_the_size_when_unknown() {
+    QVERIFY(download(0, StubServer::hash_of(m_Data)));
+    QCOMPARE(read_file(part()), m_Data);
+    QCOMPARE(m_Server->requests("HEAD files"), 1);
+    QCOMPARE(range_starts().size(), qsizetype(4));
+}
+
+void TestSegmentedDownload::fails_on_a_hash_mismatch() {
+    QVERIFY(!download(m_Data.size(), StubServer::hash_of("something else")));
+    // Nothing in it can seed a resume
+    QVERIFY(!QFile::exists(part()));
+}
+
+void TestSegmentedDownload::refetches_a_corrupt_chunk() {
+    constexpr qint64 k_Chunk = 1024 * 1024;
+    m_Server->put_chunked_file("big.bin", m_Data, k_Chunk);
+    m_Server->faults().corrupt_at = 5 * k_Chunk + 123;
+    m_Server->faults().corrupt_count = 1;
+
+    QVERIFY(download(m_Data.size(), StubServer::hash_of(m_Data)));
+    QCOMPARE(read_file(part()), m_Data);
+    QCOMPARE(m_Server->requests("GET manifests"), 1);
+    // Only the bad chunk was fetched again, not its segment or the file
+    QCOMPARE(m_Server->ranges().size(), qsizetype(5));
+    QVERIFY(m_Server->ranges().contains("bytes=" + QByteArray::number(5 * k_Chunk) + '-' + QByteArray::number(6 * k_Chunk - 1)));
+}
+
+void TestSegmentedDownload::gives_up_on_a_chunk_that_stays_corrupt() {
+    constexpr qint64 k_Chunk = 1024 * 1024;
+    m_Server->put_chunked_file("big.bin", m_Data, k_Chunk);
+    m_Server->faults().corrupt_at = 5 * k_Chunk + 123;
+    m_Server->faults().corrupt_count = 100;
+
+    QVERIFY(!download(m_Data.size(), StubServer::hash_of(m_Data)));
+    // The first fetch and a bounded number of repairs
+    QVERIFY(m_Server->faults().corrupt_count > 90);
+    QVERIFY(m_Server->ranges().size() < 10);
+}
+
+QTEST_GUILESS_MAIN(TestSegmentedDownload)
+#include "tst_segmented_download.moc"
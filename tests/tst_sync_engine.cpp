@@ -0,0 +1,212 @@
+#include <QDateTime>
+#include <QDir>
+#include <QSignalSpy>
+#include <QStandardPaths>
+#include <QtTest>
+#include "sap_cloud_client/sync_engine.h"
+#include "support/stub_server.h"
+
+using namespace sap::client;
+using namespace sap::client::test;
+
+class TestSyncEngine : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+    void lists_once_then_applies_deltas();
+    void overlap_replays_are_not_reported();
+    void restores_the_index_from_its_snapshot();
+    void cursor_follows_the_server_clock();
+    void backs_off_while_nothing_changes();
+    void reset_forgets_the_index();
+
+private:
+    // Waits for the next changed() and returns its arguments
+    void next_change(SyncEngine& engine, QStringList* updated, QStringList* removed);
+
+    std::unique_ptr<StubServer> m_Server;
+    std::unique_ptr<ApiClient> m_Api;
+};
+
+void TestSyncEngine::initTestCase() { QStandardPaths::setTestModeEnabled(true); }
+
+void TestSyncEngine::init() {
+    // No snapshot from an earlier test
+    QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)).removeRecursively();
+    m_Server = std::make_unique<StubServer>();
+    QVERIFY(m_Server->listen());
+    m_Server->put_file("a.txt", "a");
+    m_Server->put_file("dir/b.txt", "b");
+    m_Api = std::make_unique<ApiClient>();
+    m_Api->set_server_url(m_Server->url());
+    m_Api->set_token("token");
+}
+
+void TestSyncEngine::cleanup() {
+    m_Api.reset();
+    m_Server.reset();
+}
+
+void TestSyncEngine::next_change(SyncEngine& engine, QStringList* updated, QStringList* removed) {
+    QSignalSpy changed(&engine, &SyncEngine::changed);
+    QTRY_COMPARE_WITH_TIMEOUT(changed.size(), 1, 10000);
+    *updated = changed.first().at(0).toStringList();
+    *removed = changed.first().at(1).toStringList();
+    updated->sort();
+    removed->sort();
+}
+
+void TestSyncEngine::lists_once_then_applies_deltas() {
+    SyncEngine engine(m_Api.get());
+    QVERIFY(!engine.has_snapshot());
+    QStringList updated;
+    QStringList removed;
+    engine.start();
+    next_change(engine, &updated, &removed);
+    QCOMPARE(updated, QStringList({"a.txt", "dir/b.txt"}));
+    QVERIFY(removed.isEmpty());
+    QVERIFY(engine.has_snapshot());
+    QCOMPARE(m_Server->sync_since(), QList<qint64>({-1}));
+
+    m_Server->put_file("c.txt", "c");
+    m_Server->put_file("a.txt", "a, edited");
+    QVERIFY(m_Server->remove_file("dir/b.txt"));
+    engine.sync_now();
+    next_change(engine, &updated, &removed);
+    QCOMPARE(updated, QStringList({"a.txt", "c.txt"}));
+    QCOMPARE(removed, QStringList({"dir/b.txt"}));
+    QCOMPARE(engine.file("a.txt")->hash, StubServer::hash_of("a, edited"));
+    QVERIFY(!engine.file("dir/b.txt"));
+    // The second request asked only for what changed
+    QCOMPARE(m_Server->sync_since().size(), qsizetype(2));
+    QVERIFY(m_Server->sync_since().last() > 0);
+    QCOMPARE(engine.files().size(), qsizetype(2));
+}
+
+void TestSyncEngine::overlap_replays_are_not_reported() {
+    SyncEngine engine(m_Api.get());
+    QStringList updated;
+    QStringList removed;
+    engine.start();
+    next_change(engine, &updated, &removed);
+
+    m_Server->put_file("c.txt", "c");
+    QVERIFY(m_Server->remove_file("a.txt"));
+    engine.sync_now();
+    next_change(engine, &updated, &removed);
+    QCOMPARE(updated, QStringList({"c.txt"}));
+    QCOMPARE(removed, QStringList({"a.txt"}));
+
+    // The next delta starts k_OverlapMs before the cursor, so it carries c.txt and the
+    // tombstone of a.txt again; neither is news
+    QSignalSpy changed(&engine, &SyncEngine::changed);
+    int requests = m_Server->requests("GET state");
+    engine.sync_now();
+    QTRY_COMPARE(m_Server->requests("GET state"), requests + 1);
+    QTest::qWait(200);
+    QCOMPARE(changed.size(), 0);
+    QVERIFY(engine.file("c.txt"));
+    QVERIFY(!engine.file("a.txt"));
+}
+
+void TestSyncEngine::restores_the_index_from_its_snapshot() {
+    {
+        SyncEngine engine(m_Api.get());
+        QStringList updated;
+        QStringList removed;
+        engine.start();
+        next_change(engine, &updated, &removed);
+        // Destroyed with a save pending: the snapshot is written on the way out
+    }
+    m_Server->reset_counters();
+
+    SyncEngine engine(m_Api.get());
+    QVERIFY(engine.has_snapshot());
+    QCOMPARE(engine.files().size(), qsizetype(2));
+    QVERIFY(engine.file("dir/b.txt"));
+
+    // Picks up from the saved cursor with a delta, and checks the restored tree once
+    m_Server->put_file("c.txt", "c");
+    QSignalSpy verified(&engine, &SyncEngine::verified);
+    QStringList updated;
+    QStringList removed;
+    engine.start();
+    next_change(engine, &updated, &removed);
+    QCOMPARE(updated, QStringList({"c.txt"}));
+    QVERIFY(m_Server->sync_since().first() > 0);
+    QTRY_COMPARE(verified.size(), 1);
+    QVERIFY(verified.first().first().toBool());
+}
+
+void TestSyncEngine::cursor_follows_the_server_clock() {
+    constexpr qint64 k_Ahead = 60LL * 60 * 1000;
+    m_Server->faults().clock_offset_ms = k_Ahead;
+    SyncEngine engine(m_Api.get());
+    QStringList updated;
+    QStringList removed;
+    engine.start();
+    next_change(engine, &updated, &removed);
+    QVERIFY(qAbs(engine.clock_skew_ms() - k_Ahead) < 5000);
+    QVERIFY(qAbs(engine.server_now() - (QDateTime::currentMSecsSinceEpoch() + k_Ahead)) < 5000);
+
+    // Deltas are asked from the server's time, an hour ahead of the local clock
+    m_Server->put_file("c.txt", "c");
+    engine.sync_now();
+    next_change(engine, &updated, &removed);
+    QCOMPARE(updated, QStringList({"c.txt"}));
+    qint64 since = m_Server->sync_since().last();
+    QVERIFY(since > QDateTime::currentMSecsSinceEpoch() + k_Ahead - SyncEngine::k_OverlapMs - 5000);
+}
+
+void TestSyncEngine::backs_off_while_nothing_changes() {
+    SyncEngine engine(m_Api.get());
+    QSignalSpy failed(&engine, &SyncEngine::sync_failed);
+    QStringList updated;
+    QStringList removed;
+    engine.start();
+    next_change(engine, &updated, &removed);
+    QCOMPARE(engine.poll_interval_ms(), SyncEngine::k_MinPollMs);
+
+    // One quiet poll doubles the interval
+    QTRY_COMPARE_WITH_TIMEOUT(engine.poll_interval_ms(), 2 * SyncEngine::k_MinPollMs, SyncEngine::k_MinPollMs + 5000);
+
+    // A change brings it straight back down
+    m_Server->put_file("c.txt", "c");
+    engine.sync_now();
+    next_change(engine, &updated, &removed);
+    QCOMPARE(engine.poll_interval_ms(), SyncEngine::k_MinPollMs);
+
+    // Failures back off too
+    m_Server->faults().missing_endpoints = {"/api/v1/sync"};
+    engine.sync_now();
+    QTRY_COMPARE(failed.size(), 1);
+    QCOMPARE(engine.poll_interval_ms(), 2 * SyncEngine::k_MinPollMs);
+    QCOMPARE(engine.files().size(), qsizetype(3));
+}
+
+void TestSyncEngine::reset_forgets_the_index() {
+    SyncEngine engine(m_Api.get());
+    QStringList updated;
+    QStringList removed;
+    engine.start();
+    next_change(engine, &updated, &removed);
+
+    QSignalSpy changed(&engine, &SyncEngine::changed);
+    engine.reset();
+    QCOMPARE(changed.size(), 1);
+    QCOMPARE(changed.first().at(1).toStringList().size(), qsizetype(2));
+    QVERIFY(!engine.has_snapshot());
+    QVERIFY(engine.files().isEmpty());
+
+    // The next sync is a full listing again
+    engine.sync_now();
+    next_change(engine, &updated, &removed);
+    QCOMPARE(updated.size(), qsizetype(2));
+    QCOMPARE(m_Server->sync_since().last(), qint64(-1));
+}
+
+QTEST_GUILESS_MAIN(TestSyncEngine)
+#include "tst_sync_engine.moc"
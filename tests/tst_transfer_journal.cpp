@@ -0,0 +1,148 @@
+#include <QTemporaryDir>
+#include <QtTest>
+#include "sap_cloud_client/transfer_journal.h"
+
+using namespace sap::client;
+
+class TestTransferJournal : public QObject {
+    Q_OBJECT
+
+private slots:
+    void init();
+    void replays_entries();
+    void truncates_torn_tail();
+    void stops_at_corrupt_record();
+    void starts_over_on_foreign_file();
+
+private:
+    QString path() const { return m_Dir.filePath("transfers.journal"); }
+    static TransferJournal::Entry download(const QString& name, qint64 committed);
+
+    QTemporaryDir m_Dir;
+};
+
+TransferJournal::Entry TestTransferJournal::download(const QString& name, qint64 committed) {
+    TransferJournal::Entry entry;
+    entry.kind = TransferJournal::Kind::Download;
+    entry.remote_path = name;
+    entry.local_path = "/tmp/" + name;
+    entry.size = 1000;
+    entry.committed = committed;
+    return entry;
+}
+
+void TestTransferJournal::init() { QFile::remove(path()); }
+
+void TestTransferJournal::replays_entries() {
+    quint64 kept = 0;
+    quint64 upload = 0;
+    {
+        TransferJournal journal(path());
+        QVERIFY(journal.open());
+        kept = journal.add(download("a", 100));
+        quint64 gone = journal.add(download("b", 0));
+
+        TransferJournal::Entry up;
+        up.kind = TransferJournal::Kind::Upload;
+        up.remote_path = "c";
+        up.local_path = "/tmp/c";
+        up.upload_id = "42";
+        up.part_size = 5;
+        up.acked_parts = QBitArray(4);
+        up.acked_parts.setBit(1);
+        up.local_mtime = 1700000000123;
+        upload = journal.add(up);
+
+        TransferJournal::Entry updated = *journal.find(kept);
+        updated.committed = 600;
+        updated.attempts = 2;
+        journal.update(updated);
+        journal.remove(gone);
+    }
+
+    TransferJournal journal(path());
+    QVERIFY(journal.open());
+    QCOMPARE(journal.entries().size(), qsizetype(2));
+    const auto* a = journal.find(kept);
+    QVERIFY(a);
+    QCOMPARE(a->committed, qint64(600));
+    QCOMPARE(a->attempts, 2);
+    const auto* c = journal.find(upload);
+    QVERIFY(c);
+    QCOMPARE(c->upload_id, QString("42"));
+    QCOMPARE(c->acked_parts.size(), qsizetype(4));
+    QVERIFY(c->acked_parts.testBit(1));
+    QVERIFY(!c->acked_parts.testBit(0));
+    QCOMPARE(c->local_mtime, qint64(1700000000123));
+    // Ids are never reused after a restart
+    QVERIFY(journal.add(download("d", 0)) > upload);
+}
+
+void TestTransferJournal::truncates_torn_tail() {
+    quint64 first = 0;
+    {
+        TransferJournal journal(path());
+        QVERIFY(journal.open());
+        first = journal.add(download("a", 10));
+    }
+    // A record header that promises more than was written, as after a crash mid-append
+    QFile file(path());
+    QVERIFY(file.open(QIODevice::Append));
+    file.write(QByteArray::fromHex("00010000deadbeef0102"));
+    file.close();
+
+    quint64 second = 0;
+    {
+        TransferJournal journal(path());
+        QVERIFY(journal.open());
+        QCOMPARE(journal.entries().size(), qsizetype(1));
+        second = journal.add(download("b", 20));
+    }
+    // The torn bytes are gone, so the record written after them replays too
+    TransferJournal journal(path());
+    QVERIFY(journal.open());
+    QVERIFY(journal.find(first));
+    QVERIFY(journal.find(second));
+}
+
+void TestTransferJournal::stops_at_corrupt_record() {
+    qint64 first_end = 0;
+    quint64 first = 0;
+    {
+        TransferJournal journal(path());
+        QVERIFY(journal.open());
+        first = journal.add(download("a", 10));
+        first_end = QFileInfo(path()).size();
+        journal.add(download("b", 20));
+    }
+    // Flip a payload byte of the second record; its checksum no longer matches
+    QFile file(path());
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QVERIFY(file.seek(first_end + 10));
+    char byte = 0;
+    QVERIFY(file.getChar(&byte));
+    QVERIFY(file.seek(first_end + 10));
+    QVERIFY(file.putChar(static_cast<char>(byte ^ 0x55)));
+    file.close();
+
+    TransferJournal journal(path());
+    QVERIFY(journal.open());
+    QCOMPARE(journal.entries().size(), qsizetype(1));
+    QVERIFY(journal.find(first));
+}
+
+void TestTransferJournal::starts_over_on_foreign_file() {
+    QFile file(path());
+    QVERIFY(file.open(QIODevice::WriteOnly));
+    file.write("not a journal at all");
+    file.close();
+
+    TransferJournal journal(path());
+    QVERIFY(journal.open());
+    QVERIFY(journal.entries().isEmpty());
+    quint64 id = journal.add(download("a", 0));
+    QVERIFY(journal.find(id));
+}
+
+QTEST_GUILESS_MAIN(TestTransferJournal)
+#include "tst_transfer_journal.moc"
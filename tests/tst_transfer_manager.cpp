@@ -0,0 +1,149 @@
+#include <QDir>
+#include <QSignalSpy>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QtTest>
+#include "sap_cloud_client/transfer_manager.h"
+#include "sap_cloud_client/upload_session.h"
+#include "support/stub_server.h"
+#include "support/test_data.h"
+
+using namespace sap::client;
+using namespace sap::client::test;
+
+class TestTransferManager : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+    void download_survives_dropped_connection();
+    void session_upload_survives_dropped_parts();
+    void cancelled_queued_download_leaves_no_entry();
+
+private:
+    static QString app_data() { return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation); }
+    // What a restart would find in the manager's journal
+    static QList<TransferJournal::Entry> journal_entries();
+    FileInfo remote(const QString& path) const;
+
+    std::unique_ptr<StubServer> m_Server;
+    std::unique_ptr<ApiClient> m_Api;
+    std::unique_ptr<TransferScheduler> m_Scheduler;
+    std::unique_ptr<TransferManager> m_Manager;
+    std::unique_ptr<QTemporaryDir> m_Dir;
+};
+
+void TestTransferManager::initTestCase() { QStandardPaths::setTestModeEnabled(true); }
+
+void TestTransferManager::init() {
+    // A fresh journal and chunk index for every test
+    QDir(app_data()).removeRecursively();
+    m_Dir = std::make_unique<QTemporaryDir>();
+    m_Server = std::make_unique<StubServer>();
+    QVERIFY(m_Server->listen());
+    m_Api = std::make_unique<ApiClient>();
+    m_Api->set_server_url(m_Server->url());
+    m_Api->set_token("token");
+    m_Scheduler = std::make_unique<TransferScheduler>();
+    m_Manager = std::make_unique<TransferManager>(m_Api.get(), m_Scheduler.get());
+}
+
+void TestTransferManager::cleanup() {
+    m_Manager.reset();
+    m_Scheduler.reset();
+    m_Api.reset();
+    m_Server.reset();
+}
+
+QList<TransferJournal::Entry> TestTransferManager::journal_entries() {
+    TransferJournal journal(app_data() + "/transfers.journal");
+    if (!journal.open())
+        return {};
+    return journal.entries();
+}
+
+FileInfo TestTransferManager::remote(const QString& path) const {
+    FileInfo info;
+    info.path = path;
+    info.size = m_Server->file(path).size();
+    info.hash = StubServer::hash_of(m_Server->file(path));
+    return info;
+}
+
+void TestTransferManager::download_survives_dropped_connection() {
+    QByteArray data = random_bytes(4 * 1024 * 1024, 3);
+    m_Server->put_file("dir/file.bin", data);
+    m_Server->faults().drop_after = 1536 * 1024;
+    m_Server->faults().drop_count = 1;
+
+    QString local = m_Dir->filePath("file.bin");
+    m_Manager->download(remote("dir/file.bin"), local);
+
+    // The retry waits out its backoff, then continues the part file
+    QTRY_VERIFY_WITH_TIMEOUT(QFile::exists(local), 20000);
+    QCOMPARE(read_file(local), data);
+    QVERIFY(!QFile::exists(local + ".part"));
+    QCOMPARE(m_Server->ranges().size(), qsizetype(1));
+    QVERIFY(m_Server->ranges().first().startsWith("bytes="));
+    QVERIFY(m_Server->ranges().first() != "bytes=0-");
+    QTRY_VERIFY(m_Scheduler->is_idle());
+
+    m_Manager.reset();
+    QVERIFY(journal_entries().isEmpty());
+}
+
+void TestTransferManager::session_upload_survives_dropped_parts() {
+    // No content chunks on this server, so a large file goes through an upload session
+    m_Server->faults().missing_endpoints = {"/api/v1/chunks", "/api/v1/manifests"};
+    m_Server->faults().drop_prefix = "/api/v1/uploads/1/parts/";
+    m_Server->faults().drop_requests = 2;
+
+    QByteArray data = random_bytes(UploadSession::k_MinFileSize + 3 * 1024 * 1024, 4);
+    QString local = m_Dir->filePath("big.bin");
+    QVERIFY(write_file(local, data));
+
+    QSignalSpy finished(m_Manager.get(), &TransferManager::upload_finished);
+    m_Manager->upload(local, "backup/big.bin");
+    QTRY_COMPARE_WITH_TIMEOUT(finished.size(), 1, 30000);
+    QCOMPARE(finished.first().at(0).toString(), local);
+    QVERIFY(finished.first().at(1).toBool());
+
+    QVERIFY(!m_Api->supports(ApiClient::Feature::ContentChunks));
+    QCOMPARE(m_Server->requests("POST uploads"), 1);
+    QVERIFY(m_Server->requests("PUT part") >= 2 + 2);
+    QCOMPARE(m_Server->requests("PUT files"), 0);
+    QCOMPARE(m_Server->file("backup/big.bin"), data);
+
+    m_Manager.reset();
+    QVERIFY(journal_entries().isEmpty());
+}
+
+void TestTransferManager::cancelled_queued_download_leaves_no_entry() {
+    m_Scheduler->set_concurrency_bounds(1, 1);
+    // Slow enough that the first download is still running when the second is cancelled
+    m_Server->faults().bytes_per_sec = 256 * 1024;
+    m_Server->put_file("a.bin", random_bytes(2 * 1024 * 1024, 5));
+    m_Server->put_file("b.bin", random_bytes(2 * 1024 * 1024, 6));
+
+    QSignalSpy finished(m_Scheduler.get(), &TransferScheduler::job_finished);
+    auto running = m_Manager->download(remote("a.bin"), m_Dir->filePath("a.bin"));
+    auto queued = m_Manager->download(remote("b.bin"), m_Dir->filePath("b.bin"));
+    QTRY_COMPARE(m_Scheduler->job(running)->state, TransferScheduler::JobState::Running);
+    QCOMPARE(m_Scheduler->job(queued)->state, TransferScheduler::JobState::Queued);
+    QCOMPARE(journal_entries().size(), qsizetype(2));
+
+    m_Scheduler->cancel(queued);
+    QCOMPARE(journal_entries().size(), qsizetype(1));
+    QCOMPARE(journal_entries().first().remote_path, QString("a.bin"));
+
+    m_Scheduler->cancel_all();
+    QCOMPARE(finished.size(), 2);
+    QTRY_VERIFY(journal_entries().isEmpty());
+    QTRY_VERIFY(!QFile::exists(m_Dir->filePath("a.bin.part")));
+    QVERIFY(!QFile::exists(m_Dir->filePath("b.bin.part")));
+}
+
+QTEST_GUILESS_MAIN(TestTransferManager)
+#include "tst_transfer_manager.moc"
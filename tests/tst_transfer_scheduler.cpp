@@ -0,0 +1,132 @@
+#include <QSignalSpy>
+#include <QtTest>
+#include "sap_cloud_client/transfer_scheduler.h"
+
+using namespace sap::client;
+
+class TestTransferScheduler : public QObject {
+    Q_OBJECT
+
+private slots:
+    void respects_concurrency_limit();
+    void cancelled_queued_job_finishes_once();
+    void cancelled_running_job_is_aborted();
+    void cancel_all_finishes_everything();
+
+private:
+    // A job that waits for the test to finish it through m_Done
+    TransferScheduler::JobId enqueue(TransferScheduler& scheduler, int* aborted = nullptr);
+
+    QHash<TransferScheduler::JobId, TransferScheduler::DoneFn> m_Done;
+    int m_Started = 0;
+};
+
+TransferScheduler::JobId TestTransferScheduler::enqueue(TransferScheduler& scheduler, int* aborted) {
+    auto id = std::make_shared<TransferScheduler::JobId>(0);
+    *id = scheduler.enqueue(TransferScheduler::JobKind::Other, "job", 100, [this, id, aborted](ProgressFn, TransferScheduler::DoneFn done) {
+        m_Started++;
+        m_Done.insert(*id, done);
+        return TransferScheduler::AbortFn([aborted]() {
+            if (aborted)
+                (*aborted)++;
+        });
+    });
+    return *id;
+}
+
+void TestTransferScheduler::respects_concurrency_limit() {
+    m_Done.clear();
+    m_Started = 0;
+    TransferScheduler scheduler;
+    scheduler.set_concurrency_bounds(2, 2);
+    QSignalSpy finished(&scheduler, &TransferScheduler::job_finished);
+    QSignalSpy batch(&scheduler, &TransferScheduler::batch_finished);
+    for (int i = 0; i < 5; ++i)
+        enqueue(scheduler);
+
+    QTRY_COMPARE(m_Started, 2);
+    QCOMPARE(scheduler.stats().running, 2);
+    QCOMPARE(scheduler.stats().queued, 3);
+
+    // Each completion lets exactly one more in
+    while (finished.size() < 5) {
+        auto ids = m_Done.keys();
+        QVERIFY(!ids.isEmpty());
+        m_Done.take(ids.first())(true);
+        QVERIFY(scheduler.stats().running <= 2);
+        QCoreApplication::processEvents();
+    }
+    QCOMPARE(m_Started, 5);
+    QTRY_COMPARE(batch.size(), 1);
+    QCOMPARE(batch.first().at(0).toInt(), 5);
+    QVERIFY(scheduler.is_idle());
+}
+
+void TestTransferScheduler::cancelled_queued_job_finishes_once() {
+    m_Done.clear();
+    m_Started = 0;
+    TransferScheduler scheduler;
+    scheduler.set_concurrency_bounds(1, 1);
+    QSignalSpy finished(&scheduler, &TransferScheduler::job_finished);
+    auto first = enqueue(scheduler);
+    auto second = enqueue(scheduler);
+    QTRY_COMPARE(m_Started, 1);
+
+    scheduler.cancel(second);
+    QCOMPARE(finished.size(), 1);
+    QCOMPARE(finished.first().at(0).value<TransferScheduler::JobId>(), second);
+    QVERIFY(!finished.first().at(1).toBool());
+    QCOMPARE(scheduler.job(second)->state, TransferScheduler::JobState::Cancelled);
+
+    m_Done.take(first)(true);
+    QCoreApplication::processEvents();
+    // The cancelled job never starts and isn't reported again
+    QCOMPARE(m_Started, 1);
+    QCOMPARE(finished.size(), 2);
+    QVERIFY(scheduler.is_idle());
+}
+
+void TestTransferScheduler::cancelled_running_job_is_aborted() {
+    m_Done.clear();
+    m_Started = 0;
+    TransferScheduler scheduler;
+    QSignalSpy finished(&scheduler, &TransferScheduler::job_finished);
+    int aborted = 0;
+    auto id = enqueue(scheduler, &aborted);
+    QTRY_COMPARE(m_Started, 1);
+
+    scheduler.cancel(id);
+    QCOMPARE(aborted, 1);
+    QCOMPARE(finished.size(), 1);
+    // A done() that arrives after the cancel is ignored
+    m_Done.take(id)(true);
+    QCOMPARE(finished.size(), 1);
+    QCOMPARE(scheduler.job(id)->state, TransferScheduler::JobState::Cancelled);
+}
+
+void TestTransferScheduler::cancel_all_finishes_everything() {
+    m_Done.clear();
+    m_Started = 0;
+    TransferScheduler scheduler;
+    scheduler.set_concurrency_bounds(2, 2);
+    QSignalSpy finished(&scheduler, &TransferScheduler::job_finished);
+    QSignalSpy batch(&scheduler, &TransferScheduler::batch_finished);
+    int aborted = 0;
+    for (int i = 0; i < 6; ++i)
+        enqueue(scheduler, &aborted);
+    QTRY_COMPARE(m_Started, 2);
+
+    scheduler.cancel_all();
+    QCOMPARE(aborted, 2);
+    QCOMPARE(finished.size(), 6);
+    QSet<TransferScheduler::JobId> ids;
+    for (const auto& args : finished)
+        ids.insert(args.at(0).value<TransferScheduler::JobId>());
+    QCOMPARE(ids.size(), 6);
+    QVERIFY(scheduler.is_idle());
+    QTRY_COMPARE(batch.size(), 1);
+    QCOMPARE(batch.first().at(2).toInt(), 6);
+}
+
+QTEST_GUILESS_MAIN(TestTransferScheduler)
+#include "tst_transfer_scheduler.moc"
@@ -0,0 +1,175 @@
+#include <QFileInfo>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QtTest>
+#include "sap_cloud_client/api_client.h"
+#include "sap_cloud_client/upload_session.h"
+#include "sap_cloud_client/upload_source.h"
+#include "support/stub_server.h"
+#include "support/test_data.h"
+
+using namespace sap::client;
+using namespace sap::client::test;
+
+class TestUploadSession : public QObject {
+    Q_OBJECT
+
+private slots:
+    void init();
+    void retries_dropped_parts();
+    void resume_sends_only_missing_parts();
+    void resume_restarts_after_an_edit();
+    void refuses_a_stitched_body();
+    void fails_after_too_many_retries();
+
+private:
+    QString local() const { return m_Dir.filePath("big.bin"); }
+    qint64 local_mtime() const { return QFileInfo(local()).lastModified().toMSecsSinceEpoch(); }
+    // Session with parts 0 and 2 acknowledged, as an earlier run would leave it
+    void interrupted_session(QString* id);
+    // Same size, different bytes in every part; optionally keeps the old mtime
+    void edit_in_place(bool keep_mtime);
+    // 4 parts of k_MinPartSize, the last one short
+    static constexpr qint64 k_FileSize = 3 * UploadSession::k_MinPartSize + 12345;
+
+    std::unique_ptr<StubServer> m_Server;
+    std::unique_ptr<ApiClient> m_Api;
+    QTemporaryDir m_Dir;
+    QByteArray m_Data;
+};
+
+void TestUploadSession::init() {
+    m_Server = std::make_unique<StubServer>();
+    QVERIFY(m_Server->listen());
+    m_Api = std::make_unique<ApiClient>();
+    m_Api->set_server_url(m_Server->url());
+    m_Api->set_token("token");
+    m_Data = random_bytes(k_FileSize, 2);
+    QVERIFY(write_file(local(), m_Data));
+}
+
+void TestUploadSession::retries_dropped_parts() {
+    m_Server->faults().drop_prefix = "/api/v1/uploads/1/parts/";
+    m_Server->faults().drop_requests = 2;
+
+    UploadSession session(m_Api.get(), local(), "big.bin");
+    QSignalSpy acked(&session, &UploadSession::part_acked);
+    QSignalSpy finished(&session, &UploadSession::finished);
+    session.start();
+
+    QTRY_COMPARE_WITH_TIMEOUT(finished.size(), 1, 20000);
+    QVERIFY(finished.first().first().toBool());
+    QCOMPARE(acked.size(), 4);
+    // Every part once, plus the two that were dropped
+    QCOMPARE(m_Server->requests("PUT part"), 6);
+    QCOMPARE(m_Server->file("big.bin"), m_Data);
+}
+
+void TestUploadSession::interrupted_session(QString* id) {
+    qint64 part_size = UploadSession::k_MinPartSize;
+    bool done = false;
+    m_Api->create_upload("big.bin", k_FileSize, part_size, [&](bool ok, UploadStatus status) {
+        QVERIFY(ok);
+        *id = status.id;
+        done = true;
+    });
+    QTRY_VERIFY(done);
+
+    // An earlier run got parts 0 and 2 through before it stopped
+    int acked_before = 0;
+    for (int part : {0, 2}) {
+        auto* source = new UploadSource(local(), part * part_size, part_size);
+        QVERIFY(source->open(QIODevice::ReadOnly));
+        m_Api->upload_part(*id, part, source, {}, [&](bool ok) {
+            if (ok)
+                acked_before++;
+        });
+    }
+    QTRY_COMPARE(acked_before, 2);
+    m_Server->reset_counters();
+}
+
+void TestUploadSession::edit_in_place(bool keep_mtime) {
+    QDateTime mtime = QFileInfo(local()).lastModified();
+    for (qint64 part = 0; part * UploadSession::k_MinPartSize < k_FileSize; ++part)
+        m_Data[part * UploadSession::k_MinPartSize] = static_cast<char>(~m_Data[part * UploadSession::k_MinPartSize]);
+    QFile file(local());
+    QVERIFY(file.open(QIODevice::ReadWrite));
+    QCOMPARE(file.write(m_Data), qint64(m_Data.size()));
+    file.flush();
+    QVERIFY(file.setFileTime(keep_mtime ? mtime : mtime.addSecs(5), QFileDevice::FileModificationTime));
+}
+
+void TestUploadSession::resume_sends_only_missing_parts() {
+    QString id;
+    interrupted_session(&id);
+    QVERIFY(!id.isEmpty());
+
+    UploadSession session(m_Api.get(), local(), "big.bin");
+    QSignalSpy acked(&session, &UploadSession::part_acked);
+    QSignalSpy finished(&session, &UploadSession::finished);
+    session.resume(id, local_mtime());
+
+    QTRY_COMPARE_WITH_TIMEOUT(finished.size(), 1, 20000);
+    QVERIFY(finished.first().first().toBool());
+    QCOMPARE(m_Server->requests("POST uploads"), 0);
+    QCOMPARE(m_Server->requests("PUT part"), 2);
+    QCOMPARE(acked.size(), 2);
+    QCOMPARE(m_Server->file("big.bin"), m_Data);
+}
+
+void TestUploadSession::resume_restarts_after_an_edit() {
+    qint64 mtime = local_mtime();
+    QString id;
+    interrupted_session(&id);
+    QVERIFY(!id.isEmpty());
+    edit_in_place(false);
+
+    UploadSession session(m_Api.get(), local(), "big.bin");
+    QSignalSpy created(&session, &UploadSession::session_created);
+    QSignalSpy finished(&session, &UploadSession::finished);
+    session.resume(id, mtime);
+
+    QTRY_COMPARE_WITH_TIMEOUT(finished.size(), 1, 20000);
+    QVERIFY(finished.first().first().toBool());
+    QCOMPARE(created.size(), 1);
+    QCOMPARE(session.local_mtime(), local_mtime());
+    QCOMPARE(m_Server->requests("PUT part"), 4);
+    QCOMPARE(m_Server->file("big.bin"), m_Data);
+}
+
+void TestUploadSession::refuses_a_stitched_body() {
+    qint64 mtime = local_mtime();
+    QString id;
+    interrupted_session(&id);
+    QVERIFY(!id.isEmpty());
+    // Size and mtime can't tell: only the hash on complete catches old parts 0 and 2 with new 1 and 3
+    edit_in_place(true);
+    QCOMPARE(local_mtime(), mtime);
+
+    UploadSession session(m_Api.get(), local(), "big.bin");
+    QSignalSpy finished(&session, &UploadSession::finished);
+    session.resume(id, mtime);
+
+    QTRY_COMPARE_WITH_TIMEOUT(finished.size(), 1, 20000);
+    QVERIFY(finished.first().first().toBool());
+    QCOMPARE(m_Server->requests("POST complete"), 2);
+    QCOMPARE(m_Server->requests("POST uploads"), 1);
+    QCOMPARE(m_Server->file("big.bin"), m_Data);
+}
+
+void TestUploadSession::fails_after_too_many_retries() {
+    m_Server->faults().drop_prefix = "/api/v1/uploads/1/parts/0";
+    m_Server->faults().drop_requests = UploadSession::k_MaxPartRetries + 1;
+
+    UploadSession session(m_Api.get(), local(), "big.bin");
+    QSignalSpy finished(&session, &UploadSession::finished);
+    session.start();
+
+    QTRY_COMPARE_WITH_TIMEOUT(finished.size(), 1, 20000);
+    QVERIFY(!finished.first().first().toBool());
+    QVERIFY(!m_Server->has_file("big.bin"));
+}
+
+QTEST_GUILESS_MAIN(TestUploadSession)
+#include "tst_upload_session.moc"
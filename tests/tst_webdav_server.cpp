@@ -0,0 +1,201 @@
+#include <QDir>
+#include <QSignalSpy>
+#include <QStandardPaths>
+#include <QTcpSocket>
+#include <QtTest>
+#include "sap_cloud_client/offline_store.h"
+#include "sap_cloud_client/sync_engine.h"
+#include "sap_cloud_client/transfer_manager.h"
+#include "sap_cloud_client/webdav_server.h"
+#include "support/stub_server.h"
+#include "support/test_data.h"
+
+using namespace sap::client;
+using namespace sap::client::test;
+
+class TestWebDavServer : public QObject {
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+    void requires_the_session_password();
+    void refuses_a_foreign_host();
+    void serves_ranges_block_by_block();
+    void put_spools_then_uploads();
+
+private:
+    struct Reply {
+        int status = 0;
+        QHash<QByteArray, QByteArray> headers; // lowercase names
+        QByteArray body;
+    };
+
+    // One request on its own connection; the server closes it after answering
+    void exchange(const QByteArray& method, const QByteArray& target, Reply* reply, const QList<QByteArray>& headers = {},
+                  const QByteArray& body = {}, bool authorize = true);
+    QByteArray authorization() const;
+
+    std::unique_ptr<StubServer> m_Server;
+    std::unique_ptr<ApiClient> m_Api;
+    std::unique_ptr<SyncEngine> m_Sync;
+    std::unique_ptr<TransferScheduler> m_Scheduler;
+    std::unique_ptr<TransferManager> m_Transfers;
+    std::unique_ptr<OfflineStore> m_Offline;
+    std::unique_ptr<WebDavServer> m_Dav;
+    QByteArray m_Data;
+};
+
+void TestWebDavServer::initTestCase() { QStandardPaths::setTestModeEnabled(true); }
+
+void TestWebDavServer::init() {
+    QDir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)).removeRecursively();
+    m_Server = std::make_unique<StubServer>();
+    QVERIFY(m_Server->listen());
+    // Three and a bit blocks
+    m_Data = random_bytes(3 * BlockCache::k_BlockSize + 1000, 5);
+    m_Server->put_file("big.bin", m_Data);
+
+    m_Api = std::make_unique<ApiClient>();
+    m_Api->set_server_url(m_Server->url());
+    m_Api->set_token("token");
+    m_Sync = std::make_unique<SyncEngine>(m_Api.get());
+    m_Scheduler = std::make_unique<TransferScheduler>();
+    m_Transfers = std::make_unique<TransferManager>(m_Api.get(), m_Scheduler.get());
+    m_Offline = std::make_unique<OfflineStore>(m_Api.get(), m_Sync.get(), m_Scheduler.get());
+    m_Dav = std::make_unique<WebDavServer>(m_Api.get(), m_Sync.get(), m_Transfers.get(), m_Offline.get());
+
+    m_Sync->start();
+    QTRY_VERIFY(m_Sync->file("big.bin").has_value());
+    QVERIFY(m_Dav->start(0));
+    m_Server->reset_counters();
+}
+
+void TestWebDavServer::cleanup() {
+    m_Dav.reset();
+    m_Offline.reset();
+    m_Transfers.reset();
+    m_Scheduler.reset();
+    m_Sync.reset();
+    m_Api.reset();
+    m_Server.reset();
+}
+
+QByteArray TestWebDavServer::authorization() const {
+    return "Basic " + (m_Dav->user() + ':' + m_Dav->password()).toUtf8().toBase64();
+}
+
+void TestWebDavServer::exchange(const QByteArray& method, const QByteArray& target, Reply* reply, const QList<QByteArray>& headers,
+                                const QByteArray& body, bool authorize) {
+    *reply = {};
+    QTcpSocket socket;
+    socket.connectToHost(QHostAddress::LocalHost, QUrl(m_Dav->url()).port());
+    QVERIFY(QTest::qWaitFor([&]() { return socket.state() == QAbstractSocket::ConnectedState; }, 5000));
+
+    QByteArray request = method + ' ' + target + " HTTP/1.1\r\nConnection: close\r\n";
+    bool has_host = false;
+    for (const auto& header : headers) {
+        request += header + "\r\n";
+        has_host = has_host || header.toLower().startsWith("host:");
+    }
+    if (!has_host)
+        request += "Host: 127.0.0.1\r\n";
+    if (authorize)
+        request += "Authorization: " + authorization() + "\r\n";
+    request += "Content-Length: " + QByteArray::number(body.size()) + "\r\n\r\n" + body;
+    socket.write(request);
+
+    QByteArray response;
+    QVERIFY(QTest::qWaitFor(
+        [&]() {
+            response += socket.readAll();
+            return socket.state() == QAbstractSocket::UnconnectedState;
+        },
+        20000));
+    response += socket.readAll();
+
+    qsizetype head_end = response.indexOf("\r\n\r\n");
+    QVERIFY(head_end > 0);
+    QList<QByteArray> lines = response.left(head_end).split('\n');
+    reply->status = lines.takeFirst().split(' ').value(1).toInt();
+    for (const auto& line : lines) {
+        qsizetype colon = line.indexOf(':');
+        if (colon > 0)
+            reply->headers.insert(line.left(colon).trimmed().toLower(), line.mid(colon + 1).trimmed());
+    }
+    reply->body = response.mid(head_end + 4);
+}
+
+void TestWebDavServer::requires_the_session_password() {
+    Reply reply;
+    exchange("GET", "/big.bin", &reply, {}, {}, false);
+    QCOMPARE(reply.status, 401);
+    QVERIFY(reply.headers.value("www-authenticate").startsWith("Basic"));
+
+    exchange("GET", "/big.bin", &reply, {"Authorization: Basic " + QByteArray("sap:guess").toBase64()}, {}, false);
+    QCOMPARE(reply.status, 401);
+    // Refused before anything is fetched for it
+    QCOMPARE(m_Server->requests("GET files"), 0);
+
+    exchange("PROPFIND", "/", &reply, {"Depth: 1"});
+    QCOMPARE(reply.status, 207);
+    QVERIFY(reply.body.contains("big.bin"));
+}
+
+void TestWebDavServer::refuses_a_foreign_host() {
+    Reply reply;
+    exchange("GET", "/big.bin", &reply, {"Host: rebound.example:8765"});
+    QCOMPARE(reply.status, 403);
+    exchange("GET", "/big.bin", &reply, {"Host: localhost"});
+    QCOMPARE(reply.status, 200);
+    QCOMPARE(reply.body, m_Data);
+}
+
+void TestWebDavServer::serves_ranges_block_by_block() {
+    // Straddles the boundary of blocks 0 and 1
+    qint64 start = BlockCache::k_BlockSize - 100;
+    qint64 last = BlockCache::k_BlockSize + 99;
+    Reply reply;
+    exchange("GET", "/big.bin", &reply, {"Range: bytes=" + QByteArray::number(start) + '-' + QByteArray::number(last)});
+    QCOMPARE(reply.status, 206);
+    QCOMPARE(reply.body, m_Data.mid(start, last - start + 1));
+    QCOMPARE(reply.headers.value("content-range"),
+             "bytes " + QByteArray::number(start) + '-' + QByteArray::number(last) + '/' + QByteArray::number(m_Data.size()));
+    // Blocks 0 and 1, and nothing of the rest of the file
+    QCOMPARE(m_Server->ranges().size(), qsizetype(2));
+    QCOMPARE(m_Dav->cache()->stats().bytes_fetched, 2 * BlockCache::k_BlockSize);
+
+    // A suffix range, from the short last block
+    exchange("GET", "/big.bin", &reply, {"Range: bytes=-500"});
+    QCOMPARE(reply.status, 206);
+    QCOMPARE(reply.body, m_Data.right(500));
+
+    exchange("GET", "/big.bin", &reply, {"Range: bytes=" + QByteArray::number(m_Data.size()) + '-'});
+    QCOMPARE(reply.status, 416);
+    QCOMPARE(reply.headers.value("content-range"), "bytes */" + QByteArray::number(m_Data.size()));
+}
+
+void TestWebDavServer::put_spools_then_uploads() {
+    QByteArray data = random_bytes(200 * 1024, 6);
+    QSignalSpy uploaded(m_Transfers.get(), &TransferManager::upload_finished);
+    Reply reply;
+    exchange("PUT", "/new.bin", &reply, {}, data);
+    QCOMPARE(reply.status, 201);
+    QCOMPARE(uploaded.size(), 1);
+    QVERIFY(uploaded.first().at(1).toBool());
+    QCOMPARE(m_Server->file("new.bin"), data);
+
+    // Served from the spool until the index catches up, then from the index
+    exchange("GET", "/new.bin", &reply);
+    QCOMPARE(reply.status, 200);
+    QCOMPARE(reply.body, data);
+
+    // Overwriting answers 204
+    exchange("PUT", "/new.bin", &reply, {}, data.left(1000));
+    QCOMPARE(reply.status, 204);
+    QCOMPARE(m_Server->file("new.bin"), data.left(1000));
+}
+
+QTEST_GUILESS_MAIN(TestWebDavServer)
+#include "tst_webdav_server.moc"